@@ -462,7 +462,7 @@
  * @note    The default is @p FALSE.
  */
 #if !defined(CH_DBG_STATISTICS)
-#define CH_DBG_STATISTICS                   FALSE
+#define CH_DBG_STATISTICS                   TRUE
 #endif
 
 /**
@@ -541,7 +541,7 @@
  * @note    The default is @p FALSE.
  */
 #if !defined(CH_DBG_FILL_THREADS)
-#define CH_DBG_FILL_THREADS                 FALSE
+#define CH_DBG_FILL_THREADS                 TRUE
 #endif
 
 /**
@@ -620,14 +620,16 @@
  * @brief   ISR enter hook.
  */
 #define CH_CFG_IRQ_PROLOGUE_HOOK() {                                        \
-  /* IRQ prologue code here.*/                                              \
+  extern void cmIrqPrologue(void);                                          \
+  cmIrqPrologue();                                                          \
 }
 
 /**
  * @brief   ISR exit hook.
  */
 #define CH_CFG_IRQ_EPILOGUE_HOOK() {                                        \
-  /* IRQ epilogue code here.*/                                              \
+  extern void cmIrqEpilogue(void);                                          \
+  cmIrqEpilogue();                                                          \
 }
 
 /**
@@ -0,0 +1,351 @@
+/**
+ * @file    gtrackconf.h
+ * @brief   Application configuration header.
+ * @details Settings of the tracker application, every setting can be
+ *          overridden from the Makefile.
+ */
+
+#ifndef GTRACKCONF_H
+#define GTRACKCONF_H
+
+/*===========================================================================*/
+/**
+ * @name Network settings
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Access point name of the mobile data connection.
+ */
+#if !defined(GTRACK_APN)
+#define GTRACK_APN                          "internet"
+#endif
+
+/**
+ * @brief   Host name or address of the tracking server.
+ */
+#if !defined(GTRACK_SERVER_HOST)
+#define GTRACK_SERVER_HOST                  "track.example.com"
+#endif
+
+/**
+ * @brief   TCP port of the tracking server.
+ */
+#if !defined(GTRACK_SERVER_PORT)
+#define GTRACK_SERVER_PORT                  5050
+#endif
+
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name Upload settings
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Target delivery latency of a fix on a good link.
+ * @note    Doubled on a weak link, on a poor link and on low supply.
+ */
+#if !defined(GTRACK_UPLOAD_LATENCY_IN_MS)
+#define GTRACK_UPLOAD_LATENCY_IN_MS         60000
+#endif
+
+/**
+ * @brief   Number of pending fixes worth a session on a good link.
+ */
+#if !defined(GTRACK_UPLOAD_GOOD_BATCH)
+#define GTRACK_UPLOAD_GOOD_BATCH            12
+#endif
+
+/**
+ * @brief   Number of pending fixes worth a session on a weak link.
+ */
+#if !defined(GTRACK_UPLOAD_WEAK_BATCH)
+#define GTRACK_UPLOAD_WEAK_BATCH            60
+#endif
+
+/**
+ * @brief   Signal levels in dBm, a good link is at or above the first, a
+ *          poor link is below the second.
+ */
+#if !defined(GTRACK_UPLOAD_GOOD_RSSI)
+#define GTRACK_UPLOAD_GOOD_RSSI             -85
+#endif
+
+#if !defined(GTRACK_UPLOAD_POOR_RSSI)
+#define GTRACK_UPLOAD_POOR_RSSI             -101
+#endif
+
+/**
+ * @brief   Modem supply below which uploads are batched harder.
+ */
+#if !defined(GTRACK_UPLOAD_LOW_SUPPLY_IN_MV)
+#define GTRACK_UPLOAD_LOW_SUPPLY_IN_MV      3600
+#endif
+
+/**
+ * @brief   Upload the outbox in UDP datagrams with application level
+ *          acknowledgements instead of a TCP connection.
+ */
+#if !defined(GTRACK_UPLOAD_UDP)
+#define GTRACK_UPLOAD_UDP                   FALSE
+#endif
+
+/**
+ * @brief   UDP port of the reporting service on GTRACK_SERVER_HOST.
+ */
+#if !defined(GTRACK_UDP_PORT)
+#define GTRACK_UDP_PORT                     5052
+#endif
+
+/**
+ * @brief   Retry period after a failed upload session.
+ */
+#if !defined(GTRACK_UPLOAD_RETRY_IN_MS)
+#define GTRACK_UPLOAD_RETRY_IN_MS           10000
+#endif
+
+/**
+ * @brief   Number of fixes read from the outbox for a single packet.
+ * @note    Fixes that do not fit in a single send are left for the next
+ *          packet, at most 255.
+ */
+#if !defined(GTRACK_UPLOAD_BATCH_SIZE)
+#define GTRACK_UPLOAD_BATCH_SIZE            200
+#endif
+
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name Live tracking settings
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Stream the position over a transparent connection while riding.
+ * @note    Can be switched at run time with the "live" shell command.
+ */
+#if !defined(GTRACK_LIVE_TRACKING)
+#define GTRACK_LIVE_TRACKING                FALSE
+#endif
+
+/**
+ * @brief   TCP port of the live tracking service on GTRACK_SERVER_HOST.
+ */
+#if !defined(GTRACK_LIVE_PORT)
+#define GTRACK_LIVE_PORT                    5051
+#endif
+
+/**
+ * @brief   Period of the live position reports.
+ */
+#if !defined(GTRACK_LIVE_PERIOD_IN_MS)
+#define GTRACK_LIVE_PERIOD_IN_MS            1000
+#endif
+
+/**
+ * @brief   Minimum time between two escapes of the live connection for the
+ *          GNSS and network queries.
+ * @note    Every escape costs the reports of about two seconds, the GNSS
+ *          position is updated once per window while streaming.
+ */
+#if !defined(GTRACK_LIVE_WINDOW_PERIOD_IN_MS)
+#define GTRACK_LIVE_WINDOW_PERIOD_IN_MS     10000
+#endif
+
+/**
+ * @brief   Period of the signal quality and operator refresh.
+ * @note    Registration changes are reported by URCs in between.
+ */
+#if !defined(GTRACK_NETWORK_REFRESH_IN_MS)
+#define GTRACK_NETWORK_REFRESH_IN_MS        30000
+#endif
+
+/**
+ * @brief   Numbers allowed to query the location, separated by commas.
+ * @note    Messages from other numbers are deleted without a reply.
+ * @note    Numbers are compared in full as E.164 numbers, "+" or "00" and
+ *          the country code first. Blanks, dashes, dots and brackets are
+ *          ignored.
+ */
+#if !defined(GTRACK_SMS_WHITELIST)
+#define GTRACK_SMS_WHITELIST                ""
+#endif
+
+/**
+ * @brief   Country code of the national numbers, without "+".
+ * @note    A number without "+" or "00" is taken as national, its trunk
+ *          prefix is replaced with this code. If it is empty, national
+ *          numbers match nothing.
+ */
+#if !defined(GTRACK_SMS_COUNTRY_CODE)
+#define GTRACK_SMS_COUNTRY_CODE             ""
+#endif
+
+/**
+ * @brief   Trunk prefix of the national numbers.
+ */
+#if !defined(GTRACK_SMS_TRUNK_PREFIX)
+#define GTRACK_SMS_TRUNK_PREFIX             "0"
+#endif
+
+/**
+ * @brief   Period of listing the message storage.
+ * @note    Catches messages whose URC was held back by a transparent link.
+ */
+#if !defined(GTRACK_SMS_SCAN_PERIOD_IN_MS)
+#define GTRACK_SMS_SCAN_PERIOD_IN_MS        60000
+#endif
+
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name Location settings
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Refresh period of the cell based location while GNSS has no fix.
+ */
+#if !defined(GTRACK_CELL_LOCATION_PERIOD_IN_MS)
+#define GTRACK_CELL_LOCATION_PERIOD_IN_MS   60000
+#endif
+
+/**
+ * @brief   Fences loaded from the SD card, read again when GNSS starts if
+ *          the file changed.
+ */
+#if !defined(GTRACK_GEOFENCE_FILE)
+#define GTRACK_GEOFENCE_FILE                "/fences.txt"
+#endif
+
+/**
+ * @brief   Storage of the fences, the grid has SIZE * SIZE cells.
+ */
+#if !defined(GTRACK_GEOFENCE_MAX_FENCES)
+#define GTRACK_GEOFENCE_MAX_FENCES          128
+#endif
+
+#if !defined(GTRACK_GEOFENCE_MAX_VERTICES)
+#define GTRACK_GEOFENCE_MAX_VERTICES        1024
+#endif
+
+#if !defined(GTRACK_GEOFENCE_GRID_SIZE)
+#define GTRACK_GEOFENCE_GRID_SIZE           12
+#endif
+
+/**
+ * @brief   GNSS fixes on the other side of a border before it counts.
+ */
+#if !defined(GTRACK_GEOFENCE_DEBOUNCE)
+#define GTRACK_GEOFENCE_DEBOUNCE            3
+#endif
+
+/**
+ * @brief   Motion without ignition turns GNSS and the fences on until this
+ *          long after the last motion.
+ */
+#if !defined(GTRACK_MOTION_WATCH_TIME_IN_MS)
+#define GTRACK_MOTION_WATCH_TIME_IN_MS      300000
+#endif
+
+/**
+ * @brief   The running totals of a trip are saved this often, a power loss
+ *          loses at most this much of the trip.
+ */
+#if !defined(GTRACK_TRIP_SAVE_PERIOD_IN_S)
+#define GTRACK_TRIP_SAVE_PERIOD_IN_S        60
+#endif
+
+/**
+ * @brief   A trip left open by a power loss is continued if riding starts
+ *          again within this time, else it is closed first.
+ */
+#if !defined(GTRACK_TRIP_RESUME_GAP_IN_S)
+#define GTRACK_TRIP_RESUME_GAP_IN_S         3600
+#endif
+
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name Sensor fusion settings
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Publication period of the fused position, the accelerometer
+ *          FIFO is read this often.
+ * @note    The FIFO holds 32 samples, 1.28 s at 25 Hz.
+ */
+#if !defined(GTRACK_FUSION_PERIOD_IN_MS)
+#define GTRACK_FUSION_PERIOD_IN_MS          200
+#endif
+
+/**
+ * @brief   Raw fixes and samples written by "fusion rec", the input of
+ *          tools/fusion_replay.c.
+ */
+#if !defined(GTRACK_FUSION_LOG_FILE)
+#define GTRACK_FUSION_LOG_FILE              "/fusion.log"
+#endif
+
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name Firmware update settings
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Flash region the new image is downloaded to.
+ * @note    The running image has to fit below it.
+ */
+#if !defined(GTRACK_OTA_SLOT_ADDRESS)
+#define GTRACK_OTA_SLOT_ADDRESS             0x08020000
+#endif
+
+#if !defined(GTRACK_OTA_SLOT_SIZE)
+#define GTRACK_OTA_SLOT_SIZE                (128 * 1024)
+#endif
+
+/**
+ * @brief   Bytes requested from the server by a single HTTP request.
+ * @note    Also the granularity of resuming after a lost connection.
+ */
+#if !defined(GTRACK_OTA_SEGMENT_SIZE)
+#define GTRACK_OTA_SEGMENT_SIZE             (16 * 1024)
+#endif
+
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name Startup settings
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Power up the modem at start when the ignition is already on,
+ *          instead of at the ignition event.
+ * @note    /boot.log tags every report with this setting, builds with and
+ *          without it can be compared there.
+ */
+#if !defined(GTRACK_BOOT_EARLY_MODEM)
+#define GTRACK_BOOT_EARLY_MODEM             TRUE
+#endif
+
+/** @} */
+
+#endif  /* GTRACKCONF_H */
@@ -0,0 +1,163 @@
+/**
+ * @file Bearer.c
+ * @brief Packet data bearer of the modem's IP based applications.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "Bearer.h"
+#include "gtrackconf.h"
+#include "sim8xx.h"
+#include "at.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define BEARER_OPEN_TIMEOUT_IN_MS   30000
+#define CIICR_TIMEOUT_IN_MS         85000
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static mutex_t lock;
+static mutex_t tcpLock;
+static Sim8xxCommand cmd;
+static volatile uint32_t generation;
+static volatile bool tcpWanted;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool isConnected(void) {
+  SAPBR_Status_t status = SAPBR_CLOSED;
+  sim8xxCommandInit(&cmd);
+  atSapbrCreateQuery(cmd.request, sizeof(cmd.request));
+  sim8xxExecute(&SIM8D1, &cmd);
+  return (SIM8XX_OK == cmd.status) &&
+         atSapbrParseQuery(&status, cmd.response) &&
+         (SAPBR_CONNECTED == status);
+}
+
+static bool execute(bool (*create)(char buf[], size_t length),
+                    sysinterval_t timeout) {
+  sim8xxCommandInit(&cmd);
+  create(cmd.request, sizeof(cmd.request));
+  cmd.timeout = timeout;
+  sim8xxExecute(&SIM8D1, &cmd);
+  return SIM8XX_OK == cmd.status;
+}
+
+static bool shutTcp(void) {
+  sim8xxCommandInit(&cmd);
+  atCipshutCreate(cmd.request, sizeof(cmd.request));
+  sim8xxExecute(&SIM8D1, &cmd);
+  return SIM8XX_SHUT_OK == cmd.status;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void brInit(void) {
+  chMtxObjectInit(&lock);
+  chMtxObjectInit(&tcpLock);
+}
+
+bool brOpen(void) {
+  chMtxLock(&lock);
+
+  bool connected = isConnected();
+  if (!connected) {
+    sim8xxCommandInit(&cmd);
+    atSapbrCreateApn(cmd.request, sizeof(cmd.request), GTRACK_APN);
+    sim8xxExecute(&SIM8D1, &cmd);
+
+    connected = (SIM8XX_OK == cmd.status) &&
+                execute(atSapbrCreateContype, 0) &&
+                execute(atSapbrCreateOpen,
+                        TIME_MS2I(BEARER_OPEN_TIMEOUT_IN_MS));
+  }
+
+  chMtxUnlock(&lock);
+  return connected;
+}
+
+void brClose(void) {
+  chMtxLock(&lock);
+  if (isConnected())
+    execute(atSapbrCreateClose, TIME_MS2I(BEARER_OPEN_TIMEOUT_IN_MS));
+  chMtxUnlock(&lock);
+}
+
+/*
+ * A refused application is remembered until the stack is taken again, the
+ * holder of a long session can give way to it.
+ */
+bool brTcpAcquire(void) {
+  bool acquired = chMtxTryLock(&tcpLock);
+  tcpWanted = !acquired;
+  return acquired;
+}
+
+bool brTcpWanted(void) {
+  return tcpWanted;
+}
+
+void brTcpRelease(void) {
+  chMtxUnlock(&tcpLock);
+}
+
+/*
+ * The state left behind by a lost connection is not worth to be recovered,
+ * the context is always shut first. AT+CIFSR answers only with the address
+ * and no final result code, the extended variant is used instead.
+ */
+bool brTcpAttach(bool transparent) {
+  chMtxLock(&lock);
+
+  generation++;
+  bool attached = shutTcp();
+  if (attached) {
+    sim8xxCommandInit(&cmd);
+    atCipmodeCreate(cmd.request, sizeof(cmd.request), transparent);
+    sim8xxExecute(&SIM8D1, &cmd);
+    attached = SIM8XX_OK == cmd.status;
+  }
+  if (attached) {
+    sim8xxCommandInit(&cmd);
+    atCsttCreate(cmd.request, sizeof(cmd.request), GTRACK_APN);
+    sim8xxExecute(&SIM8D1, &cmd);
+    attached = SIM8XX_OK == cmd.status;
+  }
+  attached = attached &&
+             execute(atCiicrCreate, TIME_MS2I(CIICR_TIMEOUT_IN_MS)) &&
+             execute(atCifsrexCreate, 0);
+
+  chMtxUnlock(&lock);
+  return attached;
+}
+
+void brTcpShut(void) {
+  chMtxLock(&lock);
+  generation++;
+  shutTcp();
+  chMtxUnlock(&lock);
+}
+
+uint32_t brTcpGeneration(void) {
+  return generation;
+}
+
+/****************************** END OF FILE **********************************/
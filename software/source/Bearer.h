@@ -0,0 +1,76 @@
+/**
+ * @file Bearer.h
+ * @brief Packet data bearer of the modem's IP based applications.
+ */
+
+#ifndef BEARER_H
+#define BEARER_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void brInit(void);
+
+/**
+ * @brief Open the bearer with GTRACK_APN unless it is already open.
+ * @return True if the bearer is connected.
+ */
+bool brOpen(void);
+
+void brClose(void);
+
+/**
+ * @brief Exclusive use of the single connection TCP/IP stack.
+ * @return False if another application holds the stack.
+ */
+bool brTcpAcquire(void);
+void brTcpRelease(void);
+
+/**
+ * @brief True if another application was refused the stack since it was
+ *        last taken.
+ */
+bool brTcpWanted(void);
+
+/**
+ * @brief Set up the TCP/IP context from scratch with GTRACK_APN.
+ * @param transparent Connections are opened in transparent mode.
+ */
+bool brTcpAttach(bool transparent);
+
+/**
+ * @brief Close the connection and deactivate the TCP/IP context.
+ */
+void brTcpShut(void);
+
+/**
+ * @brief Incremented by every attach and shut, a connection kept open
+ *        between sessions is lost if it changed.
+ */
+uint32_t brTcpGeneration(void);
+
+#endif /* BEARER_H */
+
+/****************************** END OF FILE **********************************/
@@ -29,6 +29,12 @@ event_source_t besUsbConnected;
 event_source_t besUsbDisconnected;
 event_source_t besIgnitionOn;
 event_source_t besIgnitionOff;
+event_source_t besSwitch1On;
+event_source_t besSwitch1Off;
+event_source_t besSwitch2On;
+event_source_t besSwitch2Off;
+event_source_t besAccInterrupt1;
+event_source_t besAccInterrupt2;
 
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
@@ -48,6 +54,12 @@ void boardEventsInit(void) {
     chEvtObjectInit(&besUsbDisconnected);
     chEvtObjectInit(&besIgnitionOn);
     chEvtObjectInit(&besIgnitionOff);
+    chEvtObjectInit(&besSwitch1On);
+    chEvtObjectInit(&besSwitch1Off);
+    chEvtObjectInit(&besSwitch2On);
+    chEvtObjectInit(&besSwitch2Off);
+    chEvtObjectInit(&besAccInterrupt1);
+    chEvtObjectInit(&besAccInterrupt2);
 }
 
 /******************************* END OF FILE ***********************************/
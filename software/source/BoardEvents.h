@@ -32,6 +32,12 @@ extern event_source_t besUsbConnected;
 extern event_source_t besUsbDisconnected;
 extern event_source_t besIgnitionOn;
 extern event_source_t besIgnitionOff;
+extern event_source_t besSwitch1On;
+extern event_source_t besSwitch1Off;
+extern event_source_t besSwitch2On;
+extern event_source_t besSwitch2Off;
+extern event_source_t besAccInterrupt1;
+extern event_source_t besAccInterrupt2;
 
 /*******************************************************************************/
 /* DECLARATION OF GLOBAL FUNCTIONS                                             */
@@ -8,18 +8,45 @@
 /*******************************************************************************/
 #include "BoardMonitorThread.h"
 #include "BoardEvents.h"
+#include "LatencyProbe.h"
+#include "PowerPolicy.h"
 #include "SystemThread.h"
+#include "TraceRecorder.h"
+#include "chprintf.h"
 #include "hal.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
-#define DEBOUNCE_COUNTER_START       10
-#define POLLING_DELAY                10
+#define DEBOUNCE_TIME_IN_MS          100
+#define ACC_DEBOUNCE_TIME_IN_MS      2
+#define POLL_PERIOD_IN_MS            250
+#define INPUT_NUM                    7
+/* Position in inputConfigs. */
+#define INPUT_USB                    1
+#define INPUT_IGNITION               2
+#define POLL_EVENT                   EVENT_MASK(INPUT_NUM)
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
+typedef struct {
+  const char *name;
+  ioline_t line;
+  bool activeLow;
+  bool polled;
+  sysinterval_t debounce;
+  void (*changed)(bool active);
+} BoardInputConfig_t;
+
+typedef struct {
+  const BoardInputConfig_t *config;
+  virtual_timer_t timer;
+  bool active;
+  bool sample;
+  uint32_t edges;
+  uint32_t wakeups;
+} BoardInput_t;
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -28,87 +55,186 @@
 /*******************************************************************************/
 /* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
 /*******************************************************************************/
-static virtual_timer_t monitorTimer;
-static event_source_t monitorTimerEvent;
+static thread_t *monitorThread;
+static BoardInput_t inputs[INPUT_NUM];
+static virtual_timer_t pollTimer;
+static uint32_t pollWakeups;
+static bool powered;
+static time_measurement_t poweredTm;
 
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
 /*******************************************************************************/
+static void sdcardChanged(bool inserted);
+static void usbChanged(bool connected);
+static void ignitionChanged(bool on);
+static void switch1Changed(bool on);
+static void switch2Changed(bool on);
+static void accInterrupt1Changed(bool active);
+static void accInterrupt2Changed(bool active);
+static void startPolling(bool on);
+
+/*
+ * The opto-isolated external inputs pull their line low when active.
+ *
+ * PA9 (USB VBUS) and PB9 (SW1) share EXTI line 9 and only one port can be
+ * routed to it. VBUS wakes the board from Stop 2, so it keeps the edge event
+ * and SW1 is sampled every POLL_PERIOD_IN_MS instead, only while the
+ * ignition or USB is on. A parked board is left idle, SW1 is not seen then.
+ */
+static const BoardInputConfig_t inputConfigs[INPUT_NUM] = {
+  {"sdcard", LINE_SDC_CARD_DETECT, false, false,
+   TIME_MS2I(DEBOUNCE_TIME_IN_MS), sdcardChanged},
+  {"usb", LINE_USB_VBUS_SENSE, false, false, TIME_MS2I(DEBOUNCE_TIME_IN_MS),
+   usbChanged},
+  {"ignition", LINE_EXT_IGNITION, true, false, TIME_MS2I(DEBOUNCE_TIME_IN_MS),
+   ignitionChanged},
+  {"sw1", LINE_EXT_SW1, true, true, TIME_MS2I(DEBOUNCE_TIME_IN_MS),
+   switch1Changed},
+  {"sw2", LINE_EXT_SW2, true, false, TIME_MS2I(DEBOUNCE_TIME_IN_MS),
+   switch2Changed},
+  {"acc int1", LINE_ACC_INT1, false, false,
+   TIME_MS2I(ACC_DEBOUNCE_TIME_IN_MS), accInterrupt1Changed},
+  {"acc int2", LINE_ACC_INT2, false, false,
+   TIME_MS2I(ACC_DEBOUNCE_TIME_IN_MS), accInterrupt2Changed},
+};
 
 /*******************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
 /*******************************************************************************/
-static bool isSdcardInserted(void) {
-  return PAL_HIGH == palReadLine(LINE_SDC_CARD_DETECT) ? true : false;
+/*
+ * A full mailbox means the system thread is stuck, keep the trace of it.
+ */
+static void postSystemEvent(SystemEvent_t evt) {
+  if (MSG_OK != chMBPostTimeout(&systemMailbox, evt, TIME_IMMEDIATE))
+    trFault("mailbox");
 }
 
-static void checkSdcard(void) {
-  static uint8_t counter = DEBOUNCE_COUNTER_START;
-  
-  if (counter > 0) {
-    if (isSdcardInserted()) {
-      if (--counter == 0) {
-        chSysLockFromISR();
-        chEvtBroadcastI(&besSdcardInserted);
-        chSysUnlockFromISR();
-      }
-    }
-    else
-      counter = DEBOUNCE_COUNTER_START;
-  }
-  else {
-    if (!isSdcardInserted()) {
-      counter = DEBOUNCE_COUNTER_START;
-      chSysLockFromISR();
-      chEvtBroadcastI(&besSdcardRemoved);
-      chSysUnlockFromISR();
+static void sdcardChanged(bool inserted) {
+  chEvtBroadcast(inserted ? &besSdcardInserted : &besSdcardRemoved);
+}
+
+/*
+ * The system is told about the ignition and USB together, unplugging USB
+ * does not park a bike with the ignition on. The power-on time is taken
+ * here, the system thread may still be busy when it gets the event.
+ */
+static void updatePowered(void) {
+  bool on = ppPowered(inputs[INPUT_IGNITION].active, inputs[INPUT_USB].active);
+  if (on != powered) {
+    powered = on;
+    startPolling(on);
+    if (on) {
+      chSysLock();
+      lpStart(&poweredTm);
+      chSysUnlock();
     }
+    postSystemEvent(on ? SYS_EVT_IGNITION_ON : SYS_EVT_IGNITION_OFF);
   }
 }
 
-static bool isUsbConnected(void) {
-  return PAL_HIGH == palReadLine(LINE_USB_VBUS_SENSE) ? true : false;
+static void usbChanged(bool connected) {
+  chEvtBroadcast(connected ? &besUsbConnected : &besUsbDisconnected);
+  updatePowered();
 }
 
-static void checkUsb(void) {
-  static uint8_t counter = DEBOUNCE_COUNTER_START;
-  
-  if (counter > 0) {
-    if (isUsbConnected()) {
-      if (--counter == 0) {
-        chSysLockFromISR();
-        chEvtBroadcastI(&besUsbConnected);
-        chMBPostI(&systemMailbox, SYS_EVT_IGNITION_ON);
-        chSysUnlockFromISR();
-      }
-    }
-    else
-      counter = DEBOUNCE_COUNTER_START;
-  }
-  else {
-    if (!isUsbConnected()) {
-      counter = DEBOUNCE_COUNTER_START;
-      chSysLockFromISR();
-      chEvtBroadcastI(&besUsbDisconnected);
-      chMBPostI(&systemMailbox, SYS_EVT_IGNITION_OFF);
-      chSysUnlockFromISR();
-    }
+static void ignitionChanged(bool on) {
+  chEvtBroadcast(on ? &besIgnitionOn : &besIgnitionOff);
+  updatePowered();
+}
+
+static void switch1Changed(bool on) {
+  chEvtBroadcast(on ? &besSwitch1On : &besSwitch1Off);
+}
+
+static void switch2Changed(bool on) {
+  chEvtBroadcast(on ? &besSwitch2On : &besSwitch2Off);
+}
+
+static void accInterrupt1Changed(bool active) {
+  if (active) {
+    chEvtBroadcast(&besAccInterrupt1);
+    postSystemEvent(SYS_EVT_MOTION);
   }
 }
 
-static void monitorTimerCallback(void *p) {
+static void accInterrupt2Changed(bool active) {
+  if (active)
+    chEvtBroadcast(&besAccInterrupt2);
+}
+
+static bool isInputActive(const BoardInput_t *in) {
+  bool high = (PAL_HIGH == palReadLine(in->config->line)) ? true : false;
+  return in->config->activeLow ? !high : high;
+}
+
+/*
+ * The line settled, let the thread sample it.
+ */
+static void debounceCallback(void *p) {
+  BoardInput_t *in = (BoardInput_t *)p;
+  chSysLockFromISR();
+  chEvtSignalI(monitorThread, EVENT_MASK(in - inputs));
+  chSysUnlockFromISR();
+}
+
+/*
+ * Every edge restarts the debounce timer, so it only runs while the line is
+ * bouncing and the system can stay idle otherwise.
+ */
+static void edgeCallback(void *p) {
+  BoardInput_t *in = (BoardInput_t *)p;
+  chSysLockFromISR();
+  in->edges++;
+  chVTSetI(&in->timer, in->config->debounce, debounceCallback, in);
+  chSysUnlockFromISR();
+}
+
+static void pollCallback(void *p) {
   (void)p;
   chSysLockFromISR();
-  chEvtBroadcastI(&monitorTimerEvent);
-  chVTSetI(&monitorTimer, TIME_MS2I(POLLING_DELAY),
-           monitorTimerCallback, NULL);
+  chVTSetI(&pollTimer, TIME_MS2I(POLL_PERIOD_IN_MS), pollCallback, NULL);
+  chEvtSignalI(monitorThread, POLL_EVENT);
   chSysUnlockFromISR();
 }
 
-static void timerEventHandler(eventid_t id) {
-  (void)id;
-  checkSdcard();
-  checkUsb();
+/*
+ * A line may have changed while it was not polled, the first sample only
+ * starts its debouncing.
+ */
+static void startPolling(bool on) {
+  if (!on) {
+    chVTReset(&pollTimer);
+    return;
+  }
+
+  size_t i;
+  for (i = 0; i < INPUT_NUM; ++i) {
+    if (inputs[i].config->polled)
+      inputs[i].sample = isInputActive(&inputs[i]);
+  }
+  chVTSet(&pollTimer, TIME_MS2I(POLL_PERIOD_IN_MS), pollCallback, NULL);
+}
+
+static void checkInput(BoardInput_t *in) {
+  bool active = isInputActive(in);
+  if (active != in->active) {
+    in->active = active;
+    in->config->changed(active);
+  }
+}
+
+/*
+ * The poll period is far longer than the contact bounce, two equal samples in
+ * a row are a settled line.
+ */
+static void pollInput(BoardInput_t *in) {
+  bool active = isInputActive(in);
+  if ((active == in->sample) && (active != in->active)) {
+    in->active = active;
+    in->config->changed(active);
+  }
+  in->sample = active;
 }
 
 /*******************************************************************************/
@@ -119,25 +245,85 @@ THD_FUNCTION(BoardMonitorThread, arg)
     (void)arg;
     chRegSetThreadName("board");
 
-    static const evhandler_t eventHandlers[] = {
-      timerEventHandler
-    };
-    
-    event_listener_t timerEventListener;
-    chEvtRegister(&monitorTimerEvent, &timerEventListener, 0);
-    
+    monitorThread = chThdGetSelfX();
+
+    size_t i;
+    for (i = 0; i < INPUT_NUM; ++i) {
+      BoardInput_t *in = &inputs[i];
+      if (in->config->polled)
+        continue;
+      palEnableLineEvent(in->config->line, PAL_EVENT_MODE_BOTH_EDGES);
+      palSetLineCallback(in->config->line, edgeCallback, in);
+      /* Report the inputs that are already active at startup. */
+      chVTSet(&in->timer, in->config->debounce, debounceCallback, in);
+    }
+
     while(true) {
-      chEvtDispatch(eventHandlers, chEvtWaitOne(ALL_EVENTS));
+      eventmask_t evt = chEvtWaitAny(ALL_EVENTS);
+      if (evt & POLL_EVENT)
+        pollWakeups++;
+      for (i = 0; i < INPUT_NUM; ++i) {
+        BoardInput_t *in = &inputs[i];
+        if (in->config->polled) {
+          if (evt & POLL_EVENT)
+            pollInput(in);
+        } else if (evt & EVENT_MASK(i)) {
+          in->wakeups++;
+          checkInput(in);
+        }
+      }
     }
 }
 
 void BoardMonitorThreadInit(void) {
   boardEventsInit();
-  chEvtObjectInit(&monitorTimerEvent);
+  size_t i;
+  for (i = 0; i < INPUT_NUM; ++i) {
+    inputs[i].config = &inputConfigs[i];
+    inputs[i].active = false;
+    inputs[i].sample = false;
+    inputs[i].edges = 0;
+    inputs[i].wakeups = 0;
+    chVTObjectInit(&inputs[i].timer);
+  }
+  chVTObjectInit(&pollTimer);
+  pollWakeups = 0;
+  powered = false;
+}
+
+bool BoardMonitorIsIgnitionOn(void) {
+  return ppPowered(PAL_LOW == palReadLine(LINE_EXT_IGNITION),
+                   PAL_HIGH == palReadLine(LINE_USB_VBUS_SENSE));
+}
+
+void BoardMonitorGetPowerOnTime(time_measurement_t *tmp) {
   chSysLock();
-  chVTSetI(&monitorTimer, TIME_MS2I(POLLING_DELAY),
-           monitorTimerCallback, NULL);
+  *tmp = poweredTm;
   chSysUnlock();
 }
 
+/*
+ * Edges are interrupts that only restart a timer, wakeups are the times the
+ * thread ran. Together they are what keeps the tickless kernel from idling.
+ */
+void BoardMonitorCmdBoard(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+  if (argc > 0) {
+    chprintf(chp, "Usage: board\r\n");
+    return;
+  }
+
+  uint32_t uptime = TIME_I2S(chVTGetSystemTimeX());
+  uint32_t total = pollWakeups;
+  size_t i;
+  for (i = 0; i < INPUT_NUM; ++i) {
+    const BoardInput_t *in = &inputs[i];
+    chprintf(chp, "%-8s %-8s edges %8lu wakeups %8lu\r\n", in->config->name,
+             in->active ? "active" : "inactive", in->edges, in->wakeups);
+    total += in->edges + in->wakeups;
+  }
+  chprintf(chp, "polls %lu, %lu wakeups in %lu s\r\n", pollWakeups, total,
+           uptime);
+}
+
 /******************************* END OF FILE ***********************************/
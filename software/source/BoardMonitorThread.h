@@ -10,6 +10,7 @@
 /* INCLUDES                                                                    */
 /*******************************************************************************/
 #include "ch.h"
+#include "hal.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
@@ -33,6 +34,19 @@
 THD_FUNCTION(BoardMonitorThread, arg);
 void BoardMonitorThreadInit(void);
 
+/**
+ * @brief Raw ignition state, valid before the first debounced event.
+ */
+bool BoardMonitorIsIgnitionOn(void);
+
+/**
+ * @brief Measurement started at the last power-on event, for the latencies
+ *        counted from the ignition.
+ */
+void BoardMonitorGetPowerOnTime(time_measurement_t *tmp);
+
+void BoardMonitorCmdBoard(BaseSequentialStream *chp, int argc, char *argv[]);
+
 #endif /* BOARD_MONITOR_THREAD_H */
 
 /******************************* END OF FILE ***********************************/
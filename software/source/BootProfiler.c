@@ -0,0 +1,127 @@
+/**
+ * @file BootProfiler.c
+ * @brief Timestamps of the startup phases.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "BootProfiler.h"
+#include "gtrackconf.h"
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define REPORT_TAG                  (GTRACK_BOOT_EARLY_MODEM ? "boot early" \
+                                                             : "boot late")
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const phaseNames[BP_PHASE_NUM] = {
+  [BP_THREADS_STARTED] = "threads",
+  [BP_SDCARD_MOUNTED]  = "sdcard",
+  [BP_SHELL_STARTED]   = "shell",
+  [BP_MODEM_READY]     = "modem",
+  [BP_GNSS_ON]         = "gnss",
+  [BP_FIRST_FIX]       = "fix",
+  [BP_FIRST_LOG]       = "log"
+};
+
+static bool reached[BP_PHASE_NUM];
+static uint32_t marks[BP_PHASE_NUM];
+static bool saved;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool bpMark(BootPhase_t phase) {
+  bool first = false;
+  chSysLock();
+  if (!reached[phase]) {
+    marks[phase] = (uint32_t)TIME_I2MS(chVTGetSystemTimeX());
+    reached[phase] = true;
+    first = true;
+  }
+  chSysUnlock();
+  return first;
+}
+
+/*
+ * The caller that finds the report due claims it, a failed attempt gives
+ * it back for the next call.
+ */
+void bpSave(void) {
+  chSysLock();
+  bool due = reached[BP_FIRST_LOG] && !saved;
+  saved = true;
+  chSysUnlock();
+  if (!due)
+    return;
+
+  FIL log;
+  bool ok = FR_OK == f_open(&log, "/boot.log", FA_OPEN_APPEND | FA_WRITE);
+  if (ok) {
+    char buf[24];
+    UINT bw = 0;
+    size_t i;
+    size_t length = strlen(REPORT_TAG);
+    ok = (FR_OK == f_write(&log, REPORT_TAG, length, &bw)) && (length == bw);
+    for (i = 0; ok && (i < BP_PHASE_NUM); ++i) {
+      if (reached[i])
+        chsnprintf(buf, sizeof(buf), " %s=%lu", phaseNames[i], marks[i]);
+      else
+        chsnprintf(buf, sizeof(buf), " %s=-", phaseNames[i]);
+      ok = (FR_OK == f_write(&log, buf, strlen(buf), &bw)) &&
+           (strlen(buf) == bw);
+    }
+    ok = ok && (FR_OK == f_write(&log, "\n", 1, &bw)) && (1U == bw);
+    ok = (FR_OK == f_close(&log)) && ok;
+  }
+
+  if (!ok) {
+    chSysLock();
+    saved = false;
+    chSysUnlock();
+  }
+}
+
+void bpCmdBoot(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+
+  if (argc > 0) {
+    chprintf(chp, "Usage: boot\r\n");
+    return;
+  }
+
+  size_t i;
+  chprintf(chp, "%s\r\n", REPORT_TAG);
+  for (i = 0; i < BP_PHASE_NUM; ++i) {
+    if (reached[i])
+      chprintf(chp, "%-8s %8lu ms\r\n", phaseNames[i], marks[i]);
+    else
+      chprintf(chp, "%-8s %8s\r\n", phaseNames[i], "-");
+  }
+}
+
+/****************************** END OF FILE **********************************/
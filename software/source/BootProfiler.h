@@ -0,0 +1,64 @@
+/**
+ * @file BootProfiler.h
+ * @brief Timestamps of the startup phases.
+ */
+
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  BP_THREADS_STARTED,
+  BP_SDCARD_MOUNTED,
+  BP_SHELL_STARTED,
+  BP_MODEM_READY,
+  BP_GNSS_ON,
+  BP_FIRST_FIX,
+  BP_FIRST_LOG,
+  BP_PHASE_NUM
+} BootPhase_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Record the time elapsed since kernel start when a phase is first
+ *        reached.
+ *
+ * @return True on the first call for the phase.
+ */
+bool bpMark(BootPhase_t phase);
+
+/**
+ * @brief Append the startup report to /boot.log once the first record is
+ *        logged.
+ * @note  Does nothing before that and after the report is saved, a failed
+ *        write is repeated by the next call.
+ */
+void bpSave(void);
+
+void bpCmdBoot(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* BOOT_PROFILER_H */
+
+/****************************** END OF FILE **********************************/
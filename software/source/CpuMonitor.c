@@ -0,0 +1,299 @@
+/**
+ * @file CpuMonitor.c
+ * @brief Per-thread CPU load and interrupt load statistics.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "CpuMonitor.h"
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define MAX_THREADS                 16
+#define MIN_WINDOW_IN_MS            1000
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  ISR_USART1,
+  ISR_SPI2,
+  ISR_SYSTICK,
+  ISR_USB,
+  ISR_EXTI,
+  ISR_OTHER,
+  ISR_NUM
+} IsrGroup_t;
+
+typedef struct {
+  rttime_t cycles;
+  uint32_t count;
+} IsrStats_t;
+
+typedef struct {
+  thread_t *tp;
+  rttime_t cycles;
+} ThreadSample_t;
+
+typedef struct {
+  systime_t time;
+  ucnt_t ctxswc;
+  ucnt_t irq;
+  size_t threads;
+  ThreadSample_t samples[MAX_THREADS];
+  IsrStats_t isr[ISR_NUM];
+} CpuSnapshot_t;
+
+typedef void (*LoadVisitor_t)(const char *name, uint32_t permille,
+                              void *arg);
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#if CH_DBG_STATISTICS != TRUE
+#error "CpuMonitor requires CH_DBG_STATISTICS"
+#endif
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const isrNames[ISR_NUM] = {
+  [ISR_USART1]  = "irq:usart1",
+  [ISR_SPI2]    = "irq:spi2",
+  [ISR_SYSTICK] = "irq:st",
+  [ISR_USB]     = "irq:usb",
+  [ISR_EXTI]    = "irq:exti",
+  [ISR_OTHER]   = "irq:other"
+};
+
+static IsrStats_t isrStats[ISR_NUM];
+static rtcnt_t isrStart;
+static size_t isrNesting;
+
+/* The two latest samples, the newest last. */
+static CpuSnapshot_t samples[2];
+static size_t sampleCount;
+#if CM_LOG_ENABLED == TRUE
+static CpuSnapshot_t logSnapshot;
+static CpuSnapshot_t logCurrent;
+#endif
+static CpuSnapshot_t topBegin;
+static CpuSnapshot_t topEnd;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static IsrGroup_t isrGroup(int32_t irqn) {
+  switch (irqn) {
+    case USART1_IRQn:
+      return ISR_USART1;
+    case SPI2_IRQn:
+    case DMA1_Channel4_IRQn:
+    case DMA1_Channel5_IRQn:
+      return ISR_SPI2;
+    case TIM2_IRQn:
+      return ISR_SYSTICK;
+    case USB_IRQn:
+      return ISR_USB;
+    case EXTI0_IRQn:
+    case EXTI1_IRQn:
+    case EXTI9_5_IRQn:
+    case EXTI15_10_IRQn:
+      return ISR_EXTI;
+    default:
+      return ISR_OTHER;
+  }
+}
+
+static void takeSnapshot(CpuSnapshot_t *snap) {
+  memset(snap, 0, sizeof(*snap));
+
+  thread_t *tp = chRegFirstThread();
+  while (tp) {
+    if (snap->threads < MAX_THREADS) {
+      ThreadSample_t *sample = &snap->samples[snap->threads++];
+      sample->tp = tp;
+      chSysLock();
+      sample->cycles = tp->stats.cumulative;
+      chSysUnlock();
+    }
+    tp = chRegNextThread(tp);
+  }
+
+  chSysLock();
+  snap->time = chVTGetSystemTimeX();
+  snap->ctxswc = ch.kernel_stats.n_ctxswc;
+  snap->irq = ch.kernel_stats.n_irq;
+  memcpy(snap->isr, isrStats, sizeof(snap->isr));
+  chSysUnlock();
+}
+
+static const ThreadSample_t *findSample(const CpuSnapshot_t *snap,
+                                        const thread_t *tp) {
+  size_t i;
+  for (i = 0; i < snap->threads; ++i) {
+    if (snap->samples[i].tp == tp)
+      return &snap->samples[i];
+  }
+  return NULL;
+}
+
+static uint32_t permille(rttime_t cycles, rttime_t window) {
+  return window ? (uint32_t)((cycles * 1000U) / window) : 0U;
+}
+
+/*
+ * Threads created during the window are accounted from zero, terminated
+ * ones are not reported.
+ */
+static void forEachLoad(const CpuSnapshot_t *begin, const CpuSnapshot_t *end,
+                        LoadVisitor_t visitor, void *arg) {
+  rttime_t window = (rttime_t)TIME_I2MS(chTimeDiffX(begin->time, end->time)) *
+                    (STM32_HCLK / 1000U);
+  size_t i;
+
+  for (i = 0; i < end->threads; ++i) {
+    const ThreadSample_t *last = &end->samples[i];
+    const ThreadSample_t *first = findSample(begin, last->tp);
+    rttime_t cycles = last->cycles - (first ? first->cycles : 0);
+    visitor(chRegGetThreadNameX(last->tp), permille(cycles, window), arg);
+  }
+
+  for (i = 0; i < ISR_NUM; ++i) {
+    rttime_t cycles = end->isr[i].cycles - begin->isr[i].cycles;
+    visitor(isrNames[i], permille(cycles, window), arg);
+  }
+}
+
+static void printLoad(const char *name, uint32_t load, void *arg) {
+  BaseSequentialStream *chp = (BaseSequentialStream *)arg;
+  chprintf(chp, "%-12s %3lu.%lu%%\r\n", name ? name : "?", load / 10U,
+           load % 10U);
+}
+
+#if CM_LOG_ENABLED == TRUE
+static void saveLoad(const char *name, uint32_t load, void *arg) {
+  FIL *log = (FIL *)arg;
+  char buf[48];
+  chsnprintf(buf, sizeof(buf), " %s=%lu", name ? name : "?", load);
+  UINT bw = 0;
+  f_write(log, buf, strlen(buf), &bw);
+}
+#endif
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+/*
+ * The hooks run outside the kernel's ISR bookkeeping, so the nesting is
+ * guarded at port level. Only the outermost handler is timed, a nested one
+ * is counted but its cycles go to the handler it interrupted.
+ */
+void cmIrqPrologue(void) {
+  port_lock_from_isr();
+  if (0U == isrNesting++)
+    isrStart = chSysGetRealtimeCounterX();
+  port_unlock_from_isr();
+}
+
+void cmIrqEpilogue(void) {
+  port_lock_from_isr();
+  if (0U != isrNesting) {
+    IsrStats_t *stats = &isrStats[isrGroup((int32_t)__get_IPSR() - 16)];
+    if (0U == --isrNesting)
+      stats->cycles += chSysGetRealtimeCounterX() - isrStart;
+    stats->count++;
+  }
+  port_unlock_from_isr();
+}
+
+/*
+ * The sample is taken on the side and stored at once, top may read the
+ * samples at any time.
+ */
+void cmSample(void) {
+  static CpuSnapshot_t sample;
+  takeSnapshot(&sample);
+
+  chSysLock();
+  samples[0] = samples[1];
+  samples[1] = sample;
+  if (sampleCount < 2U)
+    sampleCount++;
+  chSysUnlock();
+}
+
+void cmSaveLoad(void) {
+#if CM_LOG_ENABLED == TRUE
+  static bool started = false;
+
+  chSysLock();
+  bool sampled = sampleCount > 0U;
+  logCurrent = samples[1];
+  chSysUnlock();
+  if (!sampled)
+    return;
+
+  if (started) {
+    FIL log;
+    if (FR_OK == f_open(&log, "/cpu.log", FA_OPEN_APPEND | FA_WRITE)) {
+      char buf[48];
+      chsnprintf(buf, sizeof(buf), "%lu ctxsw=%lu irq=%lu",
+                 (uint32_t)TIME_I2MS(logCurrent.time),
+                 (uint32_t)(logCurrent.ctxswc - logSnapshot.ctxswc),
+                 (uint32_t)(logCurrent.irq - logSnapshot.irq));
+      UINT bw = 0;
+      f_write(&log, buf, strlen(buf), &bw);
+      forEachLoad(&logSnapshot, &logCurrent, saveLoad, &log);
+      f_write(&log, "\n", 1, &bw);
+      f_close(&log);
+    }
+  }
+  logSnapshot = logCurrent;
+  started = true;
+#endif
+}
+
+/*
+ * The load since the latest sample, or since the one before if the latest
+ * is too recent for a meaningful window. The shell is not held up.
+ */
+void cmCmdTop(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+  if (argc > 0) {
+    chprintf(chp, "Usage: top\r\n");
+    return;
+  }
+
+  takeSnapshot(&topEnd);
+  chSysLock();
+  size_t count = sampleCount;
+  topBegin = samples[1];
+  if ((count > 1U) && (chTimeDiffX(topBegin.time, topEnd.time) <
+                       TIME_MS2I(MIN_WINDOW_IN_MS)))
+    topBegin = samples[0];
+  chSysUnlock();
+
+  if (0U == count) {
+    chprintf(chp, "no sample yet\r\n");
+    return;
+  }
+
+  chprintf(chp, "window %lu ms, %lu context switches, %lu interrupts\r\n",
+           (uint32_t)TIME_I2MS(chTimeDiffX(topBegin.time, topEnd.time)),
+           (uint32_t)(topEnd.ctxswc - topBegin.ctxswc),
+           (uint32_t)(topEnd.irq - topBegin.irq));
+  forEachLoad(&topBegin, &topEnd, printLoad, chp);
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,60 @@
+/**
+ * @file CpuMonitor.h
+ * @brief Per-thread CPU load and interrupt load statistics.
+ */
+
+#ifndef CPU_MONITOR_H
+#define CPU_MONITOR_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Append a load record to /cpu.log on every cmSaveLoad() call.
+ */
+#if !defined(CM_LOG_ENABLED)
+#define CM_LOG_ENABLED              FALSE
+#endif
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief ISR hooks, called from CH_CFG_IRQ_PROLOGUE_HOOK/EPILOGUE_HOOK.
+ */
+void cmIrqPrologue(void);
+void cmIrqEpilogue(void);
+
+/**
+ * @brief Take the periodic sample top and the log are computed against.
+ */
+void cmSample(void);
+
+/**
+ * @brief Log the load between the latest sample and the one logged before.
+ */
+void cmSaveLoad(void);
+
+void cmCmdTop(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* CPU_MONITOR_H */
+
+/****************************** END OF FILE **********************************/
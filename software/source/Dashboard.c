@@ -7,6 +7,7 @@
 /* INCLUDES                                                                  */
 /*****************************************************************************/
 #include "Dashboard.h"
+#include "LatencyProbe.h"
 #include "ch.h"
 
 #include <string.h>
@@ -19,13 +20,24 @@
 /* TYPE DEFINITIONS                                                          */
 /*****************************************************************************/
 typedef struct {
-    mutex_t lock;
+    volatile uint32_t sequence;
+    systime_t timestamp;
+    void *data;
+    size_t size;
+    event_source_t source;
+} DashboardEntry_t;
+
+typedef struct {
+    DashboardEntry_t entries[DB_GROUP_NUM];
     Position_t position;
+    Network_t network;
+    Motion_t motion;
 } Dashboard_t;
 
 /*****************************************************************************/
 /* MACRO DEFINITIONS                                                         */
 /*****************************************************************************/
+#define DB_MEMORY_BARRIER()    __sync_synchronize()
 
 /*****************************************************************************/
 /* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
@@ -39,25 +51,111 @@ static Dashboard_t dashboard;
 /*****************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                             */
 /*****************************************************************************/
+static void dbEntryInit(DashboardGroup_t group, void *data, size_t size) {
+    DashboardEntry_t *entry = &dashboard.entries[group];
+    entry->sequence = 0;
+    entry->timestamp = 0;
+    entry->data = data;
+    entry->size = size;
+    chEvtObjectInit(&entry->source);
+}
+
+/*
+ * Writers of the same group are serialized by the critical section, the
+ * sequence counter is odd while the copy is in progress. Subscribers are
+ * notified only after the new snapshot is complete.
+ */
+static void dbPublish(DashboardGroup_t group, const void *src) {
+    DashboardEntry_t *entry = &dashboard.entries[group];
+    time_measurement_t tm;
+
+    lpStart(&tm);
+    chSysLock();
+    entry->sequence++;
+    DB_MEMORY_BARRIER();
+    memcpy(entry->data, src, entry->size);
+    entry->timestamp = chVTGetSystemTimeX();
+    DB_MEMORY_BARRIER();
+    entry->sequence++;
+    chEvtBroadcastFlagsI(&entry->source, DB_GROUP_FLAG(group));
+    chSchRescheduleS();
+    chSysUnlock();
+    lpStop(LP_DB_PUBLISH, &tm);
+}
+
+static uint32_t dbRead(DashboardGroup_t group, void *dst,
+                       systime_t *timestamp) {
+    DashboardEntry_t *entry = &dashboard.entries[group];
+    uint32_t begin, end;
+    systime_t time;
+
+    do {
+        begin = entry->sequence;
+        DB_MEMORY_BARRIER();
+        memcpy(dst, entry->data, entry->size);
+        time = entry->timestamp;
+        DB_MEMORY_BARRIER();
+        end = entry->sequence;
+    } while ((begin != end) || (begin & 1U));
+
+    if (timestamp)
+        *timestamp = time;
+
+    return begin >> 1;
+}
 
 /*****************************************************************************/
 /* DEFINITION OF GLOBAL FUNCTIONS                                            */
 /*****************************************************************************/
 void dbInit(void) {
     memset(&dashboard, 0, sizeof(dashboard));
-    chMtxObjectInit(&dashboard.lock);
+    dbEntryInit(DB_GROUP_POSITION, &dashboard.position,
+                sizeof(dashboard.position));
+    dbEntryInit(DB_GROUP_NETWORK, &dashboard.network,
+                sizeof(dashboard.network));
+    dbEntryInit(DB_GROUP_MOTION, &dashboard.motion,
+                sizeof(dashboard.motion));
+}
+
+void dbSubscribe(DashboardGroup_t group, event_listener_t *elp,
+                 eventmask_t events) {
+    chDbgCheck(group < DB_GROUP_NUM);
+    chEvtRegisterMaskWithFlags(&dashboard.entries[group].source, elp, events,
+                               DB_GROUP_FLAG(group));
+}
+
+void dbUnsubscribe(DashboardGroup_t group, event_listener_t *elp) {
+    chDbgCheck(group < DB_GROUP_NUM);
+    chEvtUnregister(&dashboard.entries[group].source, elp);
+}
+
+uint32_t dbGetVersion(DashboardGroup_t group) {
+    chDbgCheck(group < DB_GROUP_NUM);
+    return dashboard.entries[group].sequence >> 1;
+}
+
+void dbSetPosition(const Position_t *pos) {
+    dbPublish(DB_GROUP_POSITION, pos);
+}
+
+uint32_t dbGetPosition(Position_t *pos, systime_t *timestamp) {
+    return dbRead(DB_GROUP_POSITION, pos, timestamp);
+}
+
+void dbSetNetwork(const Network_t *net) {
+    dbPublish(DB_GROUP_NETWORK, net);
 }
 
-void dbLock(void) {
-    chMtxLock(&dashboard.lock);
+uint32_t dbGetNetwork(Network_t *net, systime_t *timestamp) {
+    return dbRead(DB_GROUP_NETWORK, net, timestamp);
 }
 
-void dbUnlock(void) {
-    chMtxUnlock(&dashboard.lock);
+void dbSetMotion(const Motion_t *motion) {
+    dbPublish(DB_GROUP_MOTION, motion);
 }
 
-Position_t *dbGetPosition(void) {
-    return &dashboard.position;
+uint32_t dbGetMotion(Motion_t *motion, systime_t *timestamp) {
+    return dbRead(DB_GROUP_MOTION, motion, timestamp);
 }
 
 /****************************** END OF FILE **********************************/
@@ -9,6 +9,7 @@
 /*****************************************************************************/
 /* INCLUDES                                                                  */
 /*****************************************************************************/
+#include "ch.h"
 
 /*****************************************************************************/
 /* DEFINED CONSTANTS                                                         */
@@ -17,10 +18,32 @@
 /*****************************************************************************/
 /* MACRO DEFINITIONS                                                         */
 /*****************************************************************************/
+/**
+ * @brief Event flag broadcast to the subscribers of a group on update.
+ */
+#define DB_GROUP_FLAG(group)    ((eventflags_t)1 << (group))
 
 /*****************************************************************************/
 /* TYPE DEFINITIONS                                                          */
 /*****************************************************************************/
+/**
+ * @brief Independently published field groups of the dashboard.
+ * @note  Every group has its own sequence counter, so a writer of one group
+ *        never forces the readers of another group to retry.
+ */
+typedef enum {
+  DB_GROUP_POSITION,
+  DB_GROUP_NETWORK,
+  DB_GROUP_MOTION,
+  DB_GROUP_NUM
+} DashboardGroup_t;
+
+typedef enum {
+  POS_SOURCE_NONE,
+  POS_SOURCE_GNSS,
+  POS_SOURCE_CELL
+} PositionSource_t;
+
 typedef struct {
   char date[18 + 1];
   double latitude;
@@ -30,8 +53,53 @@ typedef struct {
   int gpsSatInView;
   int gnssSatInUse;
   int gnssSatInView;
+  PositionSource_t source;
+  uint32_t accuracy;    /**< Horizontal accuracy in meters, 0 if unknown. */
 } Position_t;
 
+/**
+ * @brief Registration states as reported by +CREG and +CGREG.
+ */
+typedef enum {
+  NET_REG_NONE = 0,
+  NET_REG_HOME = 1,
+  NET_REG_SEARCHING = 2,
+  NET_REG_DENIED = 3,
+  NET_REG_UNKNOWN = 4,
+  NET_REG_ROAMING = 5
+} NetworkRegistration_t;
+
+typedef struct {
+  NetworkRegistration_t registration;      /**< Circuit switched.          */
+  NetworkRegistration_t gprsRegistration;  /**< Packet switched.           */
+  bool gprsAttached;
+  char operatorName[16 + 1];
+  int rssi;             /**< dBm, 0 if unknown.                             */
+  int ber;              /**< 0-7, 99 if unknown.                            */
+  uint16_t lac;
+  uint32_t cellId;
+  uint32_t supply;      /**< Modem supply voltage in mV, 0 if unknown.      */
+} Network_t;
+
+typedef enum {
+  MOTION_NONE,
+  MOTION_TRACKING,      /**< Fixes are arriving.                            */
+  MOTION_DEAD_RECKONING /**< Fixes are missing, the sensors carry on.       */
+} MotionState_t;
+
+/**
+ * @brief Fused position, published at every tick of the fusion thread.
+ */
+typedef struct {
+  MotionState_t state;
+  int32_t latitude;     /**< 1e-7 degrees.                                  */
+  int32_t longitude;    /**< 1e-7 degrees.                                  */
+  uint16_t speed;       /**< 0.01 km/h.                                     */
+  uint16_t heading;     /**< 0.01 degrees clockwise from north.             */
+  uint32_t accuracy;    /**< Horizontal 1 sigma in meters.                  */
+  uint32_t outage;      /**< Milliseconds since the last accepted fix.      */
+} Motion_t;
+
 /*****************************************************************************/
 /* DECLARATION OF GLOBAL VARIABLES                                           */
 /*****************************************************************************/
@@ -41,11 +109,56 @@ typedef struct {
 /*****************************************************************************/
 void dbInit(void);
 
-void dbLock(void);
+/**
+ * @brief Register a listener for the updates of a group.
+ * @note  Events are latched, a subscriber that falls behind wakes up once and
+ *        can tell the number of skipped updates from the version counter.
+ */
+void dbSubscribe(DashboardGroup_t group, event_listener_t *elp,
+                 eventmask_t events);
+
+void dbUnsubscribe(DashboardGroup_t group, event_listener_t *elp);
 
-void dbUnlock(void);
+/**
+ * @brief Version of the latest snapshot of a group, 0 if never published.
+ */
+uint32_t dbGetVersion(DashboardGroup_t group);
+
+/**
+ * @brief Publish a new position snapshot.
+ * @note  Never blocks on readers.
+ */
+void dbSetPosition(const Position_t *pos);
 
-Position_t *dbGetPosition(void);
+/**
+ * @brief Copy a consistent snapshot of the latest position.
+ * @note  Lock-free, the copy is retried if a writer published meanwhile.
+ * @param timestamp System time of the publication, can be NULL.
+ * @return Version of the snapshot, 0 if nothing was published yet.
+ */
+uint32_t dbGetPosition(Position_t *pos, systime_t *timestamp);
+
+/**
+ * @brief Publish a new network state snapshot.
+ */
+void dbSetNetwork(const Network_t *net);
+
+/**
+ * @brief Copy a consistent snapshot of the latest network state.
+ * @return Version of the snapshot, 0 if nothing was published yet.
+ */
+uint32_t dbGetNetwork(Network_t *net, systime_t *timestamp);
+
+/**
+ * @brief Publish a new fused position.
+ */
+void dbSetMotion(const Motion_t *motion);
+
+/**
+ * @brief Copy a consistent snapshot of the latest fused position.
+ * @return Version of the snapshot, 0 if nothing was published yet.
+ */
+uint32_t dbGetMotion(Motion_t *motion, systime_t *timestamp);
 
 #endif /* DASHBOARD_H */
 
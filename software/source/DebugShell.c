@@ -11,12 +11,33 @@
 #include "hal.h"
 #include "chprintf.h"
 #include "Sdcard.h"
+#include "PositionHistory.h"
+#include "PowerManager.h"
+#include "BoardMonitorThread.h"
+#include "StackMonitor.h"
+#include "CpuMonitor.h"
+#include "LatencyProbe.h"
+#include "TraceRecorder.h"
+#include "BootProfiler.h"
+#include "GnssAssist.h"
+#include "Outbox.h"
+#include "TelemetryCodec.h"
+#include "UploaderThread.h"
+#include "UdpReporter.h"
+#include "LiveTrackerThread.h"
+#include "NetworkMonitorThread.h"
+#include "SmsHandlerThread.h"
+#include "FirmwareUpdateThread.h"
+#include "GeofenceThread.h"
+#include "TripLog.h"
+#include "FusionThread.h"
 #include "usbcfg.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
  #define SHELL_WA_SIZE   THD_WORKING_AREA_SIZE(2048)
+#define USB_DISCONNECT_TIME_IN_MS      1000
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
@@ -30,9 +51,30 @@
 /* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
 /*******************************************************************************/
 static thread_reference_t shelltp;
+static systime_t disconnectTime;
 
 static const ShellCommand commands[] = {
   {"tree", sdcardCmdTree},
+  {"history", phCmdHistory},
+  {"power", pmCmdPower},
+  {"board", BoardMonitorCmdBoard},
+  {"stacks", smCmdStacks},
+  {"top", cmCmdTop},
+  {"latency", lpCmdLatency},
+  {"trace", trCmdTrace},
+  {"boot", bpCmdBoot},
+  {"gnss", gaCmdGnss},
+  {"outbox", obCmdOutbox},
+  {"codec", tcCmdCodec},
+  {"upload", UploaderCmdUpload},
+  {"udp", urCmdUdp},
+  {"live", LiveTrackerCmdLive},
+  {"network", NetworkMonitorCmdNetwork},
+  {"sms", SmsHandlerCmdSms},
+  {"ota", FirmwareUpdateCmdOta},
+  {"fence", GeofenceCmdFence},
+  {"trip", tlCmdTrip},
+  {"fusion", FusionCmdFusion},
   {NULL, NULL}
 };
 
@@ -56,10 +98,15 @@ void debugShellInit(void) {
   sduObjectInit(&SDU1);
   shellInit();
   usbDisconnectBus(serusbcfg.usbp);
-  chThdSleepMilliseconds(1000);
+  disconnectTime = chVTGetSystemTime();
 }
 
 void debugShellStart(void) {
+  /* The host must see the disconnection before the bus is connected again,
+     wait only for the rest of it instead of blocking the startup. */
+  chThdSleepUntilWindowed(disconnectTime,
+                          chTimeAddX(disconnectTime,
+                                     TIME_MS2I(USB_DISCONNECT_TIME_IN_MS)));
   sduStart(&SDU1, &serusbcfg);
   usbStart(serusbcfg.usbp, &usbcfg);
   usbConnectBus(serusbcfg.usbp);
@@ -0,0 +1,451 @@
+/**
+ * @file FirmwareUpdateThread.c
+ * @brief Firmware download over HTTP into the spare flash slot.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "FirmwareUpdateThread.h"
+#include "Bearer.h"
+#include "Flash.h"
+#include "ImageWriter.h"
+#include "NetworkMonitorThread.h"
+#include "OtaDownload.h"
+#include "Sdcard.h"
+#include "gtrackconf.h"
+#include "sim8xx.h"
+#include "at.h"
+
+#include "chprintf.h"
+#include "ff.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define START_EVENT                 EVENT_MASK(0)
+
+#define STATE_FILE                  "/ota.dat"
+#define STATE_MAGIC                 0x3141544FU
+#define URL_SIZE                    128
+
+/*
+ * Up to a page per read, the modem sends a read at the serial rate while
+ * the chunk is programmed between two reads. It holds the chunk CRCs too.
+ */
+#define CHUNK_SIZE                  FLASH_PAGE_SIZE
+
+#define HTTP_GET                    0
+#define HTTP_PARTIAL_CONTENT        206
+#define ACTION_TIMEOUT_IN_MS        60000
+#define READ_TIMEOUT_IN_MS          10000
+#define RETRY_DELAY_IN_MS           5000
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  FU_IDLE,
+  FU_DOWNLOADING,
+  FU_DONE,
+  FU_FAILED
+} FuState_t;
+
+/**
+ * @brief Progress saved on the SD card after every segment.
+ */
+typedef struct {
+  uint32_t magic;
+  ImageHeader_t header;
+  uint32_t offset;
+  char url[URL_SIZE];
+  uint32_t crc;
+} FuSavedState_t;
+
+/**
+ * @brief Transfer statistics, the download holds the rest of the progress.
+ */
+typedef struct {
+  FuState_t state;
+  const char *error;
+  uint32_t bytes;       /**< Downloaded in this run.                        */
+  uint32_t elapsed;     /**< ms.                                            */
+  uint32_t requestTime; /**< HTTPACTION round trips in ms.                  */
+  uint32_t readTime;    /**< HTTPREAD transfers in ms.                      */
+  uint32_t writeTime;   /**< Erasing, programming and verifying in ms.      */
+} FuProgress_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#define ELAPSED_MS(since)                                                      \
+  ((uint32_t)TIME_I2MS(chVTTimeElapsedSinceX(since)))
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const stateNames[] = {
+  [FU_IDLE] = "idle",
+  [FU_DOWNLOADING] = "downloading",
+  [FU_DONE] = "done",
+  [FU_FAILED] = "failed"
+};
+
+static thread_t *updateThread;
+static mutex_t sessionLock;
+static binary_semaphore_t actionDone;
+static HTTPACTION_Response_t action;
+static volatile bool aborting;
+static Sim8xxCommand cmd;
+static char url[URL_SIZE];
+static uint8_t chunk[CHUNK_SIZE];
+static uint32_t chunkCrcs[IW_MAX_CHUNKS];
+static FuProgress_t progress;
+static OtaDownload_t download;
+static systime_t writeStart;
+static FIL stateFile;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+static bool otaOpen(void *priv);
+static void otaClose(void *priv);
+static bool otaRequest(void *priv, uint32_t first, uint32_t last);
+static bool otaRead(void *priv, uint32_t pos, uint8_t *buf, size_t size);
+static bool otaLoad(void *priv, const ImageHeader_t *header,
+                    uint32_t *offset);
+static void otaSave(void *priv, const ImageHeader_t *header,
+                    uint32_t offset);
+static void otaClear(void *priv);
+static bool otaAborted(void *priv);
+static void otaPause(void *priv);
+static void otaWriting(void *priv, bool active);
+
+static const OdOps_t otaOps = {
+  otaOpen, otaClose, otaRequest, otaRead, otaLoad, otaSave, otaClear,
+  otaAborted, otaPause, otaWriting
+};
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool execute(void) {
+  sim8xxExecute(&SIM8D1, &cmd);
+  return SIM8XX_OK == cmd.status;
+}
+
+static void urcHook(eventflags_t flag, const char *line, size_t length) {
+  char buf[48];
+  (void)flag;
+
+  if (length + 3 > sizeof(buf))
+    return;
+  memcpy(buf, line, length);
+  strcpy(buf + length, "\r\n");
+  if (atHttpactionParse(&action, buf))
+    chBSemSignal(&actionDone);
+}
+
+static uint32_t stateCrc(const FuSavedState_t *saved) {
+  return iwCrc32(0, (const uint8_t *)saved, offsetof(FuSavedState_t, crc));
+}
+
+static bool loadState(FuSavedState_t *saved) {
+  UINT br = 0;
+  if (!sdcardIsMounted() ||
+      (FR_OK != f_open(&stateFile, STATE_FILE, FA_OPEN_EXISTING | FA_READ)))
+    return false;
+  FRESULT res = f_read(&stateFile, saved, sizeof(*saved), &br);
+  f_close(&stateFile);
+  return (FR_OK == res) && (sizeof(*saved) == br) &&
+         (STATE_MAGIC == saved->magic) && (stateCrc(saved) == saved->crc);
+}
+
+static void saveState(const ImageHeader_t *header, uint32_t offset) {
+  FuSavedState_t saved;
+  UINT bw = 0;
+
+  memset(&saved, 0, sizeof(saved));
+  saved.magic = STATE_MAGIC;
+  saved.header = *header;
+  saved.offset = offset;
+  strncpy(saved.url, url, sizeof(saved.url) - 1);
+  saved.crc = stateCrc(&saved);
+
+  if (sdcardIsMounted() &&
+      (FR_OK == f_open(&stateFile, STATE_FILE, FA_CREATE_ALWAYS | FA_WRITE))) {
+    f_write(&stateFile, &saved, sizeof(saved), &bw);
+    f_close(&stateFile);
+  }
+}
+
+static void clearState(void) {
+  if (sdcardIsMounted())
+    f_unlink(STATE_FILE);
+}
+
+static bool sameImage(const ImageHeader_t *a, const ImageHeader_t *b) {
+  return (a->version == b->version) && (a->size == b->size) &&
+         (a->crc == b->crc);
+}
+
+static bool httpOpen(void) {
+  if (!brOpen())
+    return false;
+
+  /* A session left over by a reset would fail the init. */
+  sim8xxCommandInit(&cmd);
+  atHttptermCreate(cmd.request, sizeof(cmd.request));
+  execute();
+
+  sim8xxCommandInit(&cmd);
+  atHttpinitCreate(cmd.request, sizeof(cmd.request));
+  if (!execute())
+    return false;
+  sim8xxCommandInit(&cmd);
+  atHttpparaCreate(cmd.request, sizeof(cmd.request), "CID", "1");
+  if (!execute())
+    return false;
+  sim8xxCommandInit(&cmd);
+  atHttpparaCreate(cmd.request, sizeof(cmd.request), "URL", url);
+  return execute();
+}
+
+static void httpClose(void) {
+  sim8xxCommandInit(&cmd);
+  atHttptermCreate(cmd.request, sizeof(cmd.request));
+  execute();
+}
+
+/*
+ * Ranged GET of the bytes first..last, the modem keeps the body until the
+ * next request.
+ */
+static bool httpGet(uint32_t first, uint32_t last) {
+  systime_t start = chVTGetSystemTime();
+
+  sim8xxCommandInit(&cmd);
+  atHttpparaNumberCreate(cmd.request, sizeof(cmd.request), "BREAK", first);
+  if (!execute())
+    return false;
+  sim8xxCommandInit(&cmd);
+  atHttpparaNumberCreate(cmd.request, sizeof(cmd.request), "BREAKEND", last);
+  if (!execute())
+    return false;
+
+  chBSemReset(&actionDone, true);
+  sim8xxCommandInit(&cmd);
+  atHttpactionCreate(cmd.request, sizeof(cmd.request), HTTP_GET);
+  if (!execute() ||
+      (MSG_OK != chBSemWaitTimeout(&actionDone,
+                                   TIME_MS2I(ACTION_TIMEOUT_IN_MS))))
+    return false;
+
+  progress.requestTime += ELAPSED_MS(start);
+  return (HTTP_PARTIAL_CONTENT == action.status) &&
+         ((uint32_t)action.length == last - first + 1U);
+}
+
+static bool httpRead(uint32_t start, uint8_t *buf, size_t size) {
+  systime_t begin = chVTGetSystemTime();
+  size_t announced;
+
+  sim8xxCommandInit(&cmd);
+  atHttpreadCreate(cmd.request, sizeof(cmd.request), start, size);
+  cmd.timeout = TIME_MS2I(READ_TIMEOUT_IN_MS);
+  size_t length = sim8xxRead(&SIM8D1, &cmd, buf, size);
+
+  progress.readTime += ELAPSED_MS(begin);
+  progress.bytes += length;
+  return (SIM8XX_OK == cmd.status) &&
+         atHttpreadParse(&announced, cmd.response) && (announced == size) &&
+         (length == size);
+}
+
+static bool otaOpen(void *priv) {
+  (void)priv;
+  return nmCanTransmit() && httpOpen();
+}
+
+static void otaClose(void *priv) {
+  (void)priv;
+  httpClose();
+}
+
+static bool otaRequest(void *priv, uint32_t first, uint32_t last) {
+  (void)priv;
+  return httpGet(first, last);
+}
+
+static bool otaRead(void *priv, uint32_t pos, uint8_t *buf, size_t size) {
+  (void)priv;
+  return httpRead(pos, buf, size);
+}
+
+/*
+ * The same image at the same URL is resumed where the saved progress
+ * ends.
+ */
+static bool otaLoad(void *priv, const ImageHeader_t *header,
+                    uint32_t *offset) {
+  FuSavedState_t saved;
+  (void)priv;
+  if (!loadState(&saved) || !sameImage(&saved.header, header) ||
+      strncmp(saved.url, url, sizeof(saved.url)))
+    return false;
+  *offset = saved.offset;
+  return true;
+}
+
+static void otaSave(void *priv, const ImageHeader_t *header,
+                    uint32_t offset) {
+  (void)priv;
+  saveState(header, offset);
+}
+
+static void otaClear(void *priv) {
+  (void)priv;
+  clearState();
+}
+
+static bool otaAborted(void *priv) {
+  (void)priv;
+  return aborting;
+}
+
+static void otaPause(void *priv) {
+  (void)priv;
+  chThdSleepMilliseconds(RETRY_DELAY_IN_MS);
+}
+
+static void otaWriting(void *priv, bool active) {
+  (void)priv;
+  if (active)
+    writeStart = chVTGetSystemTime();
+  else
+    progress.writeTime += ELAPSED_MS(writeStart);
+}
+
+static void run(void) {
+  systime_t start = chVTGetSystemTime();
+
+  memset(&progress, 0, sizeof(progress));
+  progress.state = FU_DOWNLOADING;
+  if (!flashSlotIsFree()) {
+    progress.state = FU_FAILED;
+    progress.error = "running image overlaps the slot";
+    return;
+  }
+
+  odInit(&download, &otaOps, NULL, &flashSlot, chunk, sizeof(chunk),
+         chunkCrcs, GTRACK_OTA_SEGMENT_SIZE);
+  IwStatus_t status = odRun(&download);
+  if (IW_OK == status) {
+    progress.state = FU_DONE;
+  } else {
+    progress.state = FU_FAILED;
+    progress.error = aborting ? "aborted" : iwStatusName(status);
+  }
+  progress.elapsed = ELAPSED_MS(start);
+}
+
+static void printStatus(BaseSequentialStream *chp) {
+  ImageHeader_t marker;
+
+  chprintf(chp, "state %s", stateNames[progress.state]);
+  if (FU_FAILED == progress.state)
+    chprintf(chp, " (%s)", progress.error);
+  chprintf(chp, "\r\n");
+
+  if (FU_IDLE != progress.state) {
+    chprintf(chp, "url %s\r\n", url);
+    chprintf(chp, "version %lu, %lu of %lu bytes, resumed at %lu\r\n",
+             download.header.version, download.writer.offset,
+             download.header.size, download.resumedAt);
+    chprintf(chp, "retries %lu, chunks read again %lu, requested again %lu\r\n",
+             download.retries, download.rereads, download.badChunks);
+    chprintf(chp, "downloaded %lu bytes", progress.bytes);
+    if (progress.readTime > 0U)
+      chprintf(chp, ", %lu B/s while reading",
+               progress.bytes * 1000U / progress.readTime);
+    if (progress.elapsed > 0U)
+      chprintf(chp, ", %lu B/s overall",
+               progress.bytes * 1000U / progress.elapsed);
+    chprintf(chp, "\r\n");
+    chprintf(chp, "request %lu ms, read %lu ms, write %lu ms\r\n",
+             progress.requestTime, progress.readTime, progress.writeTime);
+  }
+
+  if (iwIsBootable(&flashSlot, &marker))
+    chprintf(chp, "slot: bootable version %lu, %lu bytes, crc %08lx\r\n",
+             marker.version, marker.size, marker.crc);
+  else
+    chprintf(chp, "slot: no bootable image\r\n");
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+THD_FUNCTION(FirmwareUpdateThread, arg) {
+  (void)arg;
+  chRegSetThreadName("ota");
+  updateThread = chThdGetSelfX();
+
+  while (true) {
+    chEvtWaitAny(START_EVENT);
+    chMtxLock(&sessionLock);
+    aborting = false;
+    run();
+    chMtxUnlock(&sessionLock);
+  }
+}
+
+void FirmwareUpdateThreadInit(void) {
+  updateThread = NULL;
+  chMtxObjectInit(&sessionLock);
+  chBSemObjectInit(&actionDone, true);
+  aborting = false;
+  memset(&progress, 0, sizeof(progress));
+  memset(url, 0, sizeof(url));
+  sim8xxAddUrcHook(&SIM8D1, SIM8XX_URC_HTTPACTION, urcHook);
+}
+
+void FirmwareUpdateStop(void) {
+  aborting = true;
+  chMtxLock(&sessionLock);
+  chMtxUnlock(&sessionLock);
+}
+
+void FirmwareUpdateCmdOta(BaseSequentialStream *chp, int argc, char *argv[]) {
+  FuSavedState_t saved;
+  bool busy = (FU_DOWNLOADING == progress.state);
+
+  if (0 == argc) {
+    printStatus(chp);
+  } else if (!strcmp(argv[0], "get") && (2 == argc) && !busy) {
+    if (strlen(argv[1]) >= sizeof(url)) {
+      chprintf(chp, "URL too long\r\n");
+      return;
+    }
+    strcpy(url, argv[1]);
+    chEvtSignal(updateThread, START_EVENT);
+  } else if (!strcmp(argv[0], "resume") && (1 == argc) && !busy) {
+    if (!loadState(&saved)) {
+      chprintf(chp, "Nothing to resume\r\n");
+      return;
+    }
+    strcpy(url, saved.url);
+    chEvtSignal(updateThread, START_EVENT);
+  } else if (!strcmp(argv[0], "abort") && (1 == argc)) {
+    aborting = true;
+  } else if (busy) {
+    chprintf(chp, "Download in progress\r\n");
+  } else {
+    chprintf(chp, "Usage: ota [get <url>|resume|abort]\r\n");
+  }
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,47 @@
+/**
+ * @file FirmwareUpdateThread.h
+ * @brief Firmware download over HTTP into the spare flash slot.
+ */
+
+#ifndef FIRMWARE_UPDATE_THREAD_H
+#define FIRMWARE_UPDATE_THREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(FirmwareUpdateThread, arg);
+void FirmwareUpdateThreadInit(void);
+
+/**
+ * @brief Abort a download in progress before the modem is powered down.
+ * @note  The download is resumed by "ota resume" later.
+ */
+void FirmwareUpdateStop(void);
+
+void FirmwareUpdateCmdOta(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* FIRMWARE_UPDATE_THREAD_H */
+
+/******************************* END OF FILE ***********************************/
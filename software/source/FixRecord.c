@@ -0,0 +1,176 @@
+/**
+ * @file FixRecord.c
+ * @brief Compact fixed-point representation of a position fix.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "FixRecord.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define DATE_DIGITS                 14
+#define SECONDS_PER_DAY             86400U
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static int parseDigits(const char *str, size_t num) {
+  int value = 0;
+  while (num--)
+    value = 10 * value + (*str++ - '0');
+  return value;
+}
+
+/*
+ * Days since 1970-01-01 of a proleptic Gregorian date.
+ */
+static int32_t daysFromCivil(int y, int m, int d) {
+  y -= m <= 2;
+  const int32_t era = (y >= 0 ? y : y - 399) / 400;
+  const int32_t yoe = y - era * 400;
+  const int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/*
+ * Inverse of daysFromCivil().
+ */
+static void civilFromDays(int32_t z, int *y, int *m, int *d) {
+  z += 719468;
+  const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const int32_t doe = z - era * 146097;
+  const int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const int32_t mp = (5 * doy + 2) / 153;
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = yoe + era * 400 + (*m <= 2);
+}
+
+static int daysInMonth(int year, int month) {
+  static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31,
+                                   30, 31};
+  bool leap = (0 == year % 4) && ((0 != year % 100) || (0 == year % 400));
+  return days[month - 1] + ((2 == month) && leap ? 1 : 0);
+}
+
+static int32_t roundToInt(double value) {
+  return (int32_t)(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+uint32_t frParseTime(const char *date) {
+  size_t i;
+  for (i = 0; i < DATE_DIGITS; ++i) {
+    if ((date[i] < '0') || (date[i] > '9'))
+      return 0;
+  }
+
+  int year  = parseDigits(date, 4);
+  int month = parseDigits(date + 4, 2);
+  int day   = parseDigits(date + 6, 2);
+  int hour  = parseDigits(date + 8, 2);
+  int min   = parseDigits(date + 10, 2);
+  int sec   = parseDigits(date + 12, 2);
+
+  if ((year < 1970) || (month < 1) || (month > 12) || (day < 1) ||
+      (day > daysInMonth(year, month)) || (hour > 23) || (min > 59) ||
+      (sec > 59))
+    return 0;
+
+  /* The seconds run out in February 2106. */
+  int32_t days = daysFromCivil(year, month, day);
+  uint64_t time = (uint64_t)days * SECONDS_PER_DAY + hour * 3600U +
+                  min * 60U + sec;
+  return (time <= UINT32_MAX) ? (uint32_t)time : 0;
+}
+
+bool frFromPosition(FixRecord_t *rec, const Position_t *pos) {
+  memset(rec, 0, sizeof(*rec));
+
+  rec->time = frParseTime(pos->date);
+  if (0 == rec->time)
+    return false;
+
+  rec->latitude = roundToInt(pos->latitude * FR_DEGREE_SCALE);
+  rec->longitude = roundToInt(pos->longitude * FR_DEGREE_SCALE);
+
+  int32_t altitude = roundToInt(pos->altitude);
+  if (altitude > INT16_MAX) altitude = INT16_MAX;
+  if (altitude < INT16_MIN) altitude = INT16_MIN;
+  rec->altitude = (int16_t)altitude;
+
+  int32_t speed = roundToInt(pos->speed * FR_SPEED_SCALE);
+  if (speed > UINT16_MAX) speed = UINT16_MAX;
+  if (speed < 0) speed = 0;
+  rec->speed = (uint16_t)speed;
+
+  return true;
+}
+
+/*
+ * Every field of the cell location is two digits after a separator.
+ */
+bool frCellDate(char date[], const char *day, const char *time) {
+  static const char fraction[] = ".000";
+  size_t i;
+
+  if ((8U != strlen(day)) || (8U != strlen(time)))
+    return false;
+
+  date[0] = '2';
+  date[1] = '0';
+  for (i = 0; i < 3; ++i) {
+    memcpy(&date[2 + 2 * i], &day[3 * i], 2);
+    memcpy(&date[8 + 2 * i], &time[3 * i], 2);
+  }
+  memcpy(&date[14], fraction, sizeof(fraction));
+
+  return 0U != frParseTime(date);
+}
+
+uint32_t frTimeFromRtc(const RTCDateTime *timespec) {
+  int32_t days = daysFromCivil(timespec->year + RTC_BASE_YEAR,
+                               timespec->month, timespec->day);
+  return (uint32_t)days * SECONDS_PER_DAY + timespec->millisecond / 1000U;
+}
+
+void frTimeToRtc(uint32_t time, RTCDateTime *timespec) {
+  int32_t days = (int32_t)(time / SECONDS_PER_DAY);
+  int year, month, day;
+  civilFromDays(days, &year, &month, &day);
+
+  memset(timespec, 0, sizeof(*timespec));
+  timespec->year = year - RTC_BASE_YEAR;
+  timespec->month = month;
+  timespec->day = day;
+  /* 1970-01-01 was a Thursday, the RTC counts Monday as 1. */
+  timespec->dayofweek = (days + 3) % 7 + 1;
+  timespec->millisecond = (time % SECONDS_PER_DAY) * 1000U;
+}
+
+/****************************** END OF FILE **********************************/
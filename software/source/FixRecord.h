@@ -0,0 +1,77 @@
+/**
+ * @file FixRecord.h
+ * @brief Compact fixed-point representation of a position fix.
+ */
+
+#ifndef FIX_RECORD_H
+#define FIX_RECORD_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "Dashboard.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Coordinates are stored in units of 1e-7 degrees.
+ */
+#define FR_DEGREE_SCALE             10000000
+
+/**
+ * @brief Speed is stored in units of 0.01 km/h.
+ */
+#define FR_SPEED_SCALE              100
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief 16 byte position fix, four records share a 64 byte cache line.
+ */
+typedef struct {
+  uint32_t time;       /**< Seconds since 1970-01-01 00:00:00 UTC.          */
+  int32_t latitude;    /**< 1e-7 degrees.                                   */
+  int32_t longitude;   /**< 1e-7 degrees.                                   */
+  int16_t altitude;    /**< Meters.                                         */
+  uint16_t speed;      /**< 0.01 km/h.                                      */
+} FixRecord_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Convert a GNSS date (yyyyMMddhhmmss.sss) to seconds since epoch.
+ * @return Seconds since epoch, 0 if the date is malformed.
+ */
+uint32_t frParseTime(const char *date);
+
+bool frFromPosition(FixRecord_t *rec, const Position_t *pos);
+
+/**
+ * @brief Convert the yy/MM/dd and hh:mm:ss of a cell location to a GNSS
+ *        date, the buffer holds 19 characters.
+ * @return False if the result is not a valid date.
+ */
+bool frCellDate(char date[], const char *day, const char *time);
+
+/**
+ * @brief Conversion between seconds since epoch and the RTC calendar.
+ */
+uint32_t frTimeFromRtc(const RTCDateTime *timespec);
+void frTimeToRtc(uint32_t time, RTCDateTime *timespec);
+
+#endif /* FIX_RECORD_H */
+
+/****************************** END OF FILE **********************************/
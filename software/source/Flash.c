@@ -0,0 +1,154 @@
+/**
+ * @file Flash.c
+ * @brief Erase and program access to a region of flash.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "Flash.h"
+#include "hal.h"
+#include "gtrackconf.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define FLASH_KEY1                  0x45670123U
+#define FLASH_KEY2                  0xCDEF89ABU
+#define FLASH_BASE_ADDRESS          0x08000000U
+
+#define FLASH_SR_ERRORS                                                       \
+  (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR |    \
+   FLASH_SR_SIZERR | FLASH_SR_PGSERR | FLASH_SR_MISERR | FLASH_SR_FASTERR)
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+/* End of the initialised data in flash, the last part of the image. */
+extern uint8_t _textdata_start[];
+extern uint8_t _data_start[];
+extern uint8_t _data_end[];
+
+static bool slotErase(const FlashDevice_t *dev, uint32_t offset);
+static bool slotProgram(const FlashDevice_t *dev, uint32_t offset,
+                        const uint8_t *data, size_t length);
+
+const FlashDevice_t flashSlot = {
+  (const uint8_t *)GTRACK_OTA_SLOT_ADDRESS,
+  GTRACK_OTA_SLOT_SIZE,
+  FLASH_PAGE_SIZE,
+  FLASH_WRITE_SIZE,
+  slotErase,
+  slotProgram,
+  NULL
+};
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static void unlock(void) {
+  if (FLASH->CR & FLASH_CR_LOCK) {
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+  }
+}
+
+static void lock(void) {
+  FLASH->CR |= FLASH_CR_LOCK;
+}
+
+static bool waitReady(void) {
+  while (FLASH->SR & FLASH_SR_BSY)
+    ;
+  bool ok = (0U == (FLASH->SR & FLASH_SR_ERRORS));
+  FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;
+  return ok;
+}
+
+/*
+ * The caches may still hold the erased contents.
+ */
+static void flushCaches(void) {
+  uint32_t acr = FLASH->ACR;
+  FLASH->ACR = acr & ~(FLASH_ACR_DCEN | FLASH_ACR_ICEN);
+  FLASH->ACR = (acr & ~(FLASH_ACR_DCEN | FLASH_ACR_ICEN)) |
+               FLASH_ACR_DCRST | FLASH_ACR_ICRST;
+  FLASH->ACR = acr;
+}
+
+/*
+ * Code runs from the same bank, the CPU stalls for the 22 ms of a page
+ * erase. Serial input arriving meanwhile may overrun.
+ */
+static bool slotErase(const FlashDevice_t *dev, uint32_t offset) {
+  uint32_t page = (GTRACK_OTA_SLOT_ADDRESS - FLASH_BASE_ADDRESS + offset) /
+                  dev->pageSize;
+
+  unlock();
+  bool ok = waitReady();
+  if (ok) {
+    FLASH->CR = (FLASH->CR & ~FLASH_CR_PNB) | FLASH_CR_PER |
+                (page << FLASH_CR_PNB_Pos);
+    FLASH->CR |= FLASH_CR_STRT;
+    ok = waitReady();
+    FLASH->CR &= ~(FLASH_CR_PER | FLASH_CR_PNB);
+  }
+  lock();
+  flushCaches();
+  return ok;
+}
+
+/*
+ * Double words are programmed one by one, the two halves are written back
+ * to back.
+ */
+static bool slotProgram(const FlashDevice_t *dev, uint32_t offset,
+                        const uint8_t *data, size_t length) {
+  volatile uint32_t *dst = (volatile uint32_t *)(dev->base + offset);
+  bool ok;
+  size_t i;
+
+  unlock();
+  ok = waitReady();
+  if (ok) {
+    FLASH->CR |= FLASH_CR_PG;
+    for (i = 0; ok && (i < length); i += FLASH_WRITE_SIZE) {
+      uint32_t words[2];
+      memcpy(words, data + i, sizeof(words));
+      chSysLock();
+      dst[0] = words[0];
+      dst[1] = words[1];
+      chSysUnlock();
+      dst += 2;
+      ok = waitReady();
+    }
+    FLASH->CR &= ~FLASH_CR_PG;
+  }
+  lock();
+  return ok;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool flashSlotIsFree(void) {
+  uint32_t end = (uint32_t)(uintptr_t)_textdata_start +
+                 (uint32_t)(_data_end - _data_start);
+  return end <= GTRACK_OTA_SLOT_ADDRESS;
+}
+
+/****************************** END OF FILE **********************************/
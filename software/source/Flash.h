@@ -0,0 +1,65 @@
+/**
+ * @file Flash.h
+ * @brief Erase and program access to a region of flash.
+ */
+
+#ifndef FLASH_H
+#define FLASH_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define FLASH_PAGE_SIZE             2048
+#define FLASH_WRITE_SIZE            8
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct FlashDevice FlashDevice_t;
+
+/**
+ * @brief A region of memory mapped flash, offsets are relative to base.
+ * @note  Programming needs erased memory and writeSize aligned offsets and
+ *        lengths, the same as the internal flash of the STM32L4.
+ */
+struct FlashDevice {
+  const uint8_t *base;
+  uint32_t size;
+  uint32_t pageSize;
+  uint32_t writeSize;
+  bool (*erase)(const FlashDevice_t *dev, uint32_t offset);
+  bool (*program)(const FlashDevice_t *dev, uint32_t offset,
+                  const uint8_t *data, size_t length);
+  void *priv;
+};
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+/**
+ * @brief The internal flash at GTRACK_OTA_SLOT_ADDRESS.
+ */
+extern const FlashDevice_t flashSlot;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief False if the running image reaches into the slot.
+ */
+bool flashSlotIsFree(void);
+
+#endif /* FLASH_H */
+
+/****************************** END OF FILE **********************************/
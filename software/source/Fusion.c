@@ -0,0 +1,397 @@
+/**
+ * @file Fusion.c
+ * @brief Kalman filter of GNSS fixes and accelerometer samples.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "Fusion.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Meters per coordinate unit on the sphere of GeoMath.c.
+ */
+#define M_PER_UNIT                  0.0111195080f
+
+#define PI                          3.14159265f
+#define DEG7_PER_RAD                572957795.1f
+#define DEG_PER_RAD                 57.2957795f
+
+/**
+ * @brief The plane is moved to the latest fix beyond this offset (m), to
+ *        keep the resolution of the floats.
+ */
+#define RECENTER_DISTANCE           1000.0f
+
+/**
+ * @brief Weight of a new gravity estimate while standing.
+ */
+#define UP_WEIGHT                   0.2f
+
+/**
+ * @brief Fix intervals (ms) longer than this say nothing about the forward
+ *        acceleration.
+ */
+#define MAX_LEARN_INTERVAL_IN_MS    10000U
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+/*
+ * Newton's method from the halved exponent, libm is not linked.
+ */
+static float squareRoot(float value) {
+  union {
+    float f;
+    uint32_t u;
+  } guess = {value};
+  int i;
+
+  if (value <= 0.0f)
+    return 0.0f;
+  guess.u = (guess.u >> 1) + 0x1FC00000U;
+  for (i = 0; i < 3; ++i)
+    guess.f = 0.5f * (guess.f + value / guess.f);
+  return guess.f;
+}
+
+static float dot(const float a[3], const float b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static bool normalize(float v[3]) {
+  float length = squareRoot(dot(v, v));
+  int i;
+
+  if (length <= 0.0f)
+    return false;
+  for (i = 0; i < 3; ++i)
+    v[i] /= length;
+  return true;
+}
+
+static void cross(const float a[3], const float b[3], float out[3]) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+/*
+ * Specific force without its component along the gravity.
+ */
+static void horizontal(const Fusion_t *fu, const float acc[3], float out[3]) {
+  float vertical = dot(acc, fu->up);
+  int i;
+  for (i = 0; i < 3; ++i)
+    out[i] = acc[i] - vertical * fu->up[i];
+}
+
+static float wrapAngle(float angle) {
+  while (angle > PI)
+    angle -= 2.0f * PI;
+  while (angle <= -PI)
+    angle += 2.0f * PI;
+  return angle;
+}
+
+static void project(const Fusion_t *fu, const GmPoint_t *p, float *east,
+                    float *north) {
+  *east = (float)(int32_t)(p->lon - fu->origin.lon) * fu->eastScale;
+  *north = (float)(int32_t)(p->lat - fu->origin.lat) * M_PER_UNIT;
+}
+
+static void setOrigin(Fusion_t *fu, const GmPoint_t *p) {
+  fu->origin = *p;
+  fu->eastScale = M_PER_UNIT * (float)gmCos(p->lat) / (float)GM_ONE;
+}
+
+/*
+ * Variance of the GNSS course (rad^2), from the speed noise across the
+ * direction of travel.
+ */
+static float courseVariance(float speed, float accuracy) {
+  float sigma = FU_SPEED_NOISE * accuracy / speed;
+  return sigma * sigma;
+}
+
+static void restart(Fusion_t *fu, const FuFix_t *fix) {
+  float accuracy = (fix->accuracy > FU_MIN_ACCURACY) ? fix->accuracy
+                                                     : FU_MIN_ACCURACY;
+  float speedNoise = FU_SPEED_NOISE * accuracy;
+  float bias = fu->initialized ? fu->x[4] : 0.0f;
+  float biasVariance = fu->initialized ? fu->P[4][4] : 0.25f;
+
+  setOrigin(fu, &fix->position);
+  memset(fu->P, 0, sizeof(fu->P));
+  fu->x[0] = 0.0f;
+  fu->x[1] = 0.0f;
+  fu->x[2] = fix->speed;
+  fu->x[3] = wrapAngle(fix->course / DEG_PER_RAD);
+  fu->x[4] = bias;
+  fu->P[0][0] = accuracy * accuracy;
+  fu->P[1][1] = accuracy * accuracy;
+  fu->P[2][2] = speedNoise * speedNoise;
+  fu->P[3][3] = (fix->speed >= FU_COURSE_MIN_SPEED)
+                    ? courseVariance(fix->speed, accuracy)
+                    : PI * PI;
+  fu->P[4][4] = biasVariance;
+  fu->rejects = 0;
+  fu->initialized = true;
+}
+
+/*
+ * Sequential update with a measurement of a single state.
+ */
+static void updateState(Fusion_t *fu, int k, float innovation, float r) {
+  float row[FU_STATES];
+  float gain[FU_STATES];
+  float s = fu->P[k][k] + r;
+  int i, j;
+
+  for (i = 0; i < FU_STATES; ++i) {
+    row[i] = fu->P[k][i];
+    gain[i] = fu->P[i][k] / s;
+  }
+  for (i = 0; i < FU_STATES; ++i) {
+    fu->x[i] += gain[i] * innovation;
+    for (j = 0; j < FU_STATES; ++j)
+      fu->P[i][j] -= gain[i] * row[j];
+  }
+  fu->x[3] = wrapAngle(fu->x[3]);
+  if (fu->x[2] < 0.0f)
+    fu->x[2] = 0.0f;
+}
+
+/*
+ * The gravity is taken while standing. When moving, the horizontal force
+ * correlated with the speed change between two fixes points forward, the
+ * sideways and vertical forces average out.
+ */
+static void learnMounting(Fusion_t *fu, const FuFix_t *fix) {
+  float mean[3];
+  uint32_t interval = fix->time - fu->fixTime;
+  bool valid = (0U != fu->fixTime) && (0U != interval) &&
+               (interval <= MAX_LEARN_INTERVAL_IN_MS);
+  int i;
+
+  if (0U != fu->accCount) {
+    for (i = 0; i < 3; ++i) {
+      mean[i] = fu->accSum[i] / (float)fu->accCount;
+      fu->accSum[i] = 0.0f;
+    }
+    fu->accCount = 0;
+
+    if (!fu->upKnown) {
+      memcpy(fu->up, mean, sizeof(fu->up));
+      fu->upKnown = normalize(fu->up);
+    } else if (valid && (fix->speed < FU_STILL_SPEED) &&
+               (fu->fixSpeed < FU_STILL_SPEED)) {
+      normalize(mean);
+      for (i = 0; i < 3; ++i)
+        fu->up[i] += UP_WEIGHT * (mean[i] - fu->up[i]);
+      normalize(fu->up);
+    } else if (valid) {
+      float h[3];
+      float acceleration = (fix->speed - fu->fixSpeed) * 1000.0f /
+                           (float)interval;
+      horizontal(fu, mean, h);
+      for (i = 0; i < 3; ++i)
+        fu->evidence[i] += h[i] * acceleration;
+      fu->evidenceWeight += acceleration * acceleration;
+      if (fu->evidenceWeight >= FU_MOUNT_EVIDENCE) {
+        horizontal(fu, fu->evidence, fu->forward);
+        fu->mounted = normalize(fu->forward);
+      }
+    }
+  }
+
+  fu->fixSpeed = fix->speed;
+  fu->fixTime = fix->time;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void fuInit(Fusion_t *fu) {
+  memset(fu, 0, sizeof(*fu));
+}
+
+/*
+ * Extended filter of a vehicle moving along its heading: x' = x + (v dt +
+ * a dt^2 / 2) sin(h), y' = y + (v dt + a dt^2 / 2) cos(h), v' = v + a dt.
+ * The forward force minus the bias is the acceleration, the sideways
+ * force turns the heading, both only once the mounting is known. Without
+ * it the speed and heading walk with the larger noise.
+ */
+void fuPredict(Fusion_t *fu, const float acc[3], uint32_t time) {
+  float dt = (float)(time - fu->time) * 0.001f;
+  float forward = 0.0f;
+  float accNoise = FU_ACC_NOISE_UNMOUNTED;
+  float headingNoise = FU_HEADING_NOISE_UNMOUNTED;
+  float biasGain = 0.0f;
+  int i, j, k;
+
+  fu->time = time;
+  if (acc) {
+    for (i = 0; i < 3; ++i)
+      fu->accSum[i] += acc[i];
+    fu->accCount++;
+  }
+  if (!fu->initialized || (dt <= 0.0f))
+    return;
+
+  if (acc && fu->mounted) {
+    float h[3], right[3];
+    horizontal(fu, acc, h);
+    cross(fu->forward, fu->up, right);
+    forward = dot(h, fu->forward) - fu->x[4];
+    accNoise = FU_ACC_NOISE;
+    headingNoise = FU_HEADING_NOISE;
+    biasGain = 1.0f;
+    if (fu->x[2] > FU_COURSE_MIN_SPEED)
+      fu->x[3] = wrapAngle(fu->x[3] + dot(h, right) / fu->x[2] * dt);
+  }
+
+  int32_t angle = (int32_t)(fu->x[3] * DEG7_PER_RAD);
+  float s = (float)gmSin(angle) / (float)GM_ONE;
+  float c = (float)gmCos(angle) / (float)GM_ONE;
+  float step = fu->x[2] * dt + 0.5f * forward * dt * dt;
+
+  fu->x[0] += step * s;
+  fu->x[1] += step * c;
+  fu->x[2] += forward * dt;
+  if (fu->x[2] < 0.0f)
+    fu->x[2] = 0.0f;
+
+  float half = -0.5f * dt * dt * biasGain;
+  float F[FU_STATES][FU_STATES] = {
+    {1.0f, 0.0f, s * dt, step * c, half * s},
+    {0.0f, 1.0f, c * dt, -step * s, half * c},
+    {0.0f, 0.0f, 1.0f, 0.0f, -dt * biasGain},
+    {0.0f, 0.0f, 0.0f, 1.0f, 0.0f},
+    {0.0f, 0.0f, 0.0f, 0.0f, 1.0f}
+  };
+  float FP[FU_STATES][FU_STATES];
+  for (i = 0; i < FU_STATES; ++i)
+    for (j = 0; j < FU_STATES; ++j) {
+      FP[i][j] = 0.0f;
+      for (k = 0; k < FU_STATES; ++k)
+        FP[i][j] += F[i][k] * fu->P[k][j];
+    }
+  for (i = 0; i < FU_STATES; ++i)
+    for (j = 0; j < FU_STATES; ++j) {
+      fu->P[i][j] = 0.0f;
+      for (k = 0; k < FU_STATES; ++k)
+        fu->P[i][j] += FP[i][k] * F[j][k];
+    }
+
+  /* White acceleration along the heading, integrated twice. */
+  float q = accNoise * accNoise * dt;
+  float qp = q * dt * dt / 3.0f;
+  float qc = q * dt * 0.5f;
+  fu->P[0][0] += qp * s * s;
+  fu->P[0][1] += qp * s * c;
+  fu->P[1][0] += qp * s * c;
+  fu->P[1][1] += qp * c * c;
+  fu->P[0][2] += qc * s;
+  fu->P[2][0] += qc * s;
+  fu->P[1][2] += qc * c;
+  fu->P[2][1] += qc * c;
+  fu->P[2][2] += q;
+  fu->P[3][3] += headingNoise * headingNoise * dt;
+  fu->P[4][4] += FU_BIAS_NOISE * FU_BIAS_NOISE * dt;
+}
+
+bool fuUpdate(Fusion_t *fu, const FuFix_t *fix) {
+  if (!fu->initialized || (fix->time - fu->lastFix > FU_MAX_OUTAGE_IN_MS)) {
+    restart(fu, fix);
+    learnMounting(fu, fix);
+    fu->lastFix = fix->time;
+    fu->accepted++;
+    return true;
+  }
+
+  float accuracy = (fix->accuracy > FU_MIN_ACCURACY) ? fix->accuracy
+                                                     : FU_MIN_ACCURACY;
+  float r = accuracy * accuracy;
+  float east, north;
+  project(fu, &fix->position, &east, &north);
+
+  float de = east - fu->x[0];
+  float dn = north - fu->x[1];
+  if (de * de / (fu->P[0][0] + r) + dn * dn / (fu->P[1][1] + r) >
+      FU_GATE_POSITION) {
+    fu->rejected++;
+    if (++fu->rejects >= FU_MAX_REJECTS) {
+      restart(fu, fix);
+      fu->lastFix = fix->time;
+      fu->resets++;
+    }
+    return false;
+  }
+
+  fu->rejects = 0;
+  fu->accepted++;
+  fu->lastFix = fix->time;
+  updateState(fu, 0, east - fu->x[0], r);
+  updateState(fu, 1, north - fu->x[1], r);
+
+  float rv = FU_SPEED_NOISE * accuracy;
+  float dv = fix->speed - fu->x[2];
+  if (dv * dv / (fu->P[2][2] + rv * rv) <= FU_GATE_SPEED)
+    updateState(fu, 2, dv, rv * rv);
+  if (fix->speed >= FU_COURSE_MIN_SPEED) {
+    float rc = courseVariance(fix->speed, accuracy);
+    float dc = wrapAngle(fix->course / DEG_PER_RAD - fu->x[3]);
+    if (dc * dc / (fu->P[3][3] + rc) <= FU_GATE_SPEED)
+      updateState(fu, 3, dc, rc);
+  }
+
+  learnMounting(fu, fix);
+
+  if ((fu->x[0] * fu->x[0] + fu->x[1] * fu->x[1]) >
+      RECENTER_DISTANCE * RECENTER_DISTANCE) {
+    fu->x[0] -= east;
+    fu->x[1] -= north;
+    setOrigin(fu, &fix->position);
+  }
+  return true;
+}
+
+bool fuEstimate(const Fusion_t *fu, FuEstimate_t *out) {
+  if (!fu->initialized)
+    return false;
+
+  out->position.lat = fu->origin.lat + (int32_t)(fu->x[1] / M_PER_UNIT);
+  out->position.lon = fu->origin.lon + (int32_t)(fu->x[0] / fu->eastScale);
+  out->speed = fu->x[2];
+  out->heading = fu->x[3] * DEG_PER_RAD;
+  if (out->heading < 0.0f)
+    out->heading += 360.0f;
+  out->accuracy = squareRoot(fu->P[0][0] + fu->P[1][1]);
+  out->outage = fu->time - fu->lastFix;
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,191 @@
+/**
+ * @file Fusion.h
+ * @brief Kalman filter of GNSS fixes and accelerometer samples.
+ * @note  No OS dependency, tools/fusion_replay.c builds it on the host
+ *        together with GeoMath.c. Single precision, no libm.
+ */
+
+#ifndef FUSION_H
+#define FUSION_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "GeoMath.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief East and north position (m), speed (m/s), heading (radians
+ *        clockwise from north) and bias of the forward acceleration (m/s^2).
+ */
+#define FU_STATES                   5
+
+/**
+ * @brief Process noise densities per square root of a second: forward
+ *        acceleration (m/s^2) and heading rate (rad/s) with and without a
+ *        learned mounting, bias drift (m/s^2).
+ */
+#if !defined(FU_ACC_NOISE)
+#define FU_ACC_NOISE                0.5f
+#endif
+
+#if !defined(FU_ACC_NOISE_UNMOUNTED)
+#define FU_ACC_NOISE_UNMOUNTED      3.0f
+#endif
+
+#if !defined(FU_HEADING_NOISE)
+#define FU_HEADING_NOISE            0.02f
+#endif
+
+#if !defined(FU_HEADING_NOISE_UNMOUNTED)
+#define FU_HEADING_NOISE_UNMOUNTED  0.1f
+#endif
+
+#if !defined(FU_BIAS_NOISE)
+#define FU_BIAS_NOISE               0.005f
+#endif
+
+/**
+ * @brief Chi-square gates of a position (2 DOF) and a speed (1 DOF)
+ *        innovation, 99.9 %.
+ */
+#if !defined(FU_GATE_POSITION)
+#define FU_GATE_POSITION            13.8f
+#endif
+
+#if !defined(FU_GATE_SPEED)
+#define FU_GATE_SPEED               10.8f
+#endif
+
+/**
+ * @brief Consecutive rejected fixes that restart the filter from the fix.
+ */
+#if !defined(FU_MAX_REJECTS)
+#define FU_MAX_REJECTS              3
+#endif
+
+/**
+ * @brief An outage longer than this restarts the filter at the next fix.
+ */
+#if !defined(FU_MAX_OUTAGE_IN_MS)
+#define FU_MAX_OUTAGE_IN_MS         120000U
+#endif
+
+/**
+ * @brief Floor of the reported horizontal accuracy (m), speed noise per
+ *        meter of it.
+ */
+#if !defined(FU_MIN_ACCURACY)
+#define FU_MIN_ACCURACY             2.0f
+#endif
+
+#if !defined(FU_SPEED_NOISE)
+#define FU_SPEED_NOISE              0.1f
+#endif
+
+/**
+ * @brief Below this speed (m/s) the GNSS course is noise, below the still
+ *        speed the vehicle stands and the accelerometer shows gravity.
+ */
+#if !defined(FU_COURSE_MIN_SPEED)
+#define FU_COURSE_MIN_SPEED         2.0f
+#endif
+
+#if !defined(FU_STILL_SPEED)
+#define FU_STILL_SPEED              0.3f
+#endif
+
+/**
+ * @brief Sum of squared GNSS accelerations ((m/s^2)^2) before the forward
+ *        axis of the accelerometer is trusted.
+ */
+#if !defined(FU_MOUNT_EVIDENCE)
+#define FU_MOUNT_EVIDENCE           2.0f
+#endif
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  uint32_t time;       /**< Milliseconds, the time base of fuPredict().    */
+  GmPoint_t position;
+  float speed;         /**< m/s.                                           */
+  float course;        /**< Degrees clockwise from north.                  */
+  float accuracy;      /**< Horizontal 1 sigma (m), from HPA or HDOP.      */
+} FuFix_t;
+
+typedef struct {
+  GmPoint_t position;
+  float speed;         /**< m/s.                                           */
+  float heading;       /**< Degrees clockwise from north, [0, 360).        */
+  float accuracy;      /**< Horizontal 1 sigma (m).                        */
+  uint32_t outage;     /**< Milliseconds since the last accepted fix.      */
+} FuEstimate_t;
+
+typedef struct {
+  bool initialized;
+  uint32_t time;
+  float x[FU_STATES];
+  float P[FU_STATES][FU_STATES];
+  GmPoint_t origin;    /**< Of the local east-north plane.                 */
+  float eastScale;     /**< Meters per longitude unit at the origin.       */
+  uint32_t lastFix;
+  uint8_t rejects;     /**< Consecutive rejected fixes.                    */
+  /* Mounting of the accelerometer, unit vectors in its own frame. */
+  bool upKnown;
+  bool mounted;
+  float up[3];
+  float forward[3];
+  float evidence[3];
+  float evidenceWeight;
+  /* Mean specific force between two fixes, for learning the mounting. */
+  float accSum[3];
+  uint32_t accCount;
+  float fixSpeed;
+  uint32_t fixTime;
+  /* Statistics. */
+  uint32_t accepted;
+  uint32_t rejected;
+  uint32_t resets;
+} Fusion_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void fuInit(Fusion_t *fu);
+
+/**
+ * @brief Move the state to the given time.
+ * @param acc Mean specific force since the last call in m/s^2, axes of the
+ *            accelerometer, NULL without samples.
+ */
+void fuPredict(Fusion_t *fu, const float acc[3], uint32_t time);
+
+/**
+ * @brief Correct the state with a fix taken at the time of the last
+ *        prediction.
+ * @return False if the fix was rejected as an outlier.
+ */
+bool fuUpdate(Fusion_t *fu, const FuFix_t *fix);
+
+/**
+ * @return False until the first fix.
+ */
+bool fuEstimate(const Fusion_t *fu, FuEstimate_t *out);
+
+#endif /* FUSION_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,337 @@
+/**
+ * @file FusionThread.c
+ * @brief GNSS fixes fused with the accelerometer, published at 5 Hz.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "FusionThread.h"
+#include "Dashboard.h"
+#include "Fusion.h"
+#include "Lis3dsh.h"
+#include "Sdcard.h"
+#include "gtrackconf.h"
+
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define FIX_EVENT                   EVENT_MASK(0)
+#define GRAVITY                     9.80665f
+#define SAMPLE_PERIOD_IN_MS         (1000 / LIS_RATE_IN_HZ)
+#define LOG_BUFFER_SIZE             1024
+#define LOG_LINE_SIZE               48
+
+/**
+ * @brief A missing fix turns the output into dead reckoning, fixes come
+ *        every 5 s.
+ */
+#define DEAD_RECKONING_AFTER_IN_MS  7500U
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  uint32_t steps;
+  uint32_t samples;
+  uint32_t fixes;
+  uint64_t cycles;
+  uint32_t maxCycles;
+  uint32_t recorded;    /**< Lines written to the log.                     */
+} FusionStats_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static Fusion_t fusion;
+static mutex_t lock;
+static volatile bool running;
+static bool sensorFound;
+static thread_t *fusionThread;
+static FusionStats_t stats;
+static LisSample_t samples[LIS_FIFO_SIZE];
+
+/* Written by the GPS reader, under chSysLock(). */
+static FuFix_t pendingFix;
+static bool fixPending;
+
+/* Milliseconds since start, does not wrap with the system time. */
+static systime_t clockBase;
+static uint32_t clockMs;
+
+static FIL logFile;
+static bool recording;
+static char logBuffer[LOG_BUFFER_SIZE];
+static size_t logLength;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static uint32_t now(void) {
+  sysinterval_t elapsed = chVTTimeElapsedSinceX(clockBase);
+  uint32_t ms = (uint32_t)elapsed / (CH_CFG_ST_FREQUENCY / 1000);
+  clockBase = chTimeAddX(clockBase, (sysinterval_t)ms *
+                                    (CH_CFG_ST_FREQUENCY / 1000));
+  clockMs += ms;
+  return clockMs;
+}
+
+static void logLine(const char *line) {
+  size_t length = strlen(line);
+  if (logLength + length > sizeof(logBuffer))
+    return;
+  memcpy(logBuffer + logLength, line, length);
+  logLength += length;
+  stats.recorded++;
+}
+
+static void logFlush(bool sync) {
+  UINT bw = 0;
+  if (logLength && ((FR_OK != f_write(&logFile, logBuffer, logLength, &bw)) ||
+                    (bw != logLength))) {
+    f_close(&logFile);
+    recording = false;
+  } else if (sync) {
+    f_sync(&logFile);
+  }
+  logLength = 0;
+}
+
+static void stopRecording(void) {
+  if (recording) {
+    logFlush(false);
+    f_close(&logFile);
+    recording = false;
+  }
+}
+
+/*
+ * The FIFO is read as a whole, the samples are 40 ms apart and the last
+ * one is the newest.
+ */
+static bool readSensor(uint32_t time, float acc[3]) {
+  int32_t sum[3] = {0, 0, 0};
+  char line[LOG_LINE_SIZE];
+  size_t n = sensorFound ? lisRead(samples, LIS_FIFO_SIZE) : 0U;
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    sum[0] += samples[i].x;
+    sum[1] += samples[i].y;
+    sum[2] += samples[i].z;
+    if (recording) {
+      chsnprintf(line, sizeof(line), "A %lu %ld %ld %ld\n",
+                 time - (uint32_t)(n - 1U - i) * SAMPLE_PERIOD_IN_MS,
+                 (int32_t)samples[i].x * LIS_UG_PER_DIGIT / 1000,
+                 (int32_t)samples[i].y * LIS_UG_PER_DIGIT / 1000,
+                 (int32_t)samples[i].z * LIS_UG_PER_DIGIT / 1000);
+      logLine(line);
+    }
+  }
+  stats.samples += n;
+  if (0U == n)
+    return false;
+
+  float scale = (float)LIS_UG_PER_DIGIT * 1e-6f * GRAVITY / (float)n;
+  for (i = 0; i < 3; ++i)
+    acc[i] = (float)sum[i] * scale;
+  return true;
+}
+
+static void publish(void) {
+  FuEstimate_t e;
+  Motion_t motion;
+
+  memset(&motion, 0, sizeof(motion));
+  if (fuEstimate(&fusion, &e) && (e.outage <= FU_MAX_OUTAGE_IN_MS)) {
+    motion.state = (e.outage > DEAD_RECKONING_AFTER_IN_MS)
+                       ? MOTION_DEAD_RECKONING
+                       : MOTION_TRACKING;
+    motion.latitude = e.position.lat;
+    motion.longitude = e.position.lon;
+    motion.speed = (uint16_t)(e.speed * 360.0f);
+    motion.heading = (uint16_t)(e.heading * 100.0f);
+    motion.accuracy = (uint32_t)e.accuracy;
+    motion.outage = e.outage;
+  }
+  dbSetMotion(&motion);
+}
+
+static void step(void) {
+  uint32_t time = now();
+  float acc[3];
+  FuFix_t fix;
+  bool hasFix;
+  char line[LOG_LINE_SIZE];
+
+  bool hasAcc = readSensor(time, acc);
+
+  chSysLock();
+  hasFix = fixPending;
+  fix = pendingFix;
+  fixPending = false;
+  chSysUnlock();
+
+  rtcnt_t start = chSysGetRealtimeCounterX();
+  fuPredict(&fusion, hasAcc ? acc : NULL, time);
+  if (hasFix) {
+    fix.time = time;
+    fuUpdate(&fusion, &fix);
+  }
+  uint32_t cycles = chSysGetRealtimeCounterX() - start;
+
+  stats.steps++;
+  stats.cycles += cycles;
+  if (cycles > stats.maxCycles)
+    stats.maxCycles = cycles;
+  publish();
+
+  if (hasFix) {
+    stats.fixes++;
+    if (recording) {
+      chsnprintf(line, sizeof(line), "G %lu %ld %ld %lu %lu %lu\n", time,
+                 fix.position.lat, fix.position.lon,
+                 (uint32_t)(fix.speed * 100.0f),
+                 (uint32_t)(fix.course * 100.0f),
+                 (uint32_t)(fix.accuracy * 100.0f));
+      logLine(line);
+    }
+  }
+  if (recording)
+    logFlush(hasFix);
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+THD_FUNCTION(FusionThread, arg) {
+  (void)arg;
+  chRegSetThreadName("fusion");
+  fusionThread = chThdGetSelfX();
+
+  while (true) {
+    chEvtWaitAnyTimeout(FIX_EVENT, TIME_MS2I(GTRACK_FUSION_PERIOD_IN_MS));
+    chMtxLock(&lock);
+    if (running)
+      step();
+    chMtxUnlock(&lock);
+  }
+}
+
+void FusionThreadInit(void) {
+  chMtxObjectInit(&lock);
+  running = false;
+  sensorFound = false;
+  fixPending = false;
+  recording = false;
+  memset(&stats, 0, sizeof(stats));
+  fuInit(&fusion);
+}
+
+/*
+ * The filter starts over at every ride, the mounting is learned again
+ * since the device may have been moved.
+ */
+void FusionStart(void) {
+  chMtxLock(&lock);
+  sensorFound = lisStart();
+  fuInit(&fusion);
+  memset(&stats, 0, sizeof(stats));
+  clockBase = chVTGetSystemTimeX();
+  clockMs = 0;
+  chSysLock();
+  fixPending = false;
+  chSysUnlock();
+  running = true;
+  chMtxUnlock(&lock);
+}
+
+void FusionStop(void) {
+  chMtxLock(&lock);
+  running = false;
+  stopRecording();
+  lisPark();
+  sensorFound = false;
+  Motion_t motion;
+  memset(&motion, 0, sizeof(motion));
+  dbSetMotion(&motion);
+  chMtxUnlock(&lock);
+}
+
+void FusionGnss(const FixRecord_t *rec, float course, float accuracy) {
+  chSysLock();
+  pendingFix.position.lat = rec->latitude;
+  pendingFix.position.lon = rec->longitude;
+  pendingFix.speed = (float)rec->speed / (3.6f * FR_SPEED_SCALE);
+  pendingFix.course = course;
+  pendingFix.accuracy = accuracy;
+  fixPending = true;
+  if (fusionThread)
+    chEvtSignalI(fusionThread, FIX_EVENT);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+void FusionCmdFusion(BaseSequentialStream *chp, int argc, char *argv[]) {
+  FuEstimate_t e;
+
+  if ((1 == argc) && !strcmp(argv[0], "rec")) {
+    chMtxLock(&lock);
+    if (!recording && running && sdcardIsMounted() &&
+        (FR_OK == f_open(&logFile, GTRACK_FUSION_LOG_FILE,
+                         FA_OPEN_APPEND | FA_WRITE))) {
+      logLength = 0;
+      stats.recorded = 0;
+      recording = true;
+    }
+    chMtxUnlock(&lock);
+  } else if ((1 == argc) && !strcmp(argv[0], "stop")) {
+    chMtxLock(&lock);
+    stopRecording();
+    chMtxUnlock(&lock);
+  } else if (0 != argc) {
+    chprintf(chp, "Usage: fusion [rec|stop]\r\n");
+    return;
+  }
+
+  chMtxLock(&lock);
+  chprintf(chp, "%s, accelerometer %s, mounting %s\r\n",
+           running ? "running" : "stopped",
+           sensorFound ? "found" : "missing",
+           fusion.mounted ? "learned" : (fusion.upKnown ? "level" : "unknown"));
+  if (fuEstimate(&fusion, &e))
+    chprintf(chp, "%ld %ld, %lu.%02lu km/h, %lu.%02lu deg, "
+             "%lu m, %lu ms since the last fix\r\n",
+             e.position.lat, e.position.lon,
+             (uint32_t)(e.speed * 360.0f) / 100U,
+             (uint32_t)(e.speed * 360.0f) % 100U,
+             (uint32_t)(e.heading * 100.0f) / 100U,
+             (uint32_t)(e.heading * 100.0f) % 100U,
+             (uint32_t)e.accuracy, e.outage);
+  chprintf(chp, "fixes %lu, accepted %lu, rejected %lu, restarts %lu\r\n",
+           stats.fixes, fusion.accepted, fusion.rejected, fusion.resets);
+  if (stats.steps > 0U)
+    chprintf(chp, "steps %lu, samples %lu, %lu cycles/step, max %lu\r\n",
+             stats.steps, stats.samples,
+             (uint32_t)(stats.cycles / stats.steps),
+             stats.maxCycles);
+  if (recording)
+    chprintf(chp, "recording %s, %lu lines\r\n", GTRACK_FUSION_LOG_FILE,
+             stats.recorded);
+  chMtxUnlock(&lock);
+}
+
+/****************************** END OF FILE **********************************/
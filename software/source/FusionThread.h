@@ -0,0 +1,51 @@
+/**
+ * @file FusionThread.h
+ * @brief GNSS fixes fused with the accelerometer, published at 5 Hz.
+ */
+
+#ifndef FUSION_THREAD_H
+#define FUSION_THREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "FixRecord.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(FusionThread, arg);
+void FusionThreadInit(void);
+void FusionStart(void);
+void FusionStop(void);
+
+/**
+ * @brief Hand over a GNSS fix, applied at once by the fusion thread.
+ * @param course Degrees clockwise from north.
+ * @param accuracy Horizontal accuracy in meters.
+ */
+void FusionGnss(const FixRecord_t *rec, float course, float accuracy);
+
+void FusionCmdFusion(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* FUSION_THREAD_H */
+
+/******************************* END OF FILE ***********************************/
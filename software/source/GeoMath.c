@@ -0,0 +1,394 @@
+/**
+ * @file GeoMath.c
+ * @brief Fixed-point distance, bearing and cross-track kernels.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "GeoMath.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Mean Earth radius of 6371008.8 m in the units of the results:
+ *        centimeters per coordinate unit (Q30) and 2R in centimeters.
+ */
+#define CM_PER_UNIT_Q30             1193948083LL
+#define EARTH_DIAMETER_IN_CM        1274201760LL
+
+/**
+ * @brief Binary angle units, 2^32 per turn, per coordinate unit (Q30).
+ */
+#define BAM_PER_UNIT_Q30            1281023894LL
+
+#define DEG90                       (90LL * GM_DEGREE)
+#define DEG180                      (180LL * GM_DEGREE)
+#define HALF_PI_Q30                 1686629713LL
+
+#define SIN_STEPS                   256
+#define ATAN_STEPS                  256
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+/**
+ * @brief sin(i * 90 / 256 degrees), Q30.
+ */
+static const int32_t sinTable[SIN_STEPS + 1] = {
+           0,    6588356,   13176464,   19764076,   26350943,
+    32936819,   39521455,   46104602,   52686014,   59265442,
+    65842639,   72417357,   78989349,   85558366,   92124163,
+    98686491,  105245103,  111799753,  118350194,  124896179,
+   131437462,  137973796,  144504935,  151030634,  157550647,
+   164064728,  170572633,  177074115,  183568930,  190056834,
+   196537583,  203010932,  209476638,  215934457,  222384147,
+   228825464,  235258165,  241682010,  248096755,  254502159,
+   260897982,  267283981,  273659918,  280025552,  286380643,
+   292724951,  299058239,  305380268,  311690799,  317989595,
+   324276419,  330551034,  336813204,  343062693,  349299266,
+   355522689,  361732726,  367929144,  374111709,  380280190,
+   386434353,  392573967,  398698801,  404808624,  410903207,
+   416982319,  423045732,  429093217,  435124548,  441139496,
+   447137835,  453119340,  459083786,  465030947,  470960600,
+   476872522,  482766489,  488642281,  494499676,  500338453,
+   506158392,  511959275,  517740883,  523502998,  529245404,
+   534967884,  540670223,  546352205,  552013618,  557654248,
+   563273883,  568872310,  574449320,  580004702,  585538248,
+   591049748,  596538995,  602005783,  607449906,  612871159,
+   618269338,  623644239,  628995660,  634323400,  639627258,
+   644907034,  650162530,  655393548,  660599890,  665781362,
+   670937767,  676068911,  681174602,  686254647,  691308855,
+   696337036,  701339000,  706314559,  711263525,  716185713,
+   721080937,  725949013,  730789757,  735602987,  740388522,
+   745146182,  749875788,  754577161,  759250125,  763894504,
+   768510122,  773096806,  777654384,  782182683,  786681534,
+   791150767,  795590213,  799999706,  804379079,  808728167,
+   813046808,  817334838,  821592095,  825818421,  830013654,
+   834177638,  838310216,  842411232,  846480531,  850517961,
+   854523370,  858496606,  862437520,  866345964,  870221790,
+   874064853,  877875009,  881652112,  885396022,  889106597,
+   892783698,  896427186,  900036924,  903612776,  907154608,
+   910662286,  914135678,  917574653,  920979082,  924348837,
+   927683790,  930983817,  934248793,  937478595,  940673101,
+   943832191,  946955747,  950043650,  953095785,  956112036,
+   959092290,  962036435,  964944360,  967815955,  970651112,
+   973449725,  976211688,  978936898,  981625251,  984276646,
+   986890984,  989468165,  992008094,  994510675,  996975812,
+   999403415, 1001793390, 1004145648, 1006460100, 1008736660,
+  1010975242, 1013175761, 1015338134, 1017462281, 1019548121,
+  1021595575, 1023604567, 1025575020, 1027506862, 1029400018,
+  1031254418, 1033069992, 1034846671, 1036584389, 1038283080,
+  1039942680, 1041563127, 1043144360, 1044686319, 1046188946,
+  1047652185, 1049075980, 1050460278, 1051805027, 1053110176,
+  1054375676, 1055601479, 1056787540, 1057933813, 1059040255,
+  1060106826, 1061133483, 1062120190, 1063066909, 1063973603,
+  1064840240, 1065666786, 1066453210, 1067199483, 1067905576,
+  1068571464, 1069197120, 1069782521, 1070327646, 1070832474,
+  1071296985, 1071721163, 1072104991, 1072448455, 1072751542,
+  1073014240, 1073236540, 1073418433, 1073559913, 1073660973,
+  1073721611, 1073741824
+};
+
+/**
+ * @brief atan(i / 256) in 1e-7 degrees.
+ */
+static const int32_t atanTable[ATAN_STEPS + 1] = {
+          0,   2238105,   4476142,   6714042,   8951737,  11189159,
+   13426240,  15662912,  17899106,  20134755,  22369791,  24604145,
+   26837752,  29070542,  31302449,  33533405,  35763344,  37992198,
+   40219902,  42446388,  44671591,  46895444,  49117882,  51338839,
+   53558250,  55776051,  57992176,  60206562,  62419143,  64629858,
+   66838641,  69045431,  71250163,  73452778,  75653211,  77851401,
+   80047289,  82240811,  84431909,  86620523,  88806592,  90990057,
+   93170861,  95348944,  97524249,  99696720, 101866298, 104032927,
+  106196553, 108357119, 110514570, 112668853, 114819914, 116967698,
+  119112154, 121253230, 123390873, 125525032, 127655658, 129782699,
+  131906107, 134025833, 136141827, 138254044, 140362435, 142466953,
+  144567554, 146664191, 148756820, 150845396, 152929877, 155010218,
+  157086378, 159158315, 161225988, 163289356, 165348379, 167403018,
+  169453234, 171498989, 173540246, 175576968, 177609119, 179636663,
+  181659565, 183677791, 185691307, 187700080, 189704078, 191703268,
+  193697620, 195687103, 197671687, 199651342, 201626040, 203595752,
+  205560452, 207520112, 209474706, 211424208, 213368593, 215307837,
+  217241915, 219170805, 221094483, 223012929, 224926119, 226834034,
+  228736652, 230633954, 232525922, 234412535, 236293777, 238169630,
+  240040076, 241905100, 243764686, 245618818, 247467482, 249310664,
+  251148349, 252980525, 254807179, 256628300, 258443876, 260253895,
+  262058347, 263857222, 265650512, 267438206, 269220296, 270996775,
+  272767634, 274532867, 276292467, 278046428, 279794744, 281537410,
+  283274422, 285005775, 286731465, 288451489, 290165843, 291874526,
+  293577535, 295274869, 296966525, 298652504, 300332804, 302007426,
+  303676370, 305339636, 306997226, 308649140, 310295381, 311935951,
+  313570852, 315200088, 316823660, 318441574, 320053832, 321660439,
+  323261400, 324856719, 326446401, 328030453, 329608879, 331181686,
+  332748880, 334310468, 335866457, 337416853, 338961666, 340500901,
+  342034568, 343562675, 345085230, 346602242, 348113720, 349619673,
+  351120112, 352615045, 354104483, 355588436, 357066914, 358539928,
+  360007490, 361469609, 362926297, 364377567, 365823428, 367263894,
+  368698976, 370128687, 371553039, 372972044, 374385716, 375794066,
+  377197109, 378594857, 379987324, 381374524, 382756469, 384133174,
+  385504653, 386870920, 388231988, 389587873, 390938589, 392284150,
+  393624571, 394959867, 396290053, 397615144, 398935154, 400250100,
+  401559996, 402864858, 404164702, 405459542, 406749396, 408034277,
+  409314203, 410589189, 411859252, 413124406, 414384669, 415640057,
+  416890585, 418136270, 419377129, 420613178, 421844433, 423070911,
+  424292629, 425509603, 426721849, 427929385, 429132227, 430330392,
+  431523897, 432712759, 433896994, 435076619, 436251652, 437422109,
+  438588007, 439749364, 440906196, 442058519, 443206352, 444349712,
+  445488615, 446623078, 447753118, 448878753, 450000000
+};
+
+/**
+ * @brief Taylor series of asin(x) / x in x^2, Q30.
+ */
+static const int32_t asinSeries[] = {
+  1073741824, 178956971, 80530637, 47934903, 32622364, 24021923, 18632389,
+  14994637
+};
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static uint32_t toBam(int64_t angle) {
+  return (uint32_t)((angle * BAM_PER_UNIT_Q30) >> 30);
+}
+
+/*
+ * The two top bits select the quadrant, the next eight the table step and
+ * the low 22 bits interpolate.
+ */
+static int32_t sinBam(uint32_t bam) {
+  uint32_t quadrant = bam >> 30;
+  uint32_t within = bam & 0x3FFFFFFFU;
+
+  if (quadrant & 1U)
+    within = (1UL << 30) - within;
+
+  uint32_t i = within >> 22;
+  int32_t value = sinTable[i];
+  if (i < SIN_STEPS) {
+    int64_t step = sinTable[i + 1] - value;
+    value += (int32_t)((step * (within & 0x3FFFFFU)) >> 22);
+  }
+
+  return (quadrant & 2U) ? -value : value;
+}
+
+static int64_t wrapLongitude(int64_t dlon) {
+  if (dlon > DEG180)
+    dlon -= 2 * DEG180;
+  else if (dlon <= -DEG180)
+    dlon += 2 * DEG180;
+  return dlon;
+}
+
+static int32_t midLatitude(const GmPoint_t *a, const GmPoint_t *b) {
+  return (int32_t)(((int64_t)a->lat + b->lat) / 2);
+}
+
+/*
+ * East and north offsets of b from a in coordinate units, longitudes are
+ * scaled by the cosine of the reference latitude.
+ */
+static void project(const GmPoint_t *a, const GmPoint_t *b, int32_t cosRef,
+                    int64_t *east, int64_t *north) {
+  *east = (wrapLongitude((int64_t)b->lon - a->lon) * cosRef) >> 30;
+  *north = (int64_t)b->lat - a->lat;
+}
+
+static uint32_t unitsToCm(uint64_t units) {
+  uint64_t cm = (units * CM_PER_UNIT_Q30) >> 30;
+  return (cm > UINT32_MAX) ? UINT32_MAX : (uint32_t)cm;
+}
+
+/*
+ * Series up to x^15 for x <= 1/2, the error is below 1e-6 there. Larger
+ * arguments are folded with asin(x) = pi/2 - 2 asin(sqrt((1 - x) / 2)).
+ */
+static int64_t asinQ30(int64_t x) {
+  if (x > GM_ONE / 2) {
+    int64_t half = (GM_ONE - x) / 2;
+    return HALF_PI_Q30 - 2 * asinQ30(gmSqrt((uint64_t)half << 30));
+  }
+
+  int64_t z = (x * x) >> 30;
+  int64_t sum = 0;
+  int i;
+  for (i = (int)(sizeof(asinSeries) / sizeof(asinSeries[0])) - 1; i >= 0; --i)
+    sum = asinSeries[i] + ((sum * z) >> 30);
+  return (x * sum) >> 30;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+int32_t gmSin(int32_t angle) {
+  return sinBam(toBam(angle));
+}
+
+int32_t gmCos(int32_t angle) {
+  return sinBam(toBam(angle) + (1UL << 30));
+}
+
+int32_t gmAtan2(int32_t y, int32_t x) {
+  uint32_t ax = (x < 0) ? -(uint32_t)x : (uint32_t)x;
+  uint32_t ay = (y < 0) ? -(uint32_t)y : (uint32_t)y;
+  uint32_t num = (ay < ax) ? ay : ax;
+  uint32_t den = (ay < ax) ? ax : ay;
+
+  if (0U == den)
+    return 0;
+
+  /* Both are scaled up to keep 16 significant bits of the divisor. */
+  int shift = __builtin_clz(den);
+  den <<= shift;
+  num <<= shift;
+  uint32_t ratio = num / (den >> 16);
+  if (ratio > (1UL << 16))
+    ratio = 1UL << 16;
+
+  uint32_t i = ratio >> 8;
+  int32_t angle = atanTable[i];
+  if (i < ATAN_STEPS)
+    angle += ((atanTable[i + 1] - angle) * (int32_t)(ratio & 0xFFU)) >> 8;
+
+  if (ay > ax)
+    angle = (int32_t)(DEG90 - angle);
+  if (x < 0)
+    angle = (int32_t)(DEG180 - angle);
+  return (y < 0) ? -angle : angle;
+}
+
+/*
+ * Digit by digit from the highest set bit pair, without branches in the
+ * loop. Values below 2^32, the usual step between fixes, stay in 32 bits.
+ */
+uint32_t gmSqrt(uint64_t value) {
+  if (0U == value)
+    return 0;
+
+  if (value <= UINT32_MAX) {
+    uint32_t v = (uint32_t)value, root = 0;
+    uint32_t bit = 1UL << ((31 - __builtin_clz(v)) & ~1);
+    while (0U != bit) {
+      uint32_t trial = root + bit;
+      uint32_t mask = -(uint32_t)(v >= trial);
+      v -= trial & mask;
+      root = (root >> 1) + (bit & mask);
+      bit >>= 2;
+    }
+    return root;
+  }
+
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << ((63 - __builtin_clzll(value)) & ~1);
+  while (0U != bit) {
+    uint64_t trial = root + bit;
+    uint64_t mask = -(uint64_t)(value >= trial);
+    value -= trial & mask;
+    root = (root >> 1) + (bit & mask);
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+uint32_t gmEquirect(const GmPoint_t *a, const GmPoint_t *b) {
+  int64_t east, north;
+  project(a, b, gmCos(midLatitude(a, b)), &east, &north);
+  return unitsToCm(gmSqrt((uint64_t)(east * east) + (uint64_t)(north * north)));
+}
+
+/*
+ * hav = sin^2(dlat / 2) + cos(lat1) cos(lat2) sin^2(dlon / 2) in Q60, the
+ * halves are taken of the binary angles to keep their resolution.
+ */
+uint32_t gmHaversine(const GmPoint_t *a, const GmPoint_t *b) {
+  int64_t s1 = sinBam((uint32_t)((int32_t)toBam((int64_t)b->lat - a->lat) / 2));
+  int64_t s2 = sinBam((uint32_t)((int32_t)toBam(
+                 wrapLongitude((int64_t)b->lon - a->lon)) / 2));
+  int64_t cc = ((int64_t)gmCos(a->lat) * gmCos(b->lat)) >> 30;
+  int64_t t = (cc * s2) >> 30;
+  uint64_t hav = (uint64_t)(s1 * s1) + (uint64_t)(t * s2);
+
+  if (hav > ((uint64_t)1 << 60))
+    hav = (uint64_t)1 << 60;
+  int64_t angle = asinQ30(gmSqrt(hav));
+  return (uint32_t)((angle * EARTH_DIAMETER_IN_CM) >> 30);
+}
+
+uint32_t gmDistance(const GmPoint_t *a, const GmPoint_t *b) {
+  int64_t dlat = (int64_t)b->lat - a->lat;
+  int64_t dlon = wrapLongitude((int64_t)b->lon - a->lon);
+
+  if ((dlat > GM_EQUIRECT_MAX_SPAN) || (dlat < -GM_EQUIRECT_MAX_SPAN) ||
+      (dlon > GM_EQUIRECT_MAX_SPAN) || (dlon < -GM_EQUIRECT_MAX_SPAN))
+    return gmHaversine(a, b);
+  return gmEquirect(a, b);
+}
+
+/*
+ * The direction on the plane is the bearing at the midpoint, the meridians
+ * converge by dlon * sin(lat) between the ends and half of it is taken back.
+ * That holds within GM_EQUIRECT_MAX_SPAN, farther points take the great
+ * circle formula with its north component written as
+ * sin dlat + 2 sin lat1 cos lat2 sin^2(dlon / 2), which does not cancel.
+ */
+uint32_t gmBearing(const GmPoint_t *a, const GmPoint_t *b) {
+  int64_t dlat = (int64_t)b->lat - a->lat;
+  int64_t dlon = wrapLongitude((int64_t)b->lon - a->lon);
+  int64_t angle;
+
+  if ((dlat > GM_EQUIRECT_MAX_SPAN) || (dlat < -GM_EQUIRECT_MAX_SPAN) ||
+      (dlon > GM_EQUIRECT_MAX_SPAN) || (dlon < -GM_EQUIRECT_MAX_SPAN)) {
+    int64_t cos2 = gmCos(b->lat);
+    int64_t half = gmSin((int32_t)(dlon / 2));
+    int64_t y = (gmSin((int32_t)dlon) * cos2) >> 30;
+    int64_t x = gmSin((int32_t)dlat) +
+                ((((((gmSin(a->lat) * cos2) >> 30) * half) >> 30) * half) >> 29);
+    angle = gmAtan2((int32_t)y, (int32_t)x);
+  } else {
+    int32_t mid = midLatitude(a, b);
+    int64_t east, north;
+    project(a, b, gmCos(mid), &east, &north);
+    angle = gmAtan2((int32_t)east, (int32_t)north) -
+            ((dlon * gmSin(mid)) >> 31);
+  }
+
+  if (angle < 0)
+    angle += 2 * DEG180;
+  else if (angle >= 2 * DEG180)
+    angle -= 2 * DEG180;
+  return (uint32_t)angle;
+}
+
+/*
+ * p in polar coordinates around a, one scale of longitude for the whole
+ * triangle would be off by the convergence of the meridians.
+ */
+int32_t gmCrossTrack(const GmPoint_t *a, const GmPoint_t *b,
+                     const GmPoint_t *p) {
+  uint32_t distance = gmEquirect(a, p);
+
+  if ((a->lat == b->lat) && (a->lon == b->lon))
+    return (int32_t)((distance > INT32_MAX) ? INT32_MAX : distance);
+
+  int64_t angle = (int64_t)gmBearing(a, p) - gmBearing(a, b);
+  int64_t cm = ((int64_t)distance * sinBam(toBam(angle))) >> 30;
+  return (int32_t)((cm > INT32_MAX) ? INT32_MAX : cm);
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,119 @@
+/**
+ * @file GeoMath.h
+ * @brief Fixed-point distance, bearing and cross-track kernels.
+ * @note  No OS dependency and no floating point, the FPU is not used by this
+ *        build. tools/geomath_check.c measures the errors quoted below
+ *        against double precision on the same sphere.
+ */
+
+#ifndef GEO_MATH_H
+#define GEO_MATH_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Fixed-point one of the Q30 results.
+ */
+#define GM_ONE                      (1L << 30)
+
+/**
+ * @brief Coordinate units per degree, as in FixRecord_t.
+ */
+#define GM_DEGREE                   10000000L
+
+/**
+ * @brief gmDistance() and gmBearing() switch from the local plane to the
+ *        great circle formulas above this latitude or longitude difference.
+ */
+#if !defined(GM_EQUIRECT_MAX_SPAN)
+#define GM_EQUIRECT_MAX_SPAN        (GM_DEGREE / 2)
+#endif
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief Coordinates in 1e-7 degrees.
+ */
+typedef struct {
+  int32_t lat;
+  int32_t lon;
+} GmPoint_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Sine and cosine of an angle in 1e-7 degrees, Q30.
+ * @note  Quarter wave table of 256 steps with linear interpolation, the
+ *        error is below 5e-6.
+ */
+int32_t gmSin(int32_t angle);
+int32_t gmCos(int32_t angle);
+
+/**
+ * @brief Angle of (x, y) in 1e-7 degrees, (-180, 180].
+ * @note  Octant reduction to a 256 step table, the error is below 0.001
+ *        degrees. Only 32 bit divisions are used.
+ */
+int32_t gmAtan2(int32_t y, int32_t x);
+
+uint32_t gmSqrt(uint64_t value);
+
+/**
+ * @brief Distance in centimeters on the local plane of the midpoint.
+ * @note  Within 3 cm plus 1e-5 of the distance up to 10 km and 1e-4 up to
+ *        100 km, below 70 degrees of latitude. The 3 cm are the rounding of
+ *        the coordinates.
+ */
+uint32_t gmEquirect(const GmPoint_t *a, const GmPoint_t *b);
+
+/**
+ * @brief Great circle distance in centimeters.
+ * @note  Within 6 cm plus 1.2e-5 of the distance at any range, about twice
+ *        the cost of gmEquirect().
+ */
+uint32_t gmHaversine(const GmPoint_t *a, const GmPoint_t *b);
+
+/**
+ * @brief gmEquirect() for points within GM_EQUIRECT_MAX_SPAN, gmHaversine()
+ *        beyond.
+ */
+uint32_t gmDistance(const GmPoint_t *a, const GmPoint_t *b);
+
+/**
+ * @brief Initial great circle bearing from a to b, 1e-7 degrees clockwise
+ *        from north, [0, 360).
+ * @note  Within 0.002 degrees from 1 km to the antipode. Closer points are
+ *        limited by the rounding of the coordinates, 0.06 degrees at 10 m.
+ */
+uint32_t gmBearing(const GmPoint_t *a, const GmPoint_t *b);
+
+/**
+ * @brief Signed distance of p from the line through a and b in centimeters,
+ *        positive on the right hand side looking from a to b.
+ * @note  Within 6 cm up to 1 km and 30 cm up to 10 km from a. The distance
+ *        from a if a and b coincide.
+ */
+int32_t gmCrossTrack(const GmPoint_t *a, const GmPoint_t *b,
+                     const GmPoint_t *p);
+
+#endif /* GEO_MATH_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,314 @@
+/**
+ * @file Geofence.c
+ * @brief Polygon fences with a grid index and debounced enter/exit events.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "Geofence.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool inBox(const GfFence_t *fence, const GfPoint_t *p) {
+  return (p->lat >= fence->min.lat) && (p->lat <= fence->max.lat) &&
+         (p->lon >= fence->min.lon) && (p->lon <= fence->max.lon);
+}
+
+/*
+ * Cell coordinate of a value, clamped to the grid.
+ */
+static uint32_t cellOf(int32_t value, int32_t min, uint32_t size,
+                       uint32_t n) {
+  if (value <= min)
+    return 0;
+  uint32_t cell = (uint32_t)(((int64_t)value - min) / size);
+  return (cell < n) ? cell : n - 1U;
+}
+
+static bool inGrid(const Geofence_t *gf, const GfPoint_t *p) {
+  int64_t n = gf->mem.gridSize;
+  return (p->lat >= gf->gridMin.lat) && (p->lon >= gf->gridMin.lon) &&
+         ((int64_t)p->lat - gf->gridMin.lat < n * gf->cellLat) &&
+         ((int64_t)p->lon - gf->gridMin.lon < n * gf->cellLon);
+}
+
+/*
+ * Fences of a cell, counted in the first pass and listed in the second.
+ */
+static size_t forEachCell(Geofence_t *gf, size_t fence, bool fill) {
+  const GfFence_t *f = &gf->mem.fences[fence];
+  uint32_t n = gf->mem.gridSize;
+  uint32_t lat0 = cellOf(f->min.lat, gf->gridMin.lat, gf->cellLat, n);
+  uint32_t lat1 = cellOf(f->max.lat, gf->gridMin.lat, gf->cellLat, n);
+  uint32_t lon0 = cellOf(f->min.lon, gf->gridMin.lon, gf->cellLon, n);
+  uint32_t lon1 = cellOf(f->max.lon, gf->gridMin.lon, gf->cellLon, n);
+  uint32_t i, j;
+
+  for (i = lat0; i <= lat1; ++i) {
+    for (j = lon0; j <= lon1; ++j) {
+      uint16_t *start = &gf->mem.cellStart[i * n + j];
+      if (fill)
+        gf->mem.cellEntries[(*start)++] = (uint16_t)fence;
+      else
+        start[1]++;
+    }
+  }
+  return (size_t)(lat1 - lat0 + 1U) * (lon1 - lon0 + 1U);
+}
+
+static void activate(Geofence_t *gf, size_t fence) {
+  size_t i;
+  for (i = 0; i < gf->activeCount; ++i)
+    if (gf->mem.active[i] == fence)
+      return;
+  gf->mem.active[gf->activeCount++] = (uint16_t)fence;
+}
+
+/*
+ * A fence leaves the active list once it is outside and settled.
+ */
+static void deactivate(Geofence_t *gf) {
+  size_t i = 0;
+  while (i < gf->activeCount) {
+    const GfFence_t *f = &gf->mem.fences[gf->mem.active[i]];
+    if (!f->inside && (0U == f->contrary))
+      gf->mem.active[i] = gf->mem.active[--gf->activeCount];
+    else
+      ++i;
+  }
+}
+
+/*
+ * Hysteresis in time: the state only changes after debounce fixes on the
+ * other side, a fix on the same side starts the count again. The first fix
+ * after the index is built sets the states without a transition.
+ */
+static bool evaluate(Geofence_t *gf, size_t fence, const GfPoint_t *p) {
+  GfFence_t *f = &gf->mem.fences[fence];
+  if (f->seen == gf->epoch)
+    return false;
+  f->seen = gf->epoch;
+
+  gf->boxTests++;
+  bool inside = inBox(f, p);
+  if (inside) {
+    gf->polygonTests++;
+    inside = gfContains(gf, fence, p);
+  }
+
+  if (!gf->seeded) {
+    f->inside = inside;
+    if (inside)
+      activate(gf, fence);
+    return false;
+  }
+
+  if (inside == f->inside) {
+    f->contrary = 0;
+    return false;
+  }
+
+  if (++f->contrary < gf->debounce) {
+    activate(gf, fence);
+    return false;
+  }
+
+  f->inside = inside;
+  f->contrary = 0;
+  if (inside)
+    activate(gf, fence);
+  return true;
+}
+
+/*
+ * Every fence is evaluated, only the reported transitions are limited.
+ */
+static void check(Geofence_t *gf, size_t fence, const GfPoint_t *p,
+                  GfTransition_t *out, size_t max, size_t *num) {
+  if (!evaluate(gf, fence, p))
+    return;
+  if (*num < max) {
+    out[*num].fence = (uint16_t)fence;
+    out[*num].entered = gf->mem.fences[fence].inside;
+    ++*num;
+  } else {
+    gf->dropped++;
+  }
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void gfInit(Geofence_t *gf, const GfStorage_t *storage, uint8_t debounce) {
+  memset(gf, 0, sizeof(*gf));
+  gf->mem = *storage;
+  gf->debounce = (debounce > 0U) ? debounce : 1U;
+}
+
+int gfAddFence(Geofence_t *gf, const GfPoint_t *points, size_t count,
+               uint8_t flags) {
+  size_t i;
+
+  if ((count < 3) || (count > GF_MAX_VERTICES_PER_FENCE) ||
+      (gf->fenceCount == gf->mem.maxFences) ||
+      (gf->vertexCount + count > gf->mem.maxVertices) ||
+      (gf->vertexCount + count > UINT16_MAX))
+    return -1;
+
+  GfFence_t *f = &gf->mem.fences[gf->fenceCount];
+  memset(f, 0, sizeof(*f));
+  f->first = (uint16_t)gf->vertexCount;
+  f->count = (uint16_t)count;
+  f->flags = flags;
+  f->min = f->max = points[0];
+  for (i = 0; i < count; ++i) {
+    const GfPoint_t *v = &points[i];
+    gf->mem.vertices[gf->vertexCount + i] = *v;
+    if (v->lat < f->min.lat) f->min.lat = v->lat;
+    if (v->lat > f->max.lat) f->max.lat = v->lat;
+    if (v->lon < f->min.lon) f->min.lon = v->lon;
+    if (v->lon > f->max.lon) f->max.lon = v->lon;
+  }
+
+  gf->vertexCount += count;
+  gf->indexed = false;
+  return (int)gf->fenceCount++;
+}
+
+bool gfBuildIndex(Geofence_t *gf) {
+  uint32_t n = gf->mem.gridSize;
+  size_t cells = (size_t)n * n;
+  size_t i, total = 0;
+  GfPoint_t max;
+
+  gf->indexed = false;
+  gf->seeded = false;
+  gf->activeCount = 0;
+  memset(gf->mem.cellStart, 0, (cells + 1U) * sizeof(uint16_t));
+  if (0U == gf->fenceCount)
+    return true;
+
+  gf->gridMin = gf->mem.fences[0].min;
+  max = gf->mem.fences[0].max;
+  for (i = 0; i < gf->fenceCount; ++i) {
+    const GfFence_t *f = &gf->mem.fences[i];
+    if (f->min.lat < gf->gridMin.lat) gf->gridMin.lat = f->min.lat;
+    if (f->min.lon < gf->gridMin.lon) gf->gridMin.lon = f->min.lon;
+    if (f->max.lat > max.lat) max.lat = f->max.lat;
+    if (f->max.lon > max.lon) max.lon = f->max.lon;
+  }
+  gf->cellLat = (uint32_t)(((int64_t)max.lat - gf->gridMin.lat) / n + 1);
+  gf->cellLon = (uint32_t)(((int64_t)max.lon - gf->gridMin.lon) / n + 1);
+
+  /* Counts in cellStart[cell + 1], then prefix sums give the starts. */
+  for (i = 0; i < gf->fenceCount; ++i)
+    total += forEachCell(gf, i, false);
+  if ((total > gf->mem.maxCellEntries) || (total > UINT16_MAX))
+    return false;
+  for (i = 0; i < cells; ++i)
+    gf->mem.cellStart[i + 1] += gf->mem.cellStart[i];
+
+  /* Filling moves every start to the end of its cell, shift them back. */
+  for (i = 0; i < gf->fenceCount; ++i)
+    forEachCell(gf, i, true);
+  for (i = cells; i > 0; --i)
+    gf->mem.cellStart[i] = gf->mem.cellStart[i - 1];
+  gf->mem.cellStart[0] = 0;
+
+  for (i = 0; i < gf->fenceCount; ++i) {
+    GfFence_t *f = &gf->mem.fences[i];
+    f->inside = false;
+    f->contrary = 0;
+  }
+  gf->indexed = true;
+  return true;
+}
+
+/*
+ * Coordinates relative to the bounding box keep the differences in 32 bits
+ * and the cross products in 64 bits.
+ */
+bool gfContains(const Geofence_t *gf, size_t fence, const GfPoint_t *p) {
+  const GfFence_t *f = &gf->mem.fences[fence];
+  const GfPoint_t *v = &gf->mem.vertices[f->first];
+  int64_t py = (int64_t)p->lat - f->min.lat;
+  int64_t px = (int64_t)p->lon - f->min.lon;
+  int64_t ay, ax;
+  bool inside = false;
+  size_t i;
+
+  ay = (int64_t)v[f->count - 1U].lat - f->min.lat;
+  ax = (int64_t)v[f->count - 1U].lon - f->min.lon;
+  for (i = 0; i < f->count; ++i) {
+    int64_t by = (int64_t)v[i].lat - f->min.lat;
+    int64_t bx = (int64_t)v[i].lon - f->min.lon;
+    if ((ay > py) != (by > py)) {
+      /* Sign of the cross product tells the side of the edge. */
+      int64_t cross = (bx - ax) * (py - ay) - (px - ax) * (by - ay);
+      if ((by > ay) ? (cross > 0) : (cross < 0))
+        inside = !inside;
+    }
+    ay = by;
+    ax = bx;
+  }
+  return inside;
+}
+
+size_t gfUpdate(Geofence_t *gf, const GfPoint_t *p, GfTransition_t *out,
+                size_t max) {
+  size_t num = 0;
+  size_t i;
+
+  if (!gf->indexed)
+    return 0;
+
+  gf->fixes++;
+  gf->epoch++;
+
+  /* Fences the fix was inside of are checked even from other cells. */
+  for (i = 0; i < gf->activeCount; ++i)
+    check(gf, gf->mem.active[i], p, out, max, &num);
+
+  if (inGrid(gf, p)) {
+    uint32_t n = gf->mem.gridSize;
+    uint32_t cell =
+        cellOf(p->lat, gf->gridMin.lat, gf->cellLat, n) * n +
+        cellOf(p->lon, gf->gridMin.lon, gf->cellLon, n);
+    for (i = gf->mem.cellStart[cell]; i < gf->mem.cellStart[cell + 1]; ++i)
+      check(gf, gf->mem.cellEntries[i], p, out, max, &num);
+  }
+
+  gf->seeded = true;
+  deactivate(gf);
+  return num;
+}
+
+bool gfIsInside(const Geofence_t *gf, size_t fence) {
+  return (fence < gf->fenceCount) && gf->mem.fences[fence].inside;
+}
+
+/****************************** END OF FILE **********************************/
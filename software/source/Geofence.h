@@ -0,0 +1,139 @@
+/**
+ * @file Geofence.h
+ * @brief Polygon fences with a grid index and debounced enter/exit events.
+ * @note  No OS dependency, tools/geofence_bench.c builds it on the host.
+ */
+
+#ifndef GEOFENCE_H
+#define GEOFENCE_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define GF_ALERT_ENTER              (1U << 0)
+#define GF_ALERT_EXIT               (1U << 1)
+
+#define GF_MAX_VERTICES_PER_FENCE   UINT16_MAX
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief Coordinates in 1e-7 degrees, as in FixRecord_t.
+ */
+typedef struct {
+  int32_t lat;
+  int32_t lon;
+} GfPoint_t;
+
+typedef struct {
+  GfPoint_t min;       /**< Bounding box.                                  */
+  GfPoint_t max;
+  uint16_t first;      /**< First vertex in the vertex pool.               */
+  uint16_t count;
+  uint8_t flags;       /**< GF_ALERT_* bitmap.                              */
+  bool inside;         /**< Debounced state.                               */
+  uint8_t contrary;    /**< Consecutive fixes against the state.           */
+  uint32_t seen;       /**< Last evaluation, tests a fence once per fix.   */
+} GfFence_t;
+
+/**
+ * @brief Memory of an engine, sized by the caller.
+ * @note  cellStart holds gridSize * gridSize + 1 entries, active holds
+ *        maxFences entries.
+ */
+typedef struct {
+  GfFence_t *fences;
+  size_t maxFences;
+  GfPoint_t *vertices;
+  size_t maxVertices;
+  uint16_t *cellStart;
+  uint16_t *cellEntries;
+  size_t maxCellEntries;
+  uint16_t *active;
+  uint32_t gridSize;
+} GfStorage_t;
+
+typedef struct {
+  uint16_t fence;
+  bool entered;
+} GfTransition_t;
+
+typedef struct {
+  GfStorage_t mem;
+  size_t fenceCount;
+  size_t vertexCount;
+  size_t activeCount;
+  bool indexed;
+  bool seeded;         /**< States set from the first fix.                 */
+  GfPoint_t gridMin;
+  uint32_t cellLat;    /**< Cell size in 1e-7 degrees.                     */
+  uint32_t cellLon;
+  uint8_t debounce;    /**< Fixes needed to change the state.              */
+  uint32_t epoch;
+  uint32_t fixes;      /**< Statistics.                                    */
+  uint32_t boxTests;
+  uint32_t polygonTests;
+  uint32_t dropped;    /**< Transitions that did not fit in out.           */
+} Geofence_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @param debounce Consecutive fixes on the other side of the border before
+ *                 an enter or exit is reported, at least 1.
+ */
+void gfInit(Geofence_t *gf, const GfStorage_t *storage, uint8_t debounce);
+
+/**
+ * @brief Add a polygon, the last vertex connects to the first.
+ * @note  The index is invalid until gfBuildIndex() is called.
+ * @return The fence number, or -1 if the storage is full.
+ */
+int gfAddFence(Geofence_t *gf, const GfPoint_t *points, size_t count,
+               uint8_t flags);
+
+/**
+ * @brief Sort the fences into the cells of a uniform grid over all of
+ *        them, a fence is listed in every cell its bounding box touches.
+ * @note  The next fix sets the states of the fences without transitions.
+ * @return False if the cell entries do not fit.
+ */
+bool gfBuildIndex(Geofence_t *gf);
+
+/**
+ * @brief Crossing number test, points on the border count on either side.
+ */
+bool gfContains(const Geofence_t *gf, size_t fence, const GfPoint_t *p);
+
+/**
+ * @brief Evaluate a fix against the fences of its cell and the fences it
+ *        was last seen inside.
+ * @note  All of them are updated, transitions beyond max are counted in
+ *        dropped and not reported.
+ * @return Number of transitions written to out.
+ */
+size_t gfUpdate(Geofence_t *gf, const GfPoint_t *p, GfTransition_t *out,
+                size_t max);
+
+bool gfIsInside(const Geofence_t *gf, size_t fence);
+
+#endif /* GEOFENCE_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,379 @@
+/**
+ * @file GeofenceThread.c
+ * @brief Enter and exit alerts of the fences on the SD card.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "GeofenceThread.h"
+#include "Dashboard.h"
+#include "FixRecord.h"
+#include "Geofence.h"
+#include "Sdcard.h"
+#include "SmsHandlerThread.h"
+#include "TraceRecorder.h"
+#include "gtrackconf.h"
+
+#include "chprintf.h"
+#include "ff.h"
+
+#include <ctype.h>
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define POSITION_EVENT              EVENT_MASK(0)
+#define NAME_SIZE                   16
+#define LINE_SIZE                   64
+#define MAX_TRANSITIONS             4
+#define MAX_FENCE_VERTICES          64
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  FIL file;
+  char buf[LINE_SIZE];
+  UINT length;
+  UINT pos;
+} LineReader_t;
+
+typedef struct {
+  uint32_t fixes;
+  uint32_t skipped;     /**< Fixes without GNSS.                           */
+  uint32_t transitions;
+  uint32_t cycles;
+  uint32_t maxCycles;
+} GeofenceStats_t;
+
+typedef struct {
+  bool valid;           /**< Fences loaded while the card was mounted.     */
+  bool found;
+  FSIZE_t size;
+  WORD date;
+  WORD time;
+} FenceFile_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static GfFence_t fences[GTRACK_GEOFENCE_MAX_FENCES];
+static GfPoint_t vertices[GTRACK_GEOFENCE_MAX_VERTICES];
+static uint16_t cellStart[GTRACK_GEOFENCE_GRID_SIZE *
+                          GTRACK_GEOFENCE_GRID_SIZE + 1];
+static uint16_t cellEntries[8 * GTRACK_GEOFENCE_MAX_FENCES];
+static uint16_t active[GTRACK_GEOFENCE_MAX_FENCES];
+static char names[GTRACK_GEOFENCE_MAX_FENCES][NAME_SIZE];
+
+static const GfStorage_t storage = {
+  fences, GTRACK_GEOFENCE_MAX_FENCES,
+  vertices, GTRACK_GEOFENCE_MAX_VERTICES,
+  cellStart, cellEntries, sizeof(cellEntries) / sizeof(cellEntries[0]),
+  active, GTRACK_GEOFENCE_GRID_SIZE
+};
+
+static Geofence_t geofence;
+static mutex_t lock;
+static volatile bool running;
+static GeofenceStats_t stats;
+static LineReader_t reader;
+static GfPoint_t points[MAX_FENCE_VERTICES];
+static const char *loadError;
+static FenceFile_t loadedFile;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+/*
+ * FatFS is built without f_gets(), lines are cut from blocks.
+ */
+static bool readLine(LineReader_t *lr, char *line, size_t size) {
+  size_t n = 0;
+  while (true) {
+    if (lr->pos == lr->length) {
+      lr->pos = 0;
+      if ((FR_OK != f_read(&lr->file, lr->buf, sizeof(lr->buf), &lr->length)) ||
+          (0U == lr->length)) {
+        line[n] = '\0';
+        return n > 0;
+      }
+    }
+    char c = lr->buf[lr->pos++];
+    if ('\n' == c) {
+      line[n] = '\0';
+      return true;
+    }
+    if (('\r' != c) && (n < size - 1))
+      line[n++] = c;
+  }
+}
+
+/*
+ * Decimal degrees to 1e-7 degrees without floating point, digits after the
+ * seventh are dropped.
+ */
+static bool parseDegrees(const char **str, int32_t *value, int32_t limit) {
+  const char *s = *str;
+  bool negative = false;
+  int32_t whole = 0, fraction = 0, scale = FR_DEGREE_SCALE;
+
+  while ((' ' == *s) || (',' == *s) || ('\t' == *s))
+    s++;
+  if (('-' == *s) || ('+' == *s))
+    negative = ('-' == *s++);
+  if (!isdigit((unsigned char)*s))
+    return false;
+  while (isdigit((unsigned char)*s) && (whole <= limit))
+    whole = whole * 10 + (*s++ - '0');
+  if ('.' == *s) {
+    s++;
+    while (isdigit((unsigned char)*s)) {
+      if (scale > 1) {
+        scale /= 10;
+        fraction += (*s - '0') * scale;
+      }
+      s++;
+    }
+  }
+  if (whole > limit)
+    return false;
+
+  *value = whole * FR_DEGREE_SCALE + fraction;
+  if (negative)
+    *value = -*value;
+  *str = s;
+  return true;
+}
+
+static void addFence(const char *name, size_t count, uint8_t flags) {
+  if (0U == count)
+    return;
+  int id = gfAddFence(&geofence, points, count, flags);
+  if (id < 0) {
+    loadError = "fence storage full or fence invalid";
+    return;
+  }
+  strncpy(names[id], name, NAME_SIZE - 1);
+  names[id][NAME_SIZE - 1] = '\0';
+}
+
+/*
+ * The file lists the fences one after the other:
+ *
+ *   fence <name> [enter] [exit]
+ *   <lat> <lon>
+ *   ...
+ *
+ * Coordinates are decimal degrees, lines starting with # are comments.
+ */
+static void statFile(FenceFile_t *file) {
+  FILINFO info;
+
+  memset(file, 0, sizeof(*file));
+  file->valid = sdcardIsMounted();
+  if (file->valid && (FR_OK == f_stat(GTRACK_GEOFENCE_FILE, &info))) {
+    file->found = true;
+    file->size = info.fsize;
+    file->date = info.fdate;
+    file->time = info.ftime;
+  }
+}
+
+/*
+ * An unmounted card says nothing about the file, the fences stay.
+ */
+static bool fileChanged(void) {
+  FenceFile_t file;
+
+  statFile(&file);
+  if (!file.valid)
+    return false;
+  return !loadedFile.valid || (file.found != loadedFile.found) ||
+         (file.size != loadedFile.size) || (file.date != loadedFile.date) ||
+         (file.time != loadedFile.time);
+}
+
+static void load(void) {
+  char line[LINE_SIZE];
+  char name[NAME_SIZE] = "";
+  uint8_t flags = 0;
+  size_t count = 0;
+
+  gfInit(&geofence, &storage, GTRACK_GEOFENCE_DEBOUNCE);
+  memset(names, 0, sizeof(names));
+  statFile(&loadedFile);
+  loadError = NULL;
+
+  if (!sdcardIsMounted() ||
+      (FR_OK != f_open(&reader.file, GTRACK_GEOFENCE_FILE,
+                       FA_OPEN_EXISTING | FA_READ))) {
+    loadError = "no fence file";
+    return;
+  }
+  reader.length = reader.pos = 0;
+
+  while (readLine(&reader, line, sizeof(line)) && !loadError) {
+    const char *s = line;
+    GfPoint_t p;
+
+    if (('#' == line[0]) || ('\0' == line[0]))
+      continue;
+
+    if (!strncmp(line, "fence ", 6)) {
+      addFence(name, count, flags);
+      count = 0;
+      s += 6;
+      size_t length = strcspn(s, " ");
+      if (length >= NAME_SIZE)
+        length = NAME_SIZE - 1;
+      memcpy(name, s, length);
+      name[length] = '\0';
+      flags = (strstr(s + length, "enter") ? GF_ALERT_ENTER : 0U) |
+              (strstr(s + length, "exit") ? GF_ALERT_EXIT : 0U);
+    } else if (parseDegrees(&s, &p.lat, 90) &&
+               parseDegrees(&s, &p.lon, 180) && (count < MAX_FENCE_VERTICES)) {
+      points[count++] = p;
+    } else {
+      loadError = "syntax error";
+    }
+  }
+  f_close(&reader.file);
+
+  if (!loadError)
+    addFence(name, count, flags);
+  if (!gfBuildIndex(&geofence) && !loadError)
+    loadError = "grid index full";
+}
+
+/*
+ * Cell positions are too coarse for a fence, only GNSS fixes count.
+ */
+static void evaluate(void) {
+  GfTransition_t transitions[MAX_TRANSITIONS];
+  Position_t pos;
+  FixRecord_t rec;
+  size_t num, i;
+
+  if ((0U == dbGetPosition(&pos, NULL)) || (POS_SOURCE_GNSS != pos.source) ||
+      !frFromPosition(&rec, &pos)) {
+    stats.skipped++;
+    return;
+  }
+
+  GfPoint_t p = {rec.latitude, rec.longitude};
+  rtcnt_t start = chSysGetRealtimeCounterX();
+  num = gfUpdate(&geofence, &p, transitions, MAX_TRANSITIONS);
+  uint32_t cycles = chSysGetRealtimeCounterX() - start;
+
+  stats.fixes++;
+  stats.cycles += cycles;
+  if (cycles > stats.maxCycles)
+    stats.maxCycles = cycles;
+
+  for (i = 0; i < num; ++i) {
+    const GfTransition_t *t = &transitions[i];
+    uint8_t alert = t->entered ? GF_ALERT_ENTER : GF_ALERT_EXIT;
+    char text[40];
+
+    stats.transitions++;
+    trEvent(TR_EVT_GEOFENCE, ((uint32_t)t->fence << 1) | t->entered);
+    if (fences[t->fence].flags & alert) {
+      chsnprintf(text, sizeof(text), "g-track: %s %s",
+                 t->entered ? "entered" : "left", names[t->fence]);
+      SmsHandlerAlert(text);
+    }
+  }
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+THD_FUNCTION(GeofenceThread, arg) {
+  (void)arg;
+  chRegSetThreadName("geofence");
+
+  event_listener_t positionListener;
+  dbSubscribe(DB_GROUP_POSITION, &positionListener, POSITION_EVENT);
+
+  while (true) {
+    chEvtWaitAny(POSITION_EVENT);
+    chMtxLock(&lock);
+    if (running)
+      evaluate();
+    chMtxUnlock(&lock);
+  }
+}
+
+void GeofenceThreadInit(void) {
+  chMtxObjectInit(&lock);
+  running = false;
+  memset(&stats, 0, sizeof(stats));
+  gfInit(&geofence, &storage, GTRACK_GEOFENCE_DEBOUNCE);
+  memset(&loadedFile, 0, sizeof(loadedFile));
+  loadError = "not loaded";
+}
+
+/*
+ * The fences are read again only if the file changed since the last load,
+ * the first fix after that sets the states without alerts. Otherwise the
+ * states of the last stop carry over, a fence left while stopped is
+ * reported once the fixes arrive.
+ */
+void GeofenceStart(void) {
+  chMtxLock(&lock);
+  if (fileChanged())
+    load();
+  running = true;
+  chMtxUnlock(&lock);
+}
+
+void GeofenceStop(void) {
+  chMtxLock(&lock);
+  running = false;
+  chMtxUnlock(&lock);
+}
+
+void GeofenceCmdFence(BaseSequentialStream *chp, int argc, char *argv[]) {
+  size_t i;
+
+  if ((1 == argc) && !strcmp(argv[0], "reload")) {
+    chMtxLock(&lock);
+    load();
+    chMtxUnlock(&lock);
+  } else if (0 != argc) {
+    chprintf(chp, "Usage: fence [reload]\r\n");
+    return;
+  }
+
+  chMtxLock(&lock);
+  chprintf(chp, "%u fences, %u vertices, %ux%u grid%s%s\r\n",
+           (unsigned)geofence.fenceCount, (unsigned)geofence.vertexCount,
+           GTRACK_GEOFENCE_GRID_SIZE, GTRACK_GEOFENCE_GRID_SIZE,
+           loadError ? ", " : "", loadError ? loadError : "");
+  for (i = 0; i < geofence.fenceCount; ++i) {
+    if (gfIsInside(&geofence, i))
+      chprintf(chp, "inside %s\r\n", names[i]);
+  }
+  chprintf(chp, "fixes %lu, skipped %lu, transitions %lu, not reported %lu"
+           "\r\n", stats.fixes, stats.skipped, stats.transitions,
+           geofence.dropped);
+  if (geofence.fixes > 0U)
+    chprintf(chp, "%lu box and %lu polygon tests per 100 fixes, "
+             "%lu cycles/fix, max %lu\r\n",
+             geofence.boxTests * 100U / geofence.fixes,
+             geofence.polygonTests * 100U / geofence.fixes,
+             stats.cycles / stats.fixes, stats.maxCycles);
+  chMtxUnlock(&lock);
+}
+
+/****************************** END OF FILE **********************************/
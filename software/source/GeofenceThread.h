@@ -0,0 +1,42 @@
+/**
+ * @file GeofenceThread.h
+ * @brief Enter and exit alerts of the fences on the SD card.
+ */
+
+#ifndef GEOFENCE_THREAD_H
+#define GEOFENCE_THREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(GeofenceThread, arg);
+void GeofenceThreadInit(void);
+void GeofenceStart(void);
+void GeofenceStop(void);
+void GeofenceCmdFence(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* GEOFENCE_THREAD_H */
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,179 @@
+/**
+ * @file GnssAssist.c
+ * @brief Selection of the GNSS start mode from the persisted last fix.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "GnssAssist.h"
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define ASSIST_MAGIC                0x47415331U
+#define START_MODE_NUM              (CGNS_START_HOT + 1)
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  uint32_t magic;
+  FixRecord_t fix;
+} AssistData_t;
+
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint32_t sum;
+} TtffStats_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const modeNames[START_MODE_NUM] = {
+  [CGNS_START_COLD] = "cold",
+  [CGNS_START_WARM] = "warm",
+  [CGNS_START_HOT]  = "hot"
+};
+
+static CGNS_StartMode_t startMode = CGNS_START_COLD;
+static uint32_t startAge;
+static uint32_t savedTime;
+static TtffStats_t ttffStats[START_MODE_NUM];
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool loadAssistData(AssistData_t *data) {
+  FIL file;
+  UINT br = 0;
+
+  if (FR_OK != f_open(&file, "/gnss.dat", FA_OPEN_EXISTING | FA_READ))
+    return false;
+  f_read(&file, data, sizeof(*data), &br);
+  f_close(&file);
+
+  return (sizeof(*data) == br) && (ASSIST_MAGIC == data->magic);
+}
+
+static uint32_t rtcTime(void) {
+  RTCDateTime timespec;
+  rtcGetTime(&RTCD1, &timespec);
+  return frTimeFromRtc(&timespec);
+}
+
+static void logTtff(uint32_t time, uint32_t ttff) {
+  FIL log;
+  if (FR_OK == f_open(&log, "/gnss_ttff.log", FA_OPEN_APPEND | FA_WRITE)) {
+    char buf[48];
+    chsnprintf(buf, sizeof(buf), "%lu %s %lu %lu\n", time,
+               modeNames[startMode], startAge, ttff);
+    UINT bw = 0;
+    f_write(&log, buf, strlen(buf), &bw);
+    f_close(&log);
+  }
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void gaSave(const FixRecord_t *fix) {
+  AssistData_t data;
+  data.magic = ASSIST_MAGIC;
+  data.fix = *fix;
+
+  FIL file;
+  if (FR_OK == f_open(&file, "/gnss.dat", FA_CREATE_ALWAYS | FA_WRITE)) {
+    UINT bw = 0;
+    f_write(&file, &data, sizeof(data), &bw);
+    f_close(&file);
+  }
+}
+
+/*
+ * The RTC is clocked from the LSI and set from the GNSS time. It starts over
+ * from 1980 whenever the supply is lost, so after almost every cold boot it
+ * reads before the saved fix, the age is unknown and the start is cold even
+ * if the receiver kept its ephemeris. gaFirstFix() works the age out from
+ * the GNSS time then, for the log and the gnss command.
+ */
+CGNS_StartMode_t gaSelectStartMode(void) {
+  AssistData_t data;
+  uint32_t now = rtcTime();
+  bool loaded = loadAssistData(&data);
+
+  startMode = CGNS_START_COLD;
+  startAge = UINT32_MAX;
+  savedTime = loaded ? data.fix.time : 0U;
+
+  if (loaded && (now >= data.fix.time)) {
+    startAge = now - data.fix.time;
+    if (startAge <= GA_HOT_START_MAX_AGE_IN_S)
+      startMode = CGNS_START_HOT;
+    else if (startAge <= GA_WARM_START_MAX_AGE_IN_S)
+      startMode = CGNS_START_WARM;
+  }
+
+  return startMode;
+}
+
+/*
+ * The start was the time to first fix before the fix.
+ */
+void gaFirstFix(const FixRecord_t *fix, uint32_t ttff) {
+  RTCDateTime timespec;
+  frTimeToRtc(fix->time, &timespec);
+  rtcSetTime(&RTCD1, &timespec);
+
+  uint32_t start = fix->time - (ttff + 500U) / 1000U;
+  if ((UINT32_MAX == startAge) && (0U != savedTime) && (start >= savedTime))
+    startAge = start - savedTime;
+
+  TtffStats_t *stats = &ttffStats[startMode];
+  if ((0U == stats->count) || (ttff < stats->min))
+    stats->min = ttff;
+  if (ttff > stats->max)
+    stats->max = ttff;
+  stats->sum += ttff;
+  stats->count++;
+
+  logTtff(fix->time, ttff);
+}
+
+void gaCmdGnss(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+
+  if (argc > 0) {
+    chprintf(chp, "Usage: gnss\r\n");
+    return;
+  }
+
+  chprintf(chp, "last start %s, fix age %ld s\r\n", modeNames[startMode],
+           (UINT32_MAX == startAge) ? -1L : (int32_t)startAge);
+  chprintf(chp, "%-6s %6s %8s %8s %8s (ms)\r\n", "mode", "count", "min",
+           "mean", "max");
+
+  size_t i;
+  for (i = 0; i < START_MODE_NUM; ++i) {
+    const TtffStats_t *stats = &ttffStats[i];
+    chprintf(chp, "%-6s %6lu %8lu %8lu %8lu\r\n", modeNames[i], stats->count,
+             stats->min, stats->count ? stats->sum / stats->count : 0U,
+             stats->max);
+  }
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,67 @@
+/**
+ * @file GnssAssist.h
+ * @brief Selection of the GNSS start mode from the persisted last fix.
+ */
+
+#ifndef GNSS_ASSIST_H
+#define GNSS_ASSIST_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "FixRecord.h"
+#include "at.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Ephemeris older than this is not usable for a hot start.
+ */
+#define GA_HOT_START_MAX_AGE_IN_S   (2U * 3600U)
+
+/**
+ * @brief Almanac and last position older than this are not worth a warm
+ *        start.
+ */
+#define GA_WARM_START_MAX_AGE_IN_S  (30U * 24U * 3600U)
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Persist the last fix to /gnss.dat.
+ */
+void gaSave(const FixRecord_t *fix);
+
+/**
+ * @brief Choose the start mode from the age of the persisted fix.
+ */
+CGNS_StartMode_t gaSelectStartMode(void);
+
+/**
+ * @brief Account the time to first fix of the current start and keep the
+ *        RTC in sync with the GNSS time. A fix age the RTC could not tell
+ *        is taken from the GNSS time.
+ */
+void gaFirstFix(const FixRecord_t *fix, uint32_t ttff);
+
+void gaCmdGnss(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* GNSS_ASSIST_H */
+
+/****************************** END OF FILE **********************************/
@@ -10,6 +10,16 @@
 #include "Sdcard.h"
 #include "BoardEvents.h"
 #include "Dashboard.h"
+#include "PositionHistory.h"
+#include "Outbox.h"
+#include "LatencyProbe.h"
+#include "TraceRecorder.h"
+#include "BootProfiler.h"
+#include "GnssAssist.h"
+#include "TripLog.h"
+#include "FusionThread.h"
+#include "NetworkMonitorThread.h"
+#include "gtrackconf.h"
 #include "sim8xx.h"
 #include "at.h"
 
@@ -24,6 +34,7 @@
 /* DEFINED CONSTANTS                                                         */
 /*****************************************************************************/
 #define GPS_UPDATE_PERIOD_IN_MS     5000
+#define GNSS_UERE_IN_M              5
 /*****************************************************************************/
 /* TYPE DEFINITIONS                                                          */
 /*****************************************************************************/
@@ -46,6 +57,13 @@ static virtual_timer_t gpsTimer;
 static Sim8xxCommand cmd;
 static gpsError_t error;
 static semaphore_t gpsSem;
+static FixRecord_t lastFix;
+static systime_t startTime;
+static bool waitingFirstFix;
+static systime_t cellAttemptTime;
+static bool cellAttempted;
+static uint32_t cellBase;
+static uint32_t cellLogged;
 
 /*****************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                            */
@@ -76,6 +94,14 @@ static void gpsPowerOn(void) {
   } while (GPS_ERROR_NO_ERROR != error);
 }
 
+/*
+ * A failed restart leaves the receiver in its default start mode.
+ */
+static void gpsRestart(CGNS_StartMode_t mode) {
+  if (atCgnsstartCreate(cmd.request, sizeof(cmd.request), mode))
+    sim8xxExecute(&SIM8D1, &cmd);
+}
+
 static void gpsPowerOff(void) {
   do {
     atCgnspwrCreateOff(cmd.request, sizeof(cmd.request));
@@ -153,13 +179,22 @@ static void saveBuffer(const char *data, size_t length) {
   FIL log;
   if (FR_OK == f_open(&log, "/sim8xx_gnss.log", FA_OPEN_APPEND | FA_WRITE)) {
     UINT bw = 0;
-    f_write(&log, data, length, &bw);
+    time_measurement_t tm;
+    trEvent(TR_EVT_SD_WRITE_BEGIN, length);
+    lpStart(&tm);
+    FRESULT res = f_write(&log, data, length, &bw);
+    lpStop(LP_SD_WRITE, &tm);
+    trEvent(TR_EVT_SD_WRITE_END, bw);
     f_close(&log);
+    if ((FR_OK != res) || (length != bw))
+      trFault("sdcard");
   }
 }
 
 static void logGpsData(CGNSINF_Response_t *pdata) {
   char buf[150] = {0};
+  time_measurement_t tm;
+  lpStart(&tm);
   chsnprintf(buf, sizeof(buf), "%s %f %f %f %f %d %d %d %d\n", 
               pdata->date, 
               pdata->latitude, 
@@ -170,21 +205,90 @@ static void logGpsData(CGNSINF_Response_t *pdata) {
               pdata->gpsSatInView,
               pdata->gnssSatInView,
               pdata->gnssSatInUse);
+  lpStop(LP_GNSS_FORMAT, &tm);
   saveBuffer(buf, strlen(buf));  
+  bpMark(BP_FIRST_LOG);
+  bpSave();
+}
+
+static void logCellData(const Position_t *pos) {
+  char buf[80] = {0};
+  chsnprintf(buf, sizeof(buf), "%s %f %f cell %lu\n", pos->date,
+             pos->latitude, pos->longitude, pos->accuracy);
+  saveBuffer(buf, strlen(buf));
+}
+
+/*
+ * Without a GNSS fix the cell location is published instead, it is asked
+ * for at most once per GTRACK_CELL_LOCATION_PERIOD_IN_MS. The query runs on
+ * the network monitor thread, the poll takes the answer once it arrived.
+ * Only locations received since the fix was lost count.
+ */
+static bool saveCellPosition(CGNSINF_Response_t *data) {
+  if (!cellAttempted ||
+      (chVTTimeElapsedSinceX(cellAttemptTime) >=
+       TIME_MS2I(GTRACK_CELL_LOCATION_PERIOD_IN_MS))) {
+    cellAttempted = true;
+    cellAttemptTime = chVTGetSystemTimeX();
+    nmRequestCellLocation();
+  }
+
+  Position_t pos;
+  uint32_t count = nmGetCellLocation(&pos);
+  if (count <= cellBase)
+    return false;
+
+  if (count != cellLogged) {
+    cellLogged = count;
+    logCellData(&pos);
+  }
+  pos.gnssSatInUse = data->gnssSatInUse;
+  pos.gnssSatInView = data->gnssSatInView;
+  pos.gpsSatInView = data->gpsSatInView;
+  dbSetPosition(&pos);
+  return true;
 }
 
 static void savePosition(CGNSINF_Response_t *data) {
-  dbLock();
-  Position_t *pos = dbGetPosition();
-  strncpy(pos->date, data->date, sizeof(pos->date));
-  pos->latitude = data->latitude;
-  pos->longitude = data->longitude;
-  pos->altitude = data->altitude;
-  pos->speed = data->speed;
-  pos->gnssSatInUse = data->gnssSatInUse;
-  pos->gnssSatInView = data->gnssSatInView;
-  pos->gpsSatInView = data->gpsSatInView;
-  dbUnlock();
+  Position_t pos;
+  memset(&pos, 0, sizeof(pos));
+  strncpy(pos.date, data->date, sizeof(pos.date) - 1);
+  pos.latitude = data->latitude;
+  pos.longitude = data->longitude;
+  pos.altitude = data->altitude;
+  pos.speed = data->speed;
+  pos.gnssSatInUse = data->gnssSatInUse;
+  pos.gnssSatInView = data->gnssSatInView;
+  pos.gpsSatInView = data->gpsSatInView;
+  if (1 == data->fixStatus) {
+    pos.source = POS_SOURCE_GNSS;
+    pos.accuracy = (data->hpa > 0) ? (uint32_t)(data->hpa + 0.5)
+                                   : (uint32_t)(data->hdop * GNSS_UERE_IN_M);
+    /* A later loss of fix needs a fresh cell location. */
+    cellAttempted = false;
+    cellBase = nmGetCellLocation(NULL);
+  } else if (saveCellPosition(data)) {
+    return;
+  }
+  dbSetPosition(&pos);
+
+  FixRecord_t rec;
+  if ((1 == data->fixStatus) && frFromPosition(&rec, &pos)) {
+    bpMark(BP_FIRST_FIX);
+    if (waitingFirstFix) {
+      waitingFirstFix = false;
+      gaFirstFix(&rec, TIME_I2MS(chVTTimeElapsedSinceX(startTime)));
+    }
+    chSysLock();
+    lastFix = rec;
+    chSysUnlock();
+    phAppend(&rec);
+    obAppend(&rec);
+    tlAppend(&rec);
+    FusionGnss(&rec, (float)data->course,
+               (data->hpa > 0) ? (float)data->hpa
+                               : (float)(data->hdop * GNSS_UERE_IN_M));
+  }
 }
 
 /*****************************************************************************/
@@ -197,16 +301,36 @@ THD_FUNCTION(GpsReaderThread, arg) {
   while (true) {
     chSemWait(&gpsSem);
 
+    /* A live connection is not escaped for the poll, it waits for the
+       next window of the live tracker. */
+    if (!sim8xxPollBegin(&SIM8D1, TIME_MS2I(GPS_UPDATE_PERIOD_IN_MS))) {
+      error = GPS_ERROR_DATA_UPDATE;
+      continue;
+    }
     sim8xxCommandInit(&cmd);
     atCgnsinfCreate(cmd.request, sizeof(cmd.request));
+    time_measurement_t tm;
+    trEvent(TR_EVT_MODEM_REQUEST, 0);
+    lpStart(&tm);
     sim8xxExecute(&SIM8D1, &cmd);
+    sim8xxPollEnd(&SIM8D1);
+    lpStop(LP_GNSS_QUERY, &tm);
+    trEvent(TR_EVT_MODEM_RESPONSE, cmd.status);
+    if (SIM8XX_TIMEOUT == cmd.status)
+      trFault("modem");
 
     if (SIM8XX_OK == cmd.status) {
       CGNSINF_Response_t data;
+      lpStart(&tm);
       bool status = atCgnsinfParse(&data, cmd.response);
+      lpStop(LP_GNSS_PARSE, &tm);
       error = status ? GPS_ERROR_NO_ERROR : GPS_ERROR_IN_RESPONSE;
-      savePosition(&data);
-      logGpsData(&data);
+      /* A garbled answer must not reach the history, outbox, trip log or
+         filter as a fix. */
+      if (status) {
+        savePosition(&data);
+        logGpsData(&data);
+      }
     } else {
       error = GPS_ERROR_DATA_UPDATE;
     }
@@ -214,12 +338,20 @@ THD_FUNCTION(GpsReaderThread, arg) {
 }
 
 void GpsReaderThreadInit(void) {
+  phInit();
+  tlInit();
   chVTObjectInit(&gpsTimer);
   chSemObjectInit(&gpsSem, 0);
 }
 
 void GpsReaderStart(void) {
   gpsPowerOn();
+  gpsRestart(gaSelectStartMode());
+  startTime = chVTGetSystemTime();
+  waitingFirstFix = true;
+  cellAttempted = false;
+  cellBase = nmGetCellLocation(NULL);
+  bpMark(BP_GNSS_ON);
   chSysLock();
   chVTSetI(&gpsTimer, chTimeMS2I(GPS_UPDATE_PERIOD_IN_MS), gpsTimerCallback,
            NULL);
@@ -230,8 +362,12 @@ void GpsReaderStart(void) {
 void GpsReaderStop(void) {
   chSysLock();
   chVTResetI(&gpsTimer);
+  FixRecord_t fix = lastFix;
   chSysUnlock();
   gpsPowerOff();
+
+  if (0U != fix.time)
+    gaSave(&fix);
 }
 
 /****************************** END OF FILE **********************************/
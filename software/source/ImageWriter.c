@@ -0,0 +1,265 @@
+/**
+ * @file ImageWriter.c
+ * @brief Incremental writing and verification of a firmware image in flash.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ImageWriter.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define CRC32_POLYNOMIAL            0xEDB88320U
+#define MAX_WRITE_SIZE              16
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+/* Nibble table, a quarter of a kilobyte instead of one. */
+static const uint32_t crcTable[16] = {
+  0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU,
+  0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+  0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU,
+  0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU
+};
+
+static const char *const statusNames[] = {
+  [IW_OK] = "ok",
+  [IW_BAD_HEADER] = "bad header",
+  [IW_TOO_LARGE] = "too large",
+  [IW_ALIGNMENT] = "alignment",
+  [IW_ERASE_FAILED] = "erase failed",
+  [IW_PROGRAM_FAILED] = "program failed",
+  [IW_VERIFY_FAILED] = "verify failed",
+  [IW_INCOMPLETE] = "incomplete",
+  [IW_CRC_MISMATCH] = "crc mismatch",
+  [IW_TRANSFER_FAILED] = "transfer failed"
+};
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static uint32_t getU32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static void putU32(uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t markerOffset(const FlashDevice_t *dev) {
+  return dev->size - dev->pageSize;
+}
+
+static IwStatus_t checkHeader(const FlashDevice_t *dev,
+                              const ImageHeader_t *header) {
+  if ((IW_PACKAGE_MAGIC != header->magic) || (0U == header->size) ||
+      (0U == header->chunk) || (iwChunkCount(header) > IW_MAX_CHUNKS))
+    return IW_BAD_HEADER;
+  if ((dev->writeSize > MAX_WRITE_SIZE) || (header->chunk % dev->writeSize))
+    return IW_ALIGNMENT;
+  return (header->size <= markerOffset(dev)) ? IW_OK : IW_TOO_LARGE;
+}
+
+static IwStatus_t start(ImageWriter_t *writer, const FlashDevice_t *dev,
+                        const ImageHeader_t *header, uint32_t offset) {
+  IwStatus_t status = checkHeader(dev, header);
+  if (IW_OK != status)
+    return status;
+
+  writer->dev = dev;
+  writer->header = *header;
+  writer->offset = offset;
+  writer->erased = offset;
+
+  /* The image changes from now on, it is not bootable until finished. */
+  return dev->erase(dev, markerOffset(dev)) ? IW_OK : IW_ERASE_FAILED;
+}
+
+/*
+ * Erased pages are programmed in order, a page is only erased once the
+ * data reaches it.
+ */
+static IwStatus_t eraseUpTo(ImageWriter_t *writer, uint32_t end) {
+  const FlashDevice_t *dev = writer->dev;
+  while (writer->erased < end) {
+    if (!dev->erase(dev, writer->erased))
+      return IW_ERASE_FAILED;
+    writer->erased += dev->pageSize;
+  }
+  return IW_OK;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+uint32_t iwCrc32(uint32_t crc, const uint8_t *data, size_t length) {
+  crc = ~crc;
+  while (length--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ crcTable[crc & 0x0FU];
+    crc = (crc >> 4) ^ crcTable[crc & 0x0FU];
+  }
+  return ~crc;
+}
+
+IwStatus_t iwParseHeader(ImageHeader_t *header, const uint8_t *data,
+                         const FlashDevice_t *dev) {
+  header->magic = getU32(data);
+  header->version = getU32(data + 4);
+  header->size = getU32(data + 8);
+  header->crc = getU32(data + 12);
+  header->chunk = getU32(data + 16);
+  return checkHeader(dev, header);
+}
+
+uint32_t iwChunkCount(const ImageHeader_t *header) {
+  return (header->size + header->chunk - 1U) / header->chunk;
+}
+
+uint32_t iwImageStart(const ImageHeader_t *header) {
+  return IW_HEADER_SIZE + 4U * iwChunkCount(header);
+}
+
+void iwParseChunkCrcs(const ImageHeader_t *header, const uint8_t *data,
+                      uint32_t crcs[]) {
+  uint32_t i;
+  for (i = 0; i < iwChunkCount(header); ++i)
+    crcs[i] = getU32(data + 4U * i);
+}
+
+IwStatus_t iwBegin(ImageWriter_t *writer, const FlashDevice_t *dev,
+                   const ImageHeader_t *header) {
+  return start(writer, dev, header, 0);
+}
+
+IwStatus_t iwResume(ImageWriter_t *writer, const FlashDevice_t *dev,
+                    const ImageHeader_t *header, uint32_t offset) {
+  IwStatus_t status = checkHeader(dev, header);
+  if (IW_OK != status)
+    return status;
+
+  if (offset > header->size)
+    offset = 0;
+  /* The next write has to start a chunk on an erased page. */
+  offset -= offset % dev->pageSize;
+  while (offset % header->chunk)
+    offset -= dev->pageSize;
+  return start(writer, dev, header, offset);
+}
+
+IwStatus_t iwWrite(ImageWriter_t *writer, const uint8_t *data, size_t length,
+                   uint32_t crc) {
+  const FlashDevice_t *dev = writer->dev;
+  uint32_t end = writer->offset + length;
+  size_t aligned = length - (length % dev->writeSize);
+
+  if (end > writer->header.size)
+    return IW_TOO_LARGE;
+  if ((writer->offset % writer->header.chunk) ||
+      ((length != writer->header.chunk) && (end != writer->header.size)))
+    return IW_ALIGNMENT;
+  if (iwCrc32(0, data, length) != crc)
+    return IW_TRANSFER_FAILED;
+
+  IwStatus_t status = eraseUpTo(writer, end);
+  if (IW_OK != status)
+    return status;
+
+  bool ok = (0U == aligned) ||
+            dev->program(dev, writer->offset, data, aligned);
+  if (ok && (aligned != length)) {
+    /* The end of the image is padded with erased bytes. */
+    uint8_t last[MAX_WRITE_SIZE];
+    memset(last, 0xFF, sizeof(last));
+    memcpy(last, data + aligned, length - aligned);
+    ok = dev->program(dev, writer->offset + aligned, last, dev->writeSize);
+  }
+  if (!ok)
+    return IW_PROGRAM_FAILED;
+
+  if (iwCrc32(0, dev->base + writer->offset, length) != crc)
+    return IW_VERIFY_FAILED;
+
+  writer->offset = end;
+  return IW_OK;
+}
+
+uint32_t iwFirstBadChunk(const ImageWriter_t *writer, const uint32_t crcs[]) {
+  uint32_t chunk = writer->header.chunk;
+  uint32_t offset;
+
+  for (offset = 0; offset < writer->offset; offset += chunk) {
+    uint32_t length = writer->offset - offset;
+    if (length > chunk)
+      length = chunk;
+    if (iwCrc32(0, writer->dev->base + offset, length) != crcs[offset / chunk])
+      return offset;
+  }
+  return writer->offset;
+}
+
+IwStatus_t iwFinish(ImageWriter_t *writer) {
+  const FlashDevice_t *dev = writer->dev;
+  const ImageHeader_t *header = &writer->header;
+  uint8_t marker[IW_MARKER_SIZE];
+
+  if (writer->offset != header->size)
+    return IW_INCOMPLETE;
+  if (iwCrc32(0, dev->base, header->size) != header->crc)
+    return IW_CRC_MISMATCH;
+
+  putU32(marker, IW_BOOTABLE_MAGIC);
+  putU32(marker + 4, header->version);
+  putU32(marker + 8, header->size);
+  putU32(marker + 12, header->crc);
+  if (!dev->program(dev, markerOffset(dev), marker, sizeof(marker)))
+    return IW_PROGRAM_FAILED;
+
+  return iwIsBootable(dev, NULL) ? IW_OK : IW_VERIFY_FAILED;
+}
+
+bool iwIsBootable(const FlashDevice_t *dev, ImageHeader_t *header) {
+  ImageHeader_t marker;
+  const uint8_t *p = dev->base + markerOffset(dev);
+
+  marker.magic = getU32(p);
+  marker.version = getU32(p + 4);
+  marker.size = getU32(p + 8);
+  marker.crc = getU32(p + 12);
+  marker.chunk = 0;
+  if ((IW_BOOTABLE_MAGIC != marker.magic) ||
+      (marker.size > markerOffset(dev)) ||
+      (iwCrc32(0, dev->base, marker.size) != marker.crc))
+    return false;
+
+  if (header)
+    *header = marker;
+  return true;
+}
+
+const char *iwStatusName(IwStatus_t status) {
+  return statusNames[status];
+}
+
+/****************************** END OF FILE **********************************/
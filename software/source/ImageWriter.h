@@ -0,0 +1,158 @@
+/**
+ * @file ImageWriter.h
+ * @brief Incremental writing and verification of a firmware image in flash.
+ * @note  No OS dependency, tools/imagewriter_check.c runs it on the host
+ *        against a simulated flash device.
+ */
+
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "Flash.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Magic of the package header, "GTFW" in little endian.
+ */
+#define IW_PACKAGE_MAGIC            0x57465447U
+
+/**
+ * @brief Magic of the marker of a verified image, "GTBT" in little endian.
+ */
+#define IW_BOOTABLE_MAGIC           0x54425447U
+
+#define IW_HEADER_SIZE              20
+#define IW_MARKER_SIZE              16
+
+/**
+ * @brief Chunk CRCs a package may carry.
+ */
+#define IW_MAX_CHUNKS               128
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief Header in front of the image in the package, all fields are
+ *        little endian. It is followed by the CRC-32 of every chunk of the
+ *        image, then by the image. The marker of a bootable image has the
+ *        same layout without the chunk size.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;       /**< Image bytes after the chunk CRCs.              */
+  uint32_t crc;        /**< CRC-32 (zlib) of the image.                     */
+  uint32_t chunk;      /**< Image bytes covered by each chunk CRC.         */
+} ImageHeader_t;
+
+typedef enum {
+  IW_OK,
+  IW_BAD_HEADER,
+  IW_TOO_LARGE,
+  IW_ALIGNMENT,
+  IW_ERASE_FAILED,
+  IW_PROGRAM_FAILED,
+  IW_VERIFY_FAILED,
+  IW_INCOMPLETE,
+  IW_CRC_MISMATCH,
+  IW_TRANSFER_FAILED
+} IwStatus_t;
+
+/**
+ * @brief The image starts at offset 0 of the device, the marker is kept in
+ *        the last page.
+ */
+typedef struct {
+  const FlashDevice_t *dev;
+  ImageHeader_t header;
+  uint32_t offset;     /**< Bytes programmed and verified.                 */
+  uint32_t erased;     /**< Pages below are erased or programmed.          */
+} ImageWriter_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief CRC-32 as computed by zlib, start with 0.
+ */
+uint32_t iwCrc32(uint32_t crc, const uint8_t *data, size_t length);
+
+/**
+ * @brief Read a package header from the first IW_HEADER_SIZE bytes.
+ */
+IwStatus_t iwParseHeader(ImageHeader_t *header, const uint8_t *data,
+                         const FlashDevice_t *dev);
+
+uint32_t iwChunkCount(const ImageHeader_t *header);
+
+/**
+ * @brief Offset of the image in the package, after the chunk CRCs.
+ */
+uint32_t iwImageStart(const ImageHeader_t *header);
+
+/**
+ * @brief Read the chunk CRCs that follow the header in the package.
+ */
+void iwParseChunkCrcs(const ImageHeader_t *header, const uint8_t *data,
+                      uint32_t crcs[]);
+
+/**
+ * @brief Start a new image, the marker of the previous one is erased.
+ */
+IwStatus_t iwBegin(ImageWriter_t *writer, const FlashDevice_t *dev,
+                   const ImageHeader_t *header);
+
+/**
+ * @brief Continue an image written up to offset before a disconnect or a
+ *        reset.
+ * @note  The offset is rounded down to a page, the page may have been cut
+ *        in the middle of programming, and further down to a chunk.
+ */
+IwStatus_t iwResume(ImageWriter_t *writer, const FlashDevice_t *dev,
+                    const ImageHeader_t *header, uint32_t offset);
+
+/**
+ * @brief Program the next chunk and verify it by its CRC.
+ * @note  The chunk is checked against its CRC from the package before the
+ *        flash is touched, IW_TRANSFER_FAILED leaves the writer as it was.
+ *        The length is the chunk size of the package, except for the last
+ *        chunk of the image.
+ */
+IwStatus_t iwWrite(ImageWriter_t *writer, const uint8_t *data, size_t length,
+                   uint32_t crc);
+
+/**
+ * @brief Offset of the first written chunk whose flash content does not
+ *        match its CRC, the written length if all of them do.
+ */
+uint32_t iwFirstBadChunk(const ImageWriter_t *writer, const uint32_t crcs[]);
+
+/**
+ * @brief Verify the whole image and mark it bootable.
+ */
+IwStatus_t iwFinish(ImageWriter_t *writer);
+
+/**
+ * @brief Check the marker and the image it describes.
+ */
+bool iwIsBootable(const FlashDevice_t *dev, ImageHeader_t *header);
+
+const char *iwStatusName(IwStatus_t status);
+
+#endif /* IMAGE_WRITER_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,207 @@
+/**
+ * @file LatencyProbe.c
+ * @brief Latency histograms of the hot paths, based on chTM measurements.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "LatencyProbe.h"
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define CYCLES_PER_US               (STM32_HCLK / 1000000U)
+#define P99_PERMILLE                990
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[LP_BUCKET_NUM];
+} LatencyStats_t;
+
+typedef void (*StatsVisitor_t)(const char *name, const LatencyStats_t *stats,
+                               void *arg);
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#if CH_CFG_USE_TM != TRUE
+#error "LatencyProbe requires CH_CFG_USE_TM"
+#endif
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const probeNames[LP_PROBE_NUM] = {
+  [LP_GNSS_QUERY]  = "cgnsinf",
+  [LP_GNSS_PARSE]  = "parse",
+  [LP_GNSS_FORMAT] = "format",
+  [LP_SD_WRITE]    = "f_write",
+  [LP_DB_PUBLISH]  = "publish",
+  [LP_MODEM_READY] = "modem"
+};
+
+static LatencyStats_t probes[LP_PROBE_NUM];
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static size_t bucketIndex(uint32_t us) {
+  size_t index = (us < 2U) ? 0U : (size_t)(31 - __builtin_clz(us));
+  return (index < LP_BUCKET_NUM) ? index : LP_BUCKET_NUM - 1;
+}
+
+/*
+ * Upper bound of the bucket that holds the requested rank, limited by the
+ * largest sample seen.
+ */
+static uint32_t percentile(const LatencyStats_t *stats, uint32_t permille) {
+  uint32_t rank = (uint32_t)(((uint64_t)stats->count * permille + 999U) /
+                             1000U);
+  uint32_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < LP_BUCKET_NUM - 1; ++i) {
+    sum += stats->buckets[i];
+    if (sum >= rank) {
+      uint32_t bound = (2U << i) - 1U;
+      return (bound < stats->max) ? bound : stats->max;
+    }
+  }
+  return stats->max;
+}
+
+static void forEachProbe(StatsVisitor_t visitor, void *arg) {
+  LatencyStats_t stats;
+  size_t i;
+
+  for (i = 0; i < LP_PROBE_NUM; ++i) {
+    chSysLock();
+    stats = probes[i];
+    chSysUnlock();
+    visitor(probeNames[i], &stats, arg);
+  }
+}
+
+static void printStats(const char *name, const LatencyStats_t *stats,
+                       void *arg) {
+  BaseSequentialStream *chp = (BaseSequentialStream *)arg;
+  if (0U == stats->count) {
+    chprintf(chp, "%-8s %8u\r\n", name, 0U);
+    return;
+  }
+
+  chprintf(chp, "%-8s %8lu %8lu %8lu %8lu %8lu\r\n", name, stats->count,
+           stats->min, (uint32_t)(stats->sum / stats->count),
+           percentile(stats, P99_PERMILLE), stats->max);
+}
+
+static void printBuckets(const char *name, const LatencyStats_t *stats,
+                         void *arg) {
+  BaseSequentialStream *chp = (BaseSequentialStream *)arg;
+  size_t i;
+
+  chprintf(chp, "%s:", name);
+  for (i = 0; i < LP_BUCKET_NUM; ++i) {
+    if (stats->buckets[i])
+      chprintf(chp, " <%lu:%lu", 2UL << i, stats->buckets[i]);
+  }
+  chprintf(chp, "\r\n");
+}
+
+static void saveStats(const char *name, const LatencyStats_t *stats,
+                      void *arg) {
+  FIL *log = (FIL *)arg;
+  char buf[96];
+  UINT bw = 0;
+  size_t i;
+
+  chsnprintf(buf, sizeof(buf), "%lu %s %lu %lu %lu %lu %lu",
+             (uint32_t)TIME_I2MS(chVTGetSystemTimeX()), name, stats->count,
+             stats->min,
+             stats->count ? (uint32_t)(stats->sum / stats->count) : 0U,
+             percentile(stats, P99_PERMILLE), stats->max);
+  f_write(log, buf, strlen(buf), &bw);
+
+  for (i = 0; i < LP_BUCKET_NUM; ++i) {
+    chsnprintf(buf, sizeof(buf), " %lu", stats->buckets[i]);
+    f_write(log, buf, strlen(buf), &bw);
+  }
+  f_write(log, "\n", 1, &bw);
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void lpStart(time_measurement_t *tmp) {
+  chTMObjectInit(tmp);
+  chTMStartMeasurementX(tmp);
+}
+
+void lpStop(LatencyProbeId_t id, time_measurement_t *tmp) {
+  chTMStopMeasurementX(tmp);
+  uint32_t us = tmp->last / CYCLES_PER_US;
+
+  chSysLock();
+  LatencyStats_t *stats = &probes[id];
+  stats->count++;
+  stats->sum += us;
+  if ((1U == stats->count) || (us < stats->min))
+    stats->min = us;
+  if (us > stats->max)
+    stats->max = us;
+  stats->buckets[bucketIndex(us)]++;
+  chSysUnlock();
+}
+
+void lpReset(void) {
+  chSysLock();
+  memset(probes, 0, sizeof(probes));
+  chSysUnlock();
+}
+
+void lpSave(void) {
+  FIL log;
+  if (FR_OK == f_open(&log, "/latency.log", FA_OPEN_APPEND | FA_WRITE)) {
+    forEachProbe(saveStats, &log);
+    f_close(&log);
+  }
+}
+
+void lpCmdLatency(BaseSequentialStream *chp, int argc, char *argv[]) {
+  if ((argc > 1) || ((1 == argc) && strcmp(argv[0], "reset") &&
+                     strcmp(argv[0], "hist"))) {
+    chprintf(chp, "Usage: latency [hist|reset]\r\n");
+    return;
+  }
+
+  if ((1 == argc) && (0 == strcmp(argv[0], "reset"))) {
+    lpReset();
+    return;
+  }
+
+  if (1 == argc) {
+    forEachProbe(printBuckets, chp);
+    return;
+  }
+
+  chprintf(chp, "%-8s %8s %8s %8s %8s %8s (us)\r\n", "probe", "count", "min",
+           "mean", "p99", "max");
+  forEachProbe(printStats, chp);
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,70 @@
+/**
+ * @file LatencyProbe.h
+ * @brief Latency histograms of the hot paths, based on chTM measurements.
+ */
+
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Number of log2 buckets, the last one collects everything above
+ *        2^(LP_BUCKET_NUM-1) us.
+ */
+#define LP_BUCKET_NUM               26
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  LP_GNSS_QUERY,
+  LP_GNSS_PARSE,
+  LP_GNSS_FORMAT,
+  LP_SD_WRITE,
+  LP_DB_PUBLISH,
+  LP_MODEM_READY,
+  LP_PROBE_NUM
+} LatencyProbeId_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Start a measurement on a caller owned time measurement object, so
+ *        the same probe can be used from several threads.
+ */
+void lpStart(time_measurement_t *tmp);
+
+/**
+ * @brief Stop the measurement and add its duration to the probe.
+ */
+void lpStop(LatencyProbeId_t id, time_measurement_t *tmp);
+
+void lpReset(void);
+
+/**
+ * @brief Append the statistics of every probe to /latency.log.
+ */
+void lpSave(void);
+
+void lpCmdLatency(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* LATENCY_PROBE_H */
+
+/****************************** END OF FILE **********************************/
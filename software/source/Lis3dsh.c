@@ -0,0 +1,265 @@
+/**
+ * @file Lis3dsh.c
+ * @brief LIS3DSH accelerometer on SPI1, read through its FIFO.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "Lis3dsh.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define LIS_WHO_AM_I                0x0F
+#define LIS_CTRL_REG4               0x20
+#define LIS_CTRL_REG1               0x21
+#define LIS_CTRL_REG3               0x23
+#define LIS_CTRL_REG5               0x24
+#define LIS_CTRL_REG6               0x25
+#define LIS_OUT_X_L                 0x28
+#define LIS_FIFO_CTRL               0x2E
+#define LIS_FIFO_SRC                0x2F
+#define LIS_ST1_1                   0x40
+#define LIS_ST1_2                   0x41
+#define LIS_THRS1_1                 0x57
+#define LIS_MASK1_B                 0x59
+#define LIS_MASK1_A                 0x5A
+#define LIS_SETT1                   0x5B
+#define LIS_OUTS1                   0x5F
+
+#define LIS_ID                      0x3F
+#define LIS_READ                    0x80
+
+/* 25 Hz, block data update, X, Y and Z enabled. */
+#define LIS_CTRL_REG4_RUN           0x4F
+#define LIS_CTRL_REG4_OFF           0x00
+/* +-2 g, 800 Hz anti-aliasing filter. */
+#define LIS_CTRL_REG5_2G            0x00
+/* FIFO enabled, register address incremented in multi byte access. */
+#define LIS_CTRL_REG6_FIFO          0x50
+#define LIS_FIFO_CTRL_BYPASS        0x00
+#define LIS_FIFO_CTRL_STREAM        0x40
+#define LIS_FIFO_SRC_FSS            0x1F
+#define LIS_FIFO_SRC_OVRN           0x40
+
+/* Motion detection while parked: 3.125 Hz, X, Y and Z enabled. */
+#define LIS_CTRL_REG4_PARK          0x17
+/* Register address incremented in multi byte access, FIFO off. */
+#define LIS_CTRL_REG6_PARK          0x10
+/* State machine 1 enabled, its interrupt routed to INT1. */
+#define LIS_CTRL_REG1_SM1           0x01
+#define LIS_CTRL_REG1_OFF           0x00
+/* INT1 enabled, active high, latched until OUTS1 is read. */
+#define LIS_CTRL_REG3_INT1          0x48
+#define LIS_CTRL_REG3_OFF           0x00
+/* Next state on any unmasked axis beyond THRS1, then interrupt and restart. */
+#define LIS_ST_GNTH1                0x05
+#define LIS_ST_CONT                 0x11
+/* Program flow can be changed by the CONT command. */
+#define LIS_SETT1_SITR              0x01
+/* Positive and negative direction of each axis in MASK1_A and MASK1_B. */
+#define LIS_MASK_X                  0xC0
+#define LIS_MASK_Y                  0x30
+#define LIS_MASK_Z                  0x0C
+
+/*
+ * One threshold step is 1/128 of the full scale, 15.6 mg at +-2 g. 250 mg on
+ * a horizontal axis is a tilt of 14 degrees or a push of the bike.
+ */
+#define LIS_MOTION_THRESHOLD        16
+#define LIS_SETTLE_TIME_IN_MS       (2 * 1000 / LIS_RATE_IN_HZ)
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+/* 5 MHz from the 80 MHz APB2, CPOL=1, CPHA=1, MSb first. */
+static const SPIConfig spicfg = {false, NULL,
+                                 LINE_ACC_CS,
+                                 SPI_CR1_BR_1 | SPI_CR1_BR_0 |
+                                 SPI_CR1_CPOL | SPI_CR1_CPHA,
+                                 0};
+
+static uint8_t txbuf[2];
+static uint8_t rxbuf[6];
+static bool parked;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static void writeRegister(uint8_t reg, uint8_t value) {
+  txbuf[0] = reg;
+  txbuf[1] = value;
+  spiSelect(&SPID1);
+  spiSend(&SPID1, 2, txbuf);
+  spiUnselect(&SPID1);
+}
+
+static void readRegisters(uint8_t reg, size_t length) {
+  txbuf[0] = reg | LIS_READ;
+  spiSelect(&SPID1);
+  spiSend(&SPID1, 1, txbuf);
+  spiReceive(&SPID1, length, rxbuf);
+  spiUnselect(&SPID1);
+}
+
+static void setPins(iomode_t busMode, iomode_t csMode) {
+  palSetLineMode(LINE_ACC_SCK, busMode);
+  palSetLineMode(LINE_ACC_MISO, busMode);
+  palSetLineMode(LINE_ACC_MOSI, busMode);
+  palSetLine(LINE_ACC_CS);
+  palSetLineMode(LINE_ACC_CS, csMode);
+}
+
+/*
+ * Takes the bus, false if the sensor does not answer.
+ */
+static bool busStart(void) {
+  setPins(PAL_MODE_ALTERNATE(5) | PAL_STM32_OSPEED_HIGHEST,
+          PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+  spiAcquireBus(&SPID1);
+  spiStart(&SPID1, &spicfg);
+  readRegisters(LIS_WHO_AM_I, 1);
+  return LIS_ID == rxbuf[0];
+}
+
+static void busStop(void) {
+  spiStop(&SPID1);
+  spiReleaseBus(&SPID1);
+  setPins(PAL_MODE_INPUT_PULLUP, PAL_MODE_INPUT_PULLUP);
+}
+
+static void stopMotionDetection(void) {
+  writeRegister(LIS_CTRL_REG1, LIS_CTRL_REG1_OFF);
+  writeRegister(LIS_CTRL_REG3, LIS_CTRL_REG3_OFF);
+  readRegisters(LIS_OUTS1, 1);
+  parked = false;
+}
+
+/*
+ * Gravity dominates the axis that points up, it is left out so that the
+ * threshold can be far below 1 g on the other two.
+ */
+static uint8_t horizontalAxes(void) {
+  readRegisters(LIS_OUT_X_L, sizeof(rxbuf));
+  int32_t x = (int16_t)(rxbuf[0] | (rxbuf[1] << 8));
+  int32_t y = (int16_t)(rxbuf[2] | (rxbuf[3] << 8));
+  int32_t z = (int16_t)(rxbuf[4] | (rxbuf[5] << 8));
+  x = (x < 0) ? -x : x;
+  y = (y < 0) ? -y : y;
+  z = (z < 0) ? -z : z;
+  if ((x >= y) && (x >= z))
+    return LIS_MASK_Y | LIS_MASK_Z;
+  if (y >= z)
+    return LIS_MASK_X | LIS_MASK_Z;
+  return LIS_MASK_X | LIS_MASK_Y;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool lisStart(void) {
+  bool found = busStart();
+  if (found) {
+    stopMotionDetection();
+    writeRegister(LIS_CTRL_REG5, LIS_CTRL_REG5_2G);
+    writeRegister(LIS_CTRL_REG6, LIS_CTRL_REG6_FIFO);
+    /* Through bypass mode, to drop the samples of a previous run. */
+    writeRegister(LIS_FIFO_CTRL, LIS_FIFO_CTRL_BYPASS);
+    writeRegister(LIS_FIFO_CTRL, LIS_FIFO_CTRL_STREAM);
+    writeRegister(LIS_CTRL_REG4, LIS_CTRL_REG4_RUN);
+  }
+  spiReleaseBus(&SPID1);
+
+  if (!found)
+    lisStop();
+  return found;
+}
+
+void lisStop(void) {
+  spiAcquireBus(&SPID1);
+  if (SPI_READY == SPID1.state) {
+    writeRegister(LIS_CTRL_REG1, LIS_CTRL_REG1_OFF);
+    writeRegister(LIS_CTRL_REG4, LIS_CTRL_REG4_OFF);
+    spiStop(&SPID1);
+  }
+  parked = false;
+  spiReleaseBus(&SPID1);
+  setPins(PAL_MODE_INPUT_PULLUP, PAL_MODE_INPUT_PULLUP);
+}
+
+/*
+ * A sample at the riding rate tells which axis is vertical, then state
+ * machine 1 raises INT1 whenever one of the others passes the threshold.
+ * The SPI is stopped, the sensor runs on its own.
+ */
+bool lisPark(void) {
+  bool found = busStart();
+  if (found) {
+    stopMotionDetection();
+    writeRegister(LIS_CTRL_REG5, LIS_CTRL_REG5_2G);
+    writeRegister(LIS_CTRL_REG6, LIS_CTRL_REG6_PARK);
+    writeRegister(LIS_FIFO_CTRL, LIS_FIFO_CTRL_BYPASS);
+    writeRegister(LIS_CTRL_REG4, LIS_CTRL_REG4_RUN);
+    chThdSleepMilliseconds(LIS_SETTLE_TIME_IN_MS);
+    uint8_t mask = horizontalAxes();
+
+    writeRegister(LIS_THRS1_1, LIS_MOTION_THRESHOLD);
+    writeRegister(LIS_ST1_1, LIS_ST_GNTH1);
+    writeRegister(LIS_ST1_2, LIS_ST_CONT);
+    writeRegister(LIS_MASK1_B, mask);
+    writeRegister(LIS_MASK1_A, mask);
+    writeRegister(LIS_SETT1, LIS_SETT1_SITR);
+    writeRegister(LIS_CTRL_REG4, LIS_CTRL_REG4_PARK);
+    writeRegister(LIS_CTRL_REG3, LIS_CTRL_REG3_INT1);
+    writeRegister(LIS_CTRL_REG1, LIS_CTRL_REG1_SM1);
+    parked = true;
+  }
+  busStop();
+  return found;
+}
+
+void lisAckMotion(void) {
+  if (!parked)
+    return;
+  if (busStart())
+    readRegisters(LIS_OUTS1, 1);
+  busStop();
+}
+
+/*
+ * Every 6 byte read of the output registers pops the oldest sample.
+ */
+size_t lisRead(LisSample_t samples[], size_t max) {
+  size_t count, i;
+
+  spiAcquireBus(&SPID1);
+  readRegisters(LIS_FIFO_SRC, 1);
+  count = rxbuf[0] & LIS_FIFO_SRC_FSS;
+  if (rxbuf[0] & LIS_FIFO_SRC_OVRN)
+    count = LIS_FIFO_SIZE;
+  if (count > max)
+    count = max;
+  for (i = 0; i < count; ++i) {
+    readRegisters(LIS_OUT_X_L, sizeof(rxbuf));
+    samples[i].x = (int16_t)(rxbuf[0] | (rxbuf[1] << 8));
+    samples[i].y = (int16_t)(rxbuf[2] | (rxbuf[3] << 8));
+    samples[i].z = (int16_t)(rxbuf[4] | (rxbuf[5] << 8));
+  }
+  spiReleaseBus(&SPID1);
+  return count;
+}
+
+/****************************** END OF FILE **********************************/
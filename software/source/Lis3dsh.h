@@ -0,0 +1,81 @@
+/**
+ * @file Lis3dsh.h
+ * @brief LIS3DSH accelerometer on SPI1, read through its FIFO.
+ */
+
+#ifndef LIS3DSH_H
+#define LIS3DSH_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Output data rate and sensitivity at the +-2 g full scale.
+ */
+#define LIS_RATE_IN_HZ              25
+#define LIS_UG_PER_DIGIT            60
+
+/**
+ * @brief Depth of the FIFO in samples.
+ */
+#define LIS_FIFO_SIZE               32
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  int16_t x;
+  int16_t y;
+  int16_t z;
+} LisSample_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Power the sensor up in FIFO stream mode.
+ * @return False if the sensor does not answer.
+ */
+bool lisStart(void);
+
+/**
+ * @brief Power the sensor down and release the bus pins.
+ */
+void lisStop(void);
+
+/**
+ * @brief Leave the sensor in low-power motion detection on INT1 and release
+ *        the bus pins.
+ * @return False if the sensor does not answer.
+ */
+bool lisPark(void);
+
+/**
+ * @brief Release the latched motion interrupt, the next motion raises INT1
+ *        again.
+ */
+void lisAckMotion(void);
+
+/**
+ * @brief Drain the FIFO.
+ * @return Number of samples copied, the oldest first.
+ */
+size_t lisRead(LisSample_t samples[], size_t max);
+
+#endif /* LIS3DSH_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,263 @@
+/**
+ * @file LiveTrackerThread.c
+ * @brief Live position reports over a transparent TCP connection.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "LiveTrackerThread.h"
+#include "Bearer.h"
+#include "Dashboard.h"
+#include "NetworkMonitorThread.h"
+#include "FixRecord.h"
+#include "TelemetryCodec.h"
+#include "gtrackconf.h"
+#include "sim8xx.h"
+#include "at.h"
+
+#include "chprintf.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define LIVE_FRAME_SIZE             (TC_MAX_HEADER_SIZE + TC_MAX_FIX_SIZE +  \
+                                     TC_CRC_SIZE)
+#define LIVE_FIELDS                 (TC_FIELD_ALTITUDE | TC_FIELD_SPEED |    \
+                                     TC_FIELD_SOURCE | TC_FIELD_AGE)
+
+#define CONNECT_TIMEOUT_IN_MS       30000
+#define RETRY_PERIOD_IN_MS          10000
+
+/*
+ * A refused upload is retried after GTRACK_UPLOAD_RETRY_IN_MS, the live
+ * session stays closed a little longer so the retry finds the stack free.
+ */
+#define YIELD_PERIOD_IN_MS          (GTRACK_UPLOAD_RETRY_IN_MS + 2000)
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  uint32_t connects;
+  uint32_t failures;
+  uint32_t drops;
+  uint32_t reports;
+  uint32_t windows;
+  uint32_t yields;
+} LiveStats_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static semaphore_t liveSem;
+static binary_semaphore_t stoppedSem;
+static volatile bool running;
+static volatile bool enabled = GTRACK_LIVE_TRACKING;
+static bool connected;
+static Sim8xxCommand cmd;
+static uint32_t sequence;
+static LiveStats_t stats;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+/*
+ * A single keyframe packet with the source and the age of the position.
+ */
+static size_t encodeFrame(uint8_t frame[LIVE_FRAME_SIZE]) {
+  Position_t pos;
+  systime_t timestamp;
+  FixRecord_t rec;
+
+  if ((0U == dbGetPosition(&pos, &timestamp)) ||
+      (POS_SOURCE_NONE == pos.source) || !frFromPosition(&rec, &pos))
+    return 0;
+
+  uint32_t age = TIME_I2MS(chVTTimeElapsedSinceX(timestamp)) / 100U;
+  const TelemetryHeader_t header = {
+    LIVE_FIELDS, sequence, (uint8_t)pos.source,
+    (age > UINT16_MAX) ? UINT16_MAX : (uint16_t)age
+  };
+
+  TelemetryEncoder_t enc;
+  tcEncoderInit(&enc, frame, LIVE_FRAME_SIZE, &header);
+  tcEncoderAdd(&enc, &rec);
+  return tcEncoderFinish(&enc);
+}
+
+/*
+ * The TCP/IP stack is held while connected, the session is closed for an
+ * upload that was refused the stack.
+ */
+static bool openConnection(void) {
+  if (!brTcpAcquire())
+    return false;
+
+  if (brTcpAttach(true)) {
+    sim8xxCommandInit(&cmd);
+    atCipstartCreate(cmd.request, sizeof(cmd.request), GTRACK_SERVER_HOST,
+                     GTRACK_LIVE_PORT);
+    sim8xxConnect(&SIM8D1, &cmd, TIME_MS2I(CONNECT_TIMEOUT_IN_MS));
+    if (SIM8XX_CONNECT == cmd.status) {
+      connected = true;
+      stats.connects++;
+      return true;
+    }
+  }
+
+  stats.failures++;
+  brTcpShut();
+  brTcpRelease();
+  return false;
+}
+
+/*
+ * The command escapes the transparent link first.
+ */
+static void closeConnection(void) {
+  if (SIM8XX_LINK_COMMAND != sim8xxGetLink(&SIM8D1)) {
+    sim8xxCommandInit(&cmd);
+    atCipcloseCreate(cmd.request, sizeof(cmd.request));
+    sim8xxExecute(&SIM8D1, &cmd);
+  }
+  brTcpShut();
+  brTcpRelease();
+  connected = false;
+}
+
+static void report(void) {
+  uint8_t frame[LIVE_FRAME_SIZE];
+  size_t length = encodeFrame(frame);
+  if (0 == length)
+    return;
+
+  if (sim8xxWrite(&SIM8D1, frame, length)) {
+    sequence++;
+    stats.reports++;
+  } else {
+    stats.drops++;
+    closeConnection();
+  }
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+THD_FUNCTION(LiveTrackerThread, arg) {
+  (void)arg;
+  chRegSetThreadName("live");
+
+  sysinterval_t period = TIME_INFINITE;
+  systime_t next = chVTGetSystemTime();
+  systime_t lastWindow = next;
+
+  while (true) {
+    chSemWaitTimeout(&liveSem, period);
+
+    if (!running || !enabled) {
+      if (connected)
+        closeConnection();
+      period = TIME_INFINITE;
+      if (!running)
+        chBSemSignal(&stoppedSem);
+      continue;
+    }
+
+    if (!connected && (!nmCanTransmit() || !openConnection())) {
+      period = TIME_MS2I(RETRY_PERIOD_IN_MS);
+      continue;
+    }
+
+    report();
+
+    /* The outbox is not held back for the whole ride, the live track has a
+       gap of the upload instead. */
+    if (connected && brTcpWanted()) {
+      closeConnection();
+      stats.yields++;
+      period = TIME_MS2I(YIELD_PERIOD_IN_MS);
+      continue;
+    }
+
+    /* The GNSS and network queries wait for a window instead of escaping
+       the link each, one escape serves all of them. */
+    if (connected &&
+        (chVTTimeElapsedSinceX(lastWindow) >=
+         TIME_MS2I(GTRACK_LIVE_WINDOW_PERIOD_IN_MS)) &&
+        sim8xxOpenWindow(&SIM8D1)) {
+      lastWindow = chVTGetSystemTime();
+      stats.windows++;
+    }
+
+    /* Reports keep their rate, the schedule only restarts if a report was
+       late, e.g. after a command escaped the link. */
+    systime_t now = chVTGetSystemTime();
+    next = chTimeAddX(next, TIME_MS2I(GTRACK_LIVE_PERIOD_IN_MS));
+    if (!chTimeIsInRangeX(next, now,
+                          chTimeAddX(now, TIME_MS2I(GTRACK_LIVE_PERIOD_IN_MS) +
+                                          1)))
+      next = chTimeAddX(now, TIME_MS2I(GTRACK_LIVE_PERIOD_IN_MS));
+    period = chTimeDiffX(now, next);
+  }
+}
+
+void LiveTrackerThreadInit(void) {
+  chSemObjectInit(&liveSem, 0);
+  chBSemObjectInit(&stoppedSem, true);
+  running = false;
+  connected = false;
+}
+
+void LiveTrackerStart(void) {
+  running = true;
+  chSemSignal(&liveSem);
+}
+
+/*
+ * Waits until the connection is closed, the modem is powered down
+ * afterwards.
+ */
+void LiveTrackerStop(void) {
+  chBSemReset(&stoppedSem, true);
+  running = false;
+  chSemSignal(&liveSem);
+  chBSemWait(&stoppedSem);
+}
+
+void LiveTrackerCmdLive(BaseSequentialStream *chp, int argc, char *argv[]) {
+  if (argc > 1) {
+    chprintf(chp, "Usage: live [on|off]\r\n");
+    return;
+  }
+
+  if (1 == argc) {
+    if (0 == strcmp(argv[0], "on")) {
+      enabled = true;
+    } else if (0 == strcmp(argv[0], "off")) {
+      enabled = false;
+    } else {
+      chprintf(chp, "Usage: live [on|off]\r\n");
+      return;
+    }
+    chSemSignal(&liveSem);
+  }
+
+  chprintf(chp, "live tracking %s, %s\r\n", enabled ? "on" : "off",
+           connected ? "connected" : "not connected");
+  chprintf(chp, "connects %lu, failures %lu, drops %lu, reports %lu, "
+           "windows %lu, yields %lu\r\n", stats.connects, stats.failures,
+           stats.drops, stats.reports, stats.windows, stats.yields);
+}
+
+/****************************** END OF FILE **********************************/
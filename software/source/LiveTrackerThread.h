@@ -0,0 +1,42 @@
+/**
+ * @file LiveTrackerThread.h
+ * @brief Live position reports over a transparent TCP connection.
+ */
+
+#ifndef LIVE_TRACKER_THREAD_H
+#define LIVE_TRACKER_THREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(LiveTrackerThread, arg);
+void LiveTrackerThreadInit(void);
+void LiveTrackerStart(void);
+void LiveTrackerStop(void);
+void LiveTrackerCmdLive(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* LIVE_TRACKER_THREAD_H */
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,372 @@
+/**
+ * @file NetworkMonitorThread.c
+ * @brief Cached network registration and signal quality.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "NetworkMonitorThread.h"
+#include "Dashboard.h"
+#include "FixRecord.h"
+#include "Bearer.h"
+#include "gtrackconf.h"
+#include "sim8xx.h"
+#include "at.h"
+
+#include "chprintf.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define URC_LINE_SIZE               64
+#define CELL_LOCATION_TIMEOUT_IN_MS 30000
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#define IS_REGISTERED(reg)          ((NET_REG_HOME == (reg)) ||              \
+                                     (NET_REG_ROAMING == (reg)))
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const registrationNames[] = {
+  [NET_REG_NONE]      = "not registered",
+  [NET_REG_HOME]      = "home",
+  [NET_REG_SEARCHING] = "searching",
+  [NET_REG_DENIED]    = "denied",
+  [NET_REG_UNKNOWN]   = "unknown",
+  [NET_REG_ROAMING]   = "roaming"
+};
+
+static semaphore_t refreshSem;
+static mutex_t sessionLock;
+static mutex_t stateLock;
+static volatile bool running;
+static bool urcsEnabled;
+static Sim8xxCommand cmd;
+static Network_t state;
+static uint32_t urcCount;
+static uint32_t refreshCount;
+static systime_t lastRefresh;
+static bool refreshDue;
+static volatile bool cellRequested;
+static Position_t cellPosition;
+static uint32_t cellCount;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static void resetState(Network_t *net) {
+  memset(net, 0, sizeof(*net));
+  net->registration = NET_REG_UNKNOWN;
+  net->gprsRegistration = NET_REG_UNKNOWN;
+  net->ber = 99;
+}
+
+static void publish(void) {
+  dbSetNetwork(&state);
+}
+
+static bool execute(void) {
+  sim8xxExecute(&SIM8D1, &cmd);
+  return SIM8XX_OK == cmd.status;
+}
+
+static void updateRegistration(bool gprs, const CREG_Response_t *resp) {
+  if (gprs) {
+    state.gprsRegistration = (NetworkRegistration_t)resp->status;
+  } else {
+    state.registration = (NetworkRegistration_t)resp->status;
+  }
+
+  if (resp->lac || resp->ci) {
+    state.lac = resp->lac;
+    state.cellId = resp->ci;
+  }
+
+  /* Losing the packet domain registration also detaches the context. */
+  if (gprs && !IS_REGISTERED(state.gprsRegistration))
+    state.gprsAttached = false;
+}
+
+/*
+ * Called by the reader thread, it must not issue commands. Only the cache is
+ * updated, the line is copied because the parsers expect it to be
+ * terminated.
+ */
+static void urcHook(eventflags_t flag, const char *line, size_t length) {
+  char buf[URC_LINE_SIZE];
+  CREG_Response_t resp;
+  bool parsed;
+
+  if (!(flag & (SIM8XX_URC_CREG | SIM8XX_URC_CGREG)) ||
+      (length + 3 > sizeof(buf)))
+    return;
+
+  memcpy(buf, line, length);
+  strcpy(buf + length, "\r\n");
+
+  if (SIM8XX_URC_CREG == flag)
+    parsed = atCregParseUrc(&resp, buf);
+  else
+    parsed = atCgregParseUrc(&resp, buf);
+
+  if (parsed && running) {
+    chMtxLock(&stateLock);
+    updateRegistration(SIM8XX_URC_CGREG == flag, &resp);
+    urcCount++;
+    publish();
+    chMtxUnlock(&stateLock);
+  }
+}
+
+static void enableUrcs(void) {
+  sim8xxCommandInit(&cmd);
+  atCregCreateUrc(cmd.request, sizeof(cmd.request));
+  bool creg = execute();
+
+  sim8xxCommandInit(&cmd);
+  atCgregCreateUrc(cmd.request, sizeof(cmd.request));
+  urcsEnabled = creg && execute();
+}
+
+/*
+ * Low rate refresh of what has no URC (signal, operator, attach, supply)
+ * and a resync of the registration in case a URC was lost or consumed as
+ * the response of a concurrent command.
+ */
+static void refresh(void) {
+  CREG_Response_t creg, cgreg;
+  CSQ_Response_t csq;
+  COPS_Response_t cops;
+  CBC_Response_t cbc;
+  bool attached = false;
+  bool cregValid, cgregValid, csqValid, copsValid, cgattValid, cbcValid;
+
+  sim8xxCommandInit(&cmd);
+  atCregCreateQuery(cmd.request, sizeof(cmd.request));
+  cregValid = execute() && atCregParse(&creg, cmd.response);
+
+  sim8xxCommandInit(&cmd);
+  atCgregCreateQuery(cmd.request, sizeof(cmd.request));
+  cgregValid = execute() && atCgregParse(&cgreg, cmd.response);
+
+  sim8xxCommandInit(&cmd);
+  atCsqCreate(cmd.request, sizeof(cmd.request));
+  csqValid = execute() && atCsqParse(&csq, cmd.response);
+
+  sim8xxCommandInit(&cmd);
+  atCopsCreateQuery(cmd.request, sizeof(cmd.request));
+  copsValid = execute() && atCopsParse(&cops, cmd.response);
+
+  sim8xxCommandInit(&cmd);
+  atCgattCreateQuery(cmd.request, sizeof(cmd.request));
+  cgattValid = execute() && atCgattParse(&attached, cmd.response);
+
+  sim8xxCommandInit(&cmd);
+  atCbcCreate(cmd.request, sizeof(cmd.request));
+  cbcValid = execute() && atCbcParse(&cbc, cmd.response);
+
+  chMtxLock(&stateLock);
+  if (running) {
+    if (cregValid)
+      updateRegistration(false, &creg);
+    if (cgregValid)
+      updateRegistration(true, &cgreg);
+    if (csqValid) {
+      state.rssi = (99 == csq.rssi) ? 0 : (-113 + 2 * csq.rssi);
+      state.ber = csq.ber;
+    }
+    if (copsValid)
+      memcpy(state.operatorName, cops.name, sizeof(state.operatorName));
+    if (cgattValid)
+      state.gprsAttached = attached;
+    if (cbcValid)
+      state.supply = (uint32_t)cbc.voltage;
+    refreshCount++;
+    publish();
+  }
+  chMtxUnlock(&stateLock);
+}
+
+static void queryCellLocation(void) {
+  if (!brOpen())
+    return;
+
+  sim8xxCommandInit(&cmd);
+  atClbsCreate(cmd.request, sizeof(cmd.request));
+  cmd.timeout = TIME_MS2I(CELL_LOCATION_TIMEOUT_IN_MS);
+  CLBS_Response_t data;
+  if (!execute() || !atClbsParse(&data, cmd.response))
+    return;
+
+  Position_t pos;
+  memset(&pos, 0, sizeof(pos));
+  if (!frCellDate(pos.date, data.date, data.time))
+    return;
+  pos.latitude = data.latitude;
+  pos.longitude = data.longitude;
+  pos.source = POS_SOURCE_CELL;
+  pos.accuracy = (uint32_t)data.accuracy;
+
+  chMtxLock(&stateLock);
+  cellPosition = pos;
+  cellCount++;
+  chMtxUnlock(&stateLock);
+}
+
+/*
+ * Time left until the next refresh is due.
+ */
+static sysinterval_t untilRefresh(void) {
+  if (!running)
+    return TIME_INFINITE;
+  if (refreshDue)
+    return TIME_IMMEDIATE;
+  sysinterval_t elapsed = chVTTimeElapsedSinceX(lastRefresh);
+  sysinterval_t period = TIME_MS2I(GTRACK_NETWORK_REFRESH_IN_MS);
+  return (elapsed < period) ? period - elapsed : TIME_IMMEDIATE;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+THD_FUNCTION(NetworkMonitorThread, arg) {
+  (void)arg;
+  chRegSetThreadName("network");
+
+  while (true) {
+    chSemWaitTimeout(&refreshSem, untilRefresh());
+
+    chMtxLock(&sessionLock);
+    if (running) {
+      bool due = (TIME_IMMEDIATE == untilRefresh());
+      bool cell = cellRequested;
+      cellRequested = false;
+      /* The queries share one window of a live connection. */
+      if ((due || cell) &&
+          sim8xxPollBegin(&SIM8D1, TIME_MS2I(GTRACK_NETWORK_REFRESH_IN_MS))) {
+        if (!urcsEnabled)
+          enableUrcs();
+        if (due)
+          refresh();
+        if (cell)
+          queryCellLocation();
+        sim8xxPollEnd(&SIM8D1);
+      }
+      if (due) {
+        refreshDue = false;
+        lastRefresh = chVTGetSystemTime();
+      }
+    }
+    chMtxUnlock(&sessionLock);
+  }
+}
+
+void NetworkMonitorThreadInit(void) {
+  chSemObjectInit(&refreshSem, 0);
+  chMtxObjectInit(&sessionLock);
+  chMtxObjectInit(&stateLock);
+  resetState(&state);
+  running = false;
+  urcsEnabled = false;
+  sim8xxAddUrcHook(&SIM8D1, SIM8XX_URC_CREG | SIM8XX_URC_CGREG, urcHook);
+}
+
+/*
+ * The modem is powered on when riding starts, the URC setting is lost on
+ * every power cycle.
+ */
+void NetworkMonitorStart(void) {
+  chMtxLock(&stateLock);
+  urcsEnabled = false;
+  refreshDue = true;
+  running = true;
+  chMtxUnlock(&stateLock);
+  chSemSignal(&refreshSem);
+}
+
+/*
+ * Waits for the running refresh, the cached state is invalid once the modem
+ * is powered down.
+ */
+void NetworkMonitorStop(void) {
+  running = false;
+  chSemSignal(&refreshSem);
+  chMtxLock(&sessionLock);
+  chMtxLock(&stateLock);
+  resetState(&state);
+  publish();
+  chMtxUnlock(&stateLock);
+  chMtxUnlock(&sessionLock);
+}
+
+/*
+ * The GPS reader may ask before the monitor is started, the request is kept
+ * until then.
+ */
+void nmRequestCellLocation(void) {
+  if (!cellRequested) {
+    cellRequested = true;
+    chSemSignal(&refreshSem);
+  }
+}
+
+uint32_t nmGetCellLocation(Position_t *pos) {
+  chMtxLock(&stateLock);
+  uint32_t count = cellCount;
+  if (pos)
+    *pos = cellPosition;
+  chMtxUnlock(&stateLock);
+  return count;
+}
+
+bool nmCanTransmit(void) {
+  Network_t net;
+  if (0 == dbGetNetwork(&net, NULL))
+    return false;
+  return IS_REGISTERED(net.registration) &&
+         IS_REGISTERED(net.gprsRegistration) && net.gprsAttached;
+}
+
+void NetworkMonitorCmdNetwork(BaseSequentialStream *chp, int argc,
+                              char *argv[]) {
+  (void)argv;
+  if (argc > 0) {
+    chprintf(chp, "Usage: network\r\n");
+    return;
+  }
+
+  Network_t net;
+  systime_t timestamp;
+  if (0 == dbGetNetwork(&net, &timestamp)) {
+    chprintf(chp, "no network state yet\r\n");
+    return;
+  }
+
+  chprintf(chp, "registration %s, gprs %s, %s\r\n",
+           registrationNames[net.registration],
+           registrationNames[net.gprsRegistration],
+           net.gprsAttached ? "attached" : "detached");
+  chprintf(chp, "operator '%s', lac %04X, cell %lX\r\n", net.operatorName,
+           net.lac, net.cellId);
+  chprintf(chp, "rssi %d dBm, ber %d, supply %lu mV\r\n", net.rssi, net.ber,
+           net.supply);
+  chprintf(chp, "age %lu ms, urcs %lu, refreshes %lu, cell locations %lu\r\n",
+           (unsigned long)TIME_I2MS(chVTTimeElapsedSinceX(timestamp)),
+           urcCount, refreshCount, nmGetCellLocation(NULL));
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,65 @@
+/**
+ * @file NetworkMonitorThread.h
+ * @brief Cached network registration and signal quality.
+ */
+
+#ifndef NETWORK_MONITOR_THREAD_H
+#define NETWORK_MONITOR_THREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "Dashboard.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(NetworkMonitorThread, arg);
+void NetworkMonitorThreadInit(void);
+void NetworkMonitorStart(void);
+void NetworkMonitorStop(void);
+void NetworkMonitorCmdNetwork(BaseSequentialStream *chp, int argc,
+                              char *argv[]);
+
+/**
+ * @brief True if the modem is registered and attached to GPRS.
+ * @note  Reads the cached state only, it costs no AT traffic.
+ */
+bool nmCanTransmit(void);
+
+/**
+ * @brief Ask for the location of the serving cell.
+ * @note  Does not wait, the bearer and AT+CLBS take up to a minute and run
+ *        on the network monitor thread. nmGetCellLocation() returns the
+ *        answer once it arrived.
+ */
+void nmRequestCellLocation(void);
+
+/**
+ * @brief Latest cell location.
+ * @param pos Copy of the location, can be NULL.
+ * @return Number of cell locations received so far, 0 if none.
+ */
+uint32_t nmGetCellLocation(Position_t *pos);
+
+#endif /* NETWORK_MONITOR_THREAD_H */
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,225 @@
+/**
+ * @file OtaDownload.c
+ * @brief Segmented download of a firmware package with retries and resume.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "OtaDownload.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool aborted(const OtaDownload_t *od) {
+  return od->ops->aborted(od->priv);
+}
+
+/*
+ * The header and the chunk CRCs after it, the CRCs are fetched again with
+ * every new download. IW_INCOMPLETE if the transfer failed.
+ */
+static IwStatus_t readHeader(OtaDownload_t *od) {
+  const OdOps_t *ops = od->ops;
+  ImageHeader_t *header = &od->header;
+
+  if (!ops->request(od->priv, 0, IW_HEADER_SIZE - 1U) ||
+      !ops->read(od->priv, 0, od->buf, IW_HEADER_SIZE))
+    return IW_INCOMPLETE;
+  IwStatus_t status = iwParseHeader(header, od->buf, od->dev);
+  if (IW_OK != status)
+    return status;
+
+  uint32_t length = iwImageStart(header) - IW_HEADER_SIZE;
+  if ((header->chunk > od->bufSize) || (length > od->bufSize))
+    return IW_BAD_HEADER;
+  if (!ops->request(od->priv, IW_HEADER_SIZE, IW_HEADER_SIZE + length - 1U) ||
+      !ops->read(od->priv, 0, od->buf, length))
+    return IW_INCOMPLETE;
+  iwParseChunkCrcs(header, od->buf, od->crcs);
+  return IW_OK;
+}
+
+/*
+ * The same package is resumed where the saved progress ends, anything else
+ * starts from the beginning.
+ */
+static IwStatus_t startImage(OtaDownload_t *od) {
+  uint32_t offset;
+  if (od->ops->load(od->priv, &od->header, &offset)) {
+    od->resumedAt = offset;
+    return iwResume(&od->writer, od->dev, &od->header, offset);
+  }
+  return iwBegin(&od->writer, od->dev, &od->header);
+}
+
+static IwStatus_t writeChunk(OtaDownload_t *od, size_t size, uint32_t crc) {
+  od->ops->writing(od->priv, true);
+  IwStatus_t status = iwWrite(&od->writer, od->buf, size, crc);
+  od->ops->writing(od->priv, false);
+  return status;
+}
+
+/*
+ * A segment is requested with a single request and read chunk by chunk,
+ * the progress is saved after every segment. A chunk that fails its CRC is
+ * read once more, then the segment ends there and the next request starts
+ * with that chunk.
+ */
+static IwStatus_t downloadSegment(OtaDownload_t *od) {
+  const OdOps_t *ops = od->ops;
+  ImageWriter_t *writer = &od->writer;
+  const ImageHeader_t *header = &od->header;
+  uint32_t segment = od->segment - od->segment % header->chunk;
+  uint32_t length = header->size - writer->offset;
+  uint32_t first = iwImageStart(header) + writer->offset;
+  uint32_t pos;
+
+  if (segment < header->chunk)
+    segment = header->chunk;
+  if (length > segment)
+    length = segment;
+  if (!ops->request(od->priv, first, first + length - 1U))
+    return IW_INCOMPLETE;
+
+  for (pos = 0; (pos < length) && !aborted(od); pos += header->chunk) {
+    size_t size = (length - pos < header->chunk) ? length - pos
+                                                 : header->chunk;
+    uint32_t crc = od->crcs[writer->offset / header->chunk];
+    if (!ops->read(od->priv, pos, od->buf, size))
+      return IW_INCOMPLETE;
+    if (iwCrc32(0, od->buf, size) != crc) {
+      od->rereads++;
+      if (!ops->read(od->priv, pos, od->buf, size))
+        return IW_INCOMPLETE;
+    }
+
+    IwStatus_t status = writeChunk(od, size, crc);
+    if (IW_OK != status) {
+      if (IW_TRANSFER_FAILED == status)
+        ops->save(od->priv, header, writer->offset);
+      return status;
+    }
+  }
+
+  ops->save(od->priv, header, writer->offset);
+  return aborted(od) ? IW_INCOMPLETE : IW_OK;
+}
+
+/*
+ * Every chunk was checked before it was written, a mismatch of the whole
+ * image means one changed in flash since. The image is resumed from the
+ * first bad chunk, a package whose chunks all match but the image does not
+ * is given up.
+ */
+static IwStatus_t finishImage(OtaDownload_t *od) {
+  ImageWriter_t *writer = &od->writer;
+
+  od->ops->writing(od->priv, true);
+  IwStatus_t status = iwFinish(writer);
+  if (IW_CRC_MISMATCH == status) {
+    uint32_t bad = iwFirstBadChunk(writer, od->crcs);
+    if (bad < writer->header.size) {
+      status = iwResume(writer, od->dev, &writer->header, bad);
+      if (IW_OK == status)
+        status = IW_TRANSFER_FAILED;
+    }
+  }
+  od->ops->writing(od->priv, false);
+  return status;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void odInit(OtaDownload_t *od, const OdOps_t *ops, void *priv,
+            const FlashDevice_t *dev, uint8_t *buf, size_t bufSize,
+            uint32_t crcs[], uint32_t segment) {
+  memset(od, 0, sizeof(*od));
+  od->ops = ops;
+  od->priv = priv;
+  od->dev = dev;
+  od->buf = buf;
+  od->bufSize = bufSize;
+  od->crcs = crcs;
+  od->segment = segment;
+}
+
+IwStatus_t odRun(OtaDownload_t *od) {
+  const OdOps_t *ops = od->ops;
+  IwStatus_t status = IW_INCOMPLETE;
+  bool started = false;
+  bool done = false;
+
+  while (!aborted(od)) {
+    if (ops->open(od->priv)) {
+      if (!started) {
+        status = readHeader(od);
+        if (IW_OK == status)
+          status = startImage(od);
+        if ((IW_OK != status) && (IW_INCOMPLETE != status))
+          break;
+        started = (IW_OK == status);
+      }
+
+      /* A bad chunk is requested again in the same session. */
+      while (started && !aborted(od) && !done) {
+        if (od->writer.offset < od->header.size) {
+          status = downloadSegment(od);
+        } else {
+          status = finishImage(od);
+          done = (IW_OK == status);
+        }
+        if ((IW_TRANSFER_FAILED == status) &&
+            (++od->badChunks <= OD_MAX_BAD_CHUNKS))
+          continue;
+        if (IW_OK != status)
+          break;
+      }
+      if (done || (IW_CRC_MISMATCH == status))
+        break;
+    }
+
+    ops->close(od->priv);
+    if (aborted(od) || (++od->retries > OD_MAX_RETRIES))
+      break;
+    ops->pause(od->priv);
+
+    /* The page in progress is erased and written again. */
+    if (started) {
+      status = iwResume(&od->writer, od->dev, &od->header, od->writer.offset);
+      if (IW_OK != status)
+        break;
+    }
+  }
+
+  /* A bad package is not resumed, the next attempt starts over. */
+  if ((IW_OK == status) || (IW_CRC_MISMATCH == status))
+    ops->clear(od->priv);
+  ops->close(od->priv);
+  return status;
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,95 @@
+/**
+ * @file OtaDownload.h
+ * @brief Segmented download of a firmware package with retries and resume.
+ * @note  No OS dependency, the transport and the saved progress are
+ *        callbacks. tools/imagewriter_check.c runs it on the host against
+ *        a simulated server and flash device.
+ */
+
+#ifndef OTA_DOWNLOAD_H
+#define OTA_DOWNLOAD_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ImageWriter.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Sessions opened again after a failure.
+ */
+#define OD_MAX_RETRIES              5
+
+/**
+ * @brief Chunks requested again from the server after a bad transfer.
+ */
+#define OD_MAX_BAD_CHUNKS           16
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief Offsets are package offsets for request(), read() reads from the
+ *        body of the last request.
+ */
+typedef struct {
+  bool (*open)(void *priv);
+  void (*close)(void *priv);
+  bool (*request)(void *priv, uint32_t first, uint32_t last);
+  bool (*read)(void *priv, uint32_t pos, uint8_t *buf, size_t size);
+  /** Saved progress of the same package, false if there is none. */
+  bool (*load)(void *priv, const ImageHeader_t *header, uint32_t *offset);
+  void (*save)(void *priv, const ImageHeader_t *header, uint32_t offset);
+  void (*clear)(void *priv);
+  bool (*aborted)(void *priv);
+  /** Wait before the next session. */
+  void (*pause)(void *priv);
+  /** Called with true before and false after the flash is written. */
+  void (*writing)(void *priv, bool active);
+} OdOps_t;
+
+typedef struct {
+  const OdOps_t *ops;
+  void *priv;
+  const FlashDevice_t *dev;
+  uint8_t *buf;         /**< A chunk, or the chunk CRCs of the package.    */
+  size_t bufSize;
+  uint32_t *crcs;       /**< IW_MAX_CHUNKS entries.                        */
+  uint32_t segment;     /**< Image bytes per request.                      */
+  ImageHeader_t header;
+  ImageWriter_t writer;
+  uint32_t resumedAt;
+  uint32_t retries;
+  uint32_t rereads;     /**< Chunks read again from the transport.          */
+  uint32_t badChunks;   /**< Chunks requested again from the server.        */
+} OtaDownload_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void odInit(OtaDownload_t *od, const OdOps_t *ops, void *priv,
+            const FlashDevice_t *dev, uint8_t *buf, size_t bufSize,
+            uint32_t crcs[], uint32_t segment);
+
+/**
+ * @brief Download the package into the device until the image is bootable,
+ *        the retries run out or the download is aborted.
+ * @note  A saved progress of the same package is resumed. After a failed
+ *        session the image continues from the last verified chunk.
+ * @return IW_OK if the image is bootable.
+ */
+IwStatus_t odRun(OtaDownload_t *od);
+
+#endif /* OTA_DOWNLOAD_H */
+
+/****************************** END OF FILE **********************************/
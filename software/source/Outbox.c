@@ -0,0 +1,259 @@
+/**
+ * @file Outbox.c
+ * @brief Persistent queue of the position fixes not yet uploaded.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "Outbox.h"
+#include "Sdcard.h"
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define OUTBOX_FILE                 "/outbox.dat"
+#define CURSOR_FILE                 "/outbox.cur"
+#define CURSOR_MAGIC                0x4F424331U
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/*
+ * The cursor file is a log of acknowledged positions as well, the last
+ * intact entry is the current one. Nothing is ever rewritten in place, a
+ * torn write at power loss only costs the last acknowledgement.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t cursor;
+  uint32_t check;
+} CursorEntry_t;
+
+typedef struct {
+  mutex_t lock;
+  bool loaded;
+  uint32_t count;
+  uint32_t cursor;
+  uint32_t appended;
+  uint32_t acked;
+} Outbox_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static Outbox_t outbox;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool isValidEntry(const CursorEntry_t *entry) {
+  return (CURSOR_MAGIC == entry->magic) && (~entry->cursor == entry->check);
+}
+
+static uint32_t loadCursor(void) {
+  FIL file;
+  uint32_t cursor = 0;
+
+  if (FR_OK != f_open(&file, CURSOR_FILE, FA_OPEN_EXISTING | FA_READ))
+    return 0;
+
+  FSIZE_t entries = f_size(&file) / sizeof(CursorEntry_t);
+  while (entries > 0) {
+    CursorEntry_t entry;
+    UINT br = 0;
+    entries--;
+    f_lseek(&file, entries * sizeof(CursorEntry_t));
+    if ((FR_OK == f_read(&file, &entry, sizeof(entry), &br)) &&
+        (sizeof(entry) == br) && isValidEntry(&entry)) {
+      cursor = entry.cursor;
+      break;
+    }
+  }
+
+  f_close(&file);
+  return cursor;
+}
+
+static bool saveCursor(uint32_t cursor) {
+  CursorEntry_t entry = {CURSOR_MAGIC, cursor, ~cursor};
+  FIL file;
+  UINT bw = 0;
+
+  if (FR_OK != f_open(&file, CURSOR_FILE, FA_OPEN_APPEND | FA_WRITE))
+    return false;
+  FRESULT res = f_write(&file, &entry, sizeof(entry), &bw);
+  f_close(&file);
+
+  return (FR_OK == res) && (sizeof(entry) == bw);
+}
+
+static bool truncateFile(const char *path) {
+  FIL file;
+  if (FR_OK != f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE))
+    return false;
+  f_close(&file);
+  return true;
+}
+
+static bool load(void) {
+  if (outbox.loaded)
+    return true;
+  if (!sdcardIsMounted())
+    return false;
+
+  FILINFO info;
+  outbox.count = (FR_OK == f_stat(OUTBOX_FILE, &info)) ?
+                 (uint32_t)(info.fsize / sizeof(FixRecord_t)) : 0U;
+  outbox.cursor = loadCursor();
+
+  /* A cursor past the end means a lost truncation, sending everything
+     again is safe as the server drops duplicates by time. */
+  if (outbox.cursor > outbox.count)
+    outbox.cursor = 0;
+
+  outbox.loaded = true;
+  return true;
+}
+
+/*
+ * Both files start over once everything is acknowledged. The cursor goes
+ * first, a power loss in between leaves a zero cursor and a full outbox.
+ */
+static void restart(void) {
+  if (truncateFile(CURSOR_FILE) && truncateFile(OUTBOX_FILE)) {
+    outbox.count = 0;
+    outbox.cursor = 0;
+  }
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void obInit(void) {
+  memset(&outbox, 0, sizeof(outbox));
+  chMtxObjectInit(&outbox.lock);
+}
+
+bool obAppend(const FixRecord_t *rec) {
+  bool result = false;
+
+  chMtxLock(&outbox.lock);
+  if (load()) {
+    FIL file;
+    if (FR_OK == f_open(&file, OUTBOX_FILE, FA_OPEN_APPEND | FA_WRITE)) {
+      /* Records are only counted as a whole, the tail of a torn write is
+         overwritten by the next append. */
+      f_lseek(&file, (FSIZE_t)outbox.count * sizeof(FixRecord_t));
+      UINT bw = 0;
+      result = (FR_OK == f_write(&file, rec, sizeof(*rec), &bw)) &&
+               (sizeof(*rec) == bw);
+      f_close(&file);
+    }
+    if (result) {
+      outbox.count++;
+      outbox.appended++;
+    }
+  }
+  chMtxUnlock(&outbox.lock);
+
+  return result;
+}
+
+size_t obPending(void) {
+  size_t pending = 0;
+
+  chMtxLock(&outbox.lock);
+  if (load())
+    pending = outbox.count - outbox.cursor;
+  chMtxUnlock(&outbox.lock);
+
+  return pending;
+}
+
+size_t obPeek(FixRecord_t recs[], size_t max) {
+  size_t num = 0;
+
+  chMtxLock(&outbox.lock);
+  if (load() && (outbox.count > outbox.cursor)) {
+    FIL file;
+    if (FR_OK == f_open(&file, OUTBOX_FILE, FA_OPEN_EXISTING | FA_READ)) {
+      size_t pending = outbox.count - outbox.cursor;
+      UINT br = 0;
+      f_lseek(&file, (FSIZE_t)outbox.cursor * sizeof(FixRecord_t));
+      if (FR_OK == f_read(&file, recs,
+                          (pending < max ? pending : max) * sizeof(recs[0]),
+                          &br))
+        num = br / sizeof(recs[0]);
+      f_close(&file);
+    }
+  }
+  chMtxUnlock(&outbox.lock);
+
+  return num;
+}
+
+bool obAck(size_t count) {
+  bool result = false;
+
+  chMtxLock(&outbox.lock);
+  if (load() && (count <= outbox.count - outbox.cursor)) {
+    uint32_t cursor = outbox.cursor + count;
+    if (saveCursor(cursor)) {
+      outbox.cursor = cursor;
+      outbox.acked += count;
+      result = true;
+      if (outbox.cursor == outbox.count)
+        restart();
+    }
+  }
+  chMtxUnlock(&outbox.lock);
+
+  return result;
+}
+
+void obCmdOutbox(BaseSequentialStream *chp, int argc, char *argv[]) {
+  if ((argc > 1) || ((1 == argc) && strcmp(argv[0], "drop"))) {
+    chprintf(chp, "Usage: outbox [drop]\r\n");
+    return;
+  }
+
+  if (1 == argc) {
+    chMtxLock(&outbox.lock);
+    if (load())
+      restart();
+    chMtxUnlock(&outbox.lock);
+  }
+
+  chMtxLock(&outbox.lock);
+  bool loaded = load();
+  uint32_t count = outbox.count;
+  uint32_t cursor = outbox.cursor;
+  uint32_t appended = outbox.appended;
+  uint32_t acked = outbox.acked;
+  chMtxUnlock(&outbox.lock);
+
+  if (!loaded) {
+    chprintf(chp, "SD card is not mounted\r\n");
+    return;
+  }
+
+  chprintf(chp, "queued %lu, acked %lu, pending %lu\r\n", count, cursor,
+           count - cursor);
+  chprintf(chp, "appended %lu, uploaded %lu since boot\r\n", appended,
+           acked);
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,62 @@
+/**
+ * @file Outbox.h
+ * @brief Persistent queue of the position fixes not yet uploaded.
+ */
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "FixRecord.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void obInit(void);
+
+/**
+ * @brief Queue a fix at the end of /outbox.dat.
+ */
+bool obAppend(const FixRecord_t *rec);
+
+/**
+ * @brief Number of queued fixes the server has not acknowledged yet.
+ */
+size_t obPending(void);
+
+/**
+ * @brief Read the oldest unacknowledged fixes without removing them.
+ * @return Number of fixes copied to recs.
+ */
+size_t obPeek(FixRecord_t recs[], size_t max);
+
+/**
+ * @brief Remove the oldest count fixes by advancing the cursor.
+ */
+bool obAck(size_t count);
+
+void obCmdOutbox(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* OUTBOX_H */
+
+/****************************** END OF FILE **********************************/
@@ -10,11 +10,16 @@
 #include "BoardEvents.h"
 #include "Sdcard.h"
 #include "DebugShell.h"
+#include "StackMonitor.h"
+#include "CpuMonitor.h"
+#include "TraceRecorder.h"
+#include "BootProfiler.h"
 #include "sim8xx.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
+#define DIAGNOSTICS_PERIOD_IN_MS       60000
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
@@ -29,6 +34,8 @@
 /*******************************************************************************/
 static SerialConfig sd_config = {115200,0,0,0};
 static Sim8xxConfig sim_config = {&SD1, &sd_config, LINE_WAVESHARE_POWER};
+static virtual_timer_t diagnosticsTimer;
+static event_source_t diagnosticsEvent;
 
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
@@ -40,6 +47,10 @@ static Sim8xxConfig sim_config = {&SD1, &sd_config, LINE_WAVESHARE_POWER};
 static void sdcardInsertedHandler(eventid_t id) {
   (void)id;
   sdcardMount();
+  if (sdcardIsMounted()) {
+    bpMark(BP_SDCARD_MOUNTED);
+    bpSave();
+  }
 }
 
 static void sdcardRemovedHandler(eventid_t id) {
@@ -50,6 +61,7 @@ static void sdcardRemovedHandler(eventid_t id) {
 static void usbConnectedHandler(eventid_t id) {
   (void)id;
   debugShellStart();
+  bpMark(BP_SHELL_STARTED);
 }
 
 static void usbDisconnectedHandler(eventid_t id) {
@@ -62,6 +74,31 @@ static void debugShellTerminatedHandler(eventid_t id) {
   debugShellTerminated();
 }
 
+static void diagnosticsTimerCallback(void *p) {
+  (void)p;
+  chSysLockFromISR();
+  chEvtBroadcastI(&diagnosticsEvent);
+  chVTSetI(&diagnosticsTimer, TIME_MS2I(DIAGNOSTICS_PERIOD_IN_MS),
+           diagnosticsTimerCallback, NULL);
+  chSysUnlockFromISR();
+}
+
+static void diagnosticsHandler(eventid_t id) {
+  (void)id;
+  cmSample();
+  if (sdcardIsMounted()) {
+    smSaveStacks();
+    cmSaveLoad();
+    trSave();
+  }
+}
+
+static void traceFaultHandler(eventid_t id) {
+  (void)id;
+  if (sdcardIsMounted())
+    trSave();
+}
+
 /*******************************************************************************/
 /* DEFINITION OF GLOBAL FUNCTIONS                                              */
 /*******************************************************************************/
@@ -74,7 +111,9 @@ THD_FUNCTION(PeripheralManagerThread, arg) {
     sdcardRemovedHandler,
     usbConnectedHandler,
     usbDisconnectedHandler,
-    debugShellTerminatedHandler
+    debugShellTerminatedHandler,
+    diagnosticsHandler,
+    traceFaultHandler
   };
   
   event_listener_t sdcardInsertedListener;
@@ -82,12 +121,16 @@ THD_FUNCTION(PeripheralManagerThread, arg) {
   event_listener_t usbConnectedListener;
   event_listener_t usbDisconnectedListener;
   event_listener_t debugShellTerminatedListener;
+  event_listener_t diagnosticsListener;
+  event_listener_t traceFaultListener;
 
   chEvtRegister(&besSdcardInserted, &sdcardInsertedListener, 0);
   chEvtRegister(&besSdcardRemoved, &sdcardRemovedListener, 1);
   chEvtRegister(&besUsbConnected, &usbConnectedListener, 2);
   chEvtRegister(&besUsbDisconnected, &usbDisconnectedListener, 3);
   chEvtRegister(&shell_terminated, &debugShellTerminatedListener, 4);
+  chEvtRegister(&diagnosticsEvent, &diagnosticsListener, 5);
+  chEvtRegister(&trFaultEvent, &traceFaultListener, 6);
 
   sdcardInit();
   debugShellInit();
@@ -98,6 +141,13 @@ THD_FUNCTION(PeripheralManagerThread, arg) {
 } 
 
 void PeripheralManagerThreadInit(void) {
+  trInit();
+  chEvtObjectInit(&diagnosticsEvent);
+  chVTObjectInit(&diagnosticsTimer);
+  chSysLock();
+  chVTSetI(&diagnosticsTimer, TIME_MS2I(DIAGNOSTICS_PERIOD_IN_MS),
+           diagnosticsTimerCallback, NULL);
+  chSysUnlock();
   sim8xxInit(&SIM8D1);
   sim8xxStart(&SIM8D1, &sim_config);
 }
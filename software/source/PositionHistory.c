@@ -0,0 +1,207 @@
+/**
+ * @file PositionHistory.c
+ * @brief In-RAM ring of the most recent position fixes.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "PositionHistory.h"
+#include "chprintf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define HISTORY_MASK                (POSITION_HISTORY_SIZE - 1)
+#define DEFAULT_WINDOW_IN_S         60
+
+/*
+ * Records printed per copy, the shell stack holds them.
+ */
+#define PRINT_CHUNK                 16
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  mutex_t lock;
+  size_t head;
+  size_t count;
+  FixRecord_t records[POSITION_HISTORY_SIZE];
+} PositionHistory_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#if (POSITION_HISTORY_SIZE & HISTORY_MASK) != 0
+#error "POSITION_HISTORY_SIZE must be a power of two"
+#endif
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static PositionHistory_t history;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+/*
+ * Record at logical index i, 0 is the oldest one.
+ */
+static const FixRecord_t *recordAt(size_t i) {
+  return &history.records[(history.head + i) & HISTORY_MASK];
+}
+
+/*
+ * Logical index of the first record not older than time.
+ */
+static size_t lowerBound(uint32_t time) {
+  size_t first = 0;
+  size_t last = history.count;
+  while (first < last) {
+    size_t middle = first + (last - first) / 2;
+    if (recordAt(middle)->time < time)
+      first = middle + 1;
+    else
+      last = middle;
+  }
+  return first;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void phInit(void) {
+  memset(&history, 0, sizeof(history));
+  chMtxObjectInit(&history.lock);
+}
+
+bool phAppend(const FixRecord_t *rec) {
+  bool result = false;
+
+  chMtxLock(&history.lock);
+  if ((0 == history.count) ||
+      (recordAt(history.count - 1)->time < rec->time)) {
+    if (POSITION_HISTORY_SIZE == history.count) {
+      history.records[history.head] = *rec;
+      history.head = (history.head + 1) & HISTORY_MASK;
+    } else {
+      history.records[(history.head + history.count) & HISTORY_MASK] = *rec;
+      history.count++;
+    }
+    result = true;
+  }
+  chMtxUnlock(&history.lock);
+
+  return result;
+}
+
+size_t phCount(void) {
+  chMtxLock(&history.lock);
+  size_t count = history.count;
+  chMtxUnlock(&history.lock);
+  return count;
+}
+
+bool phFindAt(uint32_t time, FixRecord_t *rec) {
+  bool result = false;
+
+  chMtxLock(&history.lock);
+  size_t i = lowerBound(time);
+  if ((i < history.count) && (recordAt(i)->time == time)) {
+    *rec = *recordAt(i);
+    result = true;
+  } else if (i > 0) {
+    *rec = *recordAt(i - 1);
+    result = true;
+  }
+  chMtxUnlock(&history.lock);
+
+  return result;
+}
+
+size_t phForEach(uint32_t from, uint32_t to, PositionHistoryVisitor_t visitor,
+                 void *arg) {
+  size_t visited = 0;
+
+  chMtxLock(&history.lock);
+  size_t i;
+  for (i = lowerBound(from); i < history.count; ++i) {
+    const FixRecord_t *rec = recordAt(i);
+    if (rec->time > to)
+      break;
+    ++visited;
+    if (!visitor(rec, arg))
+      break;
+  }
+  chMtxUnlock(&history.lock);
+
+  return visited;
+}
+
+size_t phCopy(uint32_t from, uint32_t to, FixRecord_t *buf, size_t max) {
+  size_t copied = 0;
+
+  chMtxLock(&history.lock);
+  size_t i;
+  for (i = lowerBound(from); (i < history.count) && (copied < max); ++i) {
+    const FixRecord_t *rec = recordAt(i);
+    if (rec->time > to)
+      break;
+    buf[copied++] = *rec;
+  }
+  chMtxUnlock(&history.lock);
+
+  return copied;
+}
+
+/*
+ * The records are printed from a copy, a slow console must not hold up the
+ * GPS reader appending to the history.
+ */
+void phCmdHistory(BaseSequentialStream *chp, int argc, char *argv[]) {
+  if (argc > 1) {
+    chprintf(chp, "Usage: history [seconds]\r\n");
+    return;
+  }
+
+  uint32_t window = (1 == argc) ? (uint32_t)atoi(argv[0])
+                                : DEFAULT_WINDOW_IN_S;
+
+  chMtxLock(&history.lock);
+  uint32_t newest = history.count ? recordAt(history.count - 1)->time : 0;
+  chMtxUnlock(&history.lock);
+
+  if (0 == newest) {
+    chprintf(chp, "History is empty\r\n");
+    return;
+  }
+
+  uint32_t from = (newest > window) ? newest - window : 0;
+  FixRecord_t buf[PRINT_CHUNK];
+  size_t num = 0;
+  size_t copied;
+  do {
+    copied = phCopy(from, newest, buf, PRINT_CHUNK);
+    size_t i;
+    for (i = 0; i < copied; ++i) {
+      const FixRecord_t *rec = &buf[i];
+      chprintf(chp, "%lu %ld %ld %d %u\r\n", rec->time, rec->latitude,
+               rec->longitude, rec->altitude, rec->speed);
+    }
+    num += copied;
+    if (copied)
+      from = buf[copied - 1].time + 1U;
+  } while (PRINT_CHUNK == copied);
+  chprintf(chp, "%u of %u fixes, %u bytes\r\n", num, phCount(),
+           sizeof(history.records));
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,82 @@
+/**
+ * @file PositionHistory.h
+ * @brief In-RAM ring of the most recent position fixes.
+ */
+
+#ifndef POSITION_HISTORY_H
+#define POSITION_HISTORY_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "FixRecord.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Number of fixes kept, must be a power of two.
+ * @note  Memory budget is POSITION_HISTORY_SIZE * sizeof(FixRecord_t), that is
+ *        4 KB for 256 entries, about 21 minutes at the 5 s GPS update period.
+ */
+#if !defined(POSITION_HISTORY_SIZE)
+#define POSITION_HISTORY_SIZE       256
+#endif
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief Callback of phForEach(), return false to stop the iteration.
+ */
+typedef bool (*PositionHistoryVisitor_t)(const FixRecord_t *rec, void *arg);
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void phInit(void);
+
+/**
+ * @brief Append a fix, the oldest one is overwritten when the ring is full.
+ * @note  Fixes must arrive in increasing time order, others are rejected.
+ */
+bool phAppend(const FixRecord_t *rec);
+
+size_t phCount(void);
+
+/**
+ * @brief Find the latest fix taken at or before the given time, O(log n).
+ */
+bool phFindAt(uint32_t time, FixRecord_t *rec);
+
+/**
+ * @brief Visit the fixes of the [from, to] window in time order.
+ * @note  The visitor runs with the history locked and delays phAppend().
+ * @return Number of visited fixes.
+ */
+size_t phForEach(uint32_t from, uint32_t to, PositionHistoryVisitor_t visitor,
+                 void *arg);
+
+/**
+ * @brief Copy the first fixes of the [from, to] window in time order.
+ * @note  The history is locked only for the copy, the caller may then take
+ *        its time with the records.
+ * @return Number of copied fixes, at most max.
+ */
+size_t phCopy(uint32_t from, uint32_t to, FixRecord_t *buf, size_t max);
+
+void phCmdHistory(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* POSITION_HISTORY_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,193 @@
+/**
+ * @file PowerManager.c
+ * @brief Power state bookkeeping and Stop 2 low-power mode.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "PowerManager.h"
+#include "chprintf.h"
+
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define RTC_WUCKSEL_1HZ              4U
+#define MS_PER_DAY                   (24UL * 60UL * 60UL * 1000UL)
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef struct {
+  PowerState_t state;
+  systime_t stateStart;
+  uint32_t timeInState[PM_STATE_NUM];
+  uint32_t wakeups;
+  PowerWakeupSource_t lastWakeupSource;
+  bool waitRunning;
+  systime_t wakeupTime;
+  sysinterval_t lastLatency;
+  sysinterval_t worstLatency;
+} PowerManager_t;
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const PpWakeupLines_t wakeupLines = {
+  .ignition = 1U << PAL_PAD(LINE_EXT_IGNITION),
+  .motion   = (1U << PAL_PAD(LINE_ACC_INT1)) | (1U << PAL_PAD(LINE_ACC_INT2)),
+  .rtc      = 1U << STM32_RTC_WKUP_EXTI
+};
+
+static const RTCWakeup rtcWakeup = {
+  (RTC_WUCKSEL_1HZ << 16) | (PM_RTC_WAKEUP_PERIOD_IN_S - 1)
+};
+
+static PowerManager_t pm;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static void accountState(void) {
+  systime_t now = chVTGetSystemTimeX();
+  pm.timeInState[pm.state] += TIME_I2MS(chTimeDiffX(pm.stateStart, now));
+  pm.stateStart = now;
+}
+
+static uint32_t rtcMillisecondOfDay(void) {
+  RTCDateTime timespec;
+  rtcGetTime(&RTCD1, &timespec);
+  return timespec.millisecond;
+}
+
+/*
+ * The kernel lock masks interrupts through BASEPRI, which would keep WFI from
+ * waking up. PRIMASK is used instead, so the pending wake-up interrupt ends
+ * WFI and is served only after the clock tree has been restored.
+ */
+static uint32_t enterStop2(void) {
+  chSysLock();
+  PWR->CR1 = (PWR->CR1 & ~PWR_CR1_LPMS) | PWR_CR1_LPMS_STOP2;
+  SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+  __disable_irq();
+  chSysUnlock();
+
+  __DSB();
+  __WFI();
+
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+  stm32_clock_init();
+  uint32_t pending = EXTI->PR1;
+  __enable_irq();
+
+  return pending;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+OSAL_IRQ_HANDLER(STM32_RTC_WKUP_HANDLER) {
+  OSAL_IRQ_PROLOGUE();
+  RTC->ISR &= ~RTC_ISR_WUTF;
+  EXTI->PR1 = 1U << STM32_RTC_WKUP_EXTI;
+  OSAL_IRQ_EPILOGUE();
+}
+
+void pmInit(void) {
+  memset(&pm, 0, sizeof(pm));
+  pm.state = PM_STATE_PARKED;
+  pm.stateStart = chVTGetSystemTimeX();
+
+  EXTI->IMR1 |= 1U << STM32_RTC_WKUP_EXTI;
+  EXTI->RTSR1 |= 1U << STM32_RTC_WKUP_EXTI;
+  nvicEnableVector(STM32_RTC_WKUP_NUMBER, STM32_IRQ_EXTI20_PRIORITY);
+}
+
+void pmSetState(PowerState_t state) {
+  chDbgCheck(state < PM_STATE_NUM);
+  chSysLock();
+  accountState();
+  pm.state = state;
+  chSysUnlock();
+}
+
+bool pmCanSleep(void) {
+  return ppCanSleep(PAL_HIGH == palReadLine(LINE_USB_VBUS_SENSE));
+}
+
+PowerWakeupSource_t pmSleep(void) {
+  PowerState_t previous = pm.state;
+  pmSetState(PM_STATE_STOP2);
+
+  rtcSTM32SetPeriodicWakeup(&RTCD1, &rtcWakeup);
+  uint32_t before = rtcMillisecondOfDay();
+
+  uint32_t pending = enterStop2();
+
+  uint32_t after = rtcMillisecondOfDay();
+  rtcSTM32SetPeriodicWakeup(&RTCD1, NULL);
+
+  /* The system timer is halted in Stop 2, the RTC tells the time slept. */
+  chSysLock();
+  pm.timeInState[PM_STATE_STOP2] +=
+      (after >= before) ? after - before : MS_PER_DAY - before + after;
+  pm.stateStart = chVTGetSystemTimeX();
+  pm.state = previous;
+  chSysUnlock();
+
+  pm.wakeups++;
+  pm.lastWakeupSource = ppWakeupSource(pending, &wakeupLines);
+  pm.wakeupTime = chVTGetSystemTimeX();
+  pm.waitRunning = true;
+
+  return pm.lastWakeupSource;
+}
+
+void pmRunning(void) {
+  if (pm.waitRunning) {
+    pm.waitRunning = false;
+    pm.lastLatency = chVTTimeElapsedSinceX(pm.wakeupTime);
+    if (pm.lastLatency > pm.worstLatency)
+      pm.worstLatency = pm.lastLatency;
+  }
+}
+
+void pmCmdPower(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+
+  if (argc > 0) {
+    chprintf(chp, "Usage: power\r\n");
+    return;
+  }
+
+  chSysLock();
+  accountState();
+  chSysUnlock();
+
+  uint64_t charge = 0;
+  size_t i;
+  for (i = 0; i < PM_STATE_NUM; ++i) {
+    uint64_t uAms = (uint64_t)ppStateCurrent(i) * pm.timeInState[i];
+    charge += uAms;
+    chprintf(chp, "%-8s %10lu ms %6lu uA %8lu uAh\r\n", ppStateName(i),
+             pm.timeInState[i], ppStateCurrent(i),
+             (uint32_t)(uAms / 3600000U));
+  }
+  chprintf(chp, "total %lu uAh\r\n", (uint32_t)(charge / 3600000U));
+  chprintf(chp, "wakeups %lu, last source %s\r\n", pm.wakeups,
+           ppWakeupName(pm.lastWakeupSource));
+  chprintf(chp, "wake-to-running latency %lu ms, worst %lu ms\r\n",
+           TIME_I2MS(pm.lastLatency), TIME_I2MS(pm.worstLatency));
+}
+
+/******************************* END OF FILE ***********************************/
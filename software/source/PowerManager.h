@@ -0,0 +1,67 @@
+/**
+ * @file PowerManager.h
+ * @brief Power state bookkeeping and Stop 2 low-power mode.
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "PowerPolicy.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/**
+ * @brief Period of the RTC wake-up while parked.
+ */
+#if !defined(PM_RTC_WAKEUP_PERIOD_IN_S)
+#define PM_RTC_WAKEUP_PERIOD_IN_S    3600
+#endif
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+void pmInit(void);
+
+/**
+ * @brief Account the time spent in the previous state and switch to a new one.
+ */
+void pmSetState(PowerState_t state);
+
+/**
+ * @brief Policy check, Stop 2 is not entered while USB powers the board.
+ */
+bool pmCanSleep(void);
+
+/**
+ * @brief Enter Stop 2 and return when one of the wake-up sources fires.
+ * @note  Peripherals must be stopped by the caller.
+ */
+PowerWakeupSource_t pmSleep(void);
+
+/**
+ * @brief Mark the system fully running, closes the wake-up latency measurement.
+ */
+void pmRunning(void);
+
+void pmCmdPower(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* POWER_MANAGER_H */
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,96 @@
+/**
+ * @file PowerPolicy.c
+ * @brief Power states, wake-up sources and the decisions taken on them.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "PowerPolicy.h"
+
+#include <stddef.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+/*
+ * Modelled supply current of the board in microamperes per state. Datasheet
+ * typicals of the STM32L452, the LIS3DSH and the SIM868, to be replaced by
+ * measurements on the real hardware. The accelerometer watches for motion at
+ * its lowest data rate while parked.
+ */
+static const uint32_t stateCurrents[PM_STATE_NUM] = {
+  [PM_STATE_RIDING] = 3000 + 20000 + 25000,
+  [PM_STATE_PARKED] = 3000 + 11,
+  [PM_STATE_STOP2]  = 2 + 11
+};
+
+static const char *const stateNames[PM_STATE_NUM] = {
+  [PM_STATE_RIDING] = "riding",
+  [PM_STATE_PARKED] = "parked",
+  [PM_STATE_STOP2]  = "stop2"
+};
+
+static const char *const wakeupNames[] = {
+  [PM_WAKEUP_NONE]     = "none",
+  [PM_WAKEUP_IGNITION] = "ignition",
+  [PM_WAKEUP_MOTION]   = "motion",
+  [PM_WAKEUP_RTC]      = "rtc",
+  [PM_WAKEUP_OTHER]    = "other"
+};
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+bool ppPowered(bool ignition, bool usb) {
+  return ignition || usb;
+}
+
+bool ppCanSleep(bool usb) {
+  return !usb;
+}
+
+PowerWakeupSource_t ppWakeupSource(uint32_t pending,
+                                   const PpWakeupLines_t *lines) {
+  if (pending & lines->ignition)
+    return PM_WAKEUP_IGNITION;
+  if (pending & lines->motion)
+    return PM_WAKEUP_MOTION;
+  if (pending & lines->rtc)
+    return PM_WAKEUP_RTC;
+  return PM_WAKEUP_OTHER;
+}
+
+uint32_t ppStateCurrent(PowerState_t state) {
+  return (state < PM_STATE_NUM) ? stateCurrents[state] : 0U;
+}
+
+const char *ppStateName(PowerState_t state) {
+  return (state < PM_STATE_NUM) ? stateNames[state] : "?";
+}
+
+const char *ppWakeupName(PowerWakeupSource_t source) {
+  return (source <= PM_WAKEUP_OTHER) ? wakeupNames[source] : "?";
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,91 @@
+/**
+ * @file PowerPolicy.h
+ * @brief Power states, wake-up sources and the decisions taken on them.
+ * @note  No OS dependency, tools/power_sim.c runs the policy on the host.
+ */
+
+#ifndef POWER_POLICY_H
+#define POWER_POLICY_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/**
+ * @brief Time spent parked and awake before Stop 2 is entered.
+ */
+#if !defined(PP_PARKING_GRACE_TIME_IN_MS)
+#define PP_PARKING_GRACE_TIME_IN_MS  10000
+#endif
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+  PM_STATE_RIDING,    /**< MCU running, modem and GNSS powered.             */
+  PM_STATE_PARKED,    /**< MCU running, modem and GNSS powered down.        */
+  PM_STATE_STOP2,     /**< MCU in Stop 2, only the wake-up sources alive.   */
+  PM_STATE_NUM
+} PowerState_t;
+
+typedef enum {
+  PM_WAKEUP_NONE,
+  PM_WAKEUP_IGNITION,
+  PM_WAKEUP_MOTION,
+  PM_WAKEUP_RTC,
+  PM_WAKEUP_OTHER
+} PowerWakeupSource_t;
+
+/**
+ * @brief EXTI lines of the wake-up sources.
+ */
+typedef struct {
+  uint32_t ignition;
+  uint32_t motion;
+  uint32_t rtc;
+} PpWakeupLines_t;
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * @brief The bike counts as switched on with the ignition or with USB power,
+ *        which stands in for the ignition on the bench.
+ */
+bool ppPowered(bool ignition, bool usb);
+
+/**
+ * @brief Stop 2 is not entered while USB powers the board.
+ */
+bool ppCanSleep(bool usb);
+
+/**
+ * @brief Wake-up source from the pending EXTI lines, the ignition first.
+ */
+PowerWakeupSource_t ppWakeupSource(uint32_t pending,
+                                   const PpWakeupLines_t *lines);
+
+/**
+ * @brief Modelled supply current of the board in a state, microamperes.
+ */
+uint32_t ppStateCurrent(PowerState_t state);
+
+const char *ppStateName(PowerState_t state);
+const char *ppWakeupName(PowerWakeupSource_t source);
+
+#endif /* POWER_POLICY_H */
+
+/******************************* END OF FILE ***********************************/
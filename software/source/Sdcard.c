@@ -121,6 +121,10 @@ void sdcardUnmount(void) {
   palSetLine(LINE_LED_2_RED);
 }
 
+bool sdcardIsMounted(void) {
+  return fsReady;
+}
+
 void sdcardCmdTree(BaseSequentialStream *chp, int argc, char *argv[]) {
   FRESULT err;
   uint32_t clusters;
@@ -35,6 +35,7 @@
 void sdcardInit(void);
 void sdcardMount(void);
 void sdcardUnmount(void);
+bool sdcardIsMounted(void);
 
 void sdcardCmdTree(BaseSequentialStream *chp, int argc, char *argv[]);
 
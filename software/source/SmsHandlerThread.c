@@ -0,0 +1,551 @@
+/**
+ * @file SmsHandlerThread.c
+ * @brief Location queries by SMS and by calls from known numbers.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "SmsHandlerThread.h"
+#include "Dashboard.h"
+#include "FixRecord.h"
+#include "Outbox.h"
+#include "gtrackconf.h"
+#include "sim8xx.h"
+#include "at.h"
+
+#include "chprintf.h"
+
+#include <ctype.h>
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define REQUEST_QUEUE_SIZE          8
+#define URC_LINE_SIZE               64
+#define NUMBER_SIZE                 (20 + 1)
+#define REPLY_SIZE                  (160 + 1)
+#define ALERT_SIZE                  40
+#define SCAN_MAX_MESSAGES           8
+
+#define SEND_TIMEOUT_IN_MS          60000
+#define CALL_HOLDOFF_IN_MS          30000
+#define CTRL_Z                      0x1A
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  SMS_REQUEST_SCAN,
+  SMS_REQUEST_MESSAGE,
+  SMS_REQUEST_CALL,
+  SMS_REQUEST_ALERT
+} SmsRequestKind_t;
+
+typedef struct {
+  SmsRequestKind_t kind;
+  int index;
+  char number[NUMBER_SIZE];
+  char text[ALERT_SIZE];
+  systime_t arrived;
+} SmsRequest_t;
+
+typedef struct {
+  uint32_t messages;
+  uint32_t calls;
+  uint32_t alerts;
+  uint32_t replies;
+  uint32_t rejected;
+  uint32_t failures;
+  uint32_t dropped;
+  uint32_t latencySum;
+  uint32_t latencyMin;
+  uint32_t latencyMax;
+  uint32_t lastQueue;   /**< URC to the first command in ms.               */
+  uint32_t lastRead;    /**< Reading the message in ms.                    */
+  uint32_t lastSend;    /**< Sending the reply in ms.                      */
+} SmsStats_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#define ELAPSED_MS(since)                                                      \
+  ((uint32_t)TIME_I2MS(chVTTimeElapsedSinceX(since)))
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const sourceNames[] = {
+  [POS_SOURCE_NONE] = "none",
+  [POS_SOURCE_GNSS] = "GNSS",
+  [POS_SOURCE_CELL] = "cell"
+};
+
+static objects_fifo_t requests;
+static SmsRequest_t requestBuffer[REQUEST_QUEUE_SIZE];
+static msg_t requestMessages[REQUEST_QUEUE_SIZE];
+static mutex_t sessionLock;
+static volatile bool running;
+static Sim8xxCommand cmd;
+static char reply[REPLY_SIZE + 1];
+static char lastCaller[NUMBER_SIZE];
+static systime_t lastCall;
+static SmsStats_t stats;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool execute(void) {
+  sim8xxExecute(&SIM8D1, &cmd);
+  return SIM8XX_OK == cmd.status;
+}
+
+/*
+ * Called by the reader thread, the request is queued with the time of the
+ * URC and the reader goes on at once.
+ */
+static void urcHook(eventflags_t flag, const char *line, size_t length) {
+  char buf[URC_LINE_SIZE];
+  SmsRequest_t *req;
+
+  if (length + 3 > sizeof(buf))
+    return;
+  memcpy(buf, line, length);
+  strcpy(buf + length, "\r\n");
+
+  req = chFifoTakeObjectTimeout(&requests, TIME_IMMEDIATE);
+  if (NULL == req) {
+    stats.dropped++;
+    return;
+  }
+
+  memset(req, 0, sizeof(*req));
+  req->arrived = chVTGetSystemTime();
+  if ((SIM8XX_URC_CMTI == flag) && atCmtiParse(&req->index, buf)) {
+    req->kind = SMS_REQUEST_MESSAGE;
+  } else if ((SIM8XX_URC_CLIP == flag) &&
+             atClipParse(req->number, sizeof(req->number), buf)) {
+    req->kind = SMS_REQUEST_CALL;
+  } else {
+    chFifoReturnObject(&requests, req);
+    return;
+  }
+  chFifoSendObject(&requests, req);
+}
+
+static void queueScan(void) {
+  SmsRequest_t *req = chFifoTakeObjectTimeout(&requests, TIME_IMMEDIATE);
+  if (req) {
+    memset(req, 0, sizeof(*req));
+    req->kind = SMS_REQUEST_SCAN;
+    req->arrived = chVTGetSystemTime();
+    chFifoSendObject(&requests, req);
+  }
+}
+
+/*
+ * The E.164 form of a number, "+" and the digits. A national number gets
+ * GTRACK_SMS_COUNTRY_CODE in place of its trunk prefix. Returns false if
+ * the number has no E.164 form.
+ */
+static bool normalizeNumber(char out[NUMBER_SIZE], const char *number,
+                            size_t length) {
+  char digits[NUMBER_SIZE];
+  const char *national = "";
+  const char *rest = digits;
+  bool international = false;
+  size_t n = 0, i;
+
+  for (i = 0; i < length; ++i) {
+    char c = number[i];
+    if (isdigit((unsigned char)c)) {
+      if (n >= sizeof(digits) - 1)
+        return false;
+      digits[n++] = c;
+    } else if (('+' == c) && (0U == n) && !international) {
+      international = true;
+    } else if (!strchr(" -.()", c)) {
+      return false;
+    }
+  }
+  digits[n] = '\0';
+
+  if (!international) {
+    if (0 == strncmp(digits, "00", 2)) {
+      rest = digits + 2;
+    } else if (('\0' != GTRACK_SMS_COUNTRY_CODE[0]) &&
+               (0 == strncmp(digits, GTRACK_SMS_TRUNK_PREFIX,
+                             sizeof(GTRACK_SMS_TRUNK_PREFIX) - 1))) {
+      national = GTRACK_SMS_COUNTRY_CODE;
+      rest = digits + sizeof(GTRACK_SMS_TRUNK_PREFIX) - 1;
+    } else {
+      return false;
+    }
+  }
+
+  /* Country codes do not start with 0. */
+  if (('\0' == *rest) || (('\0' == *national) && ('0' == *rest)))
+    return false;
+  return (size_t)chsnprintf(out, NUMBER_SIZE, "+%s%s", national, rest) <
+         NUMBER_SIZE;
+}
+
+/*
+ * GTRACK_SMS_WHITELIST is a comma separated list, an empty list allows
+ * nobody. Numbers match only in full.
+ */
+static bool isAllowed(const char *number) {
+  const char *entry = GTRACK_SMS_WHITELIST;
+  char caller[NUMBER_SIZE], allowed[NUMBER_SIZE];
+
+  if (!normalizeNumber(caller, number, strlen(number)))
+    return false;
+
+  while (*entry) {
+    size_t length = strcspn(entry, ",");
+    if ((length > 0) && normalizeNumber(allowed, entry, length) &&
+        (0 == strcmp(caller, allowed)))
+      return true;
+    entry += length;
+    if (',' == *entry)
+      entry++;
+  }
+  return false;
+}
+
+static size_t formatDegrees(char *buf, size_t size, int32_t value) {
+  uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+  return chsnprintf(buf, size, "%s%lu.%07lu", (value < 0) ? "-" : "",
+                    magnitude / FR_DEGREE_SCALE, magnitude % FR_DEGREE_SCALE);
+}
+
+/*
+ * The latest fix of the dashboard is used as it is, the reply does not
+ * wait for the next GNSS poll. The text is appended at offset n of buf.
+ */
+static void formatLocation(char *buf, size_t size, size_t n) {
+  Position_t pos;
+  FixRecord_t rec;
+  systime_t timestamp;
+  char lat[16], lon[16];
+
+  if ((0 == dbGetPosition(&pos, &timestamp)) ||
+      (POS_SOURCE_NONE == pos.source) || !frFromPosition(&rec, &pos)) {
+    chsnprintf(buf + n, size - n, "g-track: no position yet");
+    return;
+  }
+
+  formatDegrees(lat, sizeof(lat), rec.latitude);
+  formatDegrees(lon, sizeof(lon), rec.longitude);
+  n += chsnprintf(buf + n, size - n,
+                  "%s %.4s-%.2s-%.2s %.2s:%.2s:%.2sZ age %lus\n",
+                  sourceNames[pos.source], &pos.date[0], &pos.date[4],
+                  &pos.date[6], &pos.date[8], &pos.date[10], &pos.date[12],
+                  (unsigned long)TIME_I2S(chVTTimeElapsedSinceX(timestamp)));
+  if (POS_SOURCE_CELL == pos.source)
+    n += chsnprintf(buf + n, size - n, "%s,%s ~%lum\n", lat, lon,
+                    pos.accuracy);
+  else
+    n += chsnprintf(buf + n, size - n, "%s,%s %dm %ukm/h\n", lat, lon,
+                    rec.altitude, (unsigned)(rec.speed / FR_SPEED_SCALE));
+  chsnprintf(buf + n, size - n, "maps.google.com/?q=%s,%s", lat, lon);
+}
+
+static void formatStatus(void) {
+  static const char *const registrationNames[] = {
+    [NET_REG_NONE] = "none", [NET_REG_HOME] = "home",
+    [NET_REG_SEARCHING] = "searching", [NET_REG_DENIED] = "denied",
+    [NET_REG_UNKNOWN] = "unknown", [NET_REG_ROAMING] = "roaming"
+  };
+  Network_t net;
+
+  dbGetNetwork(&net, NULL);
+  chsnprintf(reply, REPLY_SIZE,
+             "g-track net %s %ddBm %lumV, outbox %u, up %lus",
+             registrationNames[net.registration], net.rssi, net.supply,
+             (unsigned)obPending(),
+             (unsigned long)TIME_I2S(chVTGetSystemTime()));
+}
+
+/*
+ * Commands are case insensitive, leading and trailing blanks are ignored.
+ */
+static void formatReply(const char *text) {
+  char command[8];
+  size_t n = 0;
+
+  while (isspace((unsigned char)*text))
+    text++;
+  while (*text && !isspace((unsigned char)*text) &&
+         (n < sizeof(command) - 1))
+    command[n++] = (char)toupper((unsigned char)*text++);
+  command[n] = '\0';
+
+  if (!strcmp(command, "LOC") || !strcmp(command, "WHERE"))
+    formatLocation(reply, REPLY_SIZE, 0);
+  else if (!strcmp(command, "STATUS"))
+    formatStatus();
+  else
+    chsnprintf(reply, REPLY_SIZE, "g-track: send LOC or STATUS");
+}
+
+static bool sendReply(const char *number) {
+  size_t length = strlen(reply);
+  reply[length] = CTRL_Z;
+
+  sim8xxCommandInit(&cmd);
+  atCmgsCreate(cmd.request, sizeof(cmd.request), number);
+  cmd.timeout = TIME_MS2I(SEND_TIMEOUT_IN_MS);
+  sim8xxSend(&SIM8D1, &cmd, (const uint8_t *)reply, length + 1);
+  reply[length] = '\0';
+
+  bool sent = SIM8XX_OK == cmd.status;
+  if (sent)
+    stats.replies++;
+  else
+    stats.failures++;
+  return sent;
+}
+
+static void updateLatency(const SmsRequest_t *req) {
+  uint32_t latency = ELAPSED_MS(req->arrived);
+  stats.latencySum += latency;
+  if ((0U == stats.latencyMin) || (latency < stats.latencyMin))
+    stats.latencyMin = latency;
+  if (latency > stats.latencyMax)
+    stats.latencyMax = latency;
+}
+
+static void deleteMessage(int index) {
+  sim8xxCommandInit(&cmd);
+  atCmgdCreate(cmd.request, sizeof(cmd.request), index);
+  execute();
+}
+
+/*
+ * The reply goes out before the message is deleted, deleting is not on the
+ * path of the latency.
+ */
+static void handleMessage(const SmsRequest_t *req) {
+  CMGR_Response_t message;
+  systime_t start = chVTGetSystemTime();
+
+  stats.messages++;
+  stats.lastQueue = ELAPSED_MS(req->arrived);
+
+  sim8xxCommandInit(&cmd);
+  atCmgrCreate(cmd.request, sizeof(cmd.request), req->index);
+  bool read = execute() && atCmgrParse(&message, cmd.response);
+  stats.lastRead = ELAPSED_MS(start);
+
+  if (!read) {
+    stats.failures++;
+  } else if (!isAllowed(message.sender)) {
+    stats.rejected++;
+  } else {
+    formatReply(message.text);
+    start = chVTGetSystemTime();
+    if (sendReply(message.sender))
+      updateLatency(req);
+    stats.lastSend = ELAPSED_MS(start);
+  }
+
+  deleteMessage(req->index);
+}
+
+/*
+ * A known caller is hung up on and gets the location as a message. The
+ * caller id is repeated with every RING, only the first one is answered.
+ */
+static void handleCall(const SmsRequest_t *req) {
+  if (!isAllowed(req->number)) {
+    stats.rejected++;
+    return;
+  }
+
+  if (!strcmp(req->number, lastCaller) &&
+      chVTIsSystemTimeWithin(lastCall,
+                             chTimeAddX(lastCall,
+                                        TIME_MS2I(CALL_HOLDOFF_IN_MS))))
+    return;
+
+  stats.calls++;
+  strcpy(lastCaller, req->number);
+  lastCall = chVTGetSystemTime();
+
+  sim8xxCommandInit(&cmd);
+  atAthCreate(cmd.request, sizeof(cmd.request));
+  execute();
+
+  formatLocation(reply, REPLY_SIZE, 0);
+  if (sendReply(req->number))
+    updateLatency(req);
+}
+
+/*
+ * Alerts go to the first number of the whitelist, with the location.
+ */
+static void handleAlert(const SmsRequest_t *req) {
+  char number[NUMBER_SIZE];
+  size_t length = strcspn(GTRACK_SMS_WHITELIST, ",");
+
+  if ((0U == length) || (length >= sizeof(number)))
+    return;
+  memcpy(number, GTRACK_SMS_WHITELIST, length);
+  number[length] = '\0';
+
+  stats.alerts++;
+  formatLocation(reply, REPLY_SIZE,
+                 chsnprintf(reply, REPLY_SIZE, "%s\n", req->text));
+  sendReply(number);
+}
+
+/*
+ * Settings are lost with every power cycle of the modem. Messages that
+ * arrived while the modem was off, or while a transparent link held back
+ * the URCs, are found by listing the storage.
+ */
+static void scanStorage(void) {
+  int indices[SCAN_MAX_MESSAGES];
+  size_t num, i;
+
+  sim8xxCommandInit(&cmd);
+  atCmgfCreate(cmd.request, sizeof(cmd.request));
+  execute();
+  sim8xxCommandInit(&cmd);
+  atCnmiCreate(cmd.request, sizeof(cmd.request));
+  execute();
+  sim8xxCommandInit(&cmd);
+  atClipCreate(cmd.request, sizeof(cmd.request));
+  execute();
+
+  sim8xxCommandInit(&cmd);
+  atCmglCreate(cmd.request, sizeof(cmd.request));
+  if (!execute())
+    return;
+
+  num = atCmglParse(indices, SCAN_MAX_MESSAGES, cmd.response);
+  for (i = 0; (i < num) && running; ++i) {
+    SmsRequest_t req = {SMS_REQUEST_MESSAGE, indices[i], "", "",
+                        chVTGetSystemTime()};
+    handleMessage(&req);
+  }
+}
+
+/*
+ * The scan takes a window of a live connection like the other periodic
+ * queries, a scan that gets none waits for the next period.
+ */
+static void scan(void) {
+  if (sim8xxPollBegin(&SIM8D1, TIME_MS2I(GTRACK_SMS_SCAN_PERIOD_IN_MS))) {
+    scanStorage();
+    sim8xxPollEnd(&SIM8D1);
+  }
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+THD_FUNCTION(SmsHandlerThread, arg) {
+  (void)arg;
+  chRegSetThreadName("sms");
+
+  while (true) {
+    SmsRequest_t *req = NULL;
+    msg_t msg = chFifoReceiveObjectTimeout(
+        &requests, (void **)&req, TIME_MS2I(GTRACK_SMS_SCAN_PERIOD_IN_MS));
+
+    chMtxLock(&sessionLock);
+    if (running) {
+      if (MSG_OK != msg)
+        scan();
+      else if (SMS_REQUEST_SCAN == req->kind)
+        scan();
+      else if (SMS_REQUEST_MESSAGE == req->kind)
+        handleMessage(req);
+      else if (SMS_REQUEST_CALL == req->kind)
+        handleCall(req);
+      else
+        handleAlert(req);
+    }
+    chMtxUnlock(&sessionLock);
+
+    if (MSG_OK == msg)
+      chFifoReturnObject(&requests, req);
+  }
+}
+
+void SmsHandlerThreadInit(void) {
+  chFifoObjectInit(&requests, sizeof(SmsRequest_t), REQUEST_QUEUE_SIZE,
+                   sizeof(void *), requestBuffer, requestMessages);
+  chMtxObjectInit(&sessionLock);
+  running = false;
+  memset(&stats, 0, sizeof(stats));
+  sim8xxAddUrcHook(&SIM8D1, SIM8XX_URC_CMTI | SIM8XX_URC_CLIP, urcHook);
+}
+
+/*
+ * The modem is powered on when riding starts, messages stored while it was
+ * off are answered first.
+ */
+void SmsHandlerStart(void) {
+  running = true;
+  queueScan();
+}
+
+void SmsHandlerAlert(const char *text) {
+  SmsRequest_t *req = chFifoTakeObjectTimeout(&requests, TIME_IMMEDIATE);
+  if (NULL == req) {
+    stats.dropped++;
+    return;
+  }
+
+  memset(req, 0, sizeof(*req));
+  req->kind = SMS_REQUEST_ALERT;
+  strncpy(req->text, text, sizeof(req->text) - 1);
+  req->arrived = chVTGetSystemTime();
+  chFifoSendObject(&requests, req);
+}
+
+/*
+ * Waits for the request in progress, the modem is powered down afterwards.
+ */
+void SmsHandlerStop(void) {
+  running = false;
+  chMtxLock(&sessionLock);
+  chMtxUnlock(&sessionLock);
+}
+
+void SmsHandlerCmdSms(BaseSequentialStream *chp, int argc, char *argv[]) {
+  if ((argc > 1) || ((1 == argc) && strcmp(argv[0], "test"))) {
+    chprintf(chp, "Usage: sms [test]\r\n");
+    return;
+  }
+
+  /* The reply buffer belongs to the handler thread. */
+  if (1 == argc) {
+    char text[REPLY_SIZE + 1];
+    formatLocation(text, REPLY_SIZE, 0);
+    chprintf(chp, "%s\r\n", text);
+    return;
+  }
+
+  chprintf(chp, "messages %lu, calls %lu, alerts %lu, replies %lu\r\n",
+           stats.messages, stats.calls, stats.alerts, stats.replies);
+  chprintf(chp, "rejected %lu, failures %lu, dropped %lu\r\n",
+           stats.rejected, stats.failures, stats.dropped);
+  if (stats.replies > 0U) {
+    chprintf(chp, "latency min %lu ms, avg %lu ms, max %lu ms\r\n",
+             stats.latencyMin, stats.latencySum / stats.replies,
+             stats.latencyMax);
+    chprintf(chp, "last queue %lu ms, read %lu ms, send %lu ms\r\n",
+             stats.lastQueue, stats.lastRead, stats.lastSend);
+  }
+}
+
+/****************************** END OF FILE **********************************/
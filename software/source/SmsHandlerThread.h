@@ -0,0 +1,48 @@
+/**
+ * @file SmsHandlerThread.h
+ * @brief Location queries by SMS and by calls from known numbers.
+ */
+
+#ifndef SMS_HANDLER_THREAD_H
+#define SMS_HANDLER_THREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(SmsHandlerThread, arg);
+void SmsHandlerThreadInit(void);
+void SmsHandlerStart(void);
+void SmsHandlerStop(void);
+
+/**
+ * @brief Queue a message with the location to the first whitelisted number.
+ * @note  Dropped while the modem is off, and if the whitelist is empty.
+ */
+void SmsHandlerAlert(const char *text);
+void SmsHandlerCmdSms(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* SMS_HANDLER_THREAD_H */
+
+/******************************* END OF FILE ***********************************/
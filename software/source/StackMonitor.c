@@ -0,0 +1,132 @@
+/**
+ * @file StackMonitor.c
+ * @brief Stack high-water-mark measurement of the threads.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "StackMonitor.h"
+#include "StackSizing.h"
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  const char *name;
+  size_t size;
+  size_t peak;
+} StackUsage_t;
+
+typedef void (*StackVisitor_t)(const StackUsage_t *usage, void *arg);
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#if CH_DBG_FILL_THREADS != TRUE
+#error "StackMonitor requires CH_DBG_FILL_THREADS"
+#endif
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+extern uint8_t __main_stack_base__;
+extern uint8_t __main_stack_end__;
+extern uint8_t __main_thread_stack_base__;
+extern uint8_t __main_thread_stack_end__;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static size_t peakUsage(const uint8_t *base, const uint8_t *end) {
+  return ssPeakUsage(base, end, CH_DBG_STACK_FILL_VALUE);
+}
+
+/*
+ * The thread structure sits on top of the working area, except for the main
+ * thread that runs on the process stack reserved by the linker script. Its
+ * wabase is only set with CH_DBG_ENABLE_STACK_CHECK, so it is recognised by
+ * its thread structure.
+ */
+static void forEachStack(StackVisitor_t visitor, void *arg) {
+  StackUsage_t usage;
+
+  usage.name = "irq";
+  usage.size = &__main_stack_end__ - &__main_stack_base__;
+  usage.peak = peakUsage(&__main_stack_base__, &__main_stack_end__);
+  visitor(&usage, arg);
+
+  thread_t *tp = chRegFirstThread();
+  while (tp) {
+    const uint8_t *base = (const uint8_t *)tp->wabase;
+    const uint8_t *end = (const uint8_t *)tp;
+    if (tp == &ch.mainthread) {
+      base = &__main_thread_stack_base__;
+      end = &__main_thread_stack_end__;
+    }
+
+    usage.name = chRegGetThreadNameX(tp);
+    usage.size = end - base;
+    usage.peak = peakUsage(base, end);
+    visitor(&usage, arg);
+
+    tp = chRegNextThread(tp);
+  }
+}
+
+static void printUsage(const StackUsage_t *usage, void *arg) {
+  BaseSequentialStream *chp = (BaseSequentialStream *)arg;
+  chprintf(chp, "%-12s %6u %6u %3u%% %6u\r\n",
+           usage->name ? usage->name : "?",
+           usage->size, usage->peak,
+           usage->size ? (100U * usage->peak) / usage->size : 0U,
+           ssRecommendedSize(usage->peak));
+}
+
+static void saveUsage(const StackUsage_t *usage, void *arg) {
+  FIL *log = (FIL *)arg;
+  char buf[64];
+  chsnprintf(buf, sizeof(buf), "%lu %s %u %u\n",
+             (uint32_t)TIME_I2MS(chVTGetSystemTimeX()),
+             usage->name ? usage->name : "?", usage->size, usage->peak);
+  UINT bw = 0;
+  f_write(log, buf, strlen(buf), &bw);
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void smSaveStacks(void) {
+  FIL log;
+  if (FR_OK == f_open(&log, "/stacks.log", FA_OPEN_APPEND | FA_WRITE)) {
+    forEachStack(saveUsage, &log);
+    f_close(&log);
+  }
+}
+
+void smCmdStacks(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+
+  if (argc > 0) {
+    chprintf(chp, "Usage: stacks\r\n");
+    return;
+  }
+
+  chprintf(chp, "%-12s %6s %6s %4s %6s\r\n", "thread", "size", "peak", "use",
+           "advice");
+  forEachStack(printUsage, chp);
+}
+
+/****************************** END OF FILE **********************************/
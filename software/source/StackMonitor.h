@@ -0,0 +1,43 @@
+/**
+ * @file StackMonitor.h
+ * @brief Stack high-water-mark measurement of the threads.
+ */
+
+#ifndef STACK_MONITOR_H
+#define STACK_MONITOR_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Append the peak stack usage of every thread to /stacks.log.
+ */
+void smSaveStacks(void);
+
+void smCmdStacks(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* STACK_MONITOR_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,50 @@
+/**
+ * @file StackSizing.c
+ * @brief High-water-mark scan and stack size advice.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "StackSizing.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+size_t ssPeakUsage(const uint8_t *base, const uint8_t *end, uint8_t fill) {
+  const uint8_t *p = base;
+  while ((p < end) && (fill == *p))
+    ++p;
+  return (size_t)(end - p);
+}
+
+size_t ssRecommendedSize(size_t peak) {
+  size_t size = peak + peak / 4 + SS_RESERVE_IN_BYTES;
+  return (size + SS_ALIGN_IN_BYTES - 1) & ~(size_t)(SS_ALIGN_IN_BYTES - 1);
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,53 @@
+/**
+ * @file StackSizing.h
+ * @brief High-water-mark scan and stack size advice.
+ * @note  No OS dependency, tools/stack_check.c runs it on the host.
+ */
+
+#ifndef STACK_SIZING_H
+#define STACK_SIZING_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/*
+ * The recommended size is the peak plus 25% and a fixed reserve for the
+ * interrupt frames, rounded up to the stack alignment.
+ */
+#define SS_RESERVE_IN_BYTES         128
+#define SS_ALIGN_IN_BYTES           8
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Bytes used of a descending stack from base to end that was filled
+ *        with the fill value.
+ * @note  A used byte that happens to equal the fill value at the deepest
+ *        point is counted as free.
+ */
+size_t ssPeakUsage(const uint8_t *base, const uint8_t *end, uint8_t fill);
+
+size_t ssRecommendedSize(size_t peak);
+
+#endif /* STACK_SIZING_H */
+
+/****************************** END OF FILE **********************************/
@@ -8,8 +8,25 @@
 /*******************************************************************************/
 #include "SystemThread.h"
 #include "GpsReaderThread.h"
+#include "UploaderThread.h"
+#include "LiveTrackerThread.h"
+#include "NetworkMonitorThread.h"
+#include "SmsHandlerThread.h"
+#include "FirmwareUpdateThread.h"
+#include "GeofenceThread.h"
+#include "FusionThread.h"
+#include "TripLog.h"
+#include "BoardMonitorThread.h"
+#include "BootProfiler.h"
 #include "Dashboard.h"
+#include "PowerManager.h"
+#include "Bearer.h"
+#include "LatencyProbe.h"
+#include "TraceRecorder.h"
+#include "Sdcard.h"
+#include "Lis3dsh.h"
 #include "sim8xx.h"
+#include "gtrackconf.h"
 #include <string.h>
 
 /*******************************************************************************/
@@ -44,30 +61,110 @@ mailbox_t systemMailbox;
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
 /*******************************************************************************/
 static void connectModem(void) {
-  while(!sim8xxIsConnected(&SIM8D1)) {
-    sim8xxTogglePower(&SIM8D1);
-  }
+  sim8xxPowerOn(&SIM8D1);
+  bpMark(BP_MODEM_READY);
 }
 
 static void disconnectModem(void) {
-  while(sim8xxIsConnected(&SIM8D1)) {
-    sim8xxTogglePower(&SIM8D1);
+  if (!sim8xxPowerOff(&SIM8D1))
+    trFault("modem");
+}
+
+/*
+ * The modem may have been powered up at boot already, its latency still
+ * counts from the ignition event. GNSS, SMS and the fences keep running if
+ * motion started them while parked.
+ */
+static SystemState_t startRiding(bool watching) {
+  time_measurement_t tm;
+  BoardMonitorGetPowerOnTime(&tm);
+  connectModem();
+  lpStop(LP_MODEM_READY, &tm);
+  if (!watching)
+    GpsReaderStart();
+  FusionStart();
+  NetworkMonitorStart();
+  if (!watching) {
+    SmsHandlerStart();
+    GeofenceStart();
   }
+  UploaderStart();
+  LiveTrackerStart();
+  pmSetState(PM_STATE_RIDING);
+  pmRunning();
+  return SYSTEM_RIDING;
+}
+
+static SystemState_t startParking(void) {
+  LiveTrackerStop();
+  UploaderStop();
+  GeofenceStop();
+  SmsHandlerStop();
+  FirmwareUpdateStop();
+  NetworkMonitorStop();
+  FusionStop();
+  GpsReaderStop();
+  tlFinish();
+  lpSave();
+  disconnectModem();
+  pmSetState(PM_STATE_PARKED);
+  return SYSTEM_PARKING;
+}
+
+/*
+ * Motion without ignition, the vehicle may be towed or stolen. GNSS feeds
+ * the fences, so leaving one sends its alert while parked. The latched
+ * motion interrupt is released, further motion extends the watch.
+ */
+static SystemState_t startWatching(void) {
+  lisAckMotion();
+  connectModem();
+  GpsReaderStart();
+  SmsHandlerStart();
+  GeofenceStart();
+  pmSetState(PM_STATE_RIDING);
+  pmRunning();
+  return SYSTEM_TRACKING;
+}
+
+static SystemState_t stopWatching(void) {
+  GeofenceStop();
+  SmsHandlerStop();
+  GpsReaderStop();
+  disconnectModem();
+  pmSetState(PM_STATE_PARKED);
+  return SYSTEM_PARKING;
+}
+
+/*
+ * Modem and GNSS are already powered down, the SD card is released before
+ * the MCU stops and mounted again after wake-up. A motion interrupt latched
+ * since parking is released, so the next motion is an edge again.
+ */
+static void systemSleep(void) {
+  if (!pmCanSleep())
+    return;
+
+  bool mounted = sdcardIsMounted();
+  if (mounted)
+    sdcardUnmount();
+
+  lisAckMotion();
+  pmSleep();
+
+  if (mounted)
+    sdcardMount();
 }
 
 static SystemState_t systemInitHandler(SystemEvent_t evt) {
   SystemState_t newState = SYSTEM_INIT;
   switch(evt) {
     case SYS_EVT_IGNITION_ON: {
-      connectModem();
-      GpsReaderStart();
-      newState = SYSTEM_RIDING;
+      newState = startRiding(false);
       break;
     }
     case SYS_EVT_IGNITION_OFF: {
-      GpsReaderStop();
-      disconnectModem();
-      newState = SYSTEM_PARKING;
+      newState = startParking();
       break;
     }
     default: {
@@ -78,18 +175,53 @@ static SystemState_t systemInitHandler(SystemEvent_t evt) {
 }
 
 static SystemState_t systemParkingHandler(SystemEvent_t evt) {
-  (void)evt;
-  return SYSTEM_PARKING;
+  SystemState_t newState = SYSTEM_PARKING;
+  switch(evt) {
+    case SYS_EVT_IGNITION_ON: {
+      newState = startRiding(false);
+      break;
+    }
+    case SYS_EVT_MOTION: {
+      newState = startWatching();
+      break;
+    }
+    default: {
+      ;
+    }
+  }
+  return newState;
 }
 
 static SystemState_t systemRidingHandler(SystemEvent_t evt) {
-  (void)evt;
-  return SYSTEM_RIDING;
+  SystemState_t newState = SYSTEM_RIDING;
+  switch(evt) {
+    case SYS_EVT_IGNITION_OFF: {
+      newState = startParking();
+      break;
+    }
+    default: {
+      ;
+    }
+  }
+  return newState;
 }
 
 static SystemState_t systemTrackingHandler(SystemEvent_t evt) {
-  (void)evt;
-  return SYSTEM_TRACKING;
+  SystemState_t newState = SYSTEM_TRACKING;
+  switch(evt) {
+    case SYS_EVT_IGNITION_ON: {
+      newState = startRiding(true);
+      break;
+    }
+    case SYS_EVT_MOTION: {
+      lisAckMotion();
+      break;
+    }
+    default: {
+      ;
+    }
+  }
+  return newState;
 }
 
 /*******************************************************************************/
@@ -101,9 +233,25 @@ THD_FUNCTION(SystemThread, arg) {
 
   static SystemState_t state = SYSTEM_INIT;
 
+  /* Power up the modem while the SD card is mounted and USB enumerates, the
+     ignition event finds it ready. */
+  if (GTRACK_BOOT_EARLY_MODEM && BoardMonitorIsIgnitionOn())
+    connectModem();
+
   while(true) {
     SystemEvent_t evt;
-    if (MSG_OK == chMBFetchTimeout(&systemMailbox, (msg_t*)&evt, TIME_INFINITE)) {
+    sysinterval_t timeout = TIME_INFINITE;
+    if (SYSTEM_PARKING == state)
+      timeout = TIME_MS2I(PP_PARKING_GRACE_TIME_IN_MS);
+    else if (SYSTEM_TRACKING == state)
+      timeout = TIME_MS2I(GTRACK_MOTION_WATCH_TIME_IN_MS);
+    msg_t msg = chMBFetchTimeout(&systemMailbox, (msg_t*)&evt, timeout);
+    if ((MSG_TIMEOUT == msg) && (SYSTEM_TRACKING == state)) {
+      state = stopWatching();
+    } else if (MSG_TIMEOUT == msg) {
+      systemSleep();
+    } else if (MSG_OK == msg) {
+      trEvent(TR_EVT_SYSTEM_EVENT, evt);
       switch(state) {
         case SYSTEM_INIT: {
           state = systemInitHandler(evt);
@@ -131,6 +279,8 @@ THD_FUNCTION(SystemThread, arg) {
 
 void SystemThreadInit(void) {
     dbInit();
+    pmInit();
+    brInit();
     memset(&events, 0, sizeof(events));
     chMBObjectInit(&systemMailbox, events, sizeof(events)/sizeof(events[0]));
 }
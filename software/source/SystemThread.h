@@ -24,7 +24,8 @@
 /*******************************************************************************/
 typedef enum {
   SYS_EVT_IGNITION_ON,
-  SYS_EVT_IGNITION_OFF
+  SYS_EVT_IGNITION_OFF,
+  SYS_EVT_MOTION
 } SystemEvent_t;
 
 /*******************************************************************************/
@@ -0,0 +1,226 @@
+/**
+ * @file TelemetryCodec.c
+ * @brief Compact binary packets of position fixes for the uplink.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "TelemetryCodec.h"
+#include "PositionHistory.h"
+#include "chprintf.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define COUNT_OFFSET                4
+#define VARINT_MAX_SIZE             5
+#define BENCH_PACKET_SIZE           1400
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  TelemetryEncoder_t enc;
+  uint32_t fixes;
+  uint32_t packets;
+  uint32_t bytes;
+  uint32_t cycles;
+} CodecBench_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static uint8_t benchPacket[BENCH_PACKET_SIZE];
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static size_t putVarint(uint8_t *p, uint32_t value) {
+  size_t n = 0;
+  while (value >= 0x80U) {
+    p[n++] = (uint8_t)(value | 0x80U);
+    value >>= 7;
+  }
+  p[n++] = (uint8_t)value;
+  return n;
+}
+
+/*
+ * Small deltas of either sign become small unsigned numbers.
+ */
+static size_t putZigZag(uint8_t *p, int32_t value) {
+  return putVarint(p, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+/*
+ * Deltas are computed in 32 bit two's complement, wrap-around is undone by
+ * the decoder the same way.
+ */
+static size_t putDelta(uint8_t *p, uint32_t value, uint32_t last) {
+  return putZigZag(p, (int32_t)(value - last));
+}
+
+static size_t encodeFix(uint8_t *p, uint8_t fields, const FixRecord_t *rec,
+                        const FixRecord_t *last) {
+  size_t n = 0;
+  if (last) {
+    n += putDelta(p + n, rec->time, last->time);
+    n += putDelta(p + n, (uint32_t)rec->latitude, (uint32_t)last->latitude);
+    n += putDelta(p + n, (uint32_t)rec->longitude,
+                  (uint32_t)last->longitude);
+    if (fields & TC_FIELD_ALTITUDE)
+      n += putZigZag(p + n, rec->altitude - last->altitude);
+    if (fields & TC_FIELD_SPEED)
+      n += putZigZag(p + n, rec->speed - last->speed);
+  } else {
+    n += putVarint(p + n, rec->time);
+    n += putZigZag(p + n, rec->latitude);
+    n += putZigZag(p + n, rec->longitude);
+    if (fields & TC_FIELD_ALTITUDE)
+      n += putZigZag(p + n, rec->altitude);
+    if (fields & TC_FIELD_SPEED)
+      n += putVarint(p + n, rec->speed);
+  }
+  return n;
+}
+
+static bool benchVisitor(const FixRecord_t *rec, void *arg) {
+  CodecBench_t *bench = (CodecBench_t *)arg;
+  const TelemetryHeader_t header = {TC_FIELD_ALTITUDE | TC_FIELD_SPEED,
+                                    bench->packets, 0, 0};
+
+  rtcnt_t start = chSysGetRealtimeCounterX();
+  if (!tcEncoderAdd(&bench->enc, rec)) {
+    bench->bytes += tcEncoderFinish(&bench->enc);
+    bench->packets++;
+    tcEncoderInit(&bench->enc, benchPacket, sizeof(benchPacket), &header);
+    tcEncoderAdd(&bench->enc, rec);
+  }
+  bench->cycles += chSysGetRealtimeCounterX() - start;
+  bench->fixes++;
+
+  return true;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+/*
+ * 'G', 'P', version, field bitmap, fix count, then the varint sequence and
+ * the optional header fields.
+ */
+bool tcEncoderInit(TelemetryEncoder_t *enc, uint8_t *buf, size_t size,
+                   const TelemetryHeader_t *header) {
+  memset(enc, 0, sizeof(*enc));
+  if (size < TC_MAX_HEADER_SIZE + TC_CRC_SIZE)
+    return false;
+
+  enc->buf = buf;
+  enc->size = size;
+  enc->fields = header->fields;
+
+  buf[0] = TC_MAGIC_0;
+  buf[1] = TC_MAGIC_1;
+  buf[2] = TC_VERSION;
+  buf[3] = header->fields;
+  buf[COUNT_OFFSET] = 0;
+  enc->length = COUNT_OFFSET + 1;
+  enc->length += putVarint(buf + enc->length, header->sequence);
+  if (header->fields & TC_FIELD_SOURCE)
+    buf[enc->length++] = header->source;
+  if (header->fields & TC_FIELD_AGE)
+    enc->length += putVarint(buf + enc->length, header->age);
+
+  return true;
+}
+
+bool tcEncoderAdd(TelemetryEncoder_t *enc, const FixRecord_t *rec) {
+  uint8_t fix[TC_MAX_FIX_SIZE];
+
+  if (!enc->buf || (TC_MAX_FIXES == enc->count))
+    return false;
+
+  size_t n = encodeFix(fix, enc->fields, rec,
+                       enc->count ? &enc->last : NULL);
+  if (enc->length + n + TC_CRC_SIZE > enc->size)
+    return false;
+
+  memcpy(enc->buf + enc->length, fix, n);
+  enc->length += n;
+  enc->last = *rec;
+  enc->count++;
+  return true;
+}
+
+size_t tcEncoderFinish(TelemetryEncoder_t *enc) {
+  if (!enc->buf)
+    return 0;
+
+  enc->buf[COUNT_OFFSET] = enc->count;
+  uint16_t crc = tcCrc16(enc->buf, enc->length);
+  enc->buf[enc->length++] = (uint8_t)crc;
+  enc->buf[enc->length++] = (uint8_t)(crc >> 8);
+  return enc->length;
+}
+
+uint16_t tcCrc16(const uint8_t *data, size_t length) {
+  uint16_t crc = 0xFFFFU;
+  while (length--) {
+    crc ^= (uint16_t)(*data++ << 8);
+    int i;
+    for (i = 0; i < 8; ++i)
+      crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U)
+                            : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+/*
+ * Encode the fixes of the position history in upload sized packets, the
+ * cycles include the packet changes but not the history access.
+ */
+void tcCmdCodec(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+
+  if (argc > 0) {
+    chprintf(chp, "Usage: codec\r\n");
+    return;
+  }
+
+  static CodecBench_t bench;
+  const TelemetryHeader_t header = {TC_FIELD_ALTITUDE | TC_FIELD_SPEED, 0, 0,
+                                    0};
+  memset(&bench, 0, sizeof(bench));
+  tcEncoderInit(&bench.enc, benchPacket, sizeof(benchPacket), &header);
+  phForEach(0, UINT32_MAX, benchVisitor, &bench);
+  if (bench.enc.count > 0) {
+    bench.bytes += tcEncoderFinish(&bench.enc);
+    bench.packets++;
+  }
+
+  if (0U == bench.fixes) {
+    chprintf(chp, "position history is empty\r\n");
+    return;
+  }
+
+  uint32_t centiBytes = (bench.bytes * 100U) / bench.fixes;
+  chprintf(chp, "%lu fixes in %lu packets, %lu bytes\r\n", bench.fixes,
+           bench.packets, bench.bytes);
+  chprintf(chp, "%lu.%02lu bytes/fix (raw %u), %lu cycles/fix\r\n",
+           centiBytes / 100U, centiBytes % 100U,
+           (unsigned)sizeof(FixRecord_t),
+           bench.cycles / bench.fixes);
+}
+
+/****************************** END OF FILE **********************************/
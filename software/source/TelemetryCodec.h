@@ -0,0 +1,101 @@
+/**
+ * @file TelemetryCodec.h
+ * @brief Compact binary packets of position fixes for the uplink.
+ */
+
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "FixRecord.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define TC_MAGIC_0                  'G'
+#define TC_MAGIC_1                  'P'
+#define TC_VERSION                  1
+
+/**
+ * @brief Optional fields of a packet, the bitmap is sent in the header.
+ */
+#define TC_FIELD_ALTITUDE           (1U << 0)   /**< Per fix.              */
+#define TC_FIELD_SPEED              (1U << 1)   /**< Per fix.              */
+#define TC_FIELD_SOURCE             (1U << 2)   /**< Once, in the header.  */
+#define TC_FIELD_AGE                (1U << 3)   /**< Once, in the header.  */
+
+/**
+ * @brief Worst case sizes of the header and of a single fix.
+ */
+#define TC_MAX_HEADER_SIZE          14
+#define TC_MAX_FIX_SIZE             21
+#define TC_CRC_SIZE                 2
+#define TC_MAX_FIXES                255
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  uint8_t fields;      /**< TC_FIELD_* bitmap.                              */
+  uint32_t sequence;   /**< Packet counter of the sender.                   */
+  uint8_t source;      /**< PositionSource_t, with TC_FIELD_SOURCE.         */
+  uint16_t age;        /**< Age of the newest fix in 100 ms, TC_FIELD_AGE.  */
+} TelemetryHeader_t;
+
+/**
+ * @brief Encoder state, the packet is built in the buffer of the caller.
+ */
+typedef struct {
+  uint8_t *buf;
+  size_t size;
+  size_t length;
+  uint8_t fields;
+  uint8_t count;
+  FixRecord_t last;
+} TelemetryEncoder_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Start a packet in buf.
+ * @return False if buf cannot hold the header and the CRC.
+ */
+bool tcEncoderInit(TelemetryEncoder_t *enc, uint8_t *buf, size_t size,
+                   const TelemetryHeader_t *header);
+
+/**
+ * @brief Append a fix, the first one is the keyframe, the others are
+ *        deltas to the previous fix.
+ * @return False if the fix does not fit, the packet is left unchanged.
+ */
+bool tcEncoderAdd(TelemetryEncoder_t *enc, const FixRecord_t *rec);
+
+/**
+ * @brief Close the packet with the CRC.
+ * @return Length of the packet in bytes.
+ */
+size_t tcEncoderFinish(TelemetryEncoder_t *enc);
+
+/**
+ * @brief CRC-16/CCITT-FALSE.
+ */
+uint16_t tcCrc16(const uint8_t *data, size_t length);
+
+void tcCmdCodec(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* TELEMETRY_CODEC_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,190 @@
+/**
+ * @file TraceRecorder.c
+ * @brief Export of the kernel trace buffer for post-mortem analysis.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "TraceRecorder.h"
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define LINE_LENGTH                 80
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef void (*TraceSink_t)(const char *line, void *arg);
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+event_source_t trFaultEvent;
+
+#if TR_ENABLED
+static const char *faultReason;
+#endif
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+#if TR_ENABLED
+static void formatRecord(char *line, size_t size,
+                         const ch_trace_event_t *tep) {
+  switch (tep->type) {
+    case CH_TRACE_TYPE_SWITCH:
+      chsnprintf(line, size, "S %lu %lu %08lx %08lx %u",
+                 (uint32_t)tep->time, (uint32_t)tep->rtstamp,
+                 (uint32_t)(uintptr_t)tep->u.sw.ntp,
+                 (uint32_t)(uintptr_t)tep->u.sw.wtobjp,
+                 (unsigned)tep->state);
+      break;
+    case CH_TRACE_TYPE_ISR_ENTER:
+    case CH_TRACE_TYPE_ISR_LEAVE:
+      chsnprintf(line, size, "%c %lu %lu %s",
+                 (CH_TRACE_TYPE_ISR_ENTER == tep->type) ? 'I' : 'L',
+                 (uint32_t)tep->time, (uint32_t)tep->rtstamp,
+                 tep->u.isr.name);
+      break;
+    case CH_TRACE_TYPE_HALT:
+      chsnprintf(line, size, "H %lu %lu %s", (uint32_t)tep->time,
+                 (uint32_t)tep->rtstamp, tep->u.halt.reason);
+      break;
+    case CH_TRACE_TYPE_USER:
+      chsnprintf(line, size, "U %lu %lu %lu %lu",
+                 (uint32_t)tep->time, (uint32_t)tep->rtstamp,
+                 (uint32_t)(uintptr_t)tep->u.user.up1,
+                 (uint32_t)(uintptr_t)tep->u.user.up2);
+      break;
+    default:
+      line[0] = '\0';
+  }
+}
+
+/*
+ * The recording must be suspended, records are emitted from the oldest one.
+ * The thread table lets the host tool resolve the switched in threads.
+ */
+static void exportTrace(const char *reason, TraceSink_t sink, void *arg) {
+  char line[LINE_LENGTH];
+
+  chsnprintf(line, sizeof(line), "# %s %lu %lu %lu", reason,
+             (uint32_t)chVTGetSystemTime(), (uint32_t)CH_CFG_ST_FREQUENCY,
+             (uint32_t)STM32_HCLK);
+  sink(line, arg);
+
+  thread_t *tp = chRegFirstThread();
+  while (tp) {
+    const char *name = chRegGetThreadNameX(tp);
+    chsnprintf(line, sizeof(line), "T %08lx %s", (uint32_t)(uintptr_t)tp,
+               name ? name : "?");
+    sink(line, arg);
+    tp = chRegNextThread(tp);
+  }
+
+  const ch_trace_event_t *begin = &ch.dbg.trace_buffer.buffer[0];
+  const ch_trace_event_t *end = begin + CH_DBG_TRACE_BUFFER_SIZE;
+  const ch_trace_event_t *tep = ch.dbg.trace_buffer.ptr;
+  do {
+    formatRecord(line, sizeof(line), tep);
+    if (line[0])
+      sink(line, arg);
+    if (++tep >= end)
+      tep = begin;
+  } while (tep != ch.dbg.trace_buffer.ptr);
+}
+
+static void clearTrace(void) {
+  chSysLock();
+  memset(ch.dbg.trace_buffer.buffer, 0, sizeof(ch.dbg.trace_buffer.buffer));
+  ch.dbg.trace_buffer.ptr = &ch.dbg.trace_buffer.buffer[0];
+  chSysUnlock();
+}
+
+static void fileSink(const char *text, void *arg) {
+  UINT bw = 0;
+  f_write((FIL *)arg, text, strlen(text), &bw);
+  f_write((FIL *)arg, "\n", 1, &bw);
+}
+
+static void streamSink(const char *text, void *arg) {
+  chprintf((BaseSequentialStream *)arg, "%s\r\n", text);
+}
+#endif
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void trInit(void) {
+  chEvtObjectInit(&trFaultEvent);
+}
+
+void trFault(const char *reason) {
+#if TR_ENABLED
+  chSysLock();
+  if (NULL == faultReason) {
+    faultReason = reason;
+    chDbgWriteTraceI((void *)TR_EVT_FAULT, (void *)reason);
+    chDbgSuspendTraceI(CH_DBG_TRACE_MASK_ALL);
+    chEvtBroadcastI(&trFaultEvent);
+    chSchRescheduleS();
+  }
+  chSysUnlock();
+#else
+  (void)reason;
+#endif
+}
+
+void trSave(void) {
+#if TR_ENABLED
+  FIL log;
+
+  chDbgSuspendTrace(CH_DBG_TRACE_MASK_ALL);
+  if (FR_OK == f_open(&log, "/trace.log", FA_OPEN_APPEND | FA_WRITE)) {
+    exportTrace(faultReason ? faultReason : "periodic", fileSink, &log);
+    f_close(&log);
+  }
+  clearTrace();
+
+  chSysLock();
+  faultReason = NULL;
+  chDbgResumeTraceI(CH_DBG_TRACE_MASK_ALL);
+  chSysUnlock();
+#endif
+}
+
+void trCmdTrace(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+
+  if (argc > 0) {
+    chprintf(chp, "Usage: trace\r\n");
+    return;
+  }
+
+#if TR_ENABLED
+  chDbgSuspendTrace(CH_DBG_TRACE_MASK_ALL);
+  exportTrace("shell", streamSink, chp);
+  chSysLock();
+  if (NULL == faultReason)
+    chDbgResumeTraceI(CH_DBG_TRACE_MASK_ALL);
+  chSysUnlock();
+#else
+  chprintf(chp, "Trace buffer disabled, build with USE_TRACE=yes\r\n");
+#endif
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,79 @@
+/**
+ * @file TraceRecorder.h
+ * @brief Export of the kernel trace buffer for post-mortem analysis.
+ *
+ * Tracing is opt-in, build with USE_TRACE=yes to enable the trace buffer.
+ * The records are written to /trace.log, tools/trace2json.py converts them
+ * into a Chrome/Perfetto timeline.
+ */
+
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define TR_ENABLED              (CH_DBG_TRACE_MASK != CH_DBG_TRACE_MASK_DISABLED)
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Write an application event into the trace buffer.
+ */
+#define trEvent(id, arg)                                                     \
+  chDbgWriteTrace((void *)(uintptr_t)(id), (void *)(uintptr_t)(arg))
+
+#define trEventI(id, arg)                                                    \
+  chDbgWriteTraceI((void *)(uintptr_t)(id), (void *)(uintptr_t)(arg))
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief Application events, keep in sync with tools/trace2json.py.
+ */
+typedef enum {
+  TR_EVT_SYSTEM_EVENT = 1,
+  TR_EVT_MODEM_REQUEST,
+  TR_EVT_MODEM_RESPONSE,
+  TR_EVT_SD_WRITE_BEGIN,
+  TR_EVT_SD_WRITE_END,
+  TR_EVT_FAULT,
+  TR_EVT_GEOFENCE
+} TraceEvent_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+/**
+ * @brief Broadcast when a fault froze the trace buffer.
+ */
+extern event_source_t trFaultEvent;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void trInit(void);
+
+/**
+ * @brief Stop recording to keep the history of a fault and request a dump.
+ */
+void trFault(const char *reason);
+
+/**
+ * @brief Append the trace buffer to /trace.log, then clear and resume it.
+ */
+void trSave(void);
+
+void trCmdTrace(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* TRACE_RECORDER_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,181 @@
+/**
+ * @file TripLog.c
+ * @brief Statistics of the current trip, saved across power loss.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "TripLog.h"
+#include "TripStats.h"
+#include "gtrackconf.h"
+
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define TRIP_MAGIC                  0x54525031U
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+  uint32_t magic;
+  TripStats_t stats;
+} TripData_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static mutex_t lock;
+static TripStats_t trip;
+static bool loaded;
+static uint32_t savedAt;
+static uint32_t cycles;
+static uint32_t maxCycles;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static void save(void) {
+  TripData_t data;
+  data.magic = TRIP_MAGIC;
+  data.stats = trip;
+
+  FIL file;
+  if (FR_OK == f_open(&file, "/trip.dat", FA_CREATE_ALWAYS | FA_WRITE)) {
+    UINT bw = 0;
+    f_write(&file, &data, sizeof(data), &bw);
+    f_close(&file);
+  }
+  savedAt = trip.end;
+}
+
+/*
+ * The file only exists while a trip is open, a leftover is a trip cut by a
+ * power loss.
+ */
+static void load(void) {
+  TripData_t data;
+  FIL file;
+  UINT br = 0;
+
+  loaded = true;
+  tsInit(&trip);
+  if (FR_OK != f_open(&file, "/trip.dat", FA_OPEN_EXISTING | FA_READ))
+    return;
+  f_read(&file, &data, sizeof(data), &br);
+  f_close(&file);
+
+  if ((sizeof(data) == br) && (TRIP_MAGIC == data.magic))
+    trip = data.stats;
+  savedAt = trip.end;
+}
+
+/*
+ * start end distance[km] moving[s] average[km/h] max[km/h] gain[m] stops
+ */
+static void finish(void) {
+  if (trip.fixes > 1U) {
+    FIL log;
+    if (FR_OK == f_open(&log, "/trips.log", FA_OPEN_APPEND | FA_WRITE)) {
+      char buf[96];
+      uint16_t average = tsAverageSpeed(&trip);
+      chsnprintf(buf, sizeof(buf), "%lu %lu %lu.%02lu %lu %u.%02u %u.%02u "
+                 "%lu %lu\n", trip.start, trip.end, trip.distance / 100000U,
+                 (trip.distance / 1000U) % 100U, trip.movingTime,
+                 average / 100U, average % 100U, trip.maxSpeed / 100U,
+                 trip.maxSpeed % 100U, trip.elevationGain, trip.stops);
+      UINT bw = 0;
+      f_write(&log, buf, strlen(buf), &bw);
+      f_close(&log);
+    }
+  }
+  f_unlink("/trip.dat");
+  tsInit(&trip);
+  savedAt = 0;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void tlInit(void) {
+  chMtxObjectInit(&lock);
+  tsInit(&trip);
+  loaded = false;
+}
+
+void tlAppend(const FixRecord_t *rec) {
+  TsFix_t fix = {rec->time, rec->latitude, rec->longitude, rec->altitude,
+                 rec->speed};
+
+  chMtxLock(&lock);
+  if (!loaded)
+    load();
+  if ((0U != trip.fixes) &&
+      (fix.time > trip.end + GTRACK_TRIP_RESUME_GAP_IN_S))
+    finish();
+
+  rtcnt_t start = chSysGetRealtimeCounterX();
+  tsUpdate(&trip, &fix);
+  uint32_t elapsed = chSysGetRealtimeCounterX() - start;
+  cycles += elapsed;
+  if (elapsed > maxCycles)
+    maxCycles = elapsed;
+
+  if (trip.end >= savedAt + GTRACK_TRIP_SAVE_PERIOD_IN_S)
+    save();
+  chMtxUnlock(&lock);
+}
+
+void tlFinish(void) {
+  chMtxLock(&lock);
+  if (!loaded)
+    load();
+  finish();
+  chMtxUnlock(&lock);
+}
+
+void tlCmdTrip(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+
+  if (argc > 0) {
+    chprintf(chp, "Usage: trip\r\n");
+    return;
+  }
+
+  chMtxLock(&lock);
+  TripStats_t ts = trip;
+  uint32_t total = cycles;
+  uint32_t max = maxCycles;
+  chMtxUnlock(&lock);
+
+  uint16_t average = tsAverageSpeed(&ts);
+  chprintf(chp, "distance %lu.%03lu km, moving %lu:%02lu:%02lu\r\n",
+           ts.distance / 100000U, (ts.distance / 100U) % 1000U,
+           ts.movingTime / 3600U, (ts.movingTime / 60U) % 60U,
+           ts.movingTime % 60U);
+  chprintf(chp, "average %u.%02u km/h, max %u.%02u km/h\r\n",
+           average / 100U, average % 100U, ts.maxSpeed / 100U,
+           ts.maxSpeed % 100U);
+  chprintf(chp, "elevation gain %lu m, stops %lu\r\n", ts.elevationGain,
+           ts.stops);
+  chprintf(chp, "fixes %lu, rejected %lu", ts.fixes, ts.rejected);
+  if (ts.fixes > 0U)
+    chprintf(chp, ", %lu cycles/fix, max %lu", total / ts.fixes, max);
+  chprintf(chp, "\r\n");
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,52 @@
+/**
+ * @file TripLog.h
+ * @brief Statistics of the current trip, saved across power loss.
+ */
+
+#ifndef TRIP_LOG_H
+#define TRIP_LOG_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "FixRecord.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void tlInit(void);
+
+/**
+ * @brief Account a GNSS fix, the totals go to /trip.dat every
+ *        GTRACK_TRIP_SAVE_PERIOD_IN_S.
+ */
+void tlAppend(const FixRecord_t *rec);
+
+/**
+ * @brief Close the trip, its record is appended to /trips.log.
+ */
+void tlFinish(void);
+
+void tlCmdTrip(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* TRIP_LOG_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,119 @@
+/**
+ * @file TripStats.c
+ * @brief Running statistics of a ride, updated in constant time per fix.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "TripStats.h"
+#include "GeoMath.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static void climb(TripStats_t *ts, int16_t altitude) {
+  int32_t delta = (int32_t)altitude - ts->altitudeRef;
+
+  if (delta >= TS_CLIMB_THRESHOLD_IN_M) {
+    ts->elevationGain += (uint32_t)delta;
+    ts->altitudeRef = altitude;
+  } else if (delta <= -TS_CLIMB_THRESHOLD_IN_M) {
+    ts->altitudeRef = altitude;
+  }
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void tsInit(TripStats_t *ts) {
+  memset(ts, 0, sizeof(*ts));
+}
+
+/*
+ * A fix is compared with the last moving fix, not with the previous one, so
+ * the jitter of a standing receiver does not add up. A slow drift is counted
+ * once it leaves the jitter radius.
+ */
+bool tsUpdate(TripStats_t *ts, const TsFix_t *fix) {
+  if (0U == ts->fixes) {
+    ts->start = ts->end = fix->time;
+    ts->anchor = *fix;
+    ts->lastMove = fix->time;
+    ts->altitudeRef = fix->altitude;
+    ts->fixes = 1;
+    return true;
+  }
+
+  if (fix->time <= ts->end) {
+    ts->rejected++;
+    return false;
+  }
+
+  /* The anchor of a long stop is old, a spike is measured against the time
+     since the last fix. */
+  uint32_t distance = tsDistance(&ts->anchor, fix);
+  uint32_t dt = fix->time - ts->end;
+  if ((fix->speed > TS_MAX_SPEED) ||
+      ((uint64_t)distance * 36U > (uint64_t)dt * TS_MAX_SPEED * 10U)) {
+    ts->rejected++;
+    return false;
+  }
+
+  ts->end = fix->time;
+  ts->fixes++;
+
+  if ((distance < TS_JITTER_RADIUS_IN_CM) && (fix->speed < TS_MOVING_SPEED)) {
+    if (!ts->stopped && (fix->time - ts->lastMove >= TS_STOP_MIN_TIME_IN_S)) {
+      ts->stopped = true;
+      ts->stops++;
+    }
+    return true;
+  }
+
+  ts->distance += distance;
+  ts->movingTime += dt;
+  ts->lastMove = fix->time;
+  ts->stopped = false;
+  if (fix->speed > ts->maxSpeed)
+    ts->maxSpeed = fix->speed;
+  climb(ts, fix->altitude);
+  ts->anchor = *fix;
+  return true;
+}
+
+uint32_t tsDistance(const TsFix_t *a, const TsFix_t *b) {
+  GmPoint_t pa = {a->lat, a->lon};
+  GmPoint_t pb = {b->lat, b->lon};
+  return gmDistance(&pa, &pb);
+}
+
+uint16_t tsAverageSpeed(const TripStats_t *ts) {
+  if (0U == ts->movingTime)
+    return 0;
+  return (uint16_t)((uint64_t)ts->distance * 36U / (10U * ts->movingTime));
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,120 @@
+/**
+ * @file TripStats.h
+ * @brief Running statistics of a ride, updated in constant time per fix.
+ * @note  No OS dependency, tools/tripstats_check.c builds it on the host
+ *        together with GeoMath.c.
+ */
+
+#ifndef TRIP_STATS_H
+#define TRIP_STATS_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief A fix closer than this to the last moving fix is jitter, unless the
+ *        receiver reports at least TS_MOVING_SPEED.
+ */
+#if !defined(TS_JITTER_RADIUS_IN_CM)
+#define TS_JITTER_RADIUS_IN_CM      1500U
+#endif
+
+#if !defined(TS_MOVING_SPEED)
+#define TS_MOVING_SPEED             400U    /**< 0.01 km/h.                */
+#endif
+
+/**
+ * @brief Fixes implying a higher speed than this are rejected as outliers.
+ */
+#if !defined(TS_MAX_SPEED)
+#define TS_MAX_SPEED                30000U  /**< 0.01 km/h.                */
+#endif
+
+/**
+ * @brief Standing still for this long counts as a stop.
+ */
+#if !defined(TS_STOP_MIN_TIME_IN_S)
+#define TS_STOP_MIN_TIME_IN_S       60U
+#endif
+
+/**
+ * @brief Altitude changes smaller than this are noise, only the climbs
+ *        beyond it add to the elevation gain.
+ */
+#if !defined(TS_CLIMB_THRESHOLD_IN_M)
+#define TS_CLIMB_THRESHOLD_IN_M     5
+#endif
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+/**
+ * @brief Fix in the units of FixRecord_t.
+ */
+typedef struct {
+  uint32_t time;       /**< Seconds since epoch.                           */
+  int32_t lat;         /**< 1e-7 degrees.                                  */
+  int32_t lon;
+  int16_t altitude;    /**< Meters.                                        */
+  uint16_t speed;      /**< 0.01 km/h.                                     */
+} TsFix_t;
+
+/**
+ * @brief Totals and filter state, a plain structure to be saved as is.
+ */
+typedef struct {
+  uint32_t start;      /**< Time of the first and the last fix.            */
+  uint32_t end;
+  uint32_t distance;   /**< Centimeters.                                   */
+  uint32_t movingTime; /**< Seconds.                                       */
+  uint32_t elevationGain; /**< Meters.                                     */
+  uint32_t stops;
+  uint16_t maxSpeed;   /**< 0.01 km/h.                                     */
+  uint32_t fixes;
+  uint32_t rejected;
+  TsFix_t anchor;      /**< Last moving fix.                               */
+  uint32_t lastMove;
+  int16_t altitudeRef; /**< Reference of the climb hysteresis.             */
+  bool stopped;
+} TripStats_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void tsInit(TripStats_t *ts);
+
+/**
+ * @brief Account a fix.
+ * @note  Fixes must arrive in increasing time order, others are rejected.
+ * @return False if the fix was rejected.
+ */
+bool tsUpdate(TripStats_t *ts, const TsFix_t *fix);
+
+/**
+ * @brief Distance of two fixes in centimeters, see gmDistance().
+ */
+uint32_t tsDistance(const TsFix_t *a, const TsFix_t *b);
+
+/**
+ * @brief Distance over moving time in 0.01 km/h, 0 before the first move.
+ */
+uint16_t tsAverageSpeed(const TripStats_t *ts);
+
+#endif /* TRIP_STATS_H */
+
+/****************************** END OF FILE **********************************/
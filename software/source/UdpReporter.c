@@ -0,0 +1,495 @@
+/**
+ * @file UdpReporter.c
+ * @brief Outbox upload in UDP datagrams with application level acks.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "UdpReporter.h"
+#include "Outbox.h"
+#include "TelemetryCodec.h"
+#include "Bearer.h"
+#include "gtrackconf.h"
+#include "sim8xx.h"
+#include "at.h"
+
+#include "chprintf.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+#define UDP_FIELDS                  (TC_FIELD_ALTITUDE | TC_FIELD_SPEED)
+
+#define CONNECT_TIMEOUT_IN_MS       10000
+#define SEND_TIMEOUT_IN_MS          10000
+
+/*
+ * Retransmission timeout, adapted to the measured round trip time. A
+ * datagram is sent at most MAX_TRIES times, then the socket is opened
+ * again in case the NAT binding of the operator changed.
+ */
+#define RTO_INITIAL_IN_MS           4000
+#define RTO_MIN_IN_MS               1000
+#define RTO_MAX_IN_MS               15000
+#define MAX_TRIES                   4
+
+#define IP_UDP_HEADER_SIZE          28
+#define EPOCH_FILE                  "/epoch.dat"
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  SLOT_FREE,
+  SLOT_SENT,
+  SLOT_ACKED
+} SlotState_t;
+
+/*
+ * A datagram in flight, it carries count fixes of the batch from first.
+ */
+typedef struct {
+  SlotState_t state;
+  uint32_t seq;
+  size_t first;
+  size_t count;
+  systime_t sentAt;
+  uint8_t tries;
+} Slot_t;
+
+typedef struct {
+  uint32_t datagrams;
+  uint32_t retransmits;
+  uint32_t records;
+  uint32_t airBytes;    /**< Sent, with IP/UDP headers and retransmits.    */
+  uint32_t fixBytes;    /**< Encoded fixes of the first transmissions.     */
+  uint32_t acks;
+  uint32_t ackBytes;
+  uint32_t reopens;
+  uint32_t rttSum;
+  uint32_t rttCount;
+  uint32_t rttMax;
+  uint32_t ageSum;      /**< Age of the fixes when acknowledged in s.      */
+  uint32_t ageMax;
+} UdpStats_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#define SEQ_BEFORE(a, b)            ((int32_t)((a) - (b)) < 0)
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static Sim8xxCommand cmd;
+static uint8_t datagram[UR_DATAGRAM_SIZE];
+static uint8_t ack[SIM8XX_IPD_BUFFER_SIZE];
+static bool socketOpen;
+static uint32_t openGeneration;
+static uint32_t deviceId;
+static uint32_t epoch;
+static uint32_t nextSeq;
+static uint32_t srtt;
+static uint32_t rto;
+static UdpStats_t stats;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static void put32(uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static uint32_t rtcNow(void) {
+  RTCDateTime timespec;
+  rtcGetTime(&RTCD1, &timespec);
+  return frTimeFromRtc(&timespec);
+}
+
+/*
+ * The server keys its state by the device, not by the source address that
+ * changes with every NAT rebinding.
+ */
+static uint32_t readDeviceId(void) {
+  const uint32_t *uid = (const uint32_t *)UID_BASE;
+  return uid[0] ^ uid[1] ^ uid[2];
+}
+
+/*
+ * The RTC runs from the LSI and restarts after a power loss, and a reused
+ * epoch makes the server take the new sequence numbers for retransmissions.
+ * The epoch is a counter kept on the card next to the outbox instead. A card
+ * without one starts from the RTC mixed with the cycle counter, which depends
+ * on how long the network took to come up.
+ */
+static bool takeEpoch(void) {
+  uint32_t last = 0;
+  FIL file;
+  UINT n;
+
+  if (FR_OK == f_open(&file, EPOCH_FILE, FA_OPEN_EXISTING | FA_READ)) {
+    if ((FR_OK != f_read(&file, &last, sizeof(last), &n)) ||
+        (sizeof(last) != n))
+      last = 0;
+    f_close(&file);
+  }
+
+  uint32_t next = last + 1U;
+  if (0U == last)
+    next = rtcNow() ^ (uint32_t)chSysGetRealtimeCounterX();
+  if (0U == next)
+    next = 1U;
+
+  if (FR_OK != f_open(&file, EPOCH_FILE, FA_CREATE_ALWAYS | FA_WRITE))
+    return false;
+  bool saved = (FR_OK == f_write(&file, &next, sizeof(next), &n)) &&
+               (sizeof(next) == n);
+  if (FR_OK != f_close(&file))
+    saved = false;
+  if (saved)
+    epoch = next;
+  return saved;
+}
+
+static void putHeader(uint8_t *p, uint8_t type) {
+  p[0] = UR_MAGIC_0;
+  p[1] = UR_MAGIC_1;
+  p[2] = UR_VERSION;
+  p[3] = type;
+  put32(&p[4], deviceId);
+  put32(&p[8], epoch);
+}
+
+/*
+ * A retransmission encodes the same fixes with the same sequence number,
+ * the datagram is identical to the first one.
+ */
+static size_t encode(const FixRecord_t recs[], size_t num, uint32_t seq,
+                     size_t *count, size_t *fixBytes) {
+  const TelemetryHeader_t header = {UDP_FIELDS, seq, 0, 0};
+  TelemetryEncoder_t enc;
+  size_t i;
+
+  putHeader(datagram, UR_TYPE_DATA);
+  tcEncoderInit(&enc, datagram + UR_HEADER_SIZE,
+                sizeof(datagram) - UR_HEADER_SIZE, &header);
+  size_t headerLength = enc.length;
+  for (i = 0; (i < num) && tcEncoderAdd(&enc, &recs[i]); ++i)
+    ;
+  *count = i;
+  *fixBytes = enc.length - headerLength;
+  return UR_HEADER_SIZE + tcEncoderFinish(&enc);
+}
+
+static bool transmit(Slot_t *slot, const FixRecord_t batch[], size_t num) {
+  size_t count, fixBytes;
+  size_t limit = (SLOT_FREE == slot->state) ? num - slot->first : slot->count;
+  size_t length = encode(&batch[slot->first], limit, slot->seq, &count,
+                         &fixBytes);
+
+  sim8xxCommandInit(&cmd);
+  atCipsendCreate(cmd.request, sizeof(cmd.request), length);
+  cmd.timeout = TIME_MS2I(SEND_TIMEOUT_IN_MS);
+  sim8xxSend(&SIM8D1, &cmd, datagram, length);
+  if (SIM8XX_SEND_OK != cmd.status)
+    return false;
+
+  if (SLOT_FREE == slot->state) {
+    slot->count = count;
+    stats.datagrams++;
+    stats.fixBytes += fixBytes;
+  } else {
+    stats.retransmits++;
+  }
+  stats.airBytes += length + IP_UDP_HEADER_SIZE;
+  slot->state = SLOT_SENT;
+  slot->sentAt = chVTGetSystemTime();
+  slot->tries++;
+  return true;
+}
+
+/*
+ * Karn's rule, only datagrams acknowledged at the first try are sampled.
+ */
+static void sampleRtt(uint32_t rtt) {
+  srtt = srtt ? (7U * srtt + rtt) / 8U : rtt;
+  rto = 2U * srtt;
+  if (rto < RTO_MIN_IN_MS)
+    rto = RTO_MIN_IN_MS;
+  if (rto > RTO_MAX_IN_MS)
+    rto = RTO_MAX_IN_MS;
+
+  stats.rttSum += rtt;
+  stats.rttCount++;
+  if (rtt > stats.rttMax)
+    stats.rttMax = rtt;
+}
+
+static bool isAcked(uint32_t seq, uint32_t cumulative, uint32_t bitmap) {
+  if (SEQ_BEFORE(seq, cumulative))
+    return true;
+  uint32_t offset = seq - cumulative - 1U;
+  return (seq != cumulative) && (offset < 32U) && (bitmap & (1UL << offset));
+}
+
+static void processAck(Slot_t slots[]) {
+  size_t length = sim8xxReceive(&SIM8D1, ack, sizeof(ack));
+  size_t i;
+
+  if ((length < UR_ACK_SIZE) || (UR_MAGIC_0 != ack[0]) ||
+      (UR_MAGIC_1 != ack[1]) || (UR_VERSION != ack[2]) ||
+      (UR_TYPE_ACK != ack[3]) || (deviceId != get32(&ack[4])) ||
+      (epoch != get32(&ack[8])))
+    return;
+
+  uint32_t cumulative = get32(&ack[12]);
+  uint32_t bitmap = get32(&ack[16]);
+  stats.acks++;
+  stats.ackBytes += length + IP_UDP_HEADER_SIZE;
+
+  for (i = 0; i < UR_WINDOW; ++i) {
+    Slot_t *slot = &slots[i];
+    if ((SLOT_SENT == slot->state) &&
+        isAcked(slot->seq, cumulative, bitmap)) {
+      slot->state = SLOT_ACKED;
+      if (1U == slot->tries)
+        sampleRtt(TIME_I2MS(chVTTimeElapsedSinceX(slot->sentAt)));
+    }
+  }
+}
+
+/*
+ * The outbox can only be advanced from its head, an acknowledged datagram
+ * waits for the ones before it.
+ */
+static bool release(Slot_t slots[], const FixRecord_t batch[], size_t *base,
+                    uint32_t *records) {
+  uint32_t now = rtcNow();
+  bool found;
+
+  do {
+    size_t i;
+    found = false;
+    for (i = 0; i < UR_WINDOW; ++i) {
+      Slot_t *slot = &slots[i];
+      if ((SLOT_ACKED == slot->state) && (slot->first == *base)) {
+        size_t j;
+        if (!obAck(slot->count))
+          return false;
+        for (j = slot->first; j < slot->first + slot->count; ++j) {
+          uint32_t age = (now > batch[j].time) ? now - batch[j].time : 0U;
+          stats.ageSum += age;
+          if (age > stats.ageMax)
+            stats.ageMax = age;
+        }
+        stats.records += slot->count;
+        *records += slot->count;
+        *base += slot->count;
+        slot->state = SLOT_FREE;
+        found = true;
+      }
+    }
+  } while (found);
+
+  return true;
+}
+
+/*
+ * Selective retransmission, only the datagrams whose timeout expired are
+ * sent again. The next wait ends at the earliest timeout.
+ */
+static bool retransmit(Slot_t slots[], const FixRecord_t batch[],
+                       size_t num, sysinterval_t *wait) {
+  size_t i;
+
+  *wait = TIME_MS2I(rto);
+  for (i = 0; i < UR_WINDOW; ++i) {
+    Slot_t *slot = &slots[i];
+    if (SLOT_SENT != slot->state)
+      continue;
+
+    sysinterval_t elapsed = chVTTimeElapsedSinceX(slot->sentAt);
+    if (elapsed >= TIME_MS2I(rto)) {
+      if ((slot->tries >= MAX_TRIES) || !transmit(slot, batch, num))
+        return false;
+    } else if (TIME_MS2I(rto) - elapsed < *wait) {
+      *wait = TIME_MS2I(rto) - elapsed;
+    }
+  }
+  return true;
+}
+
+static bool sendBatch(const FixRecord_t batch[], size_t num,
+                      bool (*allowed)(void), uint32_t *records) {
+  Slot_t slots[UR_WINDOW];
+  size_t next = 0;
+  size_t base = 0;
+  size_t i;
+
+  memset(slots, 0, sizeof(slots));
+  while ((base < num) && allowed()) {
+    for (i = 0; (i < UR_WINDOW) && (next < num); ++i) {
+      Slot_t *slot = &slots[i];
+      if (SLOT_FREE != slot->state)
+        continue;
+      slot->first = next;
+      slot->seq = nextSeq++;
+      slot->tries = 0;
+      if (!transmit(slot, batch, num) || (0U == slot->count))
+        return false;
+      next += slot->count;
+    }
+
+    sysinterval_t wait;
+    if (!retransmit(slots, batch, num, &wait))
+      return false;
+
+    if (!sim8xxGetAndClearUrcs(&SIM8D1, SIM8XX_URC_IPD)) {
+      chEvtWaitAnyTimeout(EVENT_MASK(0), wait);
+      if (!sim8xxGetAndClearUrcs(&SIM8D1, SIM8XX_URC_IPD))
+        continue;
+    }
+
+    processAck(slots);
+    if (!release(slots, batch, &base, records))
+      return false;
+  }
+  return true;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void urInit(void) {
+  socketOpen = false;
+  nextSeq = 0;
+  srtt = 0;
+  rto = RTO_INITIAL_IN_MS;
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool urIsOpen(void) {
+  return socketOpen && (openGeneration == brTcpGeneration());
+}
+
+/*
+ * The epoch tells the server that the sequence numbers start again, a
+ * new one is taken when the device restarted. Without a card to keep it
+ * the socket is not opened, the fixes wait in the outbox anyway.
+ */
+bool urOpen(void) {
+  event_listener_t urcListener;
+  eventflags_t urcs = 0;
+
+  if (0U == deviceId)
+    deviceId = readDeviceId();
+  if ((0U == epoch) && !takeEpoch())
+    return false;
+
+  sim8xxCommandInit(&cmd);
+  atCipheadCreate(cmd.request, sizeof(cmd.request));
+  sim8xxExecute(&SIM8D1, &cmd);
+  if (SIM8XX_OK != cmd.status)
+    return false;
+
+  chEvtRegisterMaskWithFlags(&SIM8D1.urcSource, &urcListener, EVENT_MASK(0),
+                             SIM8XX_URC_CONNECT_OK | SIM8XX_URC_CONNECT_FAIL);
+  sim8xxGetAndClearUrcs(&SIM8D1,
+                        SIM8XX_URC_CONNECT_OK | SIM8XX_URC_CONNECT_FAIL);
+
+  sim8xxCommandInit(&cmd);
+  atCipstartUdpCreate(cmd.request, sizeof(cmd.request), GTRACK_SERVER_HOST,
+                      GTRACK_UDP_PORT);
+  sim8xxExecute(&SIM8D1, &cmd);
+  if (SIM8XX_OK == cmd.status) {
+    systime_t start = chVTGetSystemTime();
+    systime_t end = chTimeAddX(start, TIME_MS2I(CONNECT_TIMEOUT_IN_MS));
+    while ((0 == (urcs = sim8xxGetAndClearUrcs(&SIM8D1,
+                      SIM8XX_URC_CONNECT_OK | SIM8XX_URC_CONNECT_FAIL))) &&
+           chVTIsSystemTimeWithin(start, end)) {
+      chEvtWaitAnyTimeout(EVENT_MASK(0),
+                          chTimeDiffX(chVTGetSystemTime(), end));
+    }
+  }
+  chEvtUnregister(&SIM8D1.urcSource, &urcListener);
+
+  socketOpen = (SIM8XX_URC_CONNECT_OK == urcs);
+  openGeneration = brTcpGeneration();
+  return socketOpen;
+}
+
+void urClose(void) {
+  if (socketOpen) {
+    sim8xxCommandInit(&cmd);
+    atCipcloseCreate(cmd.request, sizeof(cmd.request));
+    sim8xxExecute(&SIM8D1, &cmd);
+    stats.reopens++;
+  }
+  socketOpen = false;
+}
+
+bool urDrain(FixRecord_t batch[], size_t size, bool (*allowed)(void),
+             uint32_t *records, uint32_t *bytes) {
+  event_listener_t ipdListener;
+  uint32_t airBytes = stats.airBytes;
+  bool ok = true;
+
+  *records = 0;
+  chEvtRegisterMaskWithFlags(&SIM8D1.urcSource, &ipdListener, EVENT_MASK(0),
+                             SIM8XX_URC_IPD);
+  sim8xxGetAndClearUrcs(&SIM8D1, SIM8XX_URC_IPD);
+
+  while (ok && allowed()) {
+    size_t num = obPeek(batch, size);
+    if (0U == num)
+      break;
+    ok = sendBatch(batch, num, allowed, records);
+  }
+
+  chEvtUnregister(&SIM8D1.urcSource, &ipdListener);
+  *bytes = stats.airBytes - airBytes;
+  return ok;
+}
+
+void urCmdUdp(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)argv;
+  if (argc > 0) {
+    chprintf(chp, "Usage: udp\r\n");
+    return;
+  }
+
+  chprintf(chp, "socket %s, device %08lX, epoch %lu, next seq %lu\r\n",
+           urIsOpen() ? "open" : "closed", deviceId, epoch, nextSeq);
+  chprintf(chp, "datagrams %lu, retransmits %lu, acks %lu, reopens %lu\r\n",
+           stats.datagrams, stats.retransmits, stats.acks, stats.reopens);
+  if (stats.rttCount > 0U)
+    chprintf(chp, "rtt avg %lu ms, max %lu ms, rto %lu ms\r\n",
+             stats.rttSum / stats.rttCount, stats.rttMax, rto);
+  if (stats.records > 0U) {
+    uint32_t overhead = stats.airBytes + stats.ackBytes - stats.fixBytes;
+    uint32_t centiBytes = (overhead * 100U) / stats.records;
+    chprintf(chp, "%lu fixes, %lu bytes sent, %lu received\r\n",
+             stats.records, stats.airBytes, stats.ackBytes);
+    chprintf(chp, "overhead %lu.%02lu bytes/fix, fix age at ack avg %lu s, "
+             "max %lu s\r\n", centiBytes / 100U, centiBytes % 100U,
+             stats.ageSum / stats.records, stats.ageMax);
+  }
+}
+
+/****************************** END OF FILE **********************************/
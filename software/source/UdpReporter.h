@@ -0,0 +1,88 @@
+/**
+ * @file UdpReporter.h
+ * @brief Outbox upload in UDP datagrams with application level acks.
+ */
+
+#ifndef UDP_REPORTER_H
+#define UDP_REPORTER_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+#include "hal.h"
+#include "FixRecord.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Datagram header, followed by a telemetry packet in data datagrams.
+ *
+ * magic "GU", version, type, device id and epoch (both 32 bit little
+ * endian). The sequence number of a data datagram is the one of its
+ * telemetry packet. An ack carries the first sequence number not received
+ * yet and a bitmap of the 32 datagrams after it.
+ */
+#define UR_MAGIC_0                  'G'
+#define UR_MAGIC_1                  'U'
+#define UR_VERSION                  1
+#define UR_TYPE_DATA                1
+#define UR_TYPE_ACK                 2
+#define UR_HEADER_SIZE              12
+#define UR_ACK_SIZE                 (UR_HEADER_SIZE + 8)
+
+/**
+ * @brief Datagrams stay well below the GPRS MTU, a few of them are in
+ *        flight at the same time.
+ */
+#define UR_DATAGRAM_SIZE            512
+#define UR_WINDOW                   4
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+void urInit(void);
+
+/**
+ * @brief True if the socket is still open, i.e. the TCP/IP stack was not
+ *        shut since it was opened.
+ */
+bool urIsOpen(void);
+
+/**
+ * @brief Open the socket to GTRACK_UDP_PORT, the stack must be attached
+ *        and held by the caller.
+ */
+bool urOpen(void);
+void urClose(void);
+
+/**
+ * @brief Send the outbox and advance it as the acks arrive, until it is
+ *        empty or allowed() returns false.
+ * @param batch Buffer of the caller for the fixes read from the outbox.
+ * @param records Number of acknowledged fixes.
+ * @param bytes Number of bytes sent, including retransmissions.
+ * @return False if the server stopped acknowledging or a send failed, the
+ *         socket should be opened again.
+ */
+bool urDrain(FixRecord_t batch[], size_t size, bool (*allowed)(void),
+             uint32_t *records, uint32_t *bytes);
+
+void urCmdUdp(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* UDP_REPORTER_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,102 @@
+/**
+ * @file UploadScheduler.c
+ * @brief Policy deciding when the outbox is worth an upload session.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "UploadScheduler.h"
+#include "gtrackconf.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+void usDefaultPolicy(UploadPolicy_t *policy) {
+  policy->goodRssi = GTRACK_UPLOAD_GOOD_RSSI;
+  policy->poorRssi = GTRACK_UPLOAD_POOR_RSSI;
+  policy->lowSupply = GTRACK_UPLOAD_LOW_SUPPLY_IN_MV;
+  policy->latency = GTRACK_UPLOAD_LATENCY_IN_MS;
+  policy->goodBatch = GTRACK_UPLOAD_GOOD_BATCH;
+  policy->weakBatch = GTRACK_UPLOAD_WEAK_BATCH;
+  policy->fullBatch = GTRACK_UPLOAD_BATCH_SIZE;
+}
+
+UploadLink_t usClassifyLink(const UploadPolicy_t *policy, int rssi) {
+  if (0 == rssi)
+    return US_LINK_WEAK;
+  if (rssi >= policy->goodRssi)
+    return US_LINK_GOOD;
+  if (rssi >= policy->poorRssi)
+    return US_LINK_WEAK;
+  return US_LINK_POOR;
+}
+
+/*
+ * The weaker the link, the more a session costs in setup time and
+ * retransmissions, so more fixes are collected for it and they may wait
+ * longer. A full packet and the last chance before the modem is powered
+ * down are always sent.
+ */
+void usDecide(const UploadPolicy_t *policy, const UploadConditions_t *cond,
+              UploadDecision_t *decision) {
+  decision->flush = false;
+  decision->recheck = policy->latency;
+
+  if (!cond->canTransmit) {
+    decision->recheck = US_RECHECK_NEVER;
+    return;
+  }
+
+  if (0U == cond->pending)
+    return;
+
+  if (!cond->ignitionOn || (cond->pending >= policy->fullBatch)) {
+    decision->flush = true;
+    return;
+  }
+
+  UploadLink_t link = usClassifyLink(policy, cond->rssi);
+  size_t batch = (US_LINK_GOOD == link) ? policy->goodBatch
+               : (US_LINK_WEAK == link) ? policy->weakBatch
+               : policy->fullBatch;
+  uint32_t budget = policy->latency << link;
+
+  if ((0U != cond->supply) && (cond->supply < policy->lowSupply)) {
+    batch *= 2U;
+    budget *= 2U;
+  }
+
+  if ((cond->pending >= batch) || (cond->age >= budget)) {
+    decision->flush = true;
+    return;
+  }
+
+  decision->recheck = budget - cond->age;
+}
+
+/****************************** END OF FILE **********************************/
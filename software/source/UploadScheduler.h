@@ -0,0 +1,88 @@
+/**
+ * @file UploadScheduler.h
+ * @brief Policy deciding when the outbox is worth an upload session.
+ */
+
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/**
+ * @brief Recheck value of a decision that only an event can change.
+ */
+#define US_RECHECK_NEVER            UINT32_MAX
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  US_LINK_GOOD,
+  US_LINK_WEAK,
+  US_LINK_POOR,
+  US_LINK_NUM
+} UploadLink_t;
+
+typedef struct {
+  int goodRssi;        /**< dBm, a good link is at or above.               */
+  int poorRssi;        /**< dBm, a poor link is below.                     */
+  uint32_t lowSupply;  /**< mV, below the batches are doubled.             */
+  uint32_t latency;    /**< Target latency on a good link in ms.           */
+  size_t goodBatch;    /**< Fixes worth a session on a good link.          */
+  size_t weakBatch;    /**< Fixes worth a session on a weak link.          */
+  size_t fullBatch;    /**< Fixes of a full packet, flushed on any link.   */
+} UploadPolicy_t;
+
+typedef struct {
+  bool canTransmit;    /**< Registered and attached.                       */
+  bool ignitionOn;     /**< False for the last flush before parking.       */
+  int rssi;            /**< dBm, 0 if unknown.                             */
+  uint32_t supply;     /**< mV, 0 if unknown.                              */
+  size_t pending;      /**< Fixes in the outbox.                           */
+  uint32_t age;        /**< Age of the oldest pending fix in ms.           */
+} UploadConditions_t;
+
+typedef struct {
+  bool flush;
+  uint32_t recheck;    /**< ms until the decision changes by aging alone.  */
+} UploadDecision_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Policy of the GTRACK_UPLOAD_* settings.
+ */
+void usDefaultPolicy(UploadPolicy_t *policy);
+
+/**
+ * @brief An unknown signal level counts as a weak link.
+ */
+UploadLink_t usClassifyLink(const UploadPolicy_t *policy, int rssi);
+
+/**
+ * @brief Decide whether the pending fixes are sent now.
+ * @note  Pure function of its inputs, it issues no AT commands.
+ */
+void usDecide(const UploadPolicy_t *policy, const UploadConditions_t *cond,
+              UploadDecision_t *decision);
+
+#endif /* UPLOAD_SCHEDULER_H */
+
+/****************************** END OF FILE **********************************/
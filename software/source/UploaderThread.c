@@ -0,0 +1,494 @@
+/**
+ * @file UploaderThread.c
+ * @brief Upload of the outbox to the tracking server.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "UploaderThread.h"
+#include "Outbox.h"
+#include "TelemetryCodec.h"
+#include "UploadScheduler.h"
+#include "UdpReporter.h"
+#include "Bearer.h"
+#include "Dashboard.h"
+#include "NetworkMonitorThread.h"
+#include "gtrackconf.h"
+#include "sim8xx.h"
+#include "at.h"
+
+#include "chprintf.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+/*
+ * The modem accepts at most 1460 bytes in a single send.
+ */
+#define UPLOAD_PAYLOAD_SIZE         1400
+#define UPLOAD_FIELDS               (TC_FIELD_ALTITUDE | TC_FIELD_SPEED)
+
+#define CONNECT_TIMEOUT_IN_MS       30000
+#define SEND_TIMEOUT_IN_MS          10000
+#define ACK_TIMEOUT_IN_MS           30000
+#define ACK_POLL_PERIOD_IN_MS       200
+
+/*
+ * The policy is evaluated at least as often as fixes are produced, the
+ * last flush before parking is cut short after a while.
+ */
+#define EVALUATION_PERIOD_IN_MS     5000
+#define FINAL_FLUSH_TIMEOUT_IN_MS   30000
+
+#define NETWORK_EVENT               EVENT_MASK(1)
+#define KICK_EVENT                  EVENT_MASK(2)
+
+#define CONNECTION_URCS             (SIM8XX_URC_CONNECT_OK |                 \
+                                     SIM8XX_URC_CONNECT_FAIL |               \
+                                     SIM8XX_URC_CLOSED)
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+  UPLOAD_ERROR_NO_ERROR,
+  UPLOAD_ERROR_NOT_REGISTERED,
+  UPLOAD_ERROR_BUSY,
+  UPLOAD_ERROR_CONTEXT,
+  UPLOAD_ERROR_CONNECT,
+  UPLOAD_ERROR_SEND,
+  UPLOAD_ERROR_ACK
+} uploadError_t;
+
+typedef struct {
+  uint32_t sessions;
+  uint32_t batches;
+  uint32_t records;
+  uint32_t bytes;
+  uint32_t failures;
+  uint32_t lastRate;
+  uint32_t radioTime;   /**< Time spent in sessions in ms.                  */
+} UploadStats_t;
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+#if GTRACK_UPLOAD_BATCH_SIZE > TC_MAX_FIXES
+#error "GTRACK_UPLOAD_BATCH_SIZE does not fit in a single packet"
+#endif
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const errorNames[] = {
+  [UPLOAD_ERROR_NO_ERROR]       = "none",
+  [UPLOAD_ERROR_NOT_REGISTERED] = "not registered",
+  [UPLOAD_ERROR_BUSY]           = "connection in use",
+  [UPLOAD_ERROR_CONTEXT]        = "no data context",
+  [UPLOAD_ERROR_CONNECT]        = "connect failed",
+  [UPLOAD_ERROR_SEND]           = "send failed",
+  [UPLOAD_ERROR_ACK]            = "not acknowledged"
+};
+
+static thread_t *uploaderThread;
+static mutex_t sessionLock;
+static binary_semaphore_t stoppedSem;
+static volatile bool running;
+static volatile bool stopping;
+static volatile bool forced;
+static bool networkReady;
+static UploadPolicy_t policy;
+static systime_t pendingSince;
+static bool pendingValid;
+static systime_t sessionStart;
+static Sim8xxCommand cmd;
+static FixRecord_t batch[GTRACK_UPLOAD_BATCH_SIZE];
+static uint8_t payload[UPLOAD_PAYLOAD_SIZE];
+static uint32_t txTotal;
+static uint32_t sequence;
+static uploadError_t error;
+static UploadStats_t stats;
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+static bool execute(Sim8xxCommandStatus_t expected, uint32_t timeout) {
+  cmd.timeout = timeout ? TIME_MS2I(timeout) : 0;
+  sim8xxExecute(&SIM8D1, &cmd);
+  return expected == cmd.status;
+}
+
+static void kick(void) {
+  if (uploaderThread)
+    chEvtSignal(uploaderThread, KICK_EVENT);
+}
+
+/*
+ * Only the transition to a usable network triggers an upload, signal
+ * quality updates are ignored.
+ */
+static bool networkReturned(void) {
+  bool ready = nmCanTransmit();
+  bool returned = ready && !networkReady;
+  networkReady = ready;
+  return returned;
+}
+
+/*
+ * The age of the oldest pending fix is measured from the first time it was
+ * seen, fixes left over from the previous ride count from the start.
+ */
+static void getConditions(UploadConditions_t *cond) {
+  Network_t net;
+  dbGetNetwork(&net, NULL);
+
+  cond->canTransmit = nmCanTransmit();
+  cond->ignitionOn = running;
+  cond->rssi = net.rssi;
+  cond->supply = net.supply;
+  cond->pending = obPending();
+
+  if (0U == cond->pending) {
+    pendingValid = false;
+  } else if (!pendingValid) {
+    pendingSince = chVTGetSystemTime();
+    pendingValid = true;
+  }
+  cond->age = pendingValid
+                  ? (uint32_t)TIME_I2MS(chVTTimeElapsedSinceX(pendingSince))
+                  : 0U;
+}
+
+static bool connect(void) {
+  event_listener_t urcListener;
+  chEvtRegisterMaskWithFlags(&SIM8D1.urcSource, &urcListener, EVENT_MASK(0),
+                             CONNECTION_URCS);
+  sim8xxGetAndClearUrcs(&SIM8D1, CONNECTION_URCS);
+
+  sim8xxCommandInit(&cmd);
+  atCipstartCreate(cmd.request, sizeof(cmd.request), GTRACK_SERVER_HOST,
+                   GTRACK_SERVER_PORT);
+  eventflags_t urcs = 0;
+  if (execute(SIM8XX_OK, 0)) {
+    systime_t start = chVTGetSystemTime();
+    systime_t end = chTimeAddX(start, TIME_MS2I(CONNECT_TIMEOUT_IN_MS));
+    while ((0 == (urcs = sim8xxGetAndClearUrcs(&SIM8D1, CONNECTION_URCS))) &&
+           chVTIsSystemTimeWithin(start, end)) {
+      chEvtWaitAnyTimeout(EVENT_MASK(0),
+                          chTimeDiffX(chVTGetSystemTime(), end));
+    }
+  }
+
+  chEvtUnregister(&SIM8D1.urcSource, &urcListener);
+  txTotal = 0;
+  return SIM8XX_URC_CONNECT_OK == urcs;
+}
+
+static void disconnect(void) {
+  sim8xxCommandInit(&cmd);
+  atCipcloseCreate(cmd.request, sizeof(cmd.request));
+  execute(SIM8XX_CLOSE_OK, 0);
+  brTcpShut();
+}
+
+/*
+ * As many of the peeked fixes as fit in a single send, the rest stays in
+ * the outbox for the next packet.
+ */
+static size_t encodeBatch(size_t num, size_t *encoded) {
+  const TelemetryHeader_t header = {UPLOAD_FIELDS, sequence, 0, 0};
+  TelemetryEncoder_t enc;
+  size_t i;
+
+  tcEncoderInit(&enc, payload, sizeof(payload), &header);
+  for (i = 0; (i < num) && tcEncoderAdd(&enc, &batch[i]); ++i)
+    ;
+  *encoded = i;
+  return tcEncoderFinish(&enc);
+}
+
+/*
+ * SEND OK only means the data left the modem, the outbox is advanced once
+ * the server acknowledged every byte on TCP level.
+ */
+static bool waitAck(void) {
+  systime_t start = chVTGetSystemTime();
+  systime_t end = chTimeAddX(start, TIME_MS2I(ACK_TIMEOUT_IN_MS));
+  do {
+    CIPACK_Response_t ack;
+    sim8xxCommandInit(&cmd);
+    atCipackCreate(cmd.request, sizeof(cmd.request));
+    if (!execute(SIM8XX_OK, 0) || !atCipackParse(&ack, cmd.response))
+      return false;
+    if (ack.ackLength >= txTotal)
+      return true;
+    if (sim8xxGetAndClearUrcs(&SIM8D1, SIM8XX_URC_CLOSED))
+      return false;
+    chThdSleepMilliseconds(ACK_POLL_PERIOD_IN_MS);
+  } while (chVTIsSystemTimeWithin(start, end));
+  return false;
+}
+
+static bool uploadBatch(void) {
+  size_t num = obPeek(batch, GTRACK_UPLOAD_BATCH_SIZE);
+  if (0 == num)
+    return false;
+
+  size_t length = encodeBatch(num, &num);
+  sim8xxCommandInit(&cmd);
+  atCipsendCreate(cmd.request, sizeof(cmd.request), length);
+  cmd.timeout = TIME_MS2I(SEND_TIMEOUT_IN_MS);
+  sim8xxSend(&SIM8D1, &cmd, payload, length);
+  if (SIM8XX_SEND_OK != cmd.status) {
+    error = UPLOAD_ERROR_SEND;
+    return false;
+  }
+
+  txTotal += length;
+  if (!waitAck()) {
+    error = UPLOAD_ERROR_ACK;
+    return false;
+  }
+
+  obAck(num);
+  sequence++;
+  stats.batches++;
+  stats.records += num;
+  stats.bytes += length;
+  return true;
+}
+
+static bool sessionAllowed(void) {
+  if (running)
+    return true;
+  return stopping &&
+         chVTIsSystemTimeWithin(sessionStart, chTimeAddX(sessionStart,
+                                TIME_MS2I(FINAL_FLUSH_TIMEOUT_IN_MS)));
+}
+
+static void uploadTcp(void) {
+  if (!brTcpAttach(false)) {
+    error = UPLOAD_ERROR_CONTEXT;
+  } else if (!connect()) {
+    error = UPLOAD_ERROR_CONNECT;
+  } else {
+    stats.sessions++;
+    while (sessionAllowed() && uploadBatch())
+      ;
+  }
+
+  disconnect();
+}
+
+/*
+ * The socket and the context are kept open between sessions, they are set
+ * up again only after a failure or after another application shut the
+ * stack.
+ */
+static void uploadUdp(void) {
+  uint32_t records, bytes;
+
+  if (!urIsOpen()) {
+    if (!brTcpAttach(false)) {
+      error = UPLOAD_ERROR_CONTEXT;
+      return;
+    }
+    if (!urOpen()) {
+      error = UPLOAD_ERROR_CONNECT;
+      brTcpShut();
+      return;
+    }
+  }
+
+  stats.sessions++;
+  bool acked = urDrain(batch, GTRACK_UPLOAD_BATCH_SIZE, sessionAllowed,
+                       &records, &bytes);
+  stats.records += records;
+  stats.bytes += bytes;
+  if (!acked) {
+    error = UPLOAD_ERROR_ACK;
+    urClose();
+    brTcpShut();
+  }
+}
+
+/*
+ * Drain the outbox in a single session while the system is riding, or for
+ * a while after ignition off.
+ * Returns false if the next attempt should come sooner.
+ */
+static bool upload(void) {
+  error = UPLOAD_ERROR_NO_ERROR;
+
+  if (!nmCanTransmit()) {
+    error = UPLOAD_ERROR_NOT_REGISTERED;
+    return false;
+  }
+
+  if (!brTcpAcquire()) {
+    error = UPLOAD_ERROR_BUSY;
+    return false;
+  }
+
+  uint32_t records = stats.records;
+  sessionStart = chVTGetSystemTime();
+  if (GTRACK_UPLOAD_UDP)
+    uploadUdp();
+  else
+    uploadTcp();
+  brTcpRelease();
+
+  sysinterval_t elapsed = chVTTimeElapsedSinceX(sessionStart);
+  stats.radioTime += TIME_I2MS(elapsed);
+  if (stats.records != records)
+    stats.lastRate = (uint32_t)(((uint64_t)(stats.records - records) *
+                                 60000U) / (TIME_I2MS(elapsed) + 1));
+
+  if (UPLOAD_ERROR_NO_ERROR != error)
+    stats.failures++;
+  return UPLOAD_ERROR_NO_ERROR == error;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+THD_FUNCTION(UploaderThread, arg) {
+  (void)arg;
+  chRegSetThreadName("uploader");
+
+  event_listener_t networkListener;
+  dbSubscribe(DB_GROUP_NETWORK, &networkListener, NETWORK_EVENT);
+  uploaderThread = chThdGetSelfX();
+
+  /* A start before the thread was running is not lost. */
+  sysinterval_t period = TIME_IMMEDIATE;
+  systime_t deadline = chVTGetSystemTime();
+
+  while (true) {
+    sysinterval_t timeout = period;
+    if (TIME_INFINITE != period) {
+      sysinterval_t left = chTimeDiffX(chVTGetSystemTime(), deadline);
+      timeout = (left <= period) ? left : TIME_IMMEDIATE;
+    }
+
+    eventmask_t events =
+        chEvtWaitAnyTimeout(NETWORK_EVENT | KICK_EVENT, timeout);
+    bool returned = (events & NETWORK_EVENT) && networkReturned();
+    if ((NETWORK_EVENT == events) && !returned)
+      continue;
+
+    period = TIME_INFINITE;
+    if (!running && !stopping)
+      continue;
+
+    bool final = !running;
+    UploadConditions_t cond;
+    UploadDecision_t decision;
+
+    chMtxLock(&sessionLock);
+    getConditions(&cond);
+    usDecide(&policy, &cond, &decision);
+    if (forced && cond.canTransmit && (cond.pending > 0U))
+      decision.flush = true;
+    forced = false;
+
+    if (decision.flush && !upload()) {
+      period = TIME_MS2I(GTRACK_UPLOAD_RETRY_IN_MS);
+    } else if (decision.flush) {
+      pendingValid = false;
+      period = TIME_MS2I(EVALUATION_PERIOD_IN_MS);
+    } else if (US_RECHECK_NEVER != decision.recheck) {
+      period = TIME_MS2I(decision.recheck < EVALUATION_PERIOD_IN_MS
+                             ? decision.recheck
+                             : EVALUATION_PERIOD_IN_MS);
+    }
+    chMtxUnlock(&sessionLock);
+    deadline = chTimeAddX(chVTGetSystemTime(), period);
+
+    if (final) {
+      if (urIsOpen() && brTcpAcquire()) {
+        urClose();
+        brTcpShut();
+        brTcpRelease();
+      }
+      stopping = false;
+      period = TIME_INFINITE;
+      chBSemSignal(&stoppedSem);
+    }
+  }
+}
+
+void UploaderThreadInit(void) {
+  obInit();
+  urInit();
+  chMtxObjectInit(&sessionLock);
+  chBSemObjectInit(&stoppedSem, true);
+  usDefaultPolicy(&policy);
+  uploaderThread = NULL;
+  running = false;
+  stopping = false;
+  forced = false;
+  networkReady = false;
+  pendingValid = false;
+}
+
+/*
+ * The modem is ready when riding starts, the scheduler decides when the
+ * queued fixes are sent once the network monitor reports the registration.
+ */
+void UploaderStart(void) {
+  running = true;
+  kick();
+}
+
+/*
+ * Ignition is off, the pending fixes are flushed if the network allows it.
+ * Waits for the last session, the modem is powered down afterwards.
+ */
+void UploaderStop(void) {
+  chBSemReset(&stoppedSem, true);
+  stopping = true;
+  running = false;
+  kick();
+  chBSemWait(&stoppedSem);
+}
+
+void UploaderCmdUpload(BaseSequentialStream *chp, int argc, char *argv[]) {
+  if ((argc > 1) || ((1 == argc) && strcmp(argv[0], "now"))) {
+    chprintf(chp, "Usage: upload [now]\r\n");
+    return;
+  }
+
+  if (1 == argc) {
+    if (running) {
+      forced = true;
+      kick();
+    }
+    else
+      chprintf(chp, "uploader is stopped\r\n");
+  }
+
+  chprintf(chp, "pending %u, last error %s\r\n", (unsigned)obPending(),
+           errorNames[error]);
+  chprintf(chp, "sessions %lu, batches %lu, records %lu, bytes %lu\r\n",
+           stats.sessions, stats.batches, stats.records, stats.bytes);
+  chprintf(chp, "failures %lu, last rate %lu records/min\r\n",
+           stats.failures, stats.lastRate);
+  if (stats.records > 0U) {
+    uint32_t centiBytes = (stats.bytes * 100U) / stats.records;
+    uint32_t centiSessions = (stats.sessions * 100U) / stats.records;
+    chprintf(chp, "per record: %lu.%02lu bytes, %lu.%02lu sessions, "
+             "%lu ms in session\r\n", centiBytes / 100U, centiBytes % 100U,
+             centiSessions / 100U, centiSessions % 100U,
+             stats.radioTime / stats.records);
+  }
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,42 @@
+/**
+ * @file UploaderThread.h
+ * @brief Upload of the outbox to the tracking server.
+ */
+
+#ifndef UPLOADER_THREAD_H
+#define UPLOADER_THREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(UploaderThread, arg);
+void UploaderThreadInit(void);
+void UploaderStart(void);
+void UploaderStop(void);
+void UploaderCmdUpload(BaseSequentialStream *chp, int argc, char *argv[]);
+
+#endif /* UPLOADER_THREAD_H */
+
+/******************************* END OF FILE ***********************************/
@@ -21,11 +21,30 @@
 #include "SystemThread.h"
 #include "PeripheralManagerThread.h"
 #include "GpsReaderThread.h"
+#include "UploaderThread.h"
+#include "LiveTrackerThread.h"
+#include "NetworkMonitorThread.h"
+#include "SmsHandlerThread.h"
+#include "FirmwareUpdateThread.h"
+#include "GeofenceThread.h"
+#include "FusionThread.h"
+#include "BootProfiler.h"
 
-static THD_WORKING_AREA(waSystemThread, 8192);
-static THD_WORKING_AREA(waBoardMonitorThread, 8192);
-static THD_WORKING_AREA(waPeripheralManagerThread, 8192);
-static THD_WORKING_AREA(waGpsReaderThread, 8192);
+/*
+ * Sized by tools/stack_estimate.py from a host build, its frames are larger
+ * than the Thumb ones. The 'stacks' command shows the real peaks.
+ */
+static THD_WORKING_AREA(waSystemThread, 3072);
+static THD_WORKING_AREA(waBoardMonitorThread, 768);
+static THD_WORKING_AREA(waPeripheralManagerThread, 3072);
+static THD_WORKING_AREA(waGpsReaderThread, 4608);
+static THD_WORKING_AREA(waUploaderThread, 4096);
+static THD_WORKING_AREA(waLiveTrackerThread, 1536);
+static THD_WORKING_AREA(waNetworkMonitorThread, 1536);
+static THD_WORKING_AREA(waSmsHandlerThread, 2048);
+static THD_WORKING_AREA(waFirmwareUpdateThread, 2048);
+static THD_WORKING_AREA(waGeofenceThread, 1024);
+static THD_WORKING_AREA(waFusionThread, 1792);
 
 /*
  * Green LED blinker thread, times are in milliseconds.
@@ -60,6 +79,13 @@ int main(void) {
   BoardMonitorThreadInit();
   PeripheralManagerThreadInit();
   GpsReaderThreadInit();
+  UploaderThreadInit();
+  LiveTrackerThreadInit();
+  NetworkMonitorThreadInit();
+  SmsHandlerThreadInit();
+  FirmwareUpdateThreadInit();
+  GeofenceThreadInit();
+  FusionThreadInit();
 
   chThdCreateStatic(waHeartBeatThread,
                     sizeof(waHeartBeatThread),
@@ -91,6 +117,50 @@ int main(void) {
                     GpsReaderThread,
                     NULL);       
 
+  chThdCreateStatic(waUploaderThread,
+                    sizeof(waUploaderThread),
+                    NORMALPRIO,
+                    UploaderThread,
+                    NULL);
+
+  chThdCreateStatic(waLiveTrackerThread,
+                    sizeof(waLiveTrackerThread),
+                    NORMALPRIO,
+                    LiveTrackerThread,
+                    NULL);
+
+  chThdCreateStatic(waNetworkMonitorThread,
+                    sizeof(waNetworkMonitorThread),
+                    NORMALPRIO,
+                    NetworkMonitorThread,
+                    NULL);
+
+  chThdCreateStatic(waSmsHandlerThread,
+                    sizeof(waSmsHandlerThread),
+                    NORMALPRIO + 1,
+                    SmsHandlerThread,
+                    NULL);
+
+  chThdCreateStatic(waFirmwareUpdateThread,
+                    sizeof(waFirmwareUpdateThread),
+                    NORMALPRIO - 1,
+                    FirmwareUpdateThread,
+                    NULL);
+
+  chThdCreateStatic(waGeofenceThread,
+                    sizeof(waGeofenceThread),
+                    NORMALPRIO,
+                    GeofenceThread,
+                    NULL);
+
+  chThdCreateStatic(waFusionThread,
+                    sizeof(waFusionThread),
+                    NORMALPRIO + 1,
+                    FusionThread,
+                    NULL);
+
+  bpMark(BP_THREADS_STARTED);
+
   while (true) {
     chThdSleepMilliseconds(1000);
     // TODO: update watchdog here.
@@ -9,8 +9,20 @@
 /*****************************************************************************/
 /* INCLUDES                                                                  */
 /*****************************************************************************/
+#include "commands/AtCgatt.h"
 #include "commands/AtCgnsinf.h"
 #include "commands/AtCgnspwr.h"
+#include "commands/AtCgnsstart.h"
+#include "commands/AtCip.h"
+#include "commands/AtClbs.h"
+#include "commands/AtCops.h"
+#include "commands/AtCreg.h"
+#include "commands/AtCsq.h"
+#include "commands/AtCbc.h"
+#include "commands/AtSapbr.h"
+#include "commands/AtSms.h"
+#include "commands/AtCall.h"
+#include "commands/AtHttp.h"
 
 /*****************************************************************************/
 /* DEFINED CONSTANTS                                                         */
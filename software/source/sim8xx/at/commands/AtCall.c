@@ -0,0 +1,70 @@
+/**
+ * @file AtCall.c
+ * @brief Incoming voice calls.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCall.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atClipCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CLIP=1", length);
+  return true;
+}
+
+bool atClipParse(char number[], size_t length, char str[]) {
+  char *start = strstr(str, "+CLIP: \"");
+  if (!start) return false;
+
+  start += strlen("+CLIP: \"");
+
+  char *end = strchr(start, '"');
+  if (!end || (end == start)) return false;
+
+  size_t n = end - start;
+  if (n > length - 1)
+    n = length - 1;
+  memcpy(number, start, n);
+  number[n] = '\0';
+
+  return true;
+}
+
+bool atAthCreate(char buf[], size_t length) {
+  strncpy(buf, "ATH", length);
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
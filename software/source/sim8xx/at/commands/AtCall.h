@@ -0,0 +1,50 @@
+/**
+ * @file AtCall.h
+ * @brief Incoming voice calls.
+ */
+
+#ifndef AT_CALL_H
+#define AT_CALL_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Report the number of the caller by +CLIP after every RING.
+ */
+bool atClipCreate(char buf[], size_t length);
+
+/**
+ * @brief +CLIP: "<number>",<type>,...
+ */
+bool atClipParse(char number[], size_t length, char str[]);
+
+/**
+ * @brief Hang up the call.
+ */
+bool atAthCreate(char buf[], size_t length);
+
+#endif /* AT_CALL_H */
+
+/****************************** END OF FILE **********************************/
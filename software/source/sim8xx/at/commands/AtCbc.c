@@ -0,0 +1,65 @@
+/**
+ * @file AtCbc.c
+ * @brief Battery charge and supply voltage.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCbc.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCbcCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CBC", length);
+  return true;
+}
+
+/*
+ * +CBC: <bcs>,<bcl>,<voltage>
+ */
+bool atCbcParse(CBC_Response_t *pdata, char str[]) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, "+CBC: ");
+  if (!start) return false;
+
+  start += strlen("+CBC: ");
+
+  if (!atGetNextInt(&start, &pdata->status, ',')) return false;
+  if (!atGetNextInt(&start, &pdata->level, ',')) return false;
+  if (!atGetNextInt(&start, &pdata->voltage, '\r')) return false;
+
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
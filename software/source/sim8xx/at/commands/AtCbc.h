@@ -0,0 +1,48 @@
+/**
+ * @file AtCbc.h
+ * @brief Battery charge and supply voltage.
+ */
+
+#ifndef AT_CBC_H
+#define AT_CBC_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+    int status;
+    int level;
+    int voltage;
+} CBC_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atCbcCreate(char buf[], size_t length);
+
+/**
+ * @brief status is 0-2 (not charging, charging, full), level is 1-100 %,
+ *        voltage is the supply of the modem in mV.
+ */
+bool atCbcParse(CBC_Response_t *pdata, char str[]);
+
+#endif /* AT_CBC_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,63 @@
+/**
+ * @file AtCgatt.c
+ * @brief Packet domain attach.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCgatt.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCgattCreateQuery(char buf[], size_t length) {
+  strncpy(buf, "AT+CGATT?", length);
+  return true;
+}
+
+/*
+ * +CGATT: <state>
+ */
+bool atCgattParse(bool *attached, char str[]) {
+  char *start = strstr(str, "+CGATT: ");
+  if (!start) return false;
+
+  start += strlen("+CGATT: ");
+
+  int state;
+  if (!atGetNextInt(&start, &state, '\r')) return false;
+
+  *attached = (1 == state);
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
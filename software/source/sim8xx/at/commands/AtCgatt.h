@@ -0,0 +1,39 @@
+/**
+ * @file AtCgatt.h
+ * @brief Packet domain attach.
+ */
+
+#ifndef AT_CGATT_H
+#define AT_CGATT_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atCgattCreateQuery(char buf[], size_t length);
+
+bool atCgattParse(bool *attached, char str[]);
+
+#endif /* AT_CGATT_H */
+
+/****************************** END OF FILE **********************************/
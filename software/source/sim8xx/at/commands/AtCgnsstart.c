@@ -0,0 +1,55 @@
+/**
+ * @file AtCgnsstart.c
+ * @brief GNSS cold, warm and hot start commands.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCgnsstart.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+static const char *const commands[] = {
+    [CGNS_START_COLD] = "AT+CGNSCOLD",
+    [CGNS_START_WARM] = "AT+CGNSWARM",
+    [CGNS_START_HOT]  = "AT+CGNSHOT"
+};
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCgnsstartCreate(char buf[], size_t length, CGNS_StartMode_t mode) {
+  if (mode > CGNS_START_HOT)
+    return false;
+
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "%s", commands[mode]);
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
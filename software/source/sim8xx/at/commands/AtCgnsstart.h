@@ -0,0 +1,42 @@
+/**
+ * @file AtCgnsstart.h
+ * @brief GNSS cold, warm and hot start commands.
+ */
+
+#ifndef AT_CGNSSTART_H
+#define AT_CGNSSTART_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+    CGNS_START_COLD,
+    CGNS_START_WARM,
+    CGNS_START_HOT
+} CGNS_StartMode_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atCgnsstartCreate(char buf[], size_t length, CGNS_StartMode_t mode);
+
+#endif /* AT_CGNSSTART_H */
+
+/****************************** END OF FILE **********************************/
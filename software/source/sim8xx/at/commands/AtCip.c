@@ -0,0 +1,130 @@
+/**
+ * @file AtCip.c
+ * @brief TCP/IP application of a single connection.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCip.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCipshutCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CIPSHUT", length);
+  return true;
+}
+
+bool atCipmodeCreate(char buf[], size_t length, bool transparent) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CIPMODE=%d", transparent ? 1 : 0);
+  return true;
+}
+
+bool atCsttCreate(char buf[], size_t length, const char *apn) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CSTT=\"%s\"", apn);
+  return true;
+}
+
+bool atCiicrCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CIICR", length);
+  return true;
+}
+
+/*
+ * AT+CIFSR answers only with the address and no final result code, the
+ * extended variant ends with OK.
+ */
+bool atCifsrexCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CIFSREX", length);
+  return true;
+}
+
+bool atCipstartCreate(char buf[], size_t length, const char *host,
+                      uint16_t port) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CIPSTART=\"TCP\",\"%s\",%u", host, port);
+  return true;
+}
+
+bool atCipstartUdpCreate(char buf[], size_t length, const char *host,
+                         uint16_t port) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CIPSTART=\"UDP\",\"%s\",%u", host, port);
+  return true;
+}
+
+bool atCipheadCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CIPHEAD=1", length);
+  return true;
+}
+
+bool atCipsendCreate(char buf[], size_t length, size_t dataLength) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CIPSEND=%u", (unsigned)dataLength);
+  return true;
+}
+
+bool atCipcloseCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CIPCLOSE=1", length);
+  return true;
+}
+
+bool atCipackCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CIPACK", length);
+  return true;
+}
+
+/*
+ * +CIPACK: <txlen>,<acklen>,<nacklen>
+ */
+bool atCipackParse(CIPACK_Response_t *pdata, char str[]) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, "+CIPACK: ");
+  if (!start) return false;
+
+  start += strlen("+CIPACK: ");
+
+  int txLength, ackLength, nackLength;
+  if (!atGetNextInt(&start, &txLength, ',')) return false;
+  if (!atGetNextInt(&start, &ackLength, ',')) return false;
+  if (!atGetNextInt(&start, &nackLength, '\r')) return false;
+
+  pdata->txLength = (uint32_t)txLength;
+  pdata->ackLength = (uint32_t)ackLength;
+  pdata->nackLength = (uint32_t)nackLength;
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
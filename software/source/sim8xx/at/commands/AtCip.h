@@ -0,0 +1,84 @@
+/**
+ * @file AtCip.h
+ * @brief TCP/IP application of a single connection.
+ */
+
+#ifndef AT_CIP_H
+#define AT_CIP_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+    uint32_t txLength;
+    uint32_t ackLength;
+    uint32_t nackLength;
+} CIPACK_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atCipshutCreate(char buf[], size_t length);
+
+/**
+ * @brief Select normal or transparent mode, only allowed while the stack
+ *        is shut.
+ */
+bool atCipmodeCreate(char buf[], size_t length, bool transparent);
+
+bool atCsttCreate(char buf[], size_t length, const char *apn);
+bool atCiicrCreate(char buf[], size_t length);
+bool atCifsrexCreate(char buf[], size_t length);
+
+/**
+ * @brief Connection to a TCP server, the result is reported by the
+ *        CONNECT OK or CONNECT FAIL URC after the OK.
+ */
+bool atCipstartCreate(char buf[], size_t length, const char *host,
+                      uint16_t port);
+
+/**
+ * @brief UDP "connection" to a server, reported like a TCP connection.
+ */
+bool atCipstartUdpCreate(char buf[], size_t length, const char *host,
+                         uint16_t port);
+
+/**
+ * @brief Prefix received data with "+IPD,<length>:".
+ */
+bool atCipheadCreate(char buf[], size_t length);
+
+/**
+ * @brief Send length bytes, the data is written after the "> " prompt.
+ */
+bool atCipsendCreate(char buf[], size_t length, size_t dataLength);
+
+bool atCipcloseCreate(char buf[], size_t length);
+
+/**
+ * @brief Amount of data sent and acknowledged by the server.
+ */
+bool atCipackCreate(char buf[], size_t length);
+
+bool atCipackParse(CIPACK_Response_t *pdata, char str[]);
+
+#endif /* AT_CIP_H */
+
+/****************************** END OF FILE **********************************/
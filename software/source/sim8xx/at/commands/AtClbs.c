@@ -0,0 +1,70 @@
+/**
+ * @file AtClbs.c
+ * @brief Cell based location.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtClbs.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atClbsCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CLBS=4,1", length);
+  return true;
+}
+
+/*
+ * +CLBS: <code>,<longitude>,<latitude>,<accuracy>,<yy/MM/dd>,<hh:mm:ss>
+ */
+bool atClbsParse(CLBS_Response_t *pdata, char str[]) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, "+CLBS: ");
+  if (!start) return false;
+
+  start += strlen("+CLBS: ");
+
+  if (!atGetNextInt(&start, &pdata->locationCode, ',')) return false;
+  if (!atGetNextDouble(&start, &pdata->longitude, ',')) return false;
+  if (!atGetNextDouble(&start, &pdata->latitude, ',')) return false;
+  if (!atGetNextInt(&start, &pdata->accuracy, ',')) return false;
+  if (!atGetNextString(&start, pdata->date, sizeof(pdata->date) - 1, ','))
+    return false;
+  if (!atGetNextString(&start, pdata->time, sizeof(pdata->time) - 1, '\r'))
+    return false;
+
+  return 0 == pdata->locationCode;
+}
+
+/****************************** END OF FILE **********************************/
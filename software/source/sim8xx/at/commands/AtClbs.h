@@ -0,0 +1,51 @@
+/**
+ * @file AtClbs.h
+ * @brief Cell based location.
+ */
+
+#ifndef AT_CLBS_H
+#define AT_CLBS_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+    int locationCode;
+    double longitude;
+    double latitude;
+    int accuracy;
+    char date[8 + 1];
+    char time[8 + 1];
+} CLBS_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Location with date and time of the serving cell, needs an open
+ *        bearer.
+ */
+bool atClbsCreate(char buf[], size_t length);
+
+bool atClbsParse(CLBS_Response_t *pdata, char str[]);
+
+#endif /* AT_CLBS_H */
+
+/****************************** END OF FILE **********************************/
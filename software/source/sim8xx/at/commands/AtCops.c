@@ -0,0 +1,80 @@
+/**
+ * @file AtCops.c
+ * @brief Operator selection.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCops.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCopsCreateQuery(char buf[], size_t length) {
+  strncpy(buf, "AT+COPS?", length);
+  return true;
+}
+
+/*
+ * +COPS: <mode>[,<format>,"<oper>"]
+ */
+bool atCopsParse(COPS_Response_t *pdata, char str[]) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, "+COPS: ");
+  if (!start) return false;
+
+  start += strlen("+COPS: ");
+
+  char *end = strpbrk(start, ",\r");
+  if (!end) return false;
+  if (!atGetNextInt(&start, &pdata->mode, *end)) return false;
+  if ('\r' == *end) return true;
+
+  int format;
+  if (!atGetNextInt(&start, &format, ',')) return false;
+
+  char *name = strchr(start, '"');
+  if (!name) return false;
+  name++;
+  end = strchr(name, '"');
+  if (!end) return false;
+
+  size_t length = end - name;
+  if (length > sizeof(pdata->name) - 1)
+    length = sizeof(pdata->name) - 1;
+  memcpy(pdata->name, name, length);
+
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,46 @@
+/**
+ * @file AtCops.h
+ * @brief Operator selection.
+ */
+
+#ifndef AT_COPS_H
+#define AT_COPS_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+    int mode;
+    char name[16 + 1];
+} COPS_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atCopsCreateQuery(char buf[], size_t length);
+
+/**
+ * @brief The name is empty while no operator is selected.
+ */
+bool atCopsParse(COPS_Response_t *pdata, char str[]);
+
+#endif /* AT_COPS_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,121 @@
+/**
+ * @file AtCreg.c
+ * @brief Network registration, circuit and packet switched.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCreg.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+/*
+ * <stat>[,<lac>,<ci>], the location is only reported while registered.
+ */
+static bool parse(CREG_Response_t *pdata, char str[], const char *prefix,
+                  bool query) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, prefix);
+  if (!start) return false;
+
+  start += strlen(prefix);
+
+  int n, value;
+  if (query && !atGetNextInt(&start, &n, ',')) return false;
+  char *end = strpbrk(start, ",\r");
+  if (!end) return false;
+  if (!atGetNextInt(&start, &value, *end)) return false;
+  /* The stat indexes name tables, values outside 27.007 are unknown. */
+  pdata->status = ((value >= CREG_NOT_REGISTERED) && (value <= CREG_ROAMING))
+                      ? (CREG_Status_t)value
+                      : CREG_UNKNOWN;
+
+  /* The location is quoted hexadecimal. */
+  if (',' == *end) {
+    char lac[4 + 2 + 1] = {0};
+    char ci[8 + 2 + 1] = {0};
+    if (!atGetNextString(&start, lac, sizeof(lac) - 1, ',')) return false;
+    end = strpbrk(start, ",\r");
+    if (!end) return false;
+    if (!atGetNextString(&start, ci, sizeof(ci) - 1, *end)) return false;
+    pdata->lac = (uint16_t)strtoul(('"' == lac[0]) ? lac + 1 : lac, NULL, 16);
+    pdata->ci = (uint32_t)strtoul(('"' == ci[0]) ? ci + 1 : ci, NULL, 16);
+  }
+
+  return true;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCregCreateQuery(char buf[], size_t length) {
+  strncpy(buf, "AT+CREG?", length);
+  return true;
+}
+
+bool atCgregCreateQuery(char buf[], size_t length) {
+  strncpy(buf, "AT+CGREG?", length);
+  return true;
+}
+
+bool atCregCreateUrc(char buf[], size_t length) {
+  strncpy(buf, "AT+CREG=2", length);
+  return true;
+}
+
+bool atCgregCreateUrc(char buf[], size_t length) {
+  strncpy(buf, "AT+CGREG=2", length);
+  return true;
+}
+
+/*
+ * +CREG: <n>,<stat>[,<lac>,<ci>]
+ */
+bool atCregParse(CREG_Response_t *pdata, char str[]) {
+  return parse(pdata, str, "+CREG: ", true);
+}
+
+bool atCgregParse(CREG_Response_t *pdata, char str[]) {
+  return parse(pdata, str, "+CGREG: ", true);
+}
+
+/*
+ * +CREG: <stat>[,<lac>,<ci>]
+ */
+bool atCregParseUrc(CREG_Response_t *pdata, char str[]) {
+  return parse(pdata, str, "+CREG: ", false);
+}
+
+bool atCgregParseUrc(CREG_Response_t *pdata, char str[]) {
+  return parse(pdata, str, "+CGREG: ", false);
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,67 @@
+/**
+ * @file AtCreg.h
+ * @brief Network registration, circuit and packet switched.
+ */
+
+#ifndef AT_CREG_H
+#define AT_CREG_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+    CREG_NOT_REGISTERED = 0,
+    CREG_HOME = 1,
+    CREG_SEARCHING = 2,
+    CREG_DENIED = 3,
+    CREG_UNKNOWN = 4,
+    CREG_ROAMING = 5
+} CREG_Status_t;
+
+typedef struct {
+    CREG_Status_t status;
+    uint16_t lac;
+    uint32_t ci;
+} CREG_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atCregCreateQuery(char buf[], size_t length);
+bool atCgregCreateQuery(char buf[], size_t length);
+
+/**
+ * @brief Enable the registration URCs with location information.
+ */
+bool atCregCreateUrc(char buf[], size_t length);
+bool atCgregCreateUrc(char buf[], size_t length);
+
+/**
+ * @brief Parse the answer of the query, it starts with the URC setting.
+ */
+bool atCregParse(CREG_Response_t *pdata, char str[]);
+bool atCgregParse(CREG_Response_t *pdata, char str[]);
+
+bool atCregParseUrc(CREG_Response_t *pdata, char str[]);
+bool atCgregParseUrc(CREG_Response_t *pdata, char str[]);
+
+#endif /* AT_CREG_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,64 @@
+/**
+ * @file AtCsq.c
+ * @brief Signal quality report.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtCsq.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCsqCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CSQ", length);
+  return true;
+}
+
+/*
+ * +CSQ: <rssi>,<ber>
+ */
+bool atCsqParse(CSQ_Response_t *pdata, char str[]) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, "+CSQ: ");
+  if (!start) return false;
+
+  start += strlen("+CSQ: ");
+
+  if (!atGetNextInt(&start, &pdata->rssi, ',')) return false;
+  if (!atGetNextInt(&start, &pdata->ber, '\r')) return false;
+
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,46 @@
+/**
+ * @file AtCsq.h
+ * @brief Signal quality report.
+ */
+
+#ifndef AT_CSQ_H
+#define AT_CSQ_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+    int rssi;
+    int ber;
+} CSQ_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atCsqCreate(char buf[], size_t length);
+
+/**
+ * @brief rssi is 0-31 (-113 to -51 dBm), ber is 0-7, both 99 if unknown.
+ */
+bool atCsqParse(CSQ_Response_t *pdata, char str[]);
+
+#endif /* AT_CSQ_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,116 @@
+/**
+ * @file AtHttp.c
+ * @brief HTTP client of the modem.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtHttp.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atHttpinitCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+HTTPINIT", length);
+  return true;
+}
+
+bool atHttptermCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+HTTPTERM", length);
+  return true;
+}
+
+bool atHttpparaCreate(char buf[], size_t length, const char *tag,
+                      const char *value) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+HTTPPARA=\"%s\",\"%s\"", tag, value);
+  return true;
+}
+
+bool atHttpparaNumberCreate(char buf[], size_t length, const char *tag,
+                            uint32_t value) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+HTTPPARA=\"%s\",%lu", tag, value);
+  return true;
+}
+
+bool atHttpactionCreate(char buf[], size_t length, int method) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+HTTPACTION=%d", method);
+  return true;
+}
+
+/*
+ * +HTTPACTION: <method>,<status>,<datalen>
+ */
+bool atHttpactionParse(HTTPACTION_Response_t *pdata, char str[]) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, "+HTTPACTION: ");
+  if (!start) return false;
+
+  start += strlen("+HTTPACTION: ");
+
+  if (!atGetNextInt(&start, &pdata->method, ',')) return false;
+  if (!atGetNextInt(&start, &pdata->status, ',')) return false;
+  if (!atGetNextInt(&start, &pdata->length, '\r')) return false;
+
+  return true;
+}
+
+bool atHttpreadCreate(char buf[], size_t length, uint32_t start,
+                      uint32_t size) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+HTTPREAD=%lu,%lu", start, size);
+  return true;
+}
+
+/*
+ * +HTTPREAD: <datalen>\r\n<data>
+ */
+bool atHttpreadParse(size_t *size, char str[]) {
+  int value;
+  *size = 0;
+
+  char *start = strstr(str, "+HTTPREAD: ");
+  if (!start) return false;
+
+  start += strlen("+HTTPREAD: ");
+
+  if (!atGetNextInt(&start, &value, '\r') || (value < 0)) return false;
+
+  *size = (size_t)value;
+  return true;
+}
+
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,70 @@
+/**
+ * @file AtHttp.h
+ * @brief HTTP client of the modem.
+ */
+
+#ifndef AT_HTTP_H
+#define AT_HTTP_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+    int method;
+    int status;
+    int length;
+} HTTPACTION_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atHttpinitCreate(char buf[], size_t length);
+bool atHttptermCreate(char buf[], size_t length);
+
+/**
+ * @brief AT+HTTPPARA with a quoted value.
+ */
+bool atHttpparaCreate(char buf[], size_t length, const char *tag,
+                      const char *value);
+
+/**
+ * @brief AT+HTTPPARA with a numeric value, e.g. "BREAK" and "BREAKEND".
+ */
+bool atHttpparaNumberCreate(char buf[], size_t length, const char *tag,
+                            uint32_t value);
+
+bool atHttpactionCreate(char buf[], size_t length, int method);
+
+/**
+ * @brief Parse the +HTTPACTION URC that ends the request.
+ */
+bool atHttpactionParse(HTTPACTION_Response_t *pdata, char str[]);
+
+bool atHttpreadCreate(char buf[], size_t length, uint32_t start,
+                      uint32_t size);
+
+/**
+ * @brief Length of the data, the data itself is passed by sim8xxRead().
+ */
+bool atHttpreadParse(size_t *size, char str[]);
+
+#endif /* AT_HTTP_H */
+
+/****************************** END OF FILE **********************************/
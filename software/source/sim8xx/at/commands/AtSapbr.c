@@ -0,0 +1,91 @@
+/**
+ * @file AtSapbr.c
+ * @brief Bearer settings for IP based applications.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtSapbr.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+/*
+ * Every application of the library uses the first bearer profile.
+ */
+static bool atSapbrCreate(char buf[], size_t length, int cmd) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+SAPBR=%d,1", cmd);
+  return true;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atSapbrCreateContype(char buf[], size_t length) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"");
+  return true;
+}
+
+bool atSapbrCreateApn(char buf[], size_t length, const char *apn) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+SAPBR=3,1,\"APN\",\"%s\"", apn);
+  return true;
+}
+
+bool atSapbrCreateOpen(char buf[], size_t length) {
+  return atSapbrCreate(buf, length, 1);
+}
+
+bool atSapbrCreateClose(char buf[], size_t length) {
+  return atSapbrCreate(buf, length, 0);
+}
+
+bool atSapbrCreateQuery(char buf[], size_t length) {
+  return atSapbrCreate(buf, length, 2);
+}
+
+/*
+ * +SAPBR: <cid>,<status>,<ip address>
+ */
+bool atSapbrParseQuery(SAPBR_Status_t *status, char str[]) {
+  char *start = strstr(str, "+SAPBR: ");
+  if (!start) return false;
+
+  start += strlen("+SAPBR: ");
+
+  int cid, value;
+  if (!atGetNextInt(&start, &cid, ',')) return false;
+  if (!atGetNextInt(&start, &value, ',')) return false;
+
+  *status = (SAPBR_Status_t)value;
+  return true;
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,49 @@
+/**
+ * @file AtSapbr.h
+ * @brief Bearer settings for IP based applications.
+ */
+
+#ifndef AT_SAPBR_H
+#define AT_SAPBR_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef enum {
+    SAPBR_CONNECTING = 0,
+    SAPBR_CONNECTED = 1,
+    SAPBR_CLOSING = 2,
+    SAPBR_CLOSED = 3
+} SAPBR_Status_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+bool atSapbrCreateContype(char buf[], size_t length);
+bool atSapbrCreateApn(char buf[], size_t length, const char *apn);
+bool atSapbrCreateOpen(char buf[], size_t length);
+bool atSapbrCreateClose(char buf[], size_t length);
+bool atSapbrCreateQuery(char buf[], size_t length);
+
+bool atSapbrParseQuery(SAPBR_Status_t *status, char str[]);
+
+#endif /* AT_SAPBR_H */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,153 @@
+/**
+ * @file AtSms.c
+ * @brief Short messages in text mode.
+ */
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "AtSms.h"
+#include "AtUtil.h"
+#include "hal.h"
+#include "chprintf.h"
+#include <string.h>
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                              */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                            */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                             */
+/*****************************************************************************/
+/*
+ * Copy the next quoted field, the rest of a longer field is dropped.
+ */
+static bool getQuoted(char **start, char buf[], size_t length) {
+  char *begin = strchr(*start, '"');
+  if (!begin) return false;
+  begin++;
+  char *end = strchr(begin, '"');
+  if (!end) return false;
+
+  size_t n = end - begin;
+  if (n > length - 1)
+    n = length - 1;
+  memcpy(buf, begin, n);
+  buf[n] = '\0';
+  *start = end + 1;
+  return true;
+}
+
+/*****************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                            */
+/*****************************************************************************/
+bool atCmgfCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CMGF=1", length);
+  return true;
+}
+
+bool atCnmiCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CNMI=2,1,0,0,0", length);
+  return true;
+}
+
+bool atCmgrCreate(char buf[], size_t length, int index) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CMGR=%d", index);
+  return true;
+}
+
+/*
+ * +CMGR: <stat>,<oa>,[<alpha>],<scts>\r\n<data>\r\n
+ */
+bool atCmgrParse(CMGR_Response_t *pdata, char str[]) {
+  memset(pdata, 0, sizeof(*pdata));
+
+  char *start = strstr(str, "+CMGR: ");
+  if (!start) return false;
+
+  start += strlen("+CMGR: ");
+
+  char status[16];
+  if (!getQuoted(&start, status, sizeof(status))) return false;
+  if (!getQuoted(&start, pdata->sender, sizeof(pdata->sender)))
+    return false;
+
+  char *text = strstr(start, "\r\n");
+  if (!text) return false;
+  text += 2;
+  char *end = strchr(text, '\r');
+  if (!end) return false;
+
+  size_t length = end - text;
+  if (length > sizeof(pdata->text) - 1)
+    length = sizeof(pdata->text) - 1;
+  memcpy(pdata->text, text, length);
+
+  return true;
+}
+
+bool atCmgsCreate(char buf[], size_t length, const char *number) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CMGS=\"%s\"", number);
+  return true;
+}
+
+bool atCmgdCreate(char buf[], size_t length, int index) {
+  memset(buf, 0, length);
+  chsnprintf(buf, length, "AT+CMGD=%d", index);
+  return true;
+}
+
+bool atCmglCreate(char buf[], size_t length) {
+  strncpy(buf, "AT+CMGL=\"ALL\",1", length);
+  return true;
+}
+
+/*
+ * +CMGL: <index>,<stat>,<oa>,...\r\n<data>\r\n for every message
+ */
+size_t atCmglParse(int indices[], size_t max, char str[]) {
+  size_t num = 0;
+  char *start = str;
+
+  while ((num < max) && (NULL != (start = strstr(start, "+CMGL: ")))) {
+    start += strlen("+CMGL: ");
+    if (atGetNextInt(&start, &indices[num], ','))
+      num++;
+  }
+
+  return num;
+}
+
+bool atCmtiParse(int *index, char str[]) {
+  char *start = strstr(str, "+CMTI: ");
+  if (!start) return false;
+
+  start += strlen("+CMTI: ");
+
+  char mem[8];
+  if (!getQuoted(&start, mem, sizeof(mem))) return false;
+  if (',' != *start) return false;
+  start++;
+
+  return atGetNextInt(&start, index, '\r');
+}
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,75 @@
+/**
+ * @file AtSms.h
+ * @brief Short messages in text mode.
+ */
+
+#ifndef AT_SMS_H
+#define AT_SMS_H
+
+/*****************************************************************************/
+/* INCLUDES                                                                  */
+/*****************************************************************************/
+#include "ch.h"
+
+/*****************************************************************************/
+/* DEFINED CONSTANTS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* MACRO DEFINITIONS                                                         */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* TYPE DEFINITIONS                                                          */
+/*****************************************************************************/
+typedef struct {
+    char sender[20 + 1];
+    char text[160 + 1];
+} CMGR_Response_t;
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                           */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                           */
+/*****************************************************************************/
+/**
+ * @brief Text mode, new messages are stored and reported by +CMTI.
+ */
+bool atCmgfCreate(char buf[], size_t length);
+bool atCnmiCreate(char buf[], size_t length);
+
+bool atCmgrCreate(char buf[], size_t length, int index);
+
+/**
+ * @brief The text is cut at the end of the first line of the message.
+ */
+bool atCmgrParse(CMGR_Response_t *pdata, char str[]);
+
+/**
+ * @brief Send to number, the text is written after the "> " prompt and
+ *        closed with Ctrl-Z.
+ */
+bool atCmgsCreate(char buf[], size_t length, const char *number);
+
+bool atCmgdCreate(char buf[], size_t length, int index);
+
+/**
+ * @brief List every stored message without changing its status.
+ */
+bool atCmglCreate(char buf[], size_t length);
+
+/**
+ * @return Number of indices copied, at most max.
+ */
+size_t atCmglParse(int indices[], size_t max, char str[]);
+
+/**
+ * @brief +CMTI: "<mem>",<index>
+ */
+bool atCmtiParse(int *index, char str[]);
+
+#endif /* AT_SMS_H */
+
+/****************************** END OF FILE **********************************/
@@ -52,13 +52,19 @@ double atAsciiToDouble(char str[]) {
   size_t len = strlen(str);
   if (0 == len) return 0.0;
 
+  double sign = 1.0;
+  size_t i = 0;
+  if ('-' == str[0]) {
+    sign = -1.0;
+    i++;
+  }
+
   double val = 0.0;
-  size_t i;
-  for (i = 0; i < len && str[i] != '.'; ++i) {
+  for (; i < len && str[i] != '.'; ++i) {
     val = 10 * val + (str[i] - '0');
   }
 
-  if (i == len) return val;
+  if (i == len) return sign * val;
   i++;
 
   double f = 1.0;
@@ -67,7 +73,7 @@ double atAsciiToDouble(char str[]) {
     val += f * (str[i++] - '0');
   }
 
-  return val;
+  return sign * val;
 }
 
 bool atGetNextDouble(char **start, double *value, char delim) {
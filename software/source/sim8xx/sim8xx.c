@@ -16,10 +16,51 @@
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
 #define READER_WA_SIZE   THD_WORKING_AREA_SIZE(2048)
+#define EXECUTE_TIMEOUT_IN_MS          5000
+
+/*
+ * The modem answers the first AT only after autobauding, a few short probes
+ * tell whether it is on much faster than a single long timeout.
+ */
+#define PROBE_TIMEOUT_IN_MS            300
+#define PROBE_RETRIES                  3
+#define CONNECT_TIMEOUT_IN_MS          1000
+#define BOOT_PROBE_PERIOD_IN_MS        500
+#define BOOT_TIMEOUT_IN_MS             10000
+#define POWER_DOWN_TIMEOUT_IN_MS       5000
+
+/*
+ * The escape sequence is only recognised after a second without data. The
+ * modem counts it from the last byte it received, which may still sit in
+ * the serial queue when the write returns, hence the margin.
+ */
+#define ESCAPE_GUARD_TIME_IN_MS        1000
+#define ESCAPE_GUARD_MARGIN_IN_MS      50
+
+/*
+ * Pollers admitted to a window get this long to finish before the link is
+ * resumed anyway.
+ */
+#define POLL_HOLD_TIMEOUT_IN_MS        10000
+
+#define CONNECT_URCS                   (SIM8XX_URC_CONNECT |                    \
+                                        SIM8XX_URC_CONNECT_OK |                 \
+                                        SIM8XX_URC_CONNECT_FAIL |               \
+                                        SIM8XX_URC_CLOSED)
+
+#define BOOT_URCS                      (SIM8XX_URC_RDY |                        \
+                                        SIM8XX_URC_CPIN_READY |                 \
+                                        SIM8XX_URC_CALL_READY)
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
+typedef enum {
+  SIM8XX_POWER_PROBE,
+  SIM8XX_POWER_TOGGLE,
+  SIM8XX_POWER_BOOTING,
+  SIM8XX_POWER_READY
+} Sim8xxPowerState_t;
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -30,6 +71,12 @@
 /*******************************************************************************/
 Sim8xxDriver SIM8D1;
 
+/*
+ * Escape and resume of the transparent link must not overwrite the command
+ * of the caller.
+ */
+static Sim8xxCommand modeCommand;
+
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
 /*******************************************************************************/
@@ -37,6 +84,178 @@ Sim8xxDriver SIM8D1;
 /*******************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
 /*******************************************************************************/
+static bool probeWithRetries(Sim8xxDriver *simp, size_t retries) {
+  size_t i;
+  for (i = 0; i < retries; ++i) {
+    if (sim8xxProbe(simp, TIME_MS2I(PROBE_TIMEOUT_IN_MS)))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Wait for the boot URCs, but probe periodically as RDY is not sent while
+ * the modem is autobauding.
+ */
+static Sim8xxPowerState_t waitBoot(Sim8xxDriver *simp) {
+  systime_t start = chVTGetSystemTime();
+  systime_t end = chTimeAddX(start, TIME_MS2I(BOOT_TIMEOUT_IN_MS));
+  while (chVTIsSystemTimeWithin(start, end)) {
+    chEvtWaitAnyTimeout(SIM8XX_URC_EVENT, TIME_MS2I(BOOT_PROBE_PERIOD_IN_MS));
+    if (sim8xxProbe(simp, TIME_MS2I(PROBE_TIMEOUT_IN_MS)))
+      return SIM8XX_POWER_READY;
+  }
+  return SIM8XX_POWER_PROBE;
+}
+
+/*
+ * The modem is down once it reports so or stops answering, probing between
+ * the URC waits also covers a modem that powers off without the URC.
+ */
+static bool waitPowerDown(Sim8xxDriver *simp) {
+  systime_t start = chVTGetSystemTime();
+  systime_t end = chTimeAddX(start, TIME_MS2I(POWER_DOWN_TIMEOUT_IN_MS));
+  while (chVTIsSystemTimeWithin(start, end)) {
+    chEvtWaitAnyTimeout(SIM8XX_URC_EVENT, TIME_MS2I(BOOT_PROBE_PERIOD_IN_MS));
+    if (sim8xxGetAndClearUrcs(simp, SIM8XX_URC_POWER_DOWN) ||
+        !probeWithRetries(simp, PROBE_RETRIES))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * The modem does not send a final result code to AT+CPOWD, only the power
+ * down URC.
+ */
+static void sendPowerDown(Sim8xxDriver *simp) {
+  chMtxLock(&simp->lock);
+  chSemWait(&simp->sync);
+  chprintf((BaseSequentialStream*)simp->config->sdp, "AT+CPOWD=1\r");
+  chSemSignal(&simp->sync);
+  chMtxUnlock(&simp->lock);
+}
+
+/*
+ * Send a request, either a command line or raw data after a prompt, and wait
+ * for the final result. The caller holds the driver lock.
+ */
+static void transfer(Sim8xxDriver *simp, Sim8xxCommand *cmdp,
+                     const uint8_t *data, size_t length) {
+  chSemWait(&simp->sync);
+
+  if (data)
+    chnWrite(simp->config->sdp, data, length);
+  else
+    chprintf((BaseSequentialStream*)simp->config->sdp, "%s\r", cmdp->request);
+
+  /* Commands with a slow network response set their own timeout. */
+  sysinterval_t timeout = cmdp->timeout ? cmdp->timeout
+                                        : TIME_MS2I(EXECUTE_TIMEOUT_IN_MS);
+
+  chSysLock();
+  msg_t msg = chThdSuspendTimeoutS(&simp->writer, timeout);
+  simp->writer = NULL;
+  chSysUnlock();
+
+  if (MSG_OK == msg) {
+    chMtxLock(&simp->rxlock);
+    strcpy(cmdp->response, simp->rxbuf);
+    cmdp->status = sim8xxGetStatus(cmdp->response);
+    chMtxUnlock(&simp->rxlock);
+  } else {
+    chSemSignal(&simp->sync);
+    cmdp->status = SIM8XX_TIMEOUT;
+  }
+
+  if (SIM8XX_CONNECT == cmdp->status)
+    simp->link = SIM8XX_LINK_DATA;
+  else if ((SIM8XX_CLOSE_OK == cmdp->status) ||
+           (SIM8XX_SHUT_OK == cmdp->status) ||
+           (SIM8XX_NO_CARRIER == cmdp->status))
+    simp->link = SIM8XX_LINK_COMMAND;
+
+  if (simp->reader) {
+    chSysLock();
+    chThdResumeS(&simp->reader, MSG_OK);
+    chSysUnlock();
+  }
+}
+
+/*
+ * Switch a transparent link to online command mode before an AT command,
+ * the connection stays open. The caller holds the driver lock.
+ */
+static void escape(Sim8xxDriver *simp) {
+  if (SIM8XX_LINK_DATA != simp->link)
+    return;
+
+  sysinterval_t guard =
+      TIME_MS2I(ESCAPE_GUARD_TIME_IN_MS + ESCAPE_GUARD_MARGIN_IN_MS);
+  sysinterval_t idle = chVTTimeElapsedSinceX(simp->lastWrite);
+  if (idle < guard)
+    chThdSleep(guard - idle);
+
+  /* The reader parses the answer of the escape as a command response. */
+  simp->link = SIM8XX_LINK_ONLINE_COMMAND;
+  sim8xxCommandInit(&modeCommand);
+  transfer(simp, &modeCommand, (const uint8_t*)"+++", 3);
+  if (SIM8XX_OK != modeCommand.status)
+    simp->link = SIM8XX_LINK_COMMAND;
+
+  /* Whoever escaped, the pollers waiting for a window get it. */
+  chSysLock();
+  chSemResetI(&simp->window, 0);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+/*
+ * Releases the driver lock while waiting on the semaphore, nothing can
+ * signal it in between.
+ */
+static void waitUnlocked(Sim8xxDriver *simp, semaphore_t *sem,
+                         sysinterval_t timeout) {
+  chSysLock();
+  chMtxUnlockS(&simp->lock);
+  chSemWaitTimeoutS(sem, timeout);
+  chSysUnlock();
+  chMtxLock(&simp->lock);
+}
+
+/*
+ * Wakes a resume waiting for the pollers. The caller holds the driver lock.
+ */
+static void checkIdle(Sim8xxDriver *simp) {
+  if (0U == simp->pollHolders + simp->pollWaiters) {
+    chSysLock();
+    chSemResetI(&simp->idle, 0);
+    chSchRescheduleS();
+    chSysUnlock();
+  }
+}
+
+/*
+ * Return to data mode if the link was escaped for a command, once the
+ * pollers of the window are done. The caller holds the driver lock.
+ */
+static bool resume(Sim8xxDriver *simp) {
+  systime_t start = chVTGetSystemTime();
+  while ((SIM8XX_LINK_ONLINE_COMMAND == simp->link) &&
+         (simp->pollWaiters + simp->pollHolders > 0U) &&
+         (chVTTimeElapsedSinceX(start) <
+          TIME_MS2I(POLL_HOLD_TIMEOUT_IN_MS)))
+    waitUnlocked(simp, &simp->idle, TIME_MS2I(POLL_HOLD_TIMEOUT_IN_MS));
+
+  if (SIM8XX_LINK_ONLINE_COMMAND == simp->link) {
+    sim8xxCommandInit(&modeCommand);
+    strcpy(modeCommand.request, "ATO");
+    transfer(simp, &modeCommand, NULL, 0);
+    if (SIM8XX_CONNECT != modeCommand.status)
+      simp->link = SIM8XX_LINK_COMMAND;
+  }
+  return SIM8XX_LINK_DATA == simp->link;
+}
 
 /*******************************************************************************/
 /* DEFINITION OF GLOBAL FUNCTIONS                                              */
@@ -48,8 +267,26 @@ void sim8xxInit(Sim8xxDriver *simp) {
   chMtxObjectInit(&simp->lock);
   chMtxObjectInit(&simp->rxlock);
   chSemObjectInit(&simp->sync, 1);
+  chEvtObjectInit(&simp->urcSource);
+  simp->urcs = 0;
+  memset(simp->urcHooks, 0, sizeof(simp->urcHooks));
+  simp->prompt = false;
+  simp->link = SIM8XX_LINK_COMMAND;
+  simp->lastWrite = 0;
+  chSemObjectInit(&simp->window, 0);
+  chSemObjectInit(&simp->idle, 0);
+  simp->pollWaiters = 0;
+  simp->pollHolders = 0;
   memset(simp->rxbuf, 0, sizeof(simp->rxbuf));
   simp->rxlength = 0;
+  simp->ipdlength = 0;
+  simp->ipdexpected = 0;
+  simp->ipdreceived = 0;
+  simp->ipdready = false;
+  simp->readbuf = NULL;
+  simp->readsize = 0;
+  simp->readlength = 0;
+  simp->readexpected = 0;
   simp->state = SIM8XX_STOP;
 }
 
@@ -72,32 +309,126 @@ void sim8xxCommandInit(Sim8xxCommand *cmdp) {
 
 void sim8xxExecute(Sim8xxDriver *simp, Sim8xxCommand *cmdp) {
   chMtxLock(&simp->lock);
-  chSemWait(&simp->sync);
+  escape(simp);
+  transfer(simp, cmdp, NULL, 0);
+  chMtxUnlock(&simp->lock);
+}
+
+/*
+ * The request (e.g. AT+CIPSEND=<length>) is answered with the "> " prompt,
+ * the data is written in the same locked sequence so no other command can
+ * slip in between. The status is the final result of the data.
+ */
+void sim8xxSend(Sim8xxDriver *simp, Sim8xxCommand *cmdp,
+                const uint8_t *data, size_t length) {
+  chMtxLock(&simp->lock);
+  escape(simp);
+  simp->prompt = true;
+  transfer(simp, cmdp, NULL, 0);
+  simp->prompt = false;
+  if (SIM8XX_PROMPT == cmdp->status)
+    transfer(simp, cmdp, data, length);
+  chMtxUnlock(&simp->lock);
+}
 
-  chprintf((BaseSequentialStream*)simp->config->sdp, "%s\r", cmdp->request);
+/*
+ * In transparent mode the connect request (AT+CIPSTART) is answered with OK
+ * first, the modem switches to data mode with the CONNECT URC. The lock is
+ * held until then, so no command can be sent to the server as data.
+ */
+void sim8xxConnect(Sim8xxDriver *simp, Sim8xxCommand *cmdp,
+                   sysinterval_t timeout) {
+  event_listener_t urcListener;
+  chEvtRegisterMaskWithFlags(&simp->urcSource, &urcListener, SIM8XX_URC_EVENT,
+                             CONNECT_URCS);
 
-  chSysLock();
-  msg_t msg = chThdSuspendTimeoutS(&simp->writer, chTimeMS2I(5000));
-  simp->writer = NULL;
-  chSysUnlock();
+  chMtxLock(&simp->lock);
+  escape(simp);
+  sim8xxGetAndClearUrcs(simp, CONNECT_URCS);
+  transfer(simp, cmdp, NULL, 0);
+
+  if (SIM8XX_OK == cmdp->status) {
+    eventflags_t urcs = 0;
+    systime_t start = chVTGetSystemTime();
+    systime_t end = chTimeAddX(start, timeout);
+    while ((0 == (urcs = sim8xxGetAndClearUrcs(simp, CONNECT_URCS))) &&
+           chVTIsSystemTimeWithin(start, end)) {
+      chEvtWaitAnyTimeout(SIM8XX_URC_EVENT,
+                          chTimeDiffX(chVTGetSystemTime(), end));
+    }
+
+    if (urcs & SIM8XX_URC_CONNECT)
+      cmdp->status = SIM8XX_CONNECT;
+    else
+      cmdp->status = urcs ? SIM8XX_ERROR : SIM8XX_TIMEOUT;
+  }
 
-  if (MSG_OK == msg) {
-    chMtxLock(&simp->rxlock);
-    strcpy(cmdp->response, simp->rxbuf);
-    cmdp->status = sim8xxGetStatus(cmdp->response);
-    chMtxUnlock(&simp->rxlock);
-  } else {
-    chSemSignal(&simp->sync);
-    cmdp->status = SIM8XX_TIMEOUT;
+  simp->lastWrite = chVTGetSystemTime();
+  chMtxUnlock(&simp->lock);
+  chEvtUnregister(&simp->urcSource, &urcListener);
+}
+
+/*
+ * Data written on a transparent link goes to the server as is.
+ */
+bool sim8xxWrite(Sim8xxDriver *simp, const uint8_t *data, size_t length) {
+  chMtxLock(&simp->lock);
+  bool result = resume(simp);
+  if (result) {
+    chnWrite(simp->config->sdp, data, length);
+    simp->lastWrite = chVTGetSystemTime();
   }
+  chMtxUnlock(&simp->lock);
+  return result;
+}
 
-  if (simp->reader) {
-    chSysLock();
-    chThdResumeS(&simp->reader, MSG_OK);
-    chSysUnlock();
+Sim8xxLink_t sim8xxGetLink(Sim8xxDriver *simp) {
+  return simp->link;
+}
+
+/*
+ * Periodic queries that are not worth an escape of a transparent link wait
+ * for the next escape window instead, up to the timeout. Until
+ * sim8xxPollEnd() the link is not resumed, so the commands of the caller
+ * need no escape of their own. Returns false if no window was opened.
+ */
+bool sim8xxPollBegin(Sim8xxDriver *simp, sysinterval_t timeout) {
+  chMtxLock(&simp->lock);
+  if (SIM8XX_LINK_DATA == simp->link) {
+    simp->pollWaiters++;
+    waitUnlocked(simp, &simp->window, timeout);
+    simp->pollWaiters--;
   }
 
+  bool admitted = (SIM8XX_LINK_DATA != simp->link);
+  if (admitted)
+    simp->pollHolders++;
+  else
+    checkIdle(simp);
+  chMtxUnlock(&simp->lock);
+  return admitted;
+}
+
+void sim8xxPollEnd(Sim8xxDriver *simp) {
+  chMtxLock(&simp->lock);
+  if (simp->pollHolders > 0U)
+    simp->pollHolders--;
+  checkIdle(simp);
+  chMtxUnlock(&simp->lock);
+}
+
+/*
+ * Called by the owner of the transparent link between two writes, escapes
+ * it if a poller waits. The guard time before the escape sequence runs from
+ * the last write.
+ */
+bool sim8xxOpenWindow(Sim8xxDriver *simp) {
+  chMtxLock(&simp->lock);
+  bool open = (SIM8XX_LINK_DATA == simp->link) && (simp->pollWaiters > 0U);
+  if (open)
+    escape(simp);
   chMtxUnlock(&simp->lock);
+  return open && (SIM8XX_LINK_ONLINE_COMMAND == simp->link);
 }
 
 Sim8xxCommandStatus_t sim8xxGetStatus(char *data) {
@@ -105,6 +436,9 @@ Sim8xxCommandStatus_t sim8xxGetStatus(char *data) {
   if(length < 2)
     return SIM8XX_INVALID_STATUS;
 
+  if (0 == strcmp(data + length - 2, "> "))
+    return SIM8XX_PROMPT;
+
   if (('\r' != data[length-2]) || ('\n' != data[length-1]))
     return SIM8XX_INVALID_STATUS;
 
@@ -134,6 +468,14 @@ Sim8xxCommandStatus_t sim8xxGetStatus(char *data) {
     status = SIM8XX_NO_ANSWER;
   else if (0 == strcmp(needle, "PROCEEDING"))
     status = SIM8XX_PROCEEDING;
+  else if (0 == strcmp(needle, "SEND OK"))
+    status = SIM8XX_SEND_OK;
+  else if (0 == strcmp(needle, "SEND FAIL"))
+    status = SIM8XX_SEND_FAIL;
+  else if (0 == strcmp(needle, "SHUT OK"))
+    status = SIM8XX_SHUT_OK;
+  else if (0 == strcmp(needle, "CLOSE OK"))
+    status = SIM8XX_CLOSE_OK;
   else
     status = SIM8XX_INVALID_STATUS;
 
@@ -143,13 +485,18 @@ Sim8xxCommandStatus_t sim8xxGetStatus(char *data) {
 }
 
 bool sim8xxIsConnected(Sim8xxDriver *simp) {
+  return sim8xxProbe(simp, TIME_MS2I(CONNECT_TIMEOUT_IN_MS));
+}
+
+bool sim8xxProbe(Sim8xxDriver *simp, sysinterval_t timeout) {
   chMtxLock(&simp->lock);
+  escape(simp);
   chSemWait(&simp->sync);
 
   chprintf((BaseSequentialStream*)simp->config->sdp, "at\r");
 
   chSysLock();
-  msg_t msg = chThdSuspendTimeoutS(&simp->writer, chTimeMS2I(1000));
+  msg_t msg = chThdSuspendTimeoutS(&simp->writer, timeout);
   simp->writer = NULL;
   chSysUnlock();
 
@@ -181,9 +528,142 @@ void sim8xxTogglePower(Sim8xxDriver *simp) {
   chThdSleepMilliseconds(2500);
   palSetLine(simp->config->powerline);
   chThdSleepMilliseconds(1000);
-  chSemSignal(&simp->sync);
   chMtxUnlock(&simp->lock);
 }
 
+/*
+ * The power key toggles the modem, so it is only pulsed after the modem
+ * failed to answer several probes and did not report booting for a while.
+ */
+void sim8xxPowerOn(Sim8xxDriver *simp) {
+  event_listener_t urcListener;
+  chEvtRegisterMaskWithFlags(&simp->urcSource, &urcListener, SIM8XX_URC_EVENT,
+                             BOOT_URCS);
+
+  Sim8xxPowerState_t state = SIM8XX_POWER_PROBE;
+
+  while (SIM8XX_POWER_READY != state) {
+    switch (state) {
+      case SIM8XX_POWER_PROBE: {
+        state = probeWithRetries(simp, PROBE_RETRIES) ? SIM8XX_POWER_READY
+                                                      : SIM8XX_POWER_TOGGLE;
+        break;
+      }
+      case SIM8XX_POWER_TOGGLE: {
+        sim8xxGetAndClearUrcs(simp, BOOT_URCS | SIM8XX_URC_POWER_DOWN);
+        sim8xxTogglePower(simp);
+        state = SIM8XX_POWER_BOOTING;
+        break;
+      }
+      case SIM8XX_POWER_BOOTING: {
+        state = waitBoot(simp);
+        break;
+      }
+      default: {
+        state = SIM8XX_POWER_PROBE;
+      }
+    }
+  }
+
+  chEvtUnregister(&simp->urcSource, &urcListener);
+}
+
+/*
+ * AT+CPOWD=1 shuts the modem down cleanly, the power key is pulsed once when
+ * it still answers afterwards. Pulsing it again could only turn a slowly
+ * stopping modem back on.
+ */
+bool sim8xxPowerOff(Sim8xxDriver *simp) {
+  if (!probeWithRetries(simp, PROBE_RETRIES))
+    return true;
+
+  event_listener_t urcListener;
+  chEvtRegisterMaskWithFlags(&simp->urcSource, &urcListener, SIM8XX_URC_EVENT,
+                             SIM8XX_URC_POWER_DOWN);
+  sim8xxGetAndClearUrcs(simp, SIM8XX_URC_POWER_DOWN);
+  sendPowerDown(simp);
+
+  bool down = waitPowerDown(simp);
+  if (!down) {
+    sim8xxGetAndClearUrcs(simp, SIM8XX_URC_POWER_DOWN);
+    sim8xxTogglePower(simp);
+    down = waitPowerDown(simp);
+  }
+  chEvtUnregister(&simp->urcSource, &urcListener);
+
+  return down;
+}
+
+eventflags_t sim8xxGetAndClearUrcs(Sim8xxDriver *simp, eventflags_t mask) {
+  chSysLock();
+  eventflags_t urcs = simp->urcs & mask;
+  simp->urcs &= ~mask;
+  chSysUnlock();
+  return urcs;
+}
+
+/*
+ * The flags only tell that a URC arrived, the hooks of the matching mask
+ * get its parameters. Returns false if every hook is in use.
+ */
+bool sim8xxAddUrcHook(Sim8xxDriver *simp, eventflags_t mask,
+                      Sim8xxUrcHook_t hook) {
+  bool added = false;
+  size_t i;
+  chSysLock();
+  for (i = 0; (i < SIM8XX_URC_HOOKS) && !added; ++i) {
+    if (NULL == simp->urcHooks[i].hook) {
+      simp->urcHooks[i].mask = mask;
+      simp->urcHooks[i].hook = hook;
+      added = true;
+    }
+  }
+  chSysUnlock();
+  return added;
+}
+
+/*
+ * Only the latest packet received with the +IPD header is kept, it is
+ * announced by the SIM8XX_URC_IPD flag. Returns 0 if nothing is waiting.
+ */
+size_t sim8xxReceive(Sim8xxDriver *simp, uint8_t *data, size_t size) {
+  size_t length = 0;
+  chSysLock();
+  if (simp->ipdready) {
+    length = (simp->ipdlength < size) ? simp->ipdlength : size;
+    memcpy(data, simp->ipdbuf, length);
+    simp->ipdready = false;
+  }
+  chSysUnlock();
+  return length;
+}
+
+/*
+ * The data of a read command (AT+HTTPREAD) follows a "+HTTPREAD: <length>"
+ * line and may contain anything. It goes to the buffer of the caller, the
+ * rest of a longer answer is dropped.
+ */
+size_t sim8xxRead(Sim8xxDriver *simp, Sim8xxCommand *cmdp, uint8_t *data,
+                  size_t size) {
+  chMtxLock(&simp->lock);
+  escape(simp);
+  chSysLock();
+  simp->readbuf = data;
+  simp->readsize = size;
+  simp->readlength = 0;
+  chSysUnlock();
+
+  transfer(simp, cmdp, NULL, 0);
+
+  /* After a timeout the rest of the data is dropped by the reader. */
+  chSysLock();
+  size_t length = simp->readlength;
+  simp->readbuf = NULL;
+  simp->readsize = 0;
+  chSysUnlock();
+  chMtxUnlock(&simp->lock);
+  return length;
+}
+
 /******************************* END OF FILE ***********************************/
 
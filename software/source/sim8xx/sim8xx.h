@@ -16,6 +16,42 @@
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
+/**
+ * @brief Unsolicited result codes, broadcast as flags of urcSource.
+ */
+#define SIM8XX_URC_RDY                 ((eventflags_t)1 << 0)
+#define SIM8XX_URC_CPIN_READY          ((eventflags_t)1 << 1)
+#define SIM8XX_URC_CALL_READY          ((eventflags_t)1 << 2)
+#define SIM8XX_URC_SMS_READY           ((eventflags_t)1 << 3)
+#define SIM8XX_URC_POWER_DOWN          ((eventflags_t)1 << 4)
+#define SIM8XX_URC_RING                ((eventflags_t)1 << 5)
+#define SIM8XX_URC_CONNECT_OK          ((eventflags_t)1 << 6)
+#define SIM8XX_URC_CONNECT_FAIL        ((eventflags_t)1 << 7)
+#define SIM8XX_URC_CLOSED              ((eventflags_t)1 << 8)
+#define SIM8XX_URC_CONNECT             ((eventflags_t)1 << 9)
+#define SIM8XX_URC_CREG                ((eventflags_t)1 << 10)
+#define SIM8XX_URC_CGREG               ((eventflags_t)1 << 11)
+#define SIM8XX_URC_IPD                 ((eventflags_t)1 << 12)
+#define SIM8XX_URC_CMTI                ((eventflags_t)1 << 13)
+#define SIM8XX_URC_CLIP                ((eventflags_t)1 << 14)
+#define SIM8XX_URC_HTTPACTION          ((eventflags_t)1 << 15)
+
+/**
+ * @brief Number of URC hooks the applications can install.
+ */
+#define SIM8XX_URC_HOOKS               4
+
+/**
+ * @brief Event of the calling thread the driver waits for URCs on, threads
+ *        using the driver must not take it for their own events.
+ */
+#define SIM8XX_URC_EVENT               EVENT_MASK(31)
+
+/**
+ * @brief Size of the buffer of received data, the rest of a longer packet
+ *        is dropped.
+ */
+#define SIM8XX_IPD_BUFFER_SIZE         128
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -30,6 +66,27 @@ typedef enum {
   SIM8XX_READY = 2,
 } sim8xxstate_t;
 
+/**
+ * @brief State of the serial link while a transparent connection is used.
+ */
+typedef enum {
+  SIM8XX_LINK_COMMAND = 0,         /**< AT commands, no transparent link. */
+  SIM8XX_LINK_DATA = 1,            /**< Serial data goes to the server.   */
+  SIM8XX_LINK_ONLINE_COMMAND = 2   /**< Escaped, the connection is kept.  */
+} Sim8xxLink_t;
+
+/**
+ * @brief Called from the reader thread with every URC line, the line is not
+ *        terminated.
+ */
+typedef void (*Sim8xxUrcHook_t)(eventflags_t flag, const char *line,
+                                size_t length);
+
+typedef struct {
+  eventflags_t mask;
+  Sim8xxUrcHook_t hook;
+} Sim8xxUrcHookEntry_t;
+
 typedef struct Sim8xxConfig {
   SerialDriver *sdp;
   SerialConfig *sdConfig;
@@ -44,8 +101,27 @@ typedef struct Sim8xxDriver {
   mutex_t lock;
   mutex_t rxlock;
   semaphore_t sync;
+  event_source_t urcSource;
+  eventflags_t urcs;
+  Sim8xxUrcHookEntry_t urcHooks[SIM8XX_URC_HOOKS];
+  bool prompt;
+  Sim8xxLink_t link;
+  systime_t lastWrite;
+  semaphore_t window;
+  semaphore_t idle;
+  size_t pollWaiters;
+  size_t pollHolders;
   char rxbuf[512];
   size_t rxlength;
+  uint8_t ipdbuf[SIM8XX_IPD_BUFFER_SIZE];
+  size_t ipdlength;
+  size_t ipdexpected;
+  size_t ipdreceived;
+  bool ipdready;
+  uint8_t *readbuf;
+  size_t readsize;
+  size_t readlength;
+  size_t readexpected;
 } Sim8xxDriver;
 
 typedef enum {
@@ -58,6 +134,11 @@ typedef enum {
   SIM8XX_BUSY,
   SIM8XX_NO_ANSWER,
   SIM8XX_PROCEEDING,
+  SIM8XX_PROMPT,
+  SIM8XX_SEND_OK,
+  SIM8XX_SEND_FAIL,
+  SIM8XX_SHUT_OK,
+  SIM8XX_CLOSE_OK,
   SIM8XX_TIMEOUT,
   SIM8XX_INVALID_STATUS
 } Sim8xxCommandStatus_t;
@@ -66,6 +147,7 @@ typedef struct Sim8xxCommand {
   char request[512];
   char response[512];
   Sim8xxCommandStatus_t status;
+  sysinterval_t timeout;
 } Sim8xxCommand;
 
 /*******************************************************************************/
@@ -80,8 +162,29 @@ void sim8xxInit(Sim8xxDriver *simp);
 void sim8xxStart(Sim8xxDriver *simp, Sim8xxConfig *cfgp);
 void sim8xxCommandInit(Sim8xxCommand *cmdp);
 void sim8xxExecute(Sim8xxDriver *simp, Sim8xxCommand *cmdp);
+void sim8xxSend(Sim8xxDriver *simp, Sim8xxCommand *cmdp,
+                const uint8_t *data, size_t length);
+void sim8xxConnect(Sim8xxDriver *simp, Sim8xxCommand *cmdp,
+                   sysinterval_t timeout);
+bool sim8xxWrite(Sim8xxDriver *simp, const uint8_t *data, size_t length);
+Sim8xxLink_t sim8xxGetLink(Sim8xxDriver *simp);
+bool sim8xxPollBegin(Sim8xxDriver *simp, sysinterval_t timeout);
+void sim8xxPollEnd(Sim8xxDriver *simp);
+bool sim8xxOpenWindow(Sim8xxDriver *simp);
 bool sim8xxIsConnected(Sim8xxDriver *simp);
+bool sim8xxProbe(Sim8xxDriver *simp, sysinterval_t timeout);
 void sim8xxTogglePower(Sim8xxDriver *simp);
+void sim8xxPowerOn(Sim8xxDriver *simp);
+/**
+ * @brief Shut the modem down, false when it still answers afterwards.
+ */
+bool sim8xxPowerOff(Sim8xxDriver *simp);
+eventflags_t sim8xxGetAndClearUrcs(Sim8xxDriver *simp, eventflags_t mask);
+bool sim8xxAddUrcHook(Sim8xxDriver *simp, eventflags_t mask,
+                      Sim8xxUrcHook_t hook);
+size_t sim8xxReceive(Sim8xxDriver *simp, uint8_t *data, size_t size);
+size_t sim8xxRead(Sim8xxDriver *simp, Sim8xxCommand *cmdp, uint8_t *data,
+                  size_t size);
 Sim8xxCommandStatus_t sim8xxGetStatus(char *data);
 
 #endif
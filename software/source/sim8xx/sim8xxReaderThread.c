@@ -9,6 +9,8 @@
 /*******************************************************************************/
 #include "sim8xx.h"
 #include "sim8xxReaderThread.h"
+#include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 #include "source/Sdcard.h"
 
@@ -16,10 +18,16 @@
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
 #define GUARD_TIME_IN_MS               250
+#define DATA_TAIL_LENGTH               16
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
+typedef struct {
+  const char *prefix;
+  eventflags_t flag;
+  bool response;
+} Sim8xxUrc_t;
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -30,6 +38,31 @@
 /*******************************************************************************/
 static virtual_timer_t guard_timer;
 
+/*
+ * Lines that can also be the response of a command are only treated as URC
+ * while no command is waiting for its response.
+ */
+static const Sim8xxUrc_t urcs[] = {
+  {"RDY", SIM8XX_URC_RDY, false},
+  {"+CPIN: READY", SIM8XX_URC_CPIN_READY, true},
+  {"Call Ready", SIM8XX_URC_CALL_READY, false},
+  {"SMS Ready", SIM8XX_URC_SMS_READY, false},
+  {"NORMAL POWER DOWN", SIM8XX_URC_POWER_DOWN, false},
+  {"UNDER-VOLTAGE POWER DOWN", SIM8XX_URC_POWER_DOWN, false},
+  {"OVER-VOLTAGE POWER DOWN", SIM8XX_URC_POWER_DOWN, false},
+  {"RING", SIM8XX_URC_RING, false},
+  {"CONNECT OK", SIM8XX_URC_CONNECT_OK, false},
+  {"CONNECT FAIL", SIM8XX_URC_CONNECT_FAIL, false},
+  {"ALREADY CONNECT", SIM8XX_URC_CONNECT_OK, false},
+  {"CLOSED", SIM8XX_URC_CLOSED, false},
+  {"CONNECT", SIM8XX_URC_CONNECT, true},
+  {"+CREG: ", SIM8XX_URC_CREG, true},
+  {"+CGREG: ", SIM8XX_URC_CGREG, true},
+  {"+CMTI: ", SIM8XX_URC_CMTI, false},
+  {"+CLIP: ", SIM8XX_URC_CLIP, false},
+  {"+HTTPACTION: ", SIM8XX_URC_HTTPACTION, false},
+};
+
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
 /*******************************************************************************/
@@ -46,28 +79,248 @@ static void save_buffer(const char *data, size_t length) {
   }
 }
 
+/*
+ * A final result nobody waits for (e.g. the late answer of a timed out
+ * command) is dropped, otherwise the reader would stay suspended until the
+ * next command times out as well.
+ */
 static bool process_response(Sim8xxDriver *simp) {
-  if (SIM8XX_INVALID_STATUS == sim8xxGetStatus(simp->rxbuf))
+  Sim8xxCommandStatus_t status = sim8xxGetStatus(simp->rxbuf);
+  if (SIM8XX_INVALID_STATUS == status)
+    return false;
+
+  if ((SIM8XX_PROMPT == status) && !simp->prompt)
     return false;
 
   chSysLock();
   if (simp->writer) {
     chThdResumeS(&simp->writer, MSG_OK);
+    chSysUnlock();
+    return true;
   }
-  
   chSysUnlock();
-  
-  return true;
-}
 
-static bool process_urc(Sim8xxDriver *simp) {
-  // send appropriate urc event
-  (void)simp;
+  save_buffer(simp->rxbuf, simp->rxlength);
+  memset(simp->rxbuf, 0, sizeof(simp->rxbuf));
+  simp->rxlength = 0;
   return false;
 }
 
+static const Sim8xxUrc_t *find_urc(const char *line, size_t length,
+                                   bool busy) {
+  size_t i;
+  for (i = 0; i < sizeof(urcs)/sizeof(urcs[0]); ++i) {
+    size_t prefixLength = strlen(urcs[i].prefix);
+    if ((length >= prefixLength) &&
+        (0 == strncmp(line, urcs[i].prefix, prefixLength)) &&
+        !(busy && urcs[i].response))
+      return &urcs[i];
+  }
+  return NULL;
+}
+
+static bool is_empty_line_before(const Sim8xxDriver *simp, const char *line) {
+  const char *begin = line - 2;
+  if ((begin < simp->rxbuf) || strncmp(begin, "\r\n", 2))
+    return false;
+  return (begin == simp->rxbuf) ||
+         ((begin >= simp->rxbuf + 2) && (0 == strncmp(begin - 2, "\r\n", 2)));
+}
+
+static void call_hooks(Sim8xxDriver *simp, eventflags_t flag,
+                       const char *line, size_t length) {
+  size_t i;
+  for (i = 0; i < SIM8XX_URC_HOOKS; ++i) {
+    const Sim8xxUrcHookEntry_t *entry = &simp->urcHooks[i];
+    if (entry->hook && (entry->mask & flag))
+      entry->hook(flag, line, length);
+  }
+}
+
+/*
+ * Complete URC lines are removed from the buffer together with the empty
+ * line before them, so the reader keeps reading and does not suspend.
+ */
+static void process_urc(Sim8xxDriver *simp) {
+  bool busy = (NULL != simp->writer);
+  eventflags_t flags = 0;
+  char *line = simp->rxbuf;
+  char *end;
+
+  while (NULL != (end = strstr(line, "\r\n"))) {
+    const Sim8xxUrc_t *urc = find_urc(line, end - line, busy);
+    if (urc) {
+      call_hooks(simp, urc->flag, line, end - line);
+      char *begin = is_empty_line_before(simp, line) ? line - 2 : line;
+      end += 2;
+      memmove(begin, end, simp->rxlength - (end - simp->rxbuf) + 1);
+      simp->rxlength -= end - begin;
+      flags |= urc->flag;
+      line = begin;
+    } else {
+      line = end + 2;
+    }
+  }
+
+  if (flags & SIM8XX_URC_CONNECT)
+    simp->link = SIM8XX_LINK_DATA;
+  if (flags & SIM8XX_URC_CLOSED)
+    simp->link = SIM8XX_LINK_COMMAND;
+
+  if (flags) {
+    chSysLock();
+    simp->urcs |= flags;
+    chEvtBroadcastFlagsI(&simp->urcSource, flags);
+    chSchRescheduleS();
+    chSysUnlock();
+  }
+}
+
+/*
+ * Data from the server is dropped on a transparent link, only the end of
+ * the connection is watched for. A short tail is kept in case the report
+ * is split between reads.
+ */
+static void process_data(Sim8xxDriver *simp) {
+  if (strstr(simp->rxbuf, "CLOSED\r\n") ||
+      strstr(simp->rxbuf, "NO CARRIER\r\n")) {
+    simp->link = SIM8XX_LINK_COMMAND;
+    chSysLock();
+    simp->urcs |= SIM8XX_URC_CLOSED;
+    chEvtBroadcastFlagsI(&simp->urcSource, SIM8XX_URC_CLOSED);
+    chSchRescheduleS();
+    chSysUnlock();
+    memset(simp->rxbuf, 0, sizeof(simp->rxbuf));
+    simp->rxlength = 0;
+  } else if (simp->rxlength > DATA_TAIL_LENGTH) {
+    memmove(simp->rxbuf, simp->rxbuf + simp->rxlength - DATA_TAIL_LENGTH,
+            DATA_TAIL_LENGTH);
+    memset(simp->rxbuf + DATA_TAIL_LENGTH, 0,
+           sizeof(simp->rxbuf) - DATA_TAIL_LENGTH);
+    simp->rxlength = DATA_TAIL_LENGTH;
+  }
+}
+
 static bool process_message(Sim8xxDriver *simp) {
-  return process_response(simp) || process_urc(simp);
+  if (SIM8XX_LINK_DATA == simp->link) {
+    process_data(simp);
+    return false;
+  }
+  process_urc(simp);
+  return process_response(simp);
+}
+
+/*
+ * "+IPD,<length>:" at the beginning of a line starts binary data that may
+ * contain anything, the header is removed and the data bypasses the line
+ * buffer.
+ */
+static bool start_ipd(Sim8xxDriver *simp) {
+  const char *prefix = "+IPD,";
+  const size_t prefixLength = strlen(prefix);
+  char *colon = simp->rxbuf + simp->rxlength - 1;
+  char *digits = colon;
+
+  if ((SIM8XX_LINK_COMMAND != simp->link) || (':' != *colon))
+    return false;
+
+  while ((digits > simp->rxbuf) && isdigit((unsigned char)digits[-1]))
+    digits--;
+
+  char *begin = digits - prefixLength;
+  if ((digits == colon) || (begin < simp->rxbuf) ||
+      strncmp(begin, prefix, prefixLength) ||
+      ((begin > simp->rxbuf) && ('\n' != begin[-1])))
+    return false;
+
+  /* A packet not read yet is replaced by the new one. */
+  chSysLock();
+  simp->ipdready = false;
+  chSysUnlock();
+
+  simp->ipdexpected = strtoul(digits, NULL, 10);
+  simp->ipdreceived = 0;
+  simp->rxlength = begin - simp->rxbuf;
+  memset(begin, 0, colon - begin + 1);
+  return simp->ipdexpected > 0;
+}
+
+static void receive_ipd(Sim8xxDriver *simp, char c) {
+  if (simp->ipdreceived < SIM8XX_IPD_BUFFER_SIZE)
+    simp->ipdbuf[simp->ipdreceived] = (uint8_t)c;
+  simp->ipdreceived++;
+
+  if (simp->ipdreceived == simp->ipdexpected) {
+    chSysLock();
+    simp->ipdlength = (simp->ipdreceived < SIM8XX_IPD_BUFFER_SIZE)
+                          ? simp->ipdreceived
+                          : SIM8XX_IPD_BUFFER_SIZE;
+    simp->ipdready = true;
+    simp->ipdexpected = 0;
+    simp->urcs |= SIM8XX_URC_IPD;
+    chEvtBroadcastFlagsI(&simp->urcSource, SIM8XX_URC_IPD);
+    chSchRescheduleS();
+    chSysUnlock();
+  }
+}
+
+/*
+ * A complete "+HTTPREAD: <length>" line starts the data of sim8xxRead(), the
+ * line is kept for the response.
+ */
+static bool start_read(Sim8xxDriver *simp) {
+  const char *prefix = "+HTTPREAD: ";
+  const size_t prefixLength = strlen(prefix);
+  char *end = simp->rxbuf + simp->rxlength;
+
+  if (!simp->readbuf || (simp->rxlength < prefixLength + 3) ||
+      strncmp(end - 2, "\r\n", 2))
+    return false;
+
+  char *digits = end - 2;
+  while ((digits > simp->rxbuf) && isdigit((unsigned char)digits[-1]))
+    digits--;
+
+  char *begin = digits - prefixLength;
+  if ((digits == end - 2) || (begin < simp->rxbuf) ||
+      strncmp(begin, prefix, prefixLength) ||
+      ((begin > simp->rxbuf) && ('\n' != begin[-1])))
+    return false;
+
+  simp->readexpected = strtoul(digits, NULL, 10);
+  return simp->readexpected > 0;
+}
+
+static void receive_read(Sim8xxDriver *simp, char c) {
+  if (simp->readbuf && (simp->readlength < simp->readsize))
+    simp->readbuf[simp->readlength++] = (uint8_t)c;
+  simp->readexpected--;
+}
+
+/*
+ * The echo of raw data sent after a prompt can be longer than the buffer,
+ * the oldest half is dropped so the final result at the end is kept.
+ */
+static void append_char(Sim8xxDriver *simp, char c) {
+  const size_t size = sizeof(simp->rxbuf) - 1;
+  if (simp->rxlength == size) {
+    memmove(simp->rxbuf, simp->rxbuf + size / 2, size - size / 2);
+    simp->rxlength = size - size / 2;
+    memset(simp->rxbuf + simp->rxlength, 0, size - simp->rxlength);
+  }
+  simp->rxbuf[simp->rxlength++] = c;
+}
+
+static void receive_char(Sim8xxDriver *simp, char c) {
+  if (simp->ipdexpected > 0) {
+    receive_ipd(simp, c);
+  } else if (simp->readexpected > 0) {
+    receive_read(simp, c);
+  } else if ('\0' != c) {
+    append_char(simp, c);
+    if (!start_ipd(simp))
+      start_read(simp);
+  }
 }
 
 static void timer_cb(void *p) {
@@ -102,8 +355,8 @@ THD_FUNCTION(sim8xxReaderThread, arg) {
           msg_t c;
           do {
             c = chnGetTimeout(simp->config->sdp, TIME_IMMEDIATE);
-            if ( c != STM_TIMEOUT )
-              simp->rxbuf[simp->rxlength++] = (char)c;
+            if (c != STM_TIMEOUT)
+              receive_char(simp, (char)c);
           }
           while (c != STM_TIMEOUT);
         }
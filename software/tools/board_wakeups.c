@@ -0,0 +1,343 @@
+/**
+ * @file board_wakeups.c
+ * @brief Host model of the board input wakeup rate, polling against edges.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -o board_wakeups tools/board_wakeups.c
+ *   ./board_wakeups [seed]
+ *
+ * A scripted idle hour and a riding hour drive the inputs of the board monitor
+ * with bouncing transitions. Both debouncers are replayed against them:
+ *
+ *   - the original one, sampling every input on a 10 ms virtual timer and
+ *     reporting a line after ten equal samples,
+ *   - the current one, where every edge restarts a per input debounce timer
+ *     and the thread samples the line once it expires, with SW1 sampled every
+ *     250 ms because it shares EXTI line 9 with USB VBUS, only while the
+ *     ignition or USB is reported on.
+ *
+ * A wakeup is every time the CPU leaves idle: a timer expiry or an edge
+ * interrupt. The current debouncer has to report every scripted transition
+ * exactly once and end in the scripted state, and so does the original one
+ * for the card detect and VBUS lines it covered, otherwise the check fails.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define US_PER_MS            1000LL
+#define HOUR_IN_US           (3600LL * 1000 * US_PER_MS)
+#define MAX_TOGGLES          4096
+#define OLD_PERIOD_IN_US     (10 * US_PER_MS)
+#define OLD_COUNTER_START    10
+#define POLL_PERIOD_IN_US    (250 * US_PER_MS)
+
+typedef enum {
+  IN_SDCARD,
+  IN_USB,
+  IN_IGNITION,
+  IN_SW1,
+  IN_SW2,
+  IN_ACC_INT1,
+  IN_ACC_INT2,
+  IN_NUM,
+} Input_t;
+
+typedef struct {
+  const char *name;
+  long long debounce;
+  bool polled;
+  bool original;
+  long long toggles[MAX_TOGGLES];
+  size_t toggleNum;
+  bool initial;
+  unsigned transitions;
+} Line_t;
+
+typedef struct {
+  unsigned long long wakeups;
+  unsigned reported[IN_NUM];
+  bool state[IN_NUM];
+  long long longestIdle;
+} Result_t;
+
+static Line_t lines[IN_NUM] = {
+  {.name = "sdcard", .debounce = 100 * US_PER_MS, .original = true},
+  {.name = "usb", .debounce = 100 * US_PER_MS, .original = true},
+  {.name = "ignition", .debounce = 100 * US_PER_MS},
+  {.name = "sw1", .debounce = 100 * US_PER_MS, .polled = true},
+  {.name = "sw2", .debounce = 100 * US_PER_MS},
+  {.name = "acc int1", .debounce = 2 * US_PER_MS},
+  {.name = "acc int2", .debounce = 2 * US_PER_MS},
+};
+
+static double uniform(void) { return rand() / (RAND_MAX + 1.0); }
+
+static void addToggle(Line_t *l, long long t) {
+  if (l->toggleNum < MAX_TOGGLES)
+    l->toggles[l->toggleNum++] = t;
+}
+
+/*
+ * A mechanical contact or opto input chatters for a few milliseconds, the
+ * accelerometer interrupt is a clean pulse.
+ */
+static void addTransition(Line_t *l, long long t, bool bounce) {
+  if (bounce) {
+    int n = 2 * (1 + rand() % 6);
+    int i;
+    for (i = 0; i < n; ++i) {
+      addToggle(l, t);
+      t += 50 + (long long)(uniform() * 800);
+    }
+  }
+  addToggle(l, t);
+  l->transitions++;
+}
+
+static void addPulse(Line_t *l, long long t, long long width, bool bounce) {
+  addTransition(l, t, bounce);
+  addTransition(l, t + width, bounce);
+}
+
+static bool level(const Line_t *l, long long t) {
+  bool v = l->initial;
+  size_t i;
+  for (i = 0; i < l->toggleNum && l->toggles[i] <= t; ++i)
+    v = !v;
+  return v;
+}
+
+static int compareTime(const void *a, const void *b) {
+  long long x = *(const long long *)a, y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+static void sortToggles(void) {
+  size_t i;
+  for (i = 0; i < IN_NUM; ++i)
+    qsort(lines[i].toggles, lines[i].toggleNum, sizeof(long long),
+          compareTime);
+}
+
+static void reset(void) {
+  size_t i;
+  for (i = 0; i < IN_NUM; ++i) {
+    lines[i].toggleNum = 0;
+    lines[i].transitions = 0;
+    lines[i].initial = false;
+  }
+}
+
+/*
+ * Idle: ignition off but not yet asleep, the card is in, nothing moves apart
+ * from a few bumps of the bike.
+ */
+static void scriptIdle(void) {
+  reset();
+  lines[IN_SDCARD].initial = true;
+  int i;
+  for (i = 0; i < 6; ++i)
+    addPulse(&lines[IN_ACC_INT1], (long long)(uniform() * (HOUR_IN_US - 1e6)),
+             50 * US_PER_MS, false);
+}
+
+/*
+ * Riding: ignition on at the start and off at the end, the switches pressed
+ * now and then, the bike plugged into USB for the last quarter.
+ */
+static void scriptRiding(void) {
+  reset();
+  lines[IN_SDCARD].initial = true;
+  addTransition(&lines[IN_IGNITION], 1000 * US_PER_MS, true);
+  addTransition(&lines[IN_IGNITION], HOUR_IN_US - 5000 * US_PER_MS, true);
+  addTransition(&lines[IN_USB], 2700LL * 1000 * US_PER_MS, true);
+  long long t;
+  for (t = 60LL * 1000 * US_PER_MS; t < HOUR_IN_US - 60LL * 1000 * US_PER_MS;
+       t += 300LL * 1000 * US_PER_MS) {
+    addPulse(&lines[IN_SW1], t + (long long)(uniform() * 1e6),
+             (600 + (long long)(uniform() * 900)) * US_PER_MS, true);
+    addPulse(&lines[IN_SW2], t + 150LL * 1000 * US_PER_MS,
+             (600 + (long long)(uniform() * 900)) * US_PER_MS, true);
+  }
+}
+
+/*
+ * Original debouncer: ten equal samples report an activation, one inactive
+ * sample reports the release.
+ */
+static void runPolling(Result_t *r) {
+  int counter[IN_NUM];
+  size_t cursor[IN_NUM] = {0};
+  bool now[IN_NUM];
+  size_t i;
+  for (i = 0; i < IN_NUM; ++i) {
+    counter[i] = OLD_COUNTER_START;
+    now[i] = lines[i].initial;
+    r->state[i] = false;
+    r->reported[i] = 0;
+  }
+  r->wakeups = 0;
+  r->longestIdle = OLD_PERIOD_IN_US;
+
+  long long t;
+  for (t = OLD_PERIOD_IN_US; t <= HOUR_IN_US; t += OLD_PERIOD_IN_US) {
+    r->wakeups++;
+    for (i = 0; i < IN_NUM; ++i) {
+      Line_t *l = &lines[i];
+      while (cursor[i] < l->toggleNum && l->toggles[cursor[i]] <= t) {
+        now[i] = !now[i];
+        cursor[i]++;
+      }
+      if (counter[i] > 0) {
+        if (now[i]) {
+          if (--counter[i] == 0) {
+            r->state[i] = true;
+            r->reported[i]++;
+          }
+        } else {
+          counter[i] = OLD_COUNTER_START;
+        }
+      } else if (!now[i]) {
+        counter[i] = OLD_COUNTER_START;
+        r->state[i] = false;
+        r->reported[i]++;
+      }
+    }
+  }
+}
+
+static void wake(Result_t *r, long long *last, long long t) {
+  r->wakeups++;
+  if (t - *last > r->longestIdle)
+    r->longestIdle = t - *last;
+  *last = t;
+}
+
+/*
+ * Current debouncer: edges and debounce expiries per input, merged in time
+ * order with the SW1 poll timer.
+ */
+static void runEdges(Result_t *r) {
+  size_t cursor[IN_NUM] = {0};
+  long long deadline[IN_NUM];
+  bool sample[IN_NUM];
+  size_t i;
+  for (i = 0; i < IN_NUM; ++i) {
+    /* The thread arms every debounce timer once at startup. */
+    deadline[i] = lines[i].polled ? -1 : lines[i].debounce;
+    sample[i] = lines[i].initial;
+    r->state[i] = false;
+    r->reported[i] = 0;
+  }
+  r->wakeups = 0;
+  r->longestIdle = 0;
+  long long last = 0;
+  long long poll = -1;
+
+  while (true) {
+    long long next = (poll >= 0) ? poll : HOUR_IN_US + 1;
+    int who = -1;
+    bool edge = false;
+    for (i = 0; i < IN_NUM; ++i) {
+      const Line_t *l = &lines[i];
+      if (!l->polled && cursor[i] < l->toggleNum &&
+          l->toggles[cursor[i]] < next) {
+        next = l->toggles[cursor[i]];
+        who = (int)i;
+        edge = true;
+      }
+      if (deadline[i] >= 0 && deadline[i] < next) {
+        next = deadline[i];
+        who = (int)i;
+        edge = false;
+      }
+    }
+    if (next > HOUR_IN_US)
+      break;
+
+    wake(r, &last, next);
+    if (who < 0) {
+      poll += POLL_PERIOD_IN_US;
+      Line_t *l = &lines[IN_SW1];
+      bool active = level(l, next);
+      if (active == sample[IN_SW1] && active != r->state[IN_SW1]) {
+        r->state[IN_SW1] = active;
+        r->reported[IN_SW1]++;
+      }
+      sample[IN_SW1] = active;
+    } else if (edge) {
+      cursor[who]++;
+      deadline[who] = next + lines[who].debounce;
+    } else {
+      deadline[who] = -1;
+      bool active = level(&lines[who], next);
+      if (active != r->state[who]) {
+        r->state[who] = active;
+        r->reported[who]++;
+      }
+      bool powered = r->state[IN_IGNITION] || r->state[IN_USB];
+      if (powered && (poll < 0)) {
+        poll = next + POLL_PERIOD_IN_US;
+        sample[IN_SW1] = level(&lines[IN_SW1], next);
+      } else if (!powered) {
+        poll = -1;
+      }
+    }
+  }
+  if (HOUR_IN_US - last > r->longestIdle)
+    r->longestIdle = HOUR_IN_US - last;
+}
+
+/*
+ * The startup report of an input that is already active counts as one more
+ * transition.
+ */
+static bool check(const char *label, const Result_t *r, bool all) {
+  bool ok = true;
+  size_t i;
+  for (i = 0; i < IN_NUM; ++i) {
+    const Line_t *l = &lines[i];
+    if (!all && !l->original)
+      continue;
+    unsigned expected = l->transitions + (l->initial ? 1 : 0);
+    bool final = l->initial ^ (l->transitions & 1);
+    if (r->reported[i] != expected || r->state[i] != final) {
+      printf("FAIL %s %s: reported %u of %u, state %d instead of %d\n", label,
+             l->name, r->reported[i], expected, r->state[i], final);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static bool scenario(const char *label, void (*script)(void)) {
+  Result_t before, after;
+  script();
+  sortToggles();
+  runPolling(&before);
+  runEdges(&after);
+
+  unsigned long long edges = 0;
+  size_t i;
+  for (i = 0; i < IN_NUM; ++i)
+    edges += lines[i].toggleNum;
+
+  printf("%-8s %6llu edges  polling %7.2f wakeups/s  edges %5.2f wakeups/s"
+         "  longest idle %.2f s\n",
+         label, edges, before.wakeups / 3600.0, after.wakeups / 3600.0,
+         after.longestIdle / 1e6);
+  bool ok = check("polling", &before, false);
+  return check("edges", &after, true) && ok;
+}
+
+int main(int argc, char *argv[]) {
+  srand(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+  bool ok = scenario("idle", scriptIdle);
+  ok = scenario("riding", scriptRiding) && ok;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
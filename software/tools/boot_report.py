@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Summarize the startup reports BootProfiler appends to /boot.log.
+
+Every line is tagged with GTRACK_BOOT_EARLY_MODEM of the build that wrote
+it, so logs of both builds can be concatenated and compared:
+
+    python3 tools/boot_report.py boot-early.log boot-late.log
+
+Prints the number of boots, the median and the maximum of every phase in
+ms since kernel start, per build, and the difference of the medians.
+"""
+
+import argparse
+import statistics
+import sys
+
+PHASES = ["threads", "sdcard", "shell", "modem", "gnss", "fix", "log"]
+
+
+def parse(lines):
+    builds = {}
+    for line in lines:
+        fields = line.split()
+        if not fields or fields[0] != "boot":
+            continue
+        # Reports written before the tag have none.
+        build = "untagged"
+        if len(fields) > 1 and "=" not in fields[1]:
+            build = fields[1]
+        phases = builds.setdefault(build, {p: [] for p in PHASES})
+        for field in fields[1:]:
+            name, _, value = field.partition("=")
+            if name in phases and value != "-":
+                phases[name].append(int(value))
+    return builds
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("logs", nargs="+", help="boot.log files")
+    args = parser.parse_args()
+
+    lines = []
+    for path in args.logs:
+        with open(path) as f:
+            lines += f.readlines()
+    builds = parse(lines)
+    if not builds:
+        sys.exit("no boot reports found")
+
+    medians = {}
+    for build, phases in sorted(builds.items()):
+        print("%s: %d boots" % (build, max(len(v) for v in phases.values())))
+        for name in PHASES:
+            values = phases[name]
+            if not values:
+                print("  %-8s %8s" % (name, "-"))
+                continue
+            medians[(build, name)] = statistics.median(values)
+            print("  %-8s median %8.0f ms, max %8d ms, %d boots"
+                  % (name, medians[(build, name)], max(values), len(values)))
+
+    if "early" in builds and "late" in builds:
+        print("early - late:")
+        for name in PHASES:
+            if ("early", name) in medians and ("late", name) in medians:
+                print("  %-8s %+8.0f ms" % (name, medians[("early", name)] -
+                                            medians[("late", name)]))
+
+
+if __name__ == "__main__":
+    main()
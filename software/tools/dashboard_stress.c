@@ -0,0 +1,297 @@
+/**
+ * @file dashboard_stress.c
+ * @brief Host contention test of the dashboard sequence counters.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -pthread -Itools/host -Isource -o dashboard_stress \
+ *      tools/dashboard_stress.c source/Dashboard.c -lm
+ *   ./dashboard_stress [seconds]
+ *
+ * Dashboard.c is built against the ChibiOS stand-in in tools/host. One
+ * writer per group publishes snapshots whose every field is derived from
+ * the publication number, while reader threads copy all groups in a loop.
+ * The readers are preempted anywhere in their copy, and on a multi-core
+ * host they also run at the same time as the writers, which the target
+ * never does. Without the retry of dbRead() thousands of torn copies are
+ * caught per second even on a single core.
+ *
+ * A snapshot passes when all of its fields and its timestamp belong to the
+ * same publication, that publication is the returned version, and the
+ * versions seen by a reader never go back. Every publication has to reach
+ * the subscriber. The writers are timed alone and then against the
+ * readers: the readers never lock, so the writers lose no more than the
+ * CPU time the readers take.
+ */
+
+#include "Dashboard.h"
+#include "LatencyProbe.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define READERS              4
+
+typedef struct {
+  DashboardGroup_t group;
+  uint32_t published;
+  double seconds;
+} Writer_t;
+
+typedef struct {
+  uint64_t reads;
+  uint64_t torn;
+  uint64_t backwards;
+  uint32_t last[DB_GROUP_NUM];
+} Reader_t;
+
+static pthread_mutex_t sysLock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local systime_t publishing;
+static atomic_bool running;
+static atomic_uint_fast64_t broadcasts[DB_GROUP_NUM];
+
+/*
+ * ChibiOS stand-in, the timestamp of a snapshot is its publication number,
+ * set by the writer thread that publishes it.
+ */
+void chSysLock(void) { pthread_mutex_lock(&sysLock); }
+
+void chSysUnlock(void) { pthread_mutex_unlock(&sysLock); }
+
+void chSchRescheduleS(void) {}
+
+systime_t chVTGetSystemTimeX(void) { return publishing; }
+
+void chEvtObjectInit(event_source_t *esp) { esp->next = NULL; }
+
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags) {
+  event_listener_t *elp;
+  for (elp = esp->next; elp; elp = elp->next)
+    elp->wflags |= flags;
+  for (DashboardGroup_t g = 0; g < DB_GROUP_NUM; ++g)
+    if (flags & DB_GROUP_FLAG(g))
+      atomic_fetch_add(&broadcasts[g], 1);
+}
+
+void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp,
+                                eventmask_t events, eventflags_t wflags) {
+  elp->events = events;
+  elp->wflags = wflags;
+  elp->next = esp->next;
+  esp->next = elp;
+}
+
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp) {
+  esp->next = elp->next;
+}
+
+void lpStart(time_measurement_t *tmp) { (void)tmp; }
+
+void lpStop(LatencyProbeId_t id, time_measurement_t *tmp) {
+  (void)id;
+  (void)tmp;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Snapshots of publication n, the reader recomputes them for the check.
+ */
+static void makePosition(uint32_t n, Position_t *p) {
+  memset(p, 0, sizeof(*p));
+  snprintf(p->date, sizeof(p->date), "%018lu", (unsigned long)n);
+  p->latitude = n * 1e-3;
+  p->longitude = -(double)n;
+  p->altitude = n * 0.5;
+  p->speed = n * 0.25;
+  p->gpsSatInView = (int)(n & 0x7F);
+  p->gnssSatInUse = (int)(n % 13U);
+  p->gnssSatInView = (int)(n % 29U);
+  p->source = (PositionSource_t)(n % 3U);
+  p->accuracy = n;
+}
+
+static void makeNetwork(uint32_t n, Network_t *net) {
+  memset(net, 0, sizeof(*net));
+  net->registration = (NetworkRegistration_t)(n % 6U);
+  net->gprsRegistration = (NetworkRegistration_t)((n + 1U) % 6U);
+  net->gprsAttached = n & 1U;
+  snprintf(net->operatorName, sizeof(net->operatorName), "op%lu",
+           (unsigned long)n);
+  net->rssi = -(int)(n % 113U);
+  net->ber = (int)(n % 8U);
+  net->lac = (uint16_t)n;
+  net->cellId = ~n;
+  net->supply = n;
+}
+
+static void makeMotion(uint32_t n, Motion_t *m) {
+  memset(m, 0, sizeof(*m));
+  m->state = (MotionState_t)(n % 3U);
+  m->latitude = (int32_t)n;
+  m->longitude = -(int32_t)n;
+  m->speed = (uint16_t)(n * 3U);
+  m->heading = (uint16_t)(n % 36000U);
+  m->accuracy = n * 7U;
+  m->outage = ~n;
+}
+
+/*
+ * Every writer stamps its snapshots with their own publication number.
+ */
+static void *writer(void *arg) {
+  Writer_t *w = arg;
+  double start = now();
+  while (atomic_load(&running)) {
+    uint32_t n = dbGetVersion(w->group) + 1U;
+    publishing = n;
+    if (DB_GROUP_POSITION == w->group) {
+      Position_t p;
+      makePosition(n, &p);
+      dbSetPosition(&p);
+    } else if (DB_GROUP_NETWORK == w->group) {
+      Network_t net;
+      makeNetwork(n, &net);
+      dbSetNetwork(&net);
+    } else {
+      Motion_t m;
+      makeMotion(n, &m);
+      dbSetMotion(&m);
+    }
+    w->published++;
+  }
+  w->seconds = now() - start;
+  return NULL;
+}
+
+static bool readGroup(DashboardGroup_t group, uint32_t *version) {
+  systime_t stamp;
+  if (DB_GROUP_POSITION == group) {
+    Position_t got, want;
+    *version = dbGetPosition(&got, &stamp);
+    makePosition(*version, &want);
+    return (0U == *version) ||
+           ((0 == memcmp(&got, &want, sizeof(got))) && (stamp == *version));
+  }
+  if (DB_GROUP_NETWORK == group) {
+    Network_t got, want;
+    *version = dbGetNetwork(&got, &stamp);
+    makeNetwork(*version, &want);
+    return (0U == *version) ||
+           ((0 == memcmp(&got, &want, sizeof(got))) && (stamp == *version));
+  }
+  Motion_t got, want;
+  *version = dbGetMotion(&got, &stamp);
+  makeMotion(*version, &want);
+  return (0U == *version) ||
+         ((0 == memcmp(&got, &want, sizeof(got))) && (stamp == *version));
+}
+
+static void *reader(void *arg) {
+  Reader_t *r = arg;
+  while (atomic_load(&running)) {
+    for (DashboardGroup_t g = 0; g < DB_GROUP_NUM; ++g) {
+      uint32_t version;
+      if (!readGroup(g, &version))
+        r->torn++;
+      if (version < r->last[g])
+        r->backwards++;
+      r->last[g] = version;
+      r->reads++;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Publication numbers restart at the current version, the snapshots of a
+ * run continue where the previous one stopped.
+ */
+static double run(double seconds, int readers, Reader_t *res) {
+  pthread_t wt[DB_GROUP_NUM], rt[READERS];
+  Writer_t w[DB_GROUP_NUM];
+  int i;
+
+  memset(res, 0, sizeof(*res) * READERS);
+  atomic_store(&running, true);
+  for (i = 0; i < DB_GROUP_NUM; ++i) {
+    w[i].group = (DashboardGroup_t)i;
+    w[i].published = 0;
+    pthread_create(&wt[i], NULL, writer, &w[i]);
+  }
+  for (i = 0; i < readers; ++i)
+    pthread_create(&rt[i], NULL, reader, &res[i]);
+
+  struct timespec ts = {(time_t)seconds,
+                        (long)((seconds - (time_t)seconds) * 1e9)};
+  nanosleep(&ts, NULL);
+  atomic_store(&running, false);
+
+  double rate = 0.0;
+  for (i = 0; i < DB_GROUP_NUM; ++i) {
+    pthread_join(wt[i], NULL);
+    rate += w[i].published / w[i].seconds;
+  }
+  for (i = 0; i < readers; ++i)
+    pthread_join(rt[i], NULL);
+  return rate;
+}
+
+int main(int argc, char *argv[]) {
+  double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+  event_listener_t listeners[DB_GROUP_NUM];
+  Reader_t res[READERS];
+  bool ok = true;
+  int i;
+
+  dbInit();
+  for (i = 0; i < DB_GROUP_NUM; ++i)
+    dbSubscribe((DashboardGroup_t)i, &listeners[i], EVENT_MASK(i));
+
+  double alone = run(seconds / 2.0, 0, res);
+  double contended = run(seconds, READERS, res);
+
+  uint64_t reads = 0, torn = 0, backwards = 0;
+  for (i = 0; i < READERS; ++i) {
+    reads += res[i].reads;
+    torn += res[i].torn;
+    backwards += res[i].backwards;
+  }
+  printf("writers alone      %10.0f publications/s\n", alone);
+  printf("against %d readers %10.0f publications/s, %.0f reads/s\n", READERS,
+         contended, reads / seconds);
+  printf("torn snapshots %llu, versions going back %llu\n",
+         (unsigned long long)torn, (unsigned long long)backwards);
+  ok = (0U == torn) && (0U == backwards);
+
+  for (i = 0; i < DB_GROUP_NUM; ++i) {
+    uint32_t version = dbGetVersion((DashboardGroup_t)i);
+    if (atomic_load(&broadcasts[i]) != version) {
+      printf("FAIL group %d: %lu publications, %llu broadcasts\n", i,
+             (unsigned long)version,
+             (unsigned long long)atomic_load(&broadcasts[i]));
+      ok = false;
+    }
+  }
+  /* The share of a core each writer gets against the readers, and alone. */
+  double cpus = (double)sysconf(_SC_NPROCESSORS_ONLN);
+  double share = fmin(1.0, cpus / (DB_GROUP_NUM + READERS)) /
+                 fmin(1.0, cpus / DB_GROUP_NUM);
+  if (contended < alone * share / 2.0) {
+    printf("FAIL the readers slow the writers down beyond their CPU share\n");
+    ok = false;
+  }
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
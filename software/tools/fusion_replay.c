@@ -0,0 +1,470 @@
+/**
+ * @file fusion_replay.c
+ * @brief Host replay of the GNSS and accelerometer fusion.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -o fusion_replay tools/fusion_replay.c source/Fusion.c \
+ *      source/GeoMath.c -lm
+ *   ./fusion_replay [fusion.log ...]
+ *
+ * Without arguments a synthetic drive is simulated at 25 Hz: standing,
+ * accelerating, turns, stops and a 40 s tunnel. The accelerometer is
+ * mounted at an arbitrary angle and has noise, vibration and a bias. The
+ * fixes arrive every 5 s with correlated and white errors scaled by a
+ * wandering HDOP, a few of them missing and a few 80 m off. The fused
+ * track is compared with the truth at every 200 ms tick of the firmware,
+ * and so are two cheap alternatives: holding the last fix, and moving it
+ * on with its speed and course.
+ *
+ * Logs recorded with "fusion rec" have no truth, so fixes are held out in
+ * windows of 30 s every 2 min and the fused position at the end of each
+ * window is compared with the held out fix.
+ */
+
+#include "Fusion.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_SAMPLES         200000
+#define MAX_FIXES           20000
+#define SAMPLE_PERIOD_IN_MS 40
+#define TICK_IN_MS          200
+#define FIX_PERIOD_IN_MS    5000
+#define GRAVITY             9.80665
+#define M_PER_UNIT          0.0111195080
+#define LAT0                47.4979
+#define LON0                19.0402
+#define HOLDOUT_PERIOD_IN_MS 120000U
+#define HOLDOUT_IN_MS       30000U
+
+typedef struct {
+  uint32_t time;
+  float acc[3];
+} Sample_t;
+
+typedef struct {
+  FuFix_t fix;
+  double east, north;                   /* Truth, synthetic drive only. */
+  int outlier;
+} Fix_t;
+
+typedef struct {
+  double east, north;
+} Truth_t;
+
+typedef struct {
+  double sum2, max;
+  double all[MAX_SAMPLES / 5];
+  size_t n;
+} Error_t;
+
+static Sample_t samples[MAX_SAMPLES];
+static size_t sampleCount;
+static Fix_t fixes[MAX_FIXES];
+static size_t fixCount;
+static Truth_t truth[MAX_SAMPLES];      /* At every sample. */
+static uint32_t tunnelBegin, tunnelEnd;
+static int haveTruth;
+
+static uint32_t seed = 2024;
+
+static double uniform(void) {
+  seed = seed * 1664525U + 1013904223U;
+  return ((seed >> 8) + 0.5) / 16777216.0;
+}
+
+static double gauss(double sigma) {
+  return sigma * sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+}
+
+static double mPerLon(void) {
+  return M_PER_UNIT * cos(LAT0 * M_PI / 180.0);
+}
+
+static GmPoint_t toPoint(double east, double north) {
+  GmPoint_t p = {(int32_t)lround(LAT0 * 1e7 + north / M_PER_UNIT),
+                 (int32_t)lround(LON0 * 1e7 + east / mPerLon())};
+  return p;
+}
+
+static void toPlane(const GmPoint_t *p, double *east, double *north) {
+  *north = (p->lat - LAT0 * 1e7) * M_PER_UNIT;
+  *east = (p->lon - LON0 * 1e7) * mPerLon();
+}
+
+static void addError(Error_t *e, double value) {
+  e->sum2 += value * value;
+  e->max = fmax(e->max, value);
+  if (e->n < sizeof(e->all) / sizeof(e->all[0]))
+    e->all[e->n] = value;
+  e->n++;
+}
+
+static int compare(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void printError(const char *name, Error_t *e) {
+  if (0 == e->n)
+    return;
+  qsort(e->all, e->n, sizeof(double), compare);
+  printf("  %-14s rms %7.2f m, p95 %7.2f m, max %7.2f m\n", name,
+         sqrt(e->sum2 / e->n), e->all[e->n * 95 / 100], e->max);
+}
+
+/*
+ * Segments of the drive: duration (s), acceleration (m/s^2), yaw rate
+ * (deg/s, positive to the right) and whether the sky is hidden.
+ */
+static const struct {
+  double duration, accel, yaw;
+  int tunnel;
+} drive[] = {
+  {30, 0, 0, 0},     {8, 1.5, 0, 0},    {40, 0, 0, 0},     {15, 0, 6, 0},
+  {20, 0, 0, 0},     {6, -2, 0, 0},     {20, 0, 0, 0},     {10, 2, 0, 0},
+  {60, 0, 1, 0},     {10, -1, 0, 0},    {15, 0, -6, 0},    {10, 0, 0, 0},
+  {40, 0.25, 1.5, 1}, {30, 0, 0, 0},    {8, -2.5, 0, 0},   {20, 0, 0, 0},
+  {10, 1.5, 0, 0},   {30, 0, -3, 0},    {40, 0, 2, 0},     {20, 0.5, 0, 0},
+  {60, 0, 0, 0},     {12, -2.1, 0, 0},  {20, 0, 0, 0},
+};
+
+/*
+ * Vehicle frame (forward, left, up) to the accelerometer axes.
+ */
+static void mounting(double R[3][3]) {
+  double yaw = 130 * M_PI / 180, pitch = 20 * M_PI / 180,
+         roll = -70 * M_PI / 180;
+  double cy = cos(yaw), sy = sin(yaw), cp = cos(pitch), sp = sin(pitch),
+         cr = cos(roll), sr = sin(roll);
+  double Rz[3][3] = {{cy, -sy, 0}, {sy, cy, 0}, {0, 0, 1}};
+  double Ry[3][3] = {{cp, 0, sp}, {0, 1, 0}, {-sp, 0, cp}};
+  double Rx[3][3] = {{1, 0, 0}, {0, cr, -sr}, {0, sr, cr}};
+  double T[3][3];
+  int i, j, k;
+  for (i = 0; i < 3; ++i)
+    for (j = 0; j < 3; ++j)
+      for (T[i][j] = 0, k = 0; k < 3; ++k)
+        T[i][j] += Ry[i][k] * Rx[k][j];
+  for (i = 0; i < 3; ++i)
+    for (j = 0; j < 3; ++j)
+      for (R[i][j] = 0, k = 0; k < 3; ++k)
+        R[i][j] += Rz[i][k] * T[k][j];
+}
+
+static void synthesize(void) {
+  const double bias[3] = {0.1, -0.08, 0.12};
+  double R[3][3];
+  double east = 0, north = 0, speed = 0, heading = 0.4;
+  double hdop = 1.2, slowE = 0, slowN = 0;
+  uint32_t t = 1000;
+  size_t s, step;
+
+  mounting(R);
+  sampleCount = fixCount = 0;
+  haveTruth = 1;
+  for (s = 0; s < sizeof(drive) / sizeof(drive[0]); ++s) {
+    size_t steps = (size_t)(drive[s].duration * 1000 / SAMPLE_PERIOD_IN_MS);
+    if (drive[s].tunnel)
+      tunnelBegin = t;
+    for (step = 0; step < steps; ++step, t += SAMPLE_PERIOD_IN_MS) {
+      double dt = SAMPLE_PERIOD_IN_MS / 1000.0;
+      double accel = drive[s].accel, yaw = drive[s].yaw * M_PI / 180;
+      if (speed + accel * dt < 0)
+        accel = -speed / dt;
+      if (speed < 0.5)
+        yaw = 0;
+      speed += accel * dt;
+      heading += yaw * dt;
+      east += speed * sin(heading) * dt;
+      north += speed * cos(heading) * dt;
+
+      double vibration = speed > 0.5 ? 0.3 : 0.02;
+      double vehicle[3] = {accel + gauss(vibration),
+                           -speed * yaw + gauss(vibration),
+                           GRAVITY + gauss(vibration)};
+      Sample_t *sample = &samples[sampleCount];
+      truth[sampleCount].east = east;
+      truth[sampleCount].north = north;
+      sample->time = t;
+      int i;
+      for (i = 0; i < 3; ++i) {
+        double a = R[i][0] * vehicle[0] + R[i][1] * vehicle[1] +
+                   R[i][2] * vehicle[2] + bias[i] + gauss(0.05);
+        /* 0.06 mg steps of the LIS3DSH at 2 g. */
+        sample->acc[i] = (float)(lround(a / GRAVITY * 1e3 / 0.06) * 0.06e-3 *
+                                 GRAVITY);
+      }
+      sampleCount++;
+
+      /* Correlated error with a time constant of a minute. */
+      double k = dt / 60.0;
+      slowE += -k * slowE + gauss(2.0 * sqrt(2 * k));
+      slowN += -k * slowN + gauss(2.0 * sqrt(2 * k));
+
+      if ((0 != t % FIX_PERIOD_IN_MS) || drive[s].tunnel ||
+          (uniform() < 0.04))
+        continue;
+      hdop = fmin(3.0, fmax(0.8, hdop + gauss(0.2)));
+      Fix_t *f = &fixes[fixCount++];
+      double ee = hdop * (slowE + gauss(1.5)), en = hdop * (slowN + gauss(1.5));
+      f->outlier = uniform() < 0.03;
+      if (f->outlier) {
+        double angle = 2 * M_PI * uniform();
+        ee += 80 * sin(angle);
+        en += 80 * cos(angle);
+      }
+      f->east = east;
+      f->north = north;
+      f->fix.time = t;
+      f->fix.position = toPoint(east + ee, north + en);
+      f->fix.speed = (float)fabs(speed + gauss(0.2));
+      double course = heading + gauss(atan2(0.3, speed));
+      f->fix.course = (float)fmod(fmod(course * 180 / M_PI, 360) + 360, 360);
+      f->fix.accuracy = (float)(hdop * 5.0);    /* GNSS_UERE_IN_M */
+    }
+    if (drive[s].tunnel)
+      tunnelEnd = t;
+  }
+}
+
+/*
+ * Lines of "fusion rec": "G time lat lon speed course accuracy" with
+ * 1e-7 degrees, cm/s, 0.01 degrees and cm, "A time x y z" in mg.
+ */
+static int parse(const char *path) {
+  FILE *f = fopen(path, "r");
+  char line[160];
+
+  if (!f) {
+    perror(path);
+    return 0;
+  }
+  sampleCount = fixCount = 0;
+  haveTruth = 0;
+  while (fgets(line, sizeof(line), f)) {
+    long t, lat, lon, speed, course, accuracy, x, y, z;
+    if ((6 == sscanf(line, "G %ld %ld %ld %ld %ld %ld", &t, &lat, &lon, &speed,
+                     &course, &accuracy)) && (fixCount < MAX_FIXES)) {
+      Fix_t *p = &fixes[fixCount++];
+      memset(p, 0, sizeof(*p));
+      p->fix.time = (uint32_t)t;
+      p->fix.position.lat = (int32_t)lat;
+      p->fix.position.lon = (int32_t)lon;
+      p->fix.speed = (float)speed / 100.0f;
+      p->fix.course = (float)course / 100.0f;
+      p->fix.accuracy = (float)accuracy / 100.0f;
+    } else if ((4 == sscanf(line, "A %ld %ld %ld %ld", &t, &x, &y, &z)) &&
+               (sampleCount < MAX_SAMPLES)) {
+      Sample_t *p = &samples[sampleCount++];
+      p->time = (uint32_t)t;
+      p->acc[0] = (float)(x * GRAVITY / 1000.0);
+      p->acc[1] = (float)(y * GRAVITY / 1000.0);
+      p->acc[2] = (float)(z * GRAVITY / 1000.0);
+    }
+  }
+  fclose(f);
+  return (fixCount > 1) && (sampleCount > 1);
+}
+
+static int heldOut(uint32_t time, uint32_t start) {
+  return ((time - start) % HOLDOUT_PERIOD_IN_MS) >=
+         (HOLDOUT_PERIOD_IN_MS - HOLDOUT_IN_MS);
+}
+
+typedef struct {
+  Error_t fused, hold, extrapolated;    /* All ticks. */
+  Error_t tunnelFused, tunnelHold, tunnelExtrapolated;
+  Error_t atFixFused, atFixRaw;         /* Synthetic drive only. */
+  double tunnelEnd[3];
+  double predictNs;
+  uint32_t outliers, caught, lost;
+} Result_t;
+
+/*
+ * The firmware loop: every tick and every fix predicts with the mean of
+ * the samples since the previous step, a fix is applied right after. The
+ * alternatives use every fix as it comes.
+ */
+static void run(Fusion_t *fu, int holdout, Result_t *r) {
+  size_t s = 0, f = 0, truthIndex = 0;
+  uint32_t start = samples[0].time;
+  uint32_t t = start;
+  uint32_t end = samples[sampleCount - 1].time;
+  const FuFix_t *raw = NULL;
+  struct timespec t0, t1;
+  double spent = 0;
+  uint32_t steps = 0;
+
+  memset(r, 0, sizeof(*r));
+  fuInit(fu);
+  while (t <= end) {
+    uint32_t next = (t / TICK_IN_MS + 1) * TICK_IN_MS;
+    int fixNow = (f < fixCount) && (fixes[f].fix.time <= next);
+    if (fixNow)
+      next = fixes[f].fix.time;
+
+    float sum[3] = {0, 0, 0};
+    int n = 0;
+    while ((s < sampleCount) && (samples[s].time <= next)) {
+      sum[0] += samples[s].acc[0];
+      sum[1] += samples[s].acc[1];
+      sum[2] += samples[s].acc[2];
+      n++;
+      s++;
+    }
+    if (n) {
+      sum[0] /= (float)n;
+      sum[1] /= (float)n;
+      sum[2] /= (float)n;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    fuPredict(fu, n ? sum : NULL, next);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    spent += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    steps++;
+
+    if (fixNow) {
+      const Fix_t *fix = &fixes[f++];
+      if (holdout && heldOut(fix->fix.time, start)) {
+        FuEstimate_t e;
+        if (raw && fuEstimate(fu, &e) &&
+            ((f >= fixCount) || !heldOut(fixes[f].fix.time, start))) {
+          /* Last fix of a window, the whole outage is behind. */
+          double fe, fn, ee, en, he, hn;
+          toPlane(&fix->fix.position, &fe, &fn);
+          toPlane(&e.position, &ee, &en);
+          toPlane(&raw->position, &he, &hn);
+          double dt = (fix->fix.time - raw->time) / 1000.0;
+          double c = (double)(double)raw->course * M_PI / 180;
+          addError(&r->fused, hypot(ee - fe, en - fn));
+          addError(&r->hold, hypot(he - fe, hn - fn));
+          addError(&r->extrapolated,
+                   hypot(he + (double)(double)raw->speed * sin(c) * dt - fe,
+                         hn + (double)(double)raw->speed * cos(c) * dt - fn));
+        }
+      } else {
+        bool accepted = fuUpdate(fu, &fix->fix);
+        raw = &fix->fix;
+        r->outliers += (uint32_t)fix->outlier;
+        r->caught += (uint32_t)(fix->outlier && !accepted);
+        r->lost += (uint32_t)(!fix->outlier && !accepted);
+        FuEstimate_t e;
+        if (haveTruth && fuEstimate(fu, &e)) {
+          double ee, en, fe, fn;
+          toPlane(&e.position, &ee, &en);
+          toPlane(&fix->fix.position, &fe, &fn);
+          addError(&r->atFixFused, hypot(ee - fix->east, en - fix->north));
+          addError(&r->atFixRaw, hypot(fe - fix->east, fn - fix->north));
+        }
+      }
+    }
+
+    /* Truth is known at the samples of the synthetic drive. */
+    while ((truthIndex < sampleCount) && (samples[truthIndex].time < next))
+      truthIndex++;
+    if (haveTruth && !fixNow && raw && (truthIndex < sampleCount) &&
+        (samples[truthIndex].time == next)) {
+      FuEstimate_t e;
+      double ee, en, he, hn;
+      const Truth_t *tr = &truth[truthIndex];
+      fuEstimate(fu, &e);
+      toPlane(&e.position, &ee, &en);
+      toPlane(&raw->position, &he, &hn);
+      double dt = (next - raw->time) / 1000.0, c = (double)(double)raw->course * M_PI / 180;
+      double errors[3] = {
+        hypot(ee - tr->east, en - tr->north),
+        hypot(he - tr->east, hn - tr->north),
+        hypot(he + (double)(double)raw->speed * sin(c) * dt - tr->east,
+              hn + (double)(double)raw->speed * cos(c) * dt - tr->north)
+      };
+      addError(&r->fused, errors[0]);
+      addError(&r->hold, errors[1]);
+      addError(&r->extrapolated, errors[2]);
+      if ((next > tunnelBegin) && (next <= tunnelEnd)) {
+        addError(&r->tunnelFused, errors[0]);
+        addError(&r->tunnelHold, errors[1]);
+        addError(&r->tunnelExtrapolated, errors[2]);
+        memcpy(r->tunnelEnd, errors, sizeof(errors));
+      }
+    }
+    t = next;
+  }
+  r->predictNs = spent / steps;
+}
+
+static void report(const Fusion_t *fu, Result_t *r) {
+  printf("  %u fixes accepted, %u rejected, %u restarts, mounting %s\n",
+         fu->accepted, fu->rejected, fu->resets,
+         fu->mounted ? "learned" : "unknown");
+  printf("  %.0f ns per step on this host\n", r->predictNs);
+}
+
+static int synthetic(void) {
+  Fusion_t fu;
+  Result_t r;
+
+  synthesize();
+  run(&fu, 0, &r);
+  printf("synthetic drive: %.0f s, %zu fixes, 40 s tunnel\n",
+         (samples[sampleCount - 1].time - samples[0].time) / 1000.0, fixCount);
+  report(&fu, &r);
+  printf("  outliers %u, rejected %u, good fixes rejected %u\n", r.outliers,
+         r.caught, r.lost);
+  printf(" at the fixes:\n");
+  printError("fused", &r.atFixFused);
+  printError("fix", &r.atFixRaw);
+  printf(" every %d ms tick:\n", TICK_IN_MS);
+  printError("fused", &r.fused);
+  printError("last fix", &r.hold);
+  printError("extrapolated", &r.extrapolated);
+  printf(" in the tunnel:\n");
+  printError("fused", &r.tunnelFused);
+  printError("last fix", &r.tunnelHold);
+  printError("extrapolated", &r.tunnelExtrapolated);
+  printf("  at its end: fused %.1f m, last fix %.1f m, extrapolated %.1f m\n",
+         r.tunnelEnd[0], r.tunnelEnd[1], r.tunnelEnd[2]);
+
+  int ok = fu.mounted && (r.caught * 2 >= r.outliers) &&
+           (sqrt(r.fused.sum2 / r.fused.n) < sqrt(r.hold.sum2 / r.hold.n)) &&
+           (r.tunnelEnd[0] < r.tunnelEnd[1]) &&
+           (r.tunnelEnd[0] < r.tunnelEnd[2]);
+  printf("  %s\n", ok ? "OK" : "WORSE THAN THE FIXES");
+  return ok ? 0 : 1;
+}
+
+static int replay(const char *path) {
+  Fusion_t fu;
+  Result_t r;
+
+  if (!parse(path)) {
+    printf("%s: no data\n", path);
+    return 0;
+  }
+  printf("%s: %zu fixes, %zu samples\n", path, fixCount, sampleCount);
+  run(&fu, 0, &r);
+  report(&fu, &r);
+  run(&fu, 1, &r);
+  printf(" end of %u s outages every %u s:\n", HOLDOUT_IN_MS / 1000,
+         HOLDOUT_PERIOD_IN_MS / 1000);
+  printError("fused", &r.fused);
+  printError("last fix", &r.hold);
+  printError("extrapolated", &r.extrapolated);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int failed = 0, i;
+
+  if (argc < 2)
+    failed = synthetic();
+  for (i = 1; i < argc; ++i)
+    failed |= replay(argv[i]);
+  return failed;
+}
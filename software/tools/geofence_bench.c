@@ -0,0 +1,275 @@
+/**
+ * @file geofence_bench.c
+ * @brief Host benchmark of the geofence engine.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -o geofence_bench tools/geofence_bench.c source/Geofence.c
+ *   ./geofence_bench [fences]
+ *
+ * Random star shaped fences of 50 m - 2 km are spread at a constant
+ * density, so the area grows with their number. A random walk of fixes is
+ * evaluated with the grid index and with a linear scan of all bounding
+ * boxes. The index results are checked against the scan.
+ *
+ * The debounced states are checked against a reference that evaluates
+ * every fence at every fix, with room for a single transition per fix so
+ * the rest is dropped: the states have to match all the same, the first
+ * fix must not report anything, and reported plus dropped transitions have
+ * to add up to the reference.
+ */
+
+#include "Geofence.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FIXES               200000
+#define CHECKED_FIXES       20000
+#define DEBOUNCE            2
+#define MAX_FENCE_VERTICES  16
+#define METER               90          /* 1e-7 degrees, roughly. */
+#define FENCES_PER_KM2      0.4
+
+static uint32_t seed = 12345;
+
+static uint32_t rnd(void) {
+  seed = seed * 1664525U + 1013904223U;
+  return seed >> 8;
+}
+
+static int32_t uniform(int32_t lo, int32_t hi) {
+  return lo + (int32_t)(rnd() % (uint32_t)(hi - lo + 1));
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+  Geofence_t gf;
+  GfFence_t *fences;
+  GfPoint_t *vertices;
+  uint16_t *cellStart;
+  uint16_t *cellEntries;
+  uint16_t *active;
+  int32_t side;                         /* Extent of the area. */
+} Bench_t;
+
+static void build(Bench_t *b, size_t count) {
+  uint32_t grid = 1;
+  while (grid * grid < count)
+    grid++;
+
+  GfStorage_t storage = {
+    b->fences = calloc(count, sizeof(GfFence_t)), count,
+    b->vertices = calloc(count * MAX_FENCE_VERTICES, sizeof(GfPoint_t)),
+    count * MAX_FENCE_VERTICES,
+    b->cellStart = calloc(grid * grid + 1, sizeof(uint16_t)),
+    b->cellEntries = calloc(count * 8, sizeof(uint16_t)), count * 8,
+    b->active = calloc(count, sizeof(uint16_t)),
+    grid
+  };
+  gfInit(&b->gf, &storage, DEBOUNCE);
+
+  double km = 1.0;
+  while (km * km * FENCES_PER_KM2 < count)
+    km += 0.5;
+  b->side = (int32_t)(km * 1000 * METER);
+
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    GfPoint_t points[MAX_FENCE_VERTICES];
+    GfPoint_t center = {uniform(0, b->side), uniform(0, b->side)};
+    int32_t radius = uniform(50 * METER, 1000 * METER);
+    size_t n = 6 + rnd() % (MAX_FENCE_VERTICES - 6), k;
+    for (k = 0; k < n; ++k) {
+      /* Star shape around the center, a square path keeps it integer. */
+      int32_t r = radius / 2 + (int32_t)(rnd() % (uint32_t)(radius / 2));
+      int32_t t = (int32_t)(k * 8 * 1000 / n);
+      int32_t x, y;
+      if (t < 2000)      { x = 1000;            y = t - 1000; }
+      else if (t < 4000) { x = 3000 - t;        y = 1000; }
+      else if (t < 6000) { x = -1000;           y = 5000 - t; }
+      else               { x = t - 7000;        y = -1000; }
+      points[k].lat = center.lat + (int32_t)((int64_t)r * y / 1000);
+      points[k].lon = center.lon + (int32_t)((int64_t)r * x / 1000);
+    }
+    gfAddFence(&b->gf, points, n, GF_ALERT_ENTER | GF_ALERT_EXIT);
+  }
+
+  if (!gfBuildIndex(&b->gf)) {
+    fprintf(stderr, "cell entries do not fit\n");
+    exit(1);
+  }
+}
+
+static void release(Bench_t *b) {
+  free(b->fences);
+  free(b->vertices);
+  free(b->cellStart);
+  free(b->cellEntries);
+  free(b->active);
+}
+
+static void walk(GfPoint_t *track, size_t num, int32_t side) {
+  GfPoint_t p = {side / 2, side / 2};
+  size_t i;
+  for (i = 0; i < num; ++i) {
+    p.lat += uniform(-100 * METER, 100 * METER);
+    p.lon += uniform(-100 * METER, 100 * METER);
+    if (p.lat < 0) p.lat = side;
+    if (p.lat > side) p.lat = 0;
+    if (p.lon < 0) p.lon = side;
+    if (p.lon > side) p.lon = 0;
+    track[i] = p;
+  }
+}
+
+/*
+ * Every fence a fix is inside of has to be in the cell of the fix.
+ */
+static size_t verify(const Bench_t *b, const GfPoint_t *track, size_t num) {
+  const Geofence_t *gf = &b->gf;
+  size_t errors = 0, i, f;
+  for (i = 0; i < num; i += 97) {
+    for (f = 0; f < gf->fenceCount; ++f) {
+      const GfFence_t *fence = &gf->mem.fences[f];
+      bool expected = (track[i].lat >= fence->min.lat) &&
+                      (track[i].lat <= fence->max.lat) &&
+                      (track[i].lon >= fence->min.lon) &&
+                      (track[i].lon <= fence->max.lon) &&
+                      gfContains(gf, f, &track[i]);
+      if (!expected)
+        continue;
+      uint32_t n = gf->mem.gridSize;
+      uint32_t r = (uint32_t)(((int64_t)track[i].lat - gf->gridMin.lat) / gf->cellLat);
+      uint32_t c = (uint32_t)(((int64_t)track[i].lon - gf->gridMin.lon) / gf->cellLon);
+      if (r >= n) r = n - 1;
+      if (c >= n) c = n - 1;
+      uint32_t cell = r * n + c, k;
+      bool listed = false;
+      for (k = gf->mem.cellStart[cell]; k < gf->mem.cellStart[cell + 1]; ++k)
+        listed = listed || (gf->mem.cellEntries[k] == f);
+      errors += listed ? 0 : 1;
+    }
+  }
+  return errors;
+}
+
+static bool contains(const Geofence_t *gf, size_t f, const GfPoint_t *p) {
+  const GfFence_t *fence = &gf->mem.fences[f];
+  return (p->lat >= fence->min.lat) && (p->lat <= fence->max.lat) &&
+         (p->lon >= fence->min.lon) && (p->lon <= fence->max.lon) &&
+         gfContains(gf, f, p);
+}
+
+/*
+ * Debounced states against the reference, the number of mismatches.
+ */
+static size_t checkStates(size_t count, GfPoint_t *track,
+                          size_t *transitions, size_t *dropped) {
+  Bench_t b;
+  GfTransition_t out[1];
+  size_t errors = 0, reported = 0, i, f;
+
+  build(&b, count);
+  walk(track, CHECKED_FIXES, b.side);
+  bool *inside = calloc(count, sizeof(bool));
+  uint8_t *contrary = calloc(count, sizeof(uint8_t));
+  *transitions = 0;
+
+  for (i = 0; i < CHECKED_FIXES; ++i) {
+    size_t num = gfUpdate(&b.gf, &track[i], out, 1);
+    reported += num;
+    if ((0 == i) && (num > 0))
+      errors++;
+
+    for (f = 0; f < b.gf.fenceCount; ++f) {
+      bool in = contains(&b.gf, f, &track[i]);
+      if (0 == i) {
+        inside[f] = in;
+      } else if (in == inside[f]) {
+        contrary[f] = 0;
+      } else if (++contrary[f] >= DEBOUNCE) {
+        inside[f] = in;
+        contrary[f] = 0;
+        ++*transitions;
+      }
+      errors += (gfIsInside(&b.gf, f) != inside[f]) ? 1 : 0;
+    }
+  }
+  if (reported + b.gf.dropped != *transitions)
+    errors++;
+  *dropped = b.gf.dropped;
+
+  free(inside);
+  free(contrary);
+  release(&b);
+  return errors;
+}
+
+static bool run(size_t count, GfPoint_t *track) {
+  Bench_t b;
+  GfTransition_t out[16];
+  size_t i, f, transitions = 0, inside = 0;
+
+  build(&b, count);
+  walk(track, FIXES, b.side);
+
+  double t0 = now();
+  for (i = 0; i < FIXES; ++i)
+    transitions += gfUpdate(&b.gf, &track[i], out, 16);
+  double indexed = now() - t0;
+
+  /* Linear scan of the bounding boxes, no debouncing. */
+  t0 = now();
+  for (i = 0; i < FIXES; ++i)
+    for (f = 0; f < b.gf.fenceCount; ++f) {
+      const GfFence_t *fence = &b.gf.mem.fences[f];
+      if ((track[i].lat >= fence->min.lat) && (track[i].lat <= fence->max.lat) &&
+          (track[i].lon >= fence->min.lon) && (track[i].lon <= fence->max.lon))
+        inside += gfContains(&b.gf, f, &track[i]) ? 1 : 0;
+    }
+  double linear = now() - t0;
+
+  size_t indexErrors = verify(&b, track, FIXES);
+  printf("%6zu fences, %3u^2 grid: %9.0f fixes/s indexed "
+         "(%.2f box, %.2f polygon tests per fix), %9.0f fixes/s linear, "
+         "%zu transitions, %zu index errors\n",
+         b.gf.fenceCount, b.gf.mem.gridSize, FIXES / indexed,
+         (double)b.gf.boxTests / b.gf.fixes,
+         (double)b.gf.polygonTests / b.gf.fixes, FIXES / linear, transitions,
+         indexErrors);
+  (void)inside;
+  release(&b);
+
+  size_t checked, dropped;
+  size_t stateErrors = checkStates(count, track, &checked, &dropped);
+  printf("%6s %zu transitions in %u fixes, %zu beyond one per fix dropped, "
+         "%zu state errors\n", "", checked, CHECKED_FIXES, dropped,
+         stateErrors);
+  return (0 == indexErrors) && (0 == stateErrors);
+}
+
+int main(int argc, char *argv[]) {
+  GfPoint_t *track = malloc(FIXES * sizeof(GfPoint_t));
+  bool ok = true;
+
+  if (argc > 1) {
+    ok = run((size_t)atoi(argv[1]), track);
+  } else {
+    size_t counts[] = {10, 100, 1000, 4000};
+    size_t i;
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+      ok = run(counts[i], track) && ok;
+  }
+
+  free(track);
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file geomath_check.c
+ * @brief Host check of the fixed-point geo kernels against double precision.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -o geomath_check tools/geomath_check.c source/GeoMath.c \
+ *      -lm
+ *   ./geomath_check
+ *
+ * Point pairs are generated at fixed great circle distances with random
+ * position and direction, then rounded to 1e-7 degrees like the fixes. The
+ * reference is computed in double precision from the rounded coordinates on
+ * the same sphere. Timings are TSC cycles per call on x86 (nanoseconds
+ * elsewhere). The host has an FPU, so the double rows are a lower bound of
+ * their cost on the target, where every double operation is a library call.
+ */
+
+#include "GeoMath.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define UNIT                "cycles"
+static uint64_t ticks(void) {
+  return __rdtsc();
+}
+#else
+#define UNIT                "ns"
+static uint64_t ticks(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define EARTH_RADIUS_IN_M   6371008.8
+#define SAMPLES             20000
+#define TIMED_CALLS         200000
+#define MAX_LATITUDE        70.0
+
+static uint32_t seed = 4242;
+
+static double uniform(double lo, double hi) {
+  seed = seed * 1664525U + 1013904223U;
+  return lo + (hi - lo) * (seed >> 8) / 16777216.0;
+}
+
+static double rad(double deg) {
+  return deg * M_PI / 180.0;
+}
+
+static double deg(double rad) {
+  return rad * 180.0 / M_PI;
+}
+
+static double lat(const GmPoint_t *p) {
+  return rad(p->lat / 1e7);
+}
+
+static double lon(const GmPoint_t *p) {
+  return rad(p->lon / 1e7);
+}
+
+static double refHaversine(const GmPoint_t *a, const GmPoint_t *b) {
+  double dlat = lat(b) - lat(a), dlon = lon(b) - lon(a);
+  double h = sin(dlat / 2) * sin(dlat / 2) +
+             cos(lat(a)) * cos(lat(b)) * sin(dlon / 2) * sin(dlon / 2);
+  return 2 * EARTH_RADIUS_IN_M * 100.0 * asin(sqrt(h));
+}
+
+static double refEquirect(const GmPoint_t *a, const GmPoint_t *b) {
+  double x = (lon(b) - lon(a)) * cos((lat(a) + lat(b)) / 2);
+  double y = lat(b) - lat(a);
+  return EARTH_RADIUS_IN_M * 100.0 * sqrt(x * x + y * y);
+}
+
+/* Initial great circle bearing in radians. */
+static double refBearing(const GmPoint_t *a, const GmPoint_t *b) {
+  double dlon = lon(b) - lon(a);
+  return atan2(sin(dlon) * cos(lat(b)),
+               cos(lat(a)) * sin(lat(b)) - sin(lat(a)) * cos(lat(b)) * cos(dlon));
+}
+
+static double refCrossTrack(const GmPoint_t *a, const GmPoint_t *b,
+                            const GmPoint_t *p) {
+  double d13 = refHaversine(a, p) / 100.0 / EARTH_RADIUS_IN_M;
+  return asin(sin(d13) * sin(refBearing(a, p) - refBearing(a, b))) *
+         EARTH_RADIUS_IN_M * 100.0;
+}
+
+static GmPoint_t destination(double latDeg, double lonDeg, double bearing,
+                             double meters) {
+  double d = meters / EARTH_RADIUS_IN_M, p1 = rad(latDeg);
+  double p2 = asin(sin(p1) * cos(d) + cos(p1) * sin(d) * cos(bearing));
+  double l2 = rad(lonDeg) + atan2(sin(bearing) * sin(d) * cos(p1),
+                                  cos(d) - sin(p1) * sin(p2));
+  l2 = remainder(l2, 2 * M_PI);
+  GmPoint_t p = {(int32_t)lround(deg(p2) * 1e7), (int32_t)lround(deg(l2) * 1e7)};
+  return p;
+}
+
+static void randomPair(double meters, GmPoint_t *a, GmPoint_t *b) {
+  double la = uniform(-MAX_LATITUDE, MAX_LATITUDE), lo = uniform(-180, 180);
+  a->lat = (int32_t)lround(la * 1e7);
+  a->lon = (int32_t)lround(lo * 1e7);
+  *b = destination(a->lat / 1e7, a->lon / 1e7, uniform(0, 2 * M_PI), meters);
+}
+
+static double angleError(double a, double b) {
+  return fabs(remainder(a - b, 2 * M_PI));
+}
+
+static void trig(void) {
+  double sinErr = 0, cosErr = 0, atanErr = 0;
+  int32_t a;
+  int i;
+
+  for (a = -1800000000; a < 1800000000; a += 12347) {
+    sinErr = fmax(sinErr, fabs(gmSin(a) / 1073741824.0 - sin(rad(a / 1e7))));
+    cosErr = fmax(cosErr, fabs(gmCos(a) / 1073741824.0 - cos(rad(a / 1e7))));
+  }
+  for (i = 0; i < 1000000; ++i) {
+    int32_t y = (int32_t)uniform(-2e9, 2e9), x = (int32_t)uniform(-2e9, 2e9);
+    if (i & 1)
+      y /= 1 << (i % 24);
+    atanErr = fmax(atanErr, angleError(rad(gmAtan2(y, x) / 1e7), atan2(y, x)));
+  }
+  printf("gmSin max error %.2e, gmCos %.2e, gmAtan2 %.5f degrees\n\n", sinErr,
+         cosErr, deg(atanErr));
+}
+
+static void accuracy(void) {
+  static const double ranges[] = {10, 100, 1e3, 1e4, 1e5, 1e6, 1e7};
+  size_t r;
+  int i;
+
+  printf("%10s %22s %22s %12s %12s\n", "distance", "equirect rel (max)",
+         "haversine cm (max)", "bearing deg", "xtrack cm");
+  for (r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+    double eqRel = 0, eqAbs = 0, hvAbs = 0, hvRel = 0, brg = 0, xt = 0;
+    for (i = 0; i < SAMPLES; ++i) {
+      GmPoint_t a, b;
+      randomPair(ranges[r], &a, &b);
+      double ref = refHaversine(&a, &b);
+      double eq = gmEquirect(&a, &b), hv = gmHaversine(&a, &b);
+      eqAbs = fmax(eqAbs, fabs(eq - ref));
+      eqRel = fmax(eqRel, fabs(eq - ref) / ref);
+      hvAbs = fmax(hvAbs, fabs(hv - ref));
+      hvRel = fmax(hvRel, fabs(hv - ref) / ref);
+      brg = fmax(brg, angleError(rad(gmBearing(&a, &b) / 1e7),
+                                 refBearing(&a, &b)));
+      if (ranges[r] <= 1e4) {
+        GmPoint_t p = destination(a.lat / 1e7, a.lon / 1e7,
+                                  uniform(0, 2 * M_PI),
+                                  uniform(0, ranges[r]));
+        xt = fmax(xt, fabs(gmCrossTrack(&a, &b, &p) -
+                           refCrossTrack(&a, &b, &p)));
+      }
+    }
+    printf("%8.0f m %10.2e (%7.0f cm) %10.1f (%.0e) %12.4f ", ranges[r], eqRel,
+           eqAbs, hvAbs, hvRel, deg(brg));
+    if (ranges[r] <= 1e4)
+      printf("%12.1f\n", xt);
+    else
+      printf("%12s\n", "-");
+  }
+  printf("\n");
+}
+
+static GmPoint_t pa[TIMED_CALLS], pb[TIMED_CALLS];
+static volatile double sinkD;
+static volatile uint32_t sinkU;
+
+#define TIME(name, expr, sink)                                       \
+  do {                                                               \
+    uint64_t t0 = ticks();                                           \
+    for (i = 0; i < TIMED_CALLS; ++i)                                \
+      sink = (expr);                                                 \
+    printf("  %-22s %8.1f %s/call\n", name,                          \
+           (double)(ticks() - t0) / TIMED_CALLS, UNIT);              \
+  } while (0)
+
+static void timing(void) {
+  int i;
+
+  for (i = 0; i < TIMED_CALLS; ++i)
+    randomPair(uniform(10, 10000), &pa[i], &pb[i]);
+
+  printf("10 m - 10 km pairs:\n");
+  TIME("double haversine", refHaversine(&pa[i], &pb[i]), sinkD);
+  TIME("double equirect", refEquirect(&pa[i], &pb[i]), sinkD);
+  TIME("double bearing", refBearing(&pa[i], &pb[i]), sinkD);
+  TIME("gmEquirect", gmEquirect(&pa[i], &pb[i]), sinkU);
+  TIME("gmHaversine", gmHaversine(&pa[i], &pb[i]), sinkU);
+  TIME("gmDistance", gmDistance(&pa[i], &pb[i]), sinkU);
+  TIME("gmBearing", gmBearing(&pa[i], &pb[i]), sinkU);
+  TIME("gmCrossTrack", (uint32_t)gmCrossTrack(&pa[i], &pb[i], &pa[i ^ 1]),
+       sinkU);
+  TIME("gmSin", (uint32_t)gmSin(pa[i].lat), sinkU);
+  TIME("gmAtan2", (uint32_t)gmAtan2(pa[i].lat, pb[i].lon), sinkU);
+}
+
+int main(void) {
+  trig();
+  accuracy();
+  timing();
+  return 0;
+}
@@ -0,0 +1,547 @@
+/**
+ * @file gnss_dialog.c
+ * @brief Scripted rides against the modem stand-in: start mode, time to
+ *        first fix and cell location.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Itools/host -Isource -Isource/sim8xx/at -Iconfig \
+ *      -o gnss_dialog tools/gnss_dialog.c source/GnssAssist.c \
+ *      source/FixRecord.c source/sim8xx/at/commands/AtCgnsinf.c \
+ *      source/sim8xx/at/commands/AtCgnspwr.c \
+ *      source/sim8xx/at/commands/AtCgnsstart.c \
+ *      source/sim8xx/at/commands/AtClbs.c \
+ *      source/sim8xx/at/commands/AtSapbr.c \
+ *      source/sim8xx/at/commands/AtUtil.c
+ *   ./gnss_dialog [rounds] [scale] [seed]
+ *
+ * tools/modem_standin.py is started on a pseudo terminal with its clock
+ * [scale] times faster than real time. The rides go through the AT dialog
+ * of the GPS reader with the firmware's command builders and parsers, and
+ * GnssAssist.c picks the start mode from /gnss.dat and the RTC, both kept
+ * in a temporary directory and on the same clock. Between the rides the
+ * clock moves over the parking, the RTC is lost with the supply of the
+ * board and the receiver data with the supply of the modem.
+ *
+ * The poll runs every 5 s like the reader. While it reports no fix the
+ * bearer is opened and the cell is located once per
+ * GTRACK_CELL_LOCATION_PERIOD_IN_MS, as the network monitor does on
+ * request. The modem answers one command at a time, a poll that is due
+ * during the cell location waits for it.
+ *
+ * The rides are made once with the receiver left at its power on start,
+ * as before the start mode was selected, and then with the selected start.
+ * Every ride needs a fix, the start mode has to follow the parking and the
+ * cell location has to come first when the start is not hot, with a date
+ * that parses and precedes the fix. The fix age in the log has to match
+ * the parking, also when the RTC was lost and the start was cold. On
+ * average the selected start has to be faster. The stand-in's own report of every start is discarded, run it
+ * alone with --pty to watch it.
+ */
+
+#define _GNU_SOURCE
+
+#include "GnssAssist.h"
+#include "chprintf.h"
+#include "ff.h"
+#include "gtrackconf.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define POLL_PERIOD_IN_S            5.0
+#define FIX_TIMEOUT_IN_S            180.0
+#define CELL_PERIOD_IN_S            (GTRACK_CELL_LOCATION_PERIOD_IN_MS / 1000.0)
+#define RIDE_FIXES                  3
+#define MAX_ROUNDS                  10
+#define RTC_EPOCH                   315532800
+
+typedef struct {
+  const char *name;
+  uint32_t parked;
+  bool rtcLost;
+  bool supplyLost;
+  CGNS_StartMode_t expected;
+} Ride_t;
+
+typedef struct {
+  CGNS_StartMode_t mode;
+  double ttff;
+  double cell;
+} RideResult_t;
+
+struct RTCDriver {
+  int unused;
+};
+
+RTCDriver RTCD1;
+
+static const Ride_t rides[] = {
+  {"first boot", 0, true, true, CGNS_START_COLD},
+  {"parked 20 min", 20 * 60, false, false, CGNS_START_HOT},
+  {"parked 90 min", 90 * 60, false, false, CGNS_START_HOT},
+  {"parked 3 h", 3 * 3600, false, false, CGNS_START_WARM},
+  {"parked 9 h", 9 * 3600, false, false, CGNS_START_WARM},
+  {"parked 3 days", 3 * 86400, false, false, CGNS_START_WARM},
+  {"parked 40 days", 40 * 86400, false, false, CGNS_START_COLD},
+  {"parked 1 h", 3600, false, false, CGNS_START_HOT},
+  {"RTC lost, 30 min", 30 * 60, true, false, CGNS_START_COLD},
+  {"parked 20 min", 20 * 60, false, false, CGNS_START_HOT},
+  {"supply lost, 10 min", 10 * 60, true, true, CGNS_START_COLD},
+};
+
+#define RIDES                       (sizeof(rides) / sizeof(rides[0]))
+
+static const char *const modeNames[] = {"cold", "warm", "hot"};
+
+static char directory[] = "/tmp/gnss_dialogXXXXXX";
+static int modem = -1;
+static double scale = 50.0;
+static double origin;
+static double skipped;
+static int64_t rtcOffset;
+static bool assisted;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * The clock shared with the stand-in and the RTC.
+ */
+static double virtualNow(void) { return (now() - origin) * scale + skipped; }
+
+static void sleepUntil(double at) {
+  double wait = (at - virtualNow()) / scale;
+  if (wait > 0.0) {
+    struct timespec ts = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+    nanosleep(&ts, NULL);
+  }
+}
+
+/*
+ * ChibiOS, RTC and FatFs stand-in.
+ */
+void rtcGetTime(RTCDriver *rtcp, RTCDateTime *timespec) {
+  (void)rtcp;
+  frTimeToRtc((uint32_t)(rtcOffset + (int64_t)virtualNow()), timespec);
+}
+
+void rtcSetTime(RTCDriver *rtcp, const RTCDateTime *timespec) {
+  (void)rtcp;
+  rtcOffset = (int64_t)frTimeFromRtc(timespec) - (int64_t)virtualNow();
+}
+
+static void rtcReset(void) {
+  rtcOffset = RTC_EPOCH - (int64_t)virtualNow();
+}
+
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
+  (void)chp;
+  (void)fmt;
+  return 0;
+}
+
+int chsnprintf(char *str, size_t size, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(str, size, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode) {
+  char name[64];
+  snprintf(name, sizeof(name), "%s%s", directory, path);
+  const char *how = "rb";
+  if (FA_OPEN_APPEND == (mode & FA_OPEN_APPEND))
+    how = "ab";
+  else if (mode & FA_CREATE_ALWAYS)
+    how = "wb";
+  fp->fp = fopen(name, how);
+  return fp->fp ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+  *br = (UINT)fread(buff, 1, btr, fp->fp);
+  return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+  *bw = (UINT)fwrite(buff, 1, btw, fp->fp);
+  return FR_OK;
+}
+
+FRESULT f_close(FIL *fp) {
+  fclose(fp->fp);
+  return FR_OK;
+}
+
+/*
+ * One command and its answer up to the final result code.
+ */
+static bool command(const char *request, char response[], size_t size) {
+  size_t len = 0;
+  double deadline = now() + 10.0;
+
+  if ((write(modem, request, strlen(request)) < 0) ||
+      (write(modem, "\r", 1) < 0))
+    return false;
+
+  response[0] = '\0';
+  while ((now() < deadline) && (len + 1 < size)) {
+    struct pollfd pfd = {modem, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0)
+      continue;
+    ssize_t n = read(modem, response + len, size - 1 - len);
+    if (n <= 0)
+      break;
+    len += (size_t)n;
+    response[len] = '\0';
+    if (strstr(response, "\r\nOK\r\n"))
+      return true;
+    if (strstr(response, "\r\nERROR\r\n"))
+      return false;
+  }
+  return false;
+}
+
+static pid_t startModem(unsigned seed) {
+  modem = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((modem < 0) || grantpt(modem) || unlockpt(modem))
+    return -1;
+
+  struct termios attr;
+  int peer = open(ptsname(modem), O_RDWR | O_NOCTTY);
+  tcgetattr(peer, &attr);
+  cfmakeraw(&attr);
+  tcsetattr(peer, TCSANOW, &attr);
+
+  char scaleArg[16], seedArg[16];
+  snprintf(scaleArg, sizeof(scaleArg), "%g", scale);
+  snprintf(seedArg, sizeof(seedArg), "%u", seed);
+  pid_t pid = fork();
+  if (0 == pid) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    execlp("python3", "python3", "tools/modem_standin.py", "--port",
+           ptsname(modem), "--interval", "0", "--scale", scaleArg, "--seed",
+           seedArg, (char *)NULL);
+    _exit(127);
+  }
+  close(peer);
+
+  char response[64];
+  int tries;
+  for (tries = 0; tries < 50; ++tries)
+    if (command("AT", response, sizeof(response)))
+      break;
+  origin = now();
+  skipped = 0.0;
+  return (tries < 50) ? pid : -1;
+}
+
+static void stopModem(pid_t pid) {
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  close(modem);
+}
+
+/*
+ * The dialog of brOpen() and the network monitor's cell location.
+ */
+static bool cellLocation(Position_t *pos) {
+  char request[64], response[512];
+  SAPBR_Status_t status = SAPBR_CLOSED;
+
+  atSapbrCreateQuery(request, sizeof(request));
+  if (!command(request, response, sizeof(response)) ||
+      !atSapbrParseQuery(&status, response))
+    return false;
+  if (SAPBR_CONNECTED != status) {
+    atSapbrCreateApn(request, sizeof(request), GTRACK_APN);
+    if (!command(request, response, sizeof(response)))
+      return false;
+    atSapbrCreateContype(request, sizeof(request));
+    if (!command(request, response, sizeof(response)))
+      return false;
+    atSapbrCreateOpen(request, sizeof(request));
+    if (!command(request, response, sizeof(response)))
+      return false;
+  }
+
+  CLBS_Response_t data;
+  atClbsCreate(request, sizeof(request));
+  if (!command(request, response, sizeof(response)) ||
+      !atClbsParse(&data, response))
+    return false;
+
+  memset(pos, 0, sizeof(*pos));
+  pos->latitude = data.latitude;
+  pos->longitude = data.longitude;
+  pos->accuracy = (uint32_t)data.accuracy;
+  return frCellDate(pos->date, data.date, data.time);
+}
+
+/*
+ * Fix age of the last start in the log, UINT32_MAX when it is unknown.
+ */
+static bool loggedAge(uint32_t *age) {
+  char path[64], line[80];
+  unsigned long value = 0;
+  bool found = false;
+  snprintf(path, sizeof(path), "%s/gnss_ttff.log", directory);
+  FILE *log = fopen(path, "r");
+  if (!log)
+    return false;
+  while (fgets(line, sizeof(line), log))
+    found = 1 == sscanf(line, "%*s %*s %lu", &value);
+  fclose(log);
+  *age = (uint32_t)value;
+  return found;
+}
+
+static bool ride(const Ride_t *r, bool select, RideResult_t *res) {
+  char request[64], response[512];
+  FixRecord_t lastFix;
+  Position_t cell;
+  bool ok = true;
+
+  snprintf(request, sizeof(request), "AT+XSKIP=%lu,%d",
+           (unsigned long)r->parked, r->supplyLost ? 1 : 0);
+  command(request, response, sizeof(response));
+  skipped += r->parked;
+  if (r->rtcLost)
+    rtcReset();
+
+  /* GpsReaderStart() */
+  atCgnspwrCreateOn(request, sizeof(request));
+  command(request, response, sizeof(response));
+  res->mode = CGNS_START_COLD;
+  if (select) {
+    res->mode = gaSelectStartMode();
+    atCgnsstartCreate(request, sizeof(request), res->mode);
+    command(request, response, sizeof(response));
+  }
+
+  double start = virtualNow();
+  double next = start;
+  double cellAttempt = 0.0;
+  bool cellAttempted = false;
+  int fixes = 0;
+  res->ttff = res->cell = -1.0;
+  memset(&lastFix, 0, sizeof(lastFix));
+  bool known = assisted;
+
+  while (fixes < RIDE_FIXES) {
+    sleepUntil(next);
+    next += POLL_PERIOD_IN_S;
+
+    CGNSINF_Response_t data;
+    atCgnsinfCreate(request, sizeof(request));
+    if (!command(request, response, sizeof(response)) ||
+        !atCgnsinfParse(&data, response)) {
+      printf("FAIL %s: no answer to the poll\n", r->name);
+      ok = false;
+      break;
+    }
+
+    double t = virtualNow() - start;
+    if (1 == data.fixStatus) {
+      Position_t pos;
+      memset(&pos, 0, sizeof(pos));
+      memcpy(pos.date, data.date, sizeof(pos.date));
+      pos.latitude = data.latitude;
+      pos.longitude = data.longitude;
+      FixRecord_t rec;
+      if (!frFromPosition(&rec, &pos)) {
+        printf("FAIL %s: fix dated %s\n", r->name, data.date);
+        ok = false;
+        break;
+      }
+      if (res->ttff < 0.0) {
+        res->ttff = t;
+        gaFirstFix(&rec, (uint32_t)(t * 1000.0));
+      }
+      lastFix = rec;
+      fixes++;
+      continue;
+    }
+
+    if (t > FIX_TIMEOUT_IN_S) {
+      printf("FAIL %s: no fix in %.0f s\n", r->name, t);
+      ok = false;
+      break;
+    }
+    if ((res->cell < 0.0) &&
+        (!cellAttempted || (virtualNow() - cellAttempt >= CELL_PERIOD_IN_S))) {
+      cellAttempted = true;
+      cellAttempt = virtualNow();
+      if (cellLocation(&cell))
+        res->cell = virtualNow() - start;
+    }
+  }
+
+  /* GpsReaderStop() */
+  atCgnspwrCreateOff(request, sizeof(request));
+  command(request, response, sizeof(response));
+  if (0U != lastFix.time) {
+    gaSave(&lastFix);
+    assisted = true;
+  }
+
+  if (!select || !ok)
+    return ok;
+
+  if (res->mode != r->expected) {
+    printf("FAIL %s: %s start instead of %s\n", r->name,
+           modeNames[res->mode], modeNames[r->expected]);
+    ok = false;
+  }
+  if ((CGNS_START_HOT != res->mode) &&
+      ((res->cell < 0.0) || (res->cell >= res->ttff))) {
+    printf("FAIL %s: no cell location before the fix\n", r->name);
+    ok = false;
+  }
+  if ((res->cell >= 0.0) &&
+      ((frParseTime(cell.date) > lastFix.time) ||
+       (frParseTime(cell.date) + FIX_TIMEOUT_IN_S < lastFix.time))) {
+    printf("FAIL %s: cell location dated %s\n", r->name, cell.date);
+    ok = false;
+  }
+  uint32_t age = UINT32_MAX;
+  if (!loggedAge(&age) ||
+      (known ? (age + 1U < r->parked) ||
+                   (age > r->parked + (uint32_t)POLL_PERIOD_IN_S)
+             : (UINT32_MAX != age))) {
+    printf("FAIL %s: fix age %ld s logged after %lu s parked\n", r->name,
+           (UINT32_MAX == age) ? -1L : (long)age, (unsigned long)r->parked);
+    ok = false;
+  }
+  return ok;
+}
+
+static bool run(bool select, int rounds, unsigned seed,
+                RideResult_t res[][RIDES]) {
+  char path[64];
+  snprintf(path, sizeof(path), "%s/gnss.dat", directory);
+  remove(path);
+  snprintf(path, sizeof(path), "%s/gnss_ttff.log", directory);
+  remove(path);
+  assisted = false;
+
+  pid_t pid = startModem(seed);
+  if (pid < 0) {
+    printf("FAIL the modem stand-in does not answer\n");
+    return false;
+  }
+  rtcReset();
+
+  bool ok = true;
+  int i;
+  size_t j;
+  for (i = 0; i < rounds; ++i)
+    for (j = 0; j < RIDES; ++j)
+      ok = ride(&rides[j], select, &res[i][j]) && ok;
+
+  stopModem(pid);
+  return ok;
+}
+
+static int compare(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double printDistribution(const char *name, double *samples,
+                                size_t n) {
+  if (0U == n)
+    return 0.0;
+  double sum = 0.0;
+  size_t i;
+  qsort(samples, n, sizeof(samples[0]), compare);
+  for (i = 0; i < n; ++i)
+    sum += samples[i];
+  printf("%-24s%6zu%8.1f%8.1f%8.1f%8.1f\n", name, n, samples[0],
+         samples[n / 2], sum / n, samples[n - 1]);
+  return sum / n;
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 3;
+  scale = argc > 2 ? atof(argv[2]) : 50.0;
+  unsigned seed = argc > 3 ? (unsigned)atoi(argv[3]) : 1U;
+  static RideResult_t before[MAX_ROUNDS][RIDES], after[MAX_ROUNDS][RIDES];
+  static double samples[MAX_ROUNDS * RIDES];
+
+  if ((rounds < 1) || (rounds > MAX_ROUNDS) || (scale <= 0.0) ||
+      !mkdtemp(directory)) {
+    printf("Usage: gnss_dialog [rounds 1-%d] [scale] [seed]\n", MAX_ROUNDS);
+    return 1;
+  }
+
+  bool ok = run(false, rounds, seed, before);
+  ok = run(true, rounds, seed, after) && ok;
+
+  printf("%-24s%6s%8s%8s%8s\n", "ride (first round)", "start", "ttff s",
+         "cell s", "before");
+  size_t j;
+  int i;
+  for (j = 0; j < RIDES; ++j)
+    printf("%-24s%6s%8.1f%8.1f%8.1f\n", rides[j].name,
+           modeNames[after[0][j].mode], after[0][j].ttff, after[0][j].cell,
+           before[0][j].ttff);
+
+  printf("%-24s%6s%8s%8s%8s%8s\n", "time to first fix", "rides", "min",
+         "median", "mean", "max");
+  size_t n = 0;
+  for (i = 0; i < rounds; ++i)
+    for (j = 0; j < RIDES; ++j)
+      samples[n++] = before[i][j].ttff;
+  double powerOn = printDistribution("power on start", samples, n);
+  for (int mode = CGNS_START_HOT; mode >= CGNS_START_COLD; --mode) {
+    char name[32];
+    n = 0;
+    for (i = 0; i < rounds; ++i)
+      for (j = 0; j < RIDES; ++j)
+        if ((int)after[i][j].mode == mode)
+          samples[n++] = after[i][j].ttff;
+    snprintf(name, sizeof(name), "selected %s start", modeNames[mode]);
+    printDistribution(name, samples, n);
+  }
+  n = 0;
+  for (i = 0; i < rounds; ++i)
+    for (j = 0; j < RIDES; ++j)
+      samples[n++] = after[i][j].ttff;
+  if (printDistribution("selected, all rides", samples, n) >= powerOn) {
+    printf("FAIL the selected start is not faster\n");
+    ok = false;
+  }
+  n = 0;
+  for (i = 0; i < rounds; ++i)
+    for (j = 0; j < RIDES; ++j)
+      if (after[i][j].cell >= 0.0)
+        samples[n++] = after[i][j].cell;
+  printDistribution("cell location", samples, n);
+
+  char path[64];
+  snprintf(path, sizeof(path), "%s/gnss.dat", directory);
+  remove(path);
+  snprintf(path, sizeof(path), "%s/gnss_ttff.log", directory);
+  remove(path);
+  rmdir(directory);
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
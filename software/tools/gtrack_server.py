@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+"""Local stand-in of the tracking server for bench tests.
+
+Listens on the outbox upload port (GTRACK_SERVER_PORT), on the live
+tracking port (GTRACK_LIVE_PORT) and on the UDP reporting port
+(GTRACK_UDP_PORT) and prints every decoded position. The device has to
+reach the host, e.g. through a port forward of a public address to the
+machine running this script.
+
+Datagrams are acknowledged to the address they came from, so a device
+whose NAT binding changed is still reached. --loss drops the given share
+of datagrams in both directions to exercise the retransmissions.
+
+--selftest replays reports of a device that restarts, once with a new
+epoch and once reusing the old one, and checks that no fix is lost.
+"""
+
+import argparse
+import asyncio
+import random
+import struct
+import time
+
+import telemetry_decode as tc
+
+
+def take_packet(buf):
+    """Decode the first complete packet, returns (packet, rest).
+
+    The packet is None if more data is needed.
+    """
+    while True:
+        start = buf.find(tc.MAGIC)
+        if start < 0:
+            return None, buf[-1:]
+        buf = buf[start:]
+        try:
+            packet, end = tc.decode(buf)
+            return packet, buf[end:]
+        except tc.DecodeError as err:
+            if str(err) == "truncated packet":
+                return None, buf
+            buf = buf[1:]
+
+
+def make_handler(name):
+    async def handle(reader, writer):
+        peer = writer.get_extra_info("peername")
+        buf = b""
+        fixes = 0
+        last = None
+        while True:
+            chunk = await reader.read(4096)
+            if not chunk:
+                break
+            buf += chunk
+            while True:
+                packet, buf = take_packet(buf)
+                if packet is None:
+                    break
+                seq = packet["sequence"]
+                lost = ""
+                if last is not None and seq != last + 1:
+                    lost = " (sequence gap %d)" % (seq - last - 1)
+                last = seq
+                extra = ""
+                if "source" in packet:
+                    extra += " %s" % packet["source"]
+                if "age" in packet:
+                    extra += " age %.1f s" % packet["age"]
+                print("%s %s: #%d %d fixes%s%s" % (
+                    name, peer, seq, len(packet["fixes"]), extra, lost))
+                for fix in packet["fixes"]:
+                    print("  " + tc.format_fix(fix))
+                fixes += len(packet["fixes"])
+        print("%s %s: closed after %d fixes" % (name, peer, fixes))
+        writer.close()
+    return handle
+
+
+UDP_MAGIC = b"GU"
+UDP_VERSION = 1
+UDP_DATA = 1
+UDP_ACK = 2
+UDP_HEADER = struct.Struct("<2sBBII")
+UDP_ACK_BODY = struct.Struct("<II")
+IP_UDP_HEADER_SIZE = 28
+
+
+class Report:
+    """Receive state of a device, the sequence restarts with the epoch."""
+
+    def __init__(self):
+        self.cumulative = 0
+        self.received = set()
+        self.times = set()
+        self.fixes = 0
+        self.duplicates = 0
+        self.bytes = 0
+
+    def seen(self, seq):
+        return seq < self.cumulative or seq in self.received
+
+    def accept(self, seq):
+        """Returns False if the datagram was already received."""
+        if self.seen(seq):
+            return False
+        self.received.add(seq)
+        while self.cumulative in self.received:
+            self.received.remove(self.cumulative)
+            self.cumulative += 1
+        return True
+
+    def bitmap(self):
+        bits = 0
+        for seq in self.received:
+            offset = seq - self.cumulative - 1
+            if 0 <= offset < 32:
+                bits |= 1 << offset
+        return bits
+
+
+class ReportProtocol(asyncio.DatagramProtocol):
+    def __init__(self, loss, quiet=False):
+        self.loss = loss
+        self.quiet = quiet
+        self.reports = {}
+        self.transport = None
+
+    def log(self, text):
+        if not self.quiet:
+            print(text)
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, addr):
+        if random.random() < self.loss:
+            return
+        if len(data) < UDP_HEADER.size:
+            return
+        magic, version, kind, device, epoch = UDP_HEADER.unpack_from(data)
+        if magic != UDP_MAGIC or version != UDP_VERSION or kind != UDP_DATA:
+            return
+        try:
+            packet, _ = tc.decode(data, UDP_HEADER.size)
+        except tc.DecodeError as err:
+            self.log("udp %s: %s" % (addr, err))
+            return
+
+        report = self.reports.setdefault((device, epoch), Report())
+        seq = packet["sequence"]
+        # A retransmission carries the fixes already stored. New fixes
+        # under a known sequence number mean the device restarted with the
+        # same epoch, start its sequence again instead of acking them away.
+        if report.seen(seq) and any(f[0] not in report.times
+                                    for f in packet["fixes"]):
+            self.log("udp %08X/%d %s: #%d epoch reused, sequence restarted"
+                     % (device, epoch, addr, seq))
+            restarted = Report()
+            restarted.times = report.times
+            restarted.fixes = report.fixes
+            restarted.duplicates = report.duplicates
+            restarted.bytes = report.bytes
+            report = self.reports[(device, epoch)] = restarted
+        report.bytes += len(data) + IP_UDP_HEADER_SIZE
+        if report.accept(seq):
+            now = time.time()
+            fixes = [f for f in packet["fixes"]
+                     if f[0] not in report.times]
+            report.duplicates += len(packet["fixes"]) - len(fixes)
+            report.times.update(f[0] for f in fixes)
+            report.fixes += len(fixes)
+            newest = max(f[0] for f in packet["fixes"])
+            self.log("udp %08X/%d %s: #%d %d fixes, %d bytes, newest %.1f s "
+                     "old" % (device, epoch, addr, seq, len(fixes), len(data),
+                              now - newest))
+            for fix in fixes:
+                self.log("  " + tc.format_fix(fix))
+            if report.fixes:
+                self.log("  total %d fixes, %.2f bytes/fix, %d duplicates" % (
+                    report.fixes, report.bytes / report.fixes,
+                    report.duplicates))
+        else:
+            self.log("udp %08X/%d %s: #%d again" % (device, epoch, addr, seq))
+
+        if random.random() < self.loss:
+            return
+        ack = UDP_HEADER.pack(UDP_MAGIC, UDP_VERSION, UDP_ACK, device, epoch)
+        ack += UDP_ACK_BODY.pack(report.cumulative, report.bitmap())
+        self.transport.sendto(ack, addr)
+
+
+class AckCatcher:
+    """Transport of the self test, keeps the acks instead of sending them."""
+
+    def __init__(self):
+        self.acks = []
+
+    def sendto(self, data, addr):
+        self.acks.append(data)
+
+
+def upload(server, catcher, device, epoch, outbox, crash_after=None):
+    """Send the outbox like the device does, the acked fixes are dropped.
+
+    Returns after crash_after datagrams with the rest still queued, as a
+    device that lost power would.
+    """
+    seq = 0
+    while outbox and seq != crash_after:
+        packet, count = tc.encode(outbox[:8], sequence=seq)
+        data = UDP_HEADER.pack(UDP_MAGIC, UDP_VERSION, UDP_DATA, device,
+                               epoch) + packet
+        for _ in range(100):
+            catcher.acks.clear()
+            server.datagram_received(data, ("device", 5052))
+            acked = False
+            for ack in catcher.acks:
+                cumulative, bits = UDP_ACK_BODY.unpack_from(ack,
+                                                            UDP_HEADER.size)
+                offset = seq - cumulative - 1
+                if seq < cumulative or (0 <= offset < 32 and
+                                        bits & (1 << offset)):
+                    acked = True
+            if acked:
+                break
+        else:
+            raise SystemExit("selftest failed: #%d never acked" % seq)
+        del outbox[:count]
+        seq += 1
+
+
+def selftest():
+    ok = True
+    for loss in (0.0, 0.3):
+        for reuse in (False, True):
+            random.seed(1)
+            server = ReportProtocol(loss, quiet=True)
+            catcher = AckCatcher()
+            server.connection_made(catcher)
+            device, epoch = 0x1234ABCD, 7
+            rides = [[(t, 475000000 + t, 190000000 - t, 100, 3000)
+                      for t in range(start, start + 100)]
+                     for start in (1000, 5000, 9000)]
+            outbox = list(rides[0])
+            upload(server, catcher, device, epoch, outbox, crash_after=5)
+            for ride in rides[1:]:
+                if not reuse:
+                    epoch += 1
+                outbox += ride
+                upload(server, catcher, device, epoch, outbox)
+            stored = set()
+            for report in server.reports.values():
+                stored |= report.times
+            expected = {f[0] for ride in rides for f in ride}
+            lost = len(expected - stored)
+            print("loss %.1f, %s epoch: %d of %d fixes stored, %d lost" % (
+                loss, "reused" if reuse else "new", len(stored & expected),
+                len(expected), lost))
+            ok = ok and not lost and not outbox
+    if not ok:
+        raise SystemExit("selftest failed")
+
+
+async def serve(args):
+    upload = await asyncio.start_server(make_handler("upload"), args.host,
+                                        args.upload_port)
+    live = await asyncio.start_server(make_handler("live"), args.host,
+                                      args.live_port)
+    loop = asyncio.get_running_loop()
+    udp, _ = await loop.create_datagram_endpoint(
+        lambda: ReportProtocol(args.loss), local_addr=(args.host,
+                                                       args.udp_port))
+    print("listening on %s, upload %d, live %d, udp %d" % (
+        args.host, args.upload_port, args.live_port, args.udp_port))
+    try:
+        async with upload, live:
+            await asyncio.gather(upload.serve_forever(), live.serve_forever())
+    finally:
+        udp.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--upload-port", type=int, default=5050)
+    parser.add_argument("--live-port", type=int, default=5051)
+    parser.add_argument("--udp-port", type=int, default=5052)
+    parser.add_argument("--loss", type=float, default=0.0,
+                        help="share of datagrams dropped, 0-1")
+    parser.add_argument("--selftest", action="store_true",
+                        help="replay device restarts and check for losses")
+    args = parser.parse_args()
+    if args.selftest:
+        selftest()
+        return
+    asyncio.run(serve(args))
+
+
+if __name__ == "__main__":
+    main()
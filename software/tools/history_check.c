@@ -0,0 +1,317 @@
+/**
+ * @file history_check.c
+ * @brief Host check of the position history and its cost against the log.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Itools/host -Isource -o history_check tools/history_check.c \
+ *      source/PositionHistory.c source/FixRecord.c
+ *   ./history_check [seed]
+ *
+ * frParseTime() is checked against the C library on random times that fit
+ * in 32 bits and has to reject every field out of its range. The RTC calendar
+ * conversions have to round trip.
+ *
+ * Fixes with random gaps are appended past the capacity of the ring. Every
+ * lookup and window is compared with a linear search over the fixes the
+ * ring should still hold. The shell command has to print the same window,
+ * and never while the history is locked.
+ *
+ * The cost of "where was I at time t" is then timed on the ring and by
+ * re-reading a /sim8xx_gnss.log of one hour, written the way the GPS reader
+ * writes it. The bytes the log lookup has to read are what it costs on the
+ * card, the host time only ranks the two.
+ */
+
+#include "PositionHistory.h"
+#include "chprintf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FIXES                1000
+#define RIDE_FIXES           720
+#define FIX_PERIOD_IN_S      5
+#define LOOKUPS              10000
+#define LOG_LOOKUPS          200
+
+static bool locked;
+static unsigned printedRecords;
+static unsigned printedLocked;
+
+static FixRecord_t fixes[FIXES];
+
+/*
+ * ChibiOS stand-in, a single thread that must never print with the history
+ * locked.
+ */
+void chMtxObjectInit(mutex_t *mp) { mp->owner = 0; }
+
+void chMtxLock(mutex_t *mp) {
+  mp->owner = 1;
+  locked = true;
+}
+
+void chMtxUnlock(mutex_t *mp) {
+  mp->owner = 0;
+  locked = false;
+}
+
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
+  (void)chp;
+  if (locked)
+    printedLocked++;
+  if (0 == strncmp(fmt, "%lu %ld", 7))
+    printedRecords++;
+  return 0;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t random32(void) {
+  return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void formatDate(char *buf, size_t size, int y, int mo, int d, int h,
+                       int mi, int s) {
+  snprintf(buf, size, "%04d%02d%02d%02d%02d%02d.000", y, mo, d, h, mi, s);
+}
+
+static bool checkParse(void) {
+  bool ok = true;
+  int i;
+
+  for (i = 0; i < 100000; ++i) {
+    time_t t = (time_t)random32();
+    struct tm tm;
+    char date[80];
+    gmtime_r(&t, &tm);
+    formatDate(date, sizeof(date), tm.tm_year + 1900, tm.tm_mon + 1,
+               tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    if (frParseTime(date) != (uint32_t)t) {
+      printf("FAIL %s parsed as %lu instead of %lu\n", date,
+             (unsigned long)frParseTime(date), (unsigned long)t);
+      ok = false;
+    }
+
+    RTCDateTime rtc;
+    frTimeToRtc((uint32_t)t, &rtc);
+    if ((t >= 315532800) && (t < 315532800 + 255LL * 365 * 86400) &&
+        (frTimeFromRtc(&rtc) != (uint32_t)t)) {
+      printf("FAIL RTC round trip of %lu\n", (unsigned long)t);
+      ok = false;
+    }
+  }
+
+  static const char *const bad[] = {
+    "19691231235959.000", "21060207062816.000", "20240001000000.000",
+    "20241301000000.000", "20240100000000.000", "20240132000000.000",
+    "20230229000000.000", "20240230000000.000", "20240431000000.000",
+    "21000229000000.000", "20240101240000.000", "20240101006000.000",
+    "20240101000060.000", "2024010100000",      "2024o101000000.000",
+    "",
+  };
+  for (i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); ++i) {
+    if (0U != frParseTime(bad[i])) {
+      printf("FAIL accepted \"%s\"\n", bad[i]);
+      ok = false;
+    }
+  }
+  if (0U == frParseTime("20240229235959.000") ||
+      0U == frParseTime("20000229000000.000")) {
+    printf("FAIL rejected a leap day\n");
+    ok = false;
+  }
+  return ok;
+}
+
+/*
+ * Index in fixes[] of the latest fix at or before t among the kept ones.
+ */
+static int referenceAt(int first, int last, uint32_t t) {
+  int i, found = -1;
+  for (i = first; i < last; ++i)
+    if (fixes[i].time <= t)
+      found = i;
+  return found;
+}
+
+static bool checkHistory(void) {
+  bool ok = true;
+  uint32_t t = 1700000000U;
+  int i;
+
+  phInit();
+  for (i = 0; i < FIXES; ++i) {
+    t += 1U + (uint32_t)rand() % 10U;
+    fixes[i].time = t;
+    fixes[i].latitude = (int32_t)random32();
+    fixes[i].longitude = (int32_t)random32();
+    fixes[i].altitude = (int16_t)rand();
+    fixes[i].speed = (uint16_t)rand();
+    if (!phAppend(&fixes[i]) || phAppend(&fixes[i])) {
+      printf("FAIL append of fix %d\n", i);
+      ok = false;
+    }
+  }
+
+  int first = FIXES - POSITION_HISTORY_SIZE;
+  if (phCount() != POSITION_HISTORY_SIZE) {
+    printf("FAIL %zu fixes kept\n", phCount());
+    ok = false;
+  }
+
+  uint32_t lo = fixes[first].time - 20U, hi = fixes[FIXES - 1].time + 20U;
+  for (i = 0; i < LOOKUPS; ++i) {
+    uint32_t at = lo + random32() % (hi - lo);
+    FixRecord_t rec;
+    int want = referenceAt(first, FIXES, at);
+    bool found = phFindAt(at, &rec);
+    if ((want < 0) ? found
+                   : (!found || memcmp(&rec, &fixes[want], sizeof(rec)))) {
+      printf("FAIL lookup at %lu\n", (unsigned long)at);
+      ok = false;
+    }
+
+    uint32_t from = lo + random32() % (hi - lo);
+    uint32_t to = from + random32() % 600U;
+    FixRecord_t buf[8];
+    size_t copied = phCopy(from, to, buf, 8);
+    size_t expected = 0, j;
+    int k;
+    for (k = first; k < FIXES; ++k) {
+      if ((fixes[k].time < from) || (fixes[k].time > to))
+        continue;
+      if ((expected < 8) &&
+          memcmp(&buf[expected], &fixes[k], sizeof(fixes[k])))
+        ok = false;
+      expected++;
+    }
+    j = expected < 8 ? expected : 8;
+    if (copied != j) {
+      printf("FAIL window %lu-%lu copied %zu of %zu\n", (unsigned long)from,
+             (unsigned long)to, copied, expected);
+      ok = false;
+    }
+  }
+
+  char arg[16];
+  char *argv[] = {arg};
+  for (i = 0; i < 20; ++i) {
+    uint32_t window = (uint32_t)rand() % 3000U;
+    snprintf(arg, sizeof(arg), "%lu", (unsigned long)window);
+    printedRecords = 0;
+    phCmdHistory(NULL, 1, argv);
+    uint32_t newest = fixes[FIXES - 1].time;
+    unsigned expected = 0;
+    int k;
+    for (k = first; k < FIXES; ++k)
+      if (fixes[k].time >= newest - window)
+        expected++;
+    if (printedRecords != expected) {
+      printf("FAIL history %lu printed %u of %u fixes\n",
+             (unsigned long)window, printedRecords, expected);
+      ok = false;
+    }
+  }
+  if (printedLocked) {
+    printf("FAIL %u lines printed with the history locked\n", printedLocked);
+    ok = false;
+  }
+  return ok;
+}
+
+/*
+ * Latest fix at or before t, read back from the log like a reader without
+ * the history would.
+ */
+static bool logFindAt(FILE *log, uint32_t t, FixRecord_t *rec, long *bytes) {
+  char line[160];
+  bool found = false;
+  rewind(log);
+  while (fgets(line, sizeof(line), log)) {
+    *bytes += (long)strlen(line);
+    uint32_t time = frParseTime(line);
+    if ((0U == time) || (time > t))
+      break;
+    double lat, lon;
+    if (2 == sscanf(line + 19, "%lf %lf", &lat, &lon)) {
+      rec->time = time;
+      rec->latitude = (int32_t)(lat * FR_DEGREE_SCALE);
+      rec->longitude = (int32_t)(lon * FR_DEGREE_SCALE);
+      found = true;
+    }
+  }
+  return found;
+}
+
+static void measureCost(void) {
+  FILE *log = tmpfile();
+  uint32_t start = 1700000000U;
+  int i;
+
+  phInit();
+  for (i = 0; i < RIDE_FIXES; ++i) {
+    time_t t = (time_t)(start + (uint32_t)i * FIX_PERIOD_IN_S);
+    struct tm tm;
+    char date[80];
+    gmtime_r(&t, &tm);
+    formatDate(date, sizeof(date), tm.tm_year + 1900, tm.tm_mon + 1,
+               tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    double lat = 47.4979 + i * 1e-4, lon = 19.0402 + i * 1e-4;
+    fprintf(log, "%s %f %f %f %f %d %d %d %d\n", date, lat, lon, 42.5,
+            120.0, 1, 12, 20, 9);
+    FixRecord_t rec = {(uint32_t)t, (int32_t)(lat * FR_DEGREE_SCALE),
+                       (int32_t)(lon * FR_DEGREE_SCALE), 120, 4250};
+    phAppend(&rec);
+  }
+  fflush(log);
+  long size = ftell(log);
+
+  /* Two minutes ago, and anywhere in the time the ring covers. */
+  uint32_t newest = start + (RIDE_FIXES - 1) * FIX_PERIOD_IN_S;
+  uint32_t span = (POSITION_HISTORY_SIZE - 1) * FIX_PERIOD_IN_S;
+  FixRecord_t rec;
+  volatile uint32_t sink = 0;
+
+  double t0 = now();
+  for (i = 0; i < LOOKUPS; ++i) {
+    if (phFindAt(newest - (uint32_t)rand() % span, &rec))
+      sink += rec.time;
+  }
+  double ring = (now() - t0) / LOOKUPS;
+
+  long bytes = 0, recent = 0;
+  t0 = now();
+  for (i = 0; i < LOG_LOOKUPS; ++i) {
+    if (logFindAt(log, newest - (uint32_t)rand() % span, &rec, &bytes))
+      sink += rec.time;
+  }
+  double file = (now() - t0) / LOG_LOOKUPS;
+  logFindAt(log, newest - 120U, &rec, &recent);
+  fclose(log);
+  (void)sink;
+
+  printf("one hour log: %d fixes, %ld bytes; ring: %d fixes, %zu bytes\n",
+         RIDE_FIXES, size, POSITION_HISTORY_SIZE,
+         POSITION_HISTORY_SIZE * sizeof(FixRecord_t));
+  printf("lookup in the ring  %9.0f ns, nothing read from the card\n",
+         ring * 1e9);
+  printf("lookup in the log   %9.0f ns, %ld bytes read on average, %ld for "
+         "two minutes ago\n", file * 1e9, bytes / LOG_LOOKUPS, recent);
+}
+
+int main(int argc, char *argv[]) {
+  srand(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+  bool ok = checkParse();
+  ok = checkHistory() && ok;
+  measureCost();
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
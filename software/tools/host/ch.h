@@ -0,0 +1,64 @@
+/**
+ * @file ch.h
+ * @brief Host stand-in of the ChibiOS API used by the host checks.
+ *
+ * Only what the modules built on the host call is declared. The critical
+ * section is a process wide mutex, which serializes the writers like the
+ * real one; the readers run in parallel with them on other cores, which
+ * the target never does. The functions are defined by the check that
+ * needs them.
+ */
+
+#ifndef CH_H
+#define CH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t eventmask_t;
+typedef uint32_t eventflags_t;
+typedef uint32_t rtcnt_t;
+
+typedef struct event_listener {
+  struct event_listener *next;
+  eventmask_t events;
+  eventflags_t wflags;
+} event_listener_t;
+
+typedef struct {
+  event_listener_t *next;
+} event_source_t;
+
+typedef struct {
+  uint64_t start;
+} time_measurement_t;
+
+typedef struct {
+  int owner;
+} mutex_t;
+
+typedef struct BaseSequentialStream BaseSequentialStream;
+
+#define EVENT_MASK(eid)  ((eventmask_t)1 << (eventmask_t)(eid))
+#define chDbgCheck(c)    ((void)(c))
+
+void chSysLock(void);
+void chSysUnlock(void);
+void chSchRescheduleS(void);
+systime_t chVTGetSystemTimeX(void);
+rtcnt_t chSysGetRealtimeCounterX(void);
+
+void chMtxObjectInit(mutex_t *mp);
+void chMtxLock(mutex_t *mp);
+void chMtxUnlock(mutex_t *mp);
+
+void chEvtObjectInit(event_source_t *esp);
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags);
+void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp,
+                                eventmask_t events, eventflags_t wflags);
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp);
+
+#endif /* CH_H */
@@ -0,0 +1,16 @@
+/**
+ * @file chprintf.h
+ * @brief Host stand-in of the ChibiOS formatted output.
+ */
+
+#ifndef CHPRINTF_H
+#define CHPRINTF_H
+
+#include "hal.h"
+
+#include <stddef.h>
+
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...);
+int chsnprintf(char *str, size_t size, const char *fmt, ...);
+
+#endif /* CHPRINTF_H */
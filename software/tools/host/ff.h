@@ -0,0 +1,43 @@
+/**
+ * @file ff.h
+ * @brief Host stand-in of the FatFs calls used by the host checks.
+ */
+
+#ifndef FF_H
+#define FF_H
+
+#include <stdio.h>
+
+#define FA_READ                     0x01
+#define FA_WRITE                    0x02
+#define FA_OPEN_EXISTING            0x00
+#define FA_CREATE_ALWAYS            0x08
+#define FA_OPEN_APPEND              0x30
+
+typedef unsigned char BYTE;
+typedef unsigned int UINT;
+typedef unsigned long FSIZE_t;
+
+typedef enum {
+  FR_OK = 0,
+  FR_DISK_ERR,
+  FR_NO_FILE
+} FRESULT;
+
+typedef struct {
+  FILE *fp;
+} FIL;
+
+typedef struct {
+  FSIZE_t fsize;
+} FILINFO;
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_close(FIL *fp);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_stat(const char *path, FILINFO *fno);
+FSIZE_t f_size(FIL *fp);
+
+#endif /* FF_H */
@@ -0,0 +1,29 @@
+/**
+ * @file hal.h
+ * @brief Host stand-in of the ChibiOS HAL types used by the host checks.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "ch.h"
+
+#define RTC_BASE_YEAR               1980U
+
+typedef struct {
+  uint32_t year: 8;
+  uint32_t month: 4;
+  uint32_t dstflag: 1;
+  uint32_t dayofweek: 3;
+  uint32_t day: 5;
+  uint32_t millisecond: 27;
+} RTCDateTime;
+
+typedef struct RTCDriver RTCDriver;
+
+extern RTCDriver RTCD1;
+
+void rtcGetTime(RTCDriver *rtcp, RTCDateTime *timespec);
+void rtcSetTime(RTCDriver *rtcp, const RTCDateTime *timespec);
+
+#endif /* HAL_H */
@@ -0,0 +1,388 @@
+/**
+ * @file imagewriter_check.c
+ * @brief Host check of the OTA image writer against a simulated flash.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -o imagewriter_check tools/imagewriter_check.c \
+ *      source/ImageWriter.c source/OtaDownload.c
+ *   ./imagewriter_check
+ *
+ * The package is built like tools/ota_package.py does and downloaded by
+ * OtaDownload.c, the code FirmwareUpdateThread.c runs, from a simulated
+ * server: one range request per segment, read chunk by chunk, a chunk that
+ * fails its CRC read once more and then requested again from the server,
+ * a failed session resumed from the last verified chunk, and a bad image
+ * at the end resumed from its first bad chunk. The progress saved after
+ * every segment is resumed by a second download after a power loss.
+ *
+ * The flash follows the STM32L4: erased bytes are 0xFF and a write unit is
+ * only programmed once after an erase. Faults of a field download are
+ * injected at the same share of the image on a small device with chunks
+ * smaller than a page and on the real slot geometry. A case passes when the
+ * slot ends up bootable, or not, as expected. The bytes requested from the
+ * server beyond the package are reported, before the chunk CRCs a bad transfer cost the
+ * whole image again.
+ */
+
+#include "ImageWriter.h"
+#include "OtaDownload.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NEVER                UINT32_MAX
+#define MAX_DEVICE_SIZE      (128 * 1024)
+#define MAX_PACKAGE_SIZE     (IW_HEADER_SIZE + 4 * IW_MAX_CHUNKS + \
+                              MAX_DEVICE_SIZE)
+
+typedef struct {
+  const char *name;
+  uint32_t pageSize;
+  uint32_t deviceSize;
+  uint32_t imageSize;
+  uint32_t chunk;
+  uint32_t segment;
+} Geometry_t;
+
+typedef struct {
+  const char *name;
+  uint32_t cutAt;       /**< Program call interrupted by a reset.           */
+  uint32_t flipAt;      /**< Program call that stores a wrong bit.          */
+  uint32_t corruptAt;   /**< Byte changed on its way from the modem, per mille
+                             of the image.                                  */
+  uint32_t corruptReads;/**< Reads of that byte that come out changed.      */
+  uint32_t disconnectAt;/**< Where the connection drops once, per mille.    */
+  uint32_t decayAt;     /**< Byte that changes in flash once written,
+                             per mille.                                     */
+  uint32_t abortAt;     /**< Where the download is abandoned, per mille.    */
+  bool badImageCrc;     /**< The package carries a wrong image CRC.         */
+  bool restart;         /**< The abandoned download is started again.       */
+  bool bootable;
+} Case_t;
+
+typedef struct {
+  uint8_t mem[MAX_DEVICE_SIZE];
+  uint32_t programs;
+  uint32_t erases;
+  uint32_t cutAt;
+  uint32_t flipAt;
+} SimFlash_t;
+
+/**
+ * @brief Server, modem and SD card of a download.
+ */
+typedef struct {
+  const Case_t *tc;
+  uint32_t imageStart;
+  uint32_t first;       /**< Body of the last request.                     */
+  uint32_t length;
+  uint32_t requested;   /**< Package bytes requested from the server.       */
+  uint32_t corruptReads;
+  uint32_t disconnectAt;
+  uint32_t decayAt;
+  bool aborted;
+  bool saved;           /**< Progress on the card, kept over a restart.    */
+  ImageHeader_t savedHeader;
+  uint32_t savedOffset;
+} Server_t;
+
+static const Geometry_t geometries[] = {
+  {"small", 128, 16 * 128, 1733, 96, 384},
+  {"slot", 2048, 128 * 1024, 118001, 2048, 16 * 1024},
+};
+
+static const Case_t cases[] = {
+  {"clean", NEVER, NEVER, NEVER, 0, NEVER, NEVER, NEVER, false, false, true},
+  {"disconnect", NEVER, NEVER, NEVER, 0, 577, NEVER, NEVER, false, false,
+   true},
+  {"reset", 9, NEVER, NEVER, 0, NEVER, NEVER, NEVER, false, false, true},
+  {"bad write", NEVER, 14, NEVER, 0, NEVER, NEVER, NEVER, false, false, true},
+  {"bad read", NEVER, NEVER, 448, 1, NEVER, NEVER, NEVER, false, false, true},
+  {"bad transfer", NEVER, NEVER, 448, 2, NEVER, NEVER, NEVER, false, false,
+   true},
+  {"bad server", NEVER, NEVER, 448, NEVER, NEVER, NEVER, NEVER, false, false,
+   false},
+  {"flash decay", NEVER, NEVER, NEVER, 0, NEVER, 692, NEVER, false, false,
+   true},
+  {"bad package", NEVER, NEVER, NEVER, 0, NEVER, NEVER, NEVER, true, false,
+   false},
+  {"abandoned", NEVER, NEVER, NEVER, 0, NEVER, NEVER, 519, false, false,
+   false},
+  {"power loss", NEVER, NEVER, NEVER, 0, NEVER, NEVER, 519, false, true,
+   true},
+};
+
+static SimFlash_t sim;
+static uint8_t package[MAX_PACKAGE_SIZE];
+static uint8_t chunk[MAX_DEVICE_SIZE];
+
+static bool simErase(const FlashDevice_t *dev, uint32_t offset) {
+  SimFlash_t *s = dev->priv;
+  s->erases++;
+  memset(s->mem + offset - (offset % dev->pageSize), 0xFF, dev->pageSize);
+  return true;
+}
+
+static bool simProgram(const FlashDevice_t *dev, uint32_t offset,
+                       const uint8_t *data, size_t length) {
+  SimFlash_t *s = dev->priv;
+  uint32_t call = s->programs++;
+  size_t i;
+
+  if ((offset % dev->writeSize) || (length % dev->writeSize) ||
+      (offset + length > dev->size))
+    return false;
+  for (i = 0; i < length; ++i)
+    if (0xFF != s->mem[offset + i])
+      return false;
+
+  if (call == s->cutAt) {
+    memcpy(s->mem + offset, data, length / 2);
+    return false;
+  }
+  memcpy(s->mem + offset, data, length);
+  if (call == s->flipAt)
+    s->mem[offset + length - 1] ^= 0x10;
+  return true;
+}
+
+static uint8_t imageByte(uint32_t offset, uint32_t version) {
+  uint32_t x = (offset + 1U) * 2654435761U + version * 40503U;
+  return (uint8_t)(x >> 24);
+}
+
+static void putU32(uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+/*
+ * Header, chunk CRCs and image as tools/ota_package.py lays them out.
+ */
+static uint32_t buildPackage(const Geometry_t *g, uint32_t version,
+                             bool badImageCrc) {
+  uint32_t count = (g->imageSize + g->chunk - 1U) / g->chunk;
+  uint8_t *image = package + IW_HEADER_SIZE + 4U * count;
+  uint32_t i;
+
+  for (i = 0; i < g->imageSize; ++i)
+    image[i] = imageByte(i, version);
+  putU32(package, IW_PACKAGE_MAGIC);
+  putU32(package + 4, version);
+  putU32(package + 8, g->imageSize);
+  putU32(package + 12, iwCrc32(0, image, g->imageSize) ^
+                       (badImageCrc ? 1U : 0U));
+  putU32(package + 16, g->chunk);
+  for (i = 0; i < count; ++i) {
+    uint32_t length = g->imageSize - i * g->chunk;
+    if (length > g->chunk)
+      length = g->chunk;
+    putU32(package + IW_HEADER_SIZE + 4U * i,
+           iwCrc32(0, image + i * g->chunk, length));
+  }
+  return IW_HEADER_SIZE + 4U * count + g->imageSize;
+}
+
+static bool srvOpen(void *priv) {
+  (void)priv;
+  return true;
+}
+
+static void srvClose(void *priv) {
+  (void)priv;
+}
+
+static bool srvRequest(void *priv, uint32_t first, uint32_t last) {
+  Server_t *s = priv;
+  s->first = first;
+  s->length = last - first + 1U;
+  s->requested += s->length;
+  return true;
+}
+
+/*
+ * A chunk as the modem hands it over, the injected byte changed on as many
+ * reads as the case asks for. Faults are placed by image offset.
+ */
+static bool srvRead(void *priv, uint32_t pos, uint8_t *buf, size_t size) {
+  Server_t *s = priv;
+  uint32_t offset = s->first + pos;
+
+  if (pos + size > s->length)
+    return false;
+  memcpy(buf, package + offset, size);
+  if (offset < s->imageStart)
+    return true;
+
+  uint32_t at = offset - s->imageStart;
+  if (at >= s->tc->abortAt) {
+    s->aborted = true;
+    return false;
+  }
+  if (at + size > s->disconnectAt) {
+    s->disconnectAt = NEVER;
+    return false;
+  }
+  if ((s->tc->corruptAt >= at) && (s->tc->corruptAt < at + size) &&
+      (s->corruptReads > 0U)) {
+    buf[s->tc->corruptAt - at] ^= 0x01;
+    if (NEVER != s->corruptReads)
+      --s->corruptReads;
+  }
+  return true;
+}
+
+static bool srvLoad(void *priv, const ImageHeader_t *header,
+                    uint32_t *offset) {
+  Server_t *s = priv;
+  if (!s->saved || (s->savedHeader.version != header->version) ||
+      (s->savedHeader.size != header->size) ||
+      (s->savedHeader.crc != header->crc))
+    return false;
+  *offset = s->savedOffset;
+  return true;
+}
+
+/*
+ * The injected byte changes in flash once it is written and verified.
+ */
+static void srvSave(void *priv, const ImageHeader_t *header,
+                    uint32_t offset) {
+  Server_t *s = priv;
+  s->saved = true;
+  s->savedHeader = *header;
+  s->savedOffset = offset;
+  if (offset > s->decayAt) {
+    sim.mem[s->decayAt] ^= 0x04;
+    s->decayAt = NEVER;
+  }
+}
+
+static void srvClear(void *priv) {
+  Server_t *s = priv;
+  s->saved = false;
+}
+
+static bool srvAborted(void *priv) {
+  Server_t *s = priv;
+  return s->aborted;
+}
+
+static void srvPause(void *priv) {
+  (void)priv;
+}
+
+static void srvWriting(void *priv, bool active) {
+  (void)priv;
+  (void)active;
+}
+
+static const OdOps_t srvOps = {
+  srvOpen, srvClose, srvRequest, srvRead, srvLoad, srvSave, srvClear,
+  srvAborted, srvPause, srvWriting
+};
+
+static IwStatus_t download(OtaDownload_t *od, Server_t *s,
+                           const FlashDevice_t *dev, const Geometry_t *g,
+                           const Case_t *tc, uint32_t version) {
+  static uint32_t crcs[IW_MAX_CHUNKS];
+
+  buildPackage(g, version, tc->badImageCrc);
+  s->tc = tc;
+  s->imageStart = iwImageStart(&(ImageHeader_t){.size = g->imageSize,
+                                                .chunk = g->chunk});
+  s->requested = 0;
+  s->corruptReads = tc->corruptReads;
+  s->disconnectAt = tc->disconnectAt;
+  s->decayAt = tc->decayAt;
+  s->aborted = false;
+  odInit(od, &srvOps, s, dev, chunk, sizeof(chunk), crcs, g->segment);
+  return odRun(od);
+}
+
+static uint32_t scale(const Geometry_t *g, uint32_t permille) {
+  return (NEVER == permille) ? NEVER
+                             : (uint32_t)((uint64_t)g->imageSize * permille /
+                                          1000U);
+}
+
+static bool run(const Geometry_t *g, const Case_t *scripted) {
+  Case_t at = *scripted;
+  const Case_t *tc = &at;
+  const FlashDevice_t dev = {sim.mem, g->deviceSize, g->pageSize,
+                             FLASH_WRITE_SIZE, simErase, simProgram, &sim};
+  OtaDownload_t od;
+  Server_t server;
+  IwStatus_t status;
+
+  at.corruptAt = scale(g, at.corruptAt);
+  at.disconnectAt = scale(g, at.disconnectAt);
+  at.decayAt = scale(g, at.decayAt);
+  at.abortAt = scale(g, at.abortAt);
+
+  /* The slot holds an old image, and for one case a verified one. */
+  memset(sim.mem, 0xA5, sizeof(sim.mem));
+  memset(&server, 0, sizeof(server));
+  sim.cutAt = NEVER;
+  sim.flipAt = NEVER;
+  if (NEVER != tc->abortAt) {
+    download(&od, &server, &dev, g, &cases[0], 1);
+    if (!iwIsBootable(&dev, NULL)) {
+      printf("FAIL %s %s: previous image not bootable\n", g->name, tc->name);
+      return false;
+    }
+  }
+
+  sim.programs = 0;
+  sim.erases = 0;
+  sim.cutAt = tc->cutAt;
+  sim.flipAt = tc->flipAt;
+  status = download(&od, &server, &dev, g, tc, 2);
+  uint32_t requested = server.requested;
+
+  /* Power comes back, the download starts again. */
+  if (tc->restart) {
+    at.abortAt = NEVER;
+    status = download(&od, &server, &dev, g, tc, 2);
+    requested += server.requested;
+  }
+
+  ImageHeader_t marker;
+  bool bootable = iwIsBootable(&dev, &marker) && (2U == marker.version);
+  bool pass = (bootable == tc->bootable);
+  uint32_t package = iwImageStart(&(ImageHeader_t){.size = g->imageSize,
+                                                   .chunk = g->chunk}) +
+                     g->imageSize;
+  long extra = (long)requested - (long)package;
+
+  printf("  %-12s %-15s retries %lu, rereads %2lu, re-requests %2lu, "
+         "resumed at %6lu, erases %3lu, programs %5lu, extra %6ld B, "
+         "bootable %-3s %s\n",
+         tc->name, iwStatusName(status), (unsigned long)od.retries,
+         (unsigned long)od.rereads, (unsigned long)od.badChunks,
+         (unsigned long)od.resumedAt,
+         (unsigned long)sim.erases, (unsigned long)sim.programs, extra,
+         bootable ? "yes" : "no", pass ? "PASS" : "FAIL");
+  return pass;
+}
+
+int main(void) {
+  size_t i, j, passed = 0, total = 0;
+
+  for (i = 0; i < sizeof(geometries) / sizeof(geometries[0]); ++i) {
+    const Geometry_t *g = &geometries[i];
+    printf("%s: %lu byte pages, %lu byte chunks, %lu byte segments, "
+           "%lu byte image\n", g->name, (unsigned long)g->pageSize,
+           (unsigned long)g->chunk, (unsigned long)g->segment,
+           (unsigned long)g->imageSize);
+    for (j = 0; j < sizeof(cases) / sizeof(cases[0]); ++j, ++total)
+      passed += run(g, &cases[j]) ? 1U : 0U;
+  }
+
+  printf("%u of %u cases passed\n%s\n", (unsigned)passed, (unsigned)total,
+         (passed == total) ? "OK" : "FAILED");
+  return (passed == total) ? 0 : 1;
+}
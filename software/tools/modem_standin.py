@@ -0,0 +1,665 @@
+#!/usr/bin/env python3
+"""Scripted stand-in of the SIM868 modem for bench tests of the SMS path.
+
+Plays the modem side of the AT dialog on a serial port, e.g. a USB-UART
+wired to the modem UART of the board with the modem held in reset, or on a
+pseudo terminal (--pty) for a host client. Commands are echoed and
+answered from a small table, unknown ones with OK. Text messages from
+--sender are stored and announced with +CMTI every --interval seconds,
+--calls announces a RING with the caller id instead.
+
+The latency of every query is measured from the +CMTI (or RING) line to
+the Ctrl-Z that ends the reply text. --busy holds the answer to the
+GNSS and signal quality commands for the given time, to show that the
+reply does not wait behind other users of the modem.
+
+The GNSS receiver runs on a virtual clock --scale times faster than real
+time. It powers on with a cold start and reports no fix until its time to
+first fix has passed, AT+CGNSHOT/WARM/COLD restart it with the data it
+still has: the last fix is kept across power downs and only a commanded
+cold start clears it, the ephemeris is good for 4 hours and the almanac
+for 180 days. Every start is printed. The
+bearer can be opened and AT+CLBS answers a cell location after a few
+seconds once it is. AT+XSKIP=<seconds>[,1] is not a modem command, it
+moves the clock over a parking, 1 also cuts the supply and clears the
+receiver. --seed makes the times repeatable.
+
+AT+CIPSTART opens a transparent connection: the data is counted as live
+frames of --frame bytes until "+++" arrives between two --guard seconds
+of silence, ATO resumes it. The sustained frame rate and the escapes are
+reported at the end.
+
+--selftest runs a minimal client of the firmware's dialog on a pty, to
+check the stand-in itself. --live runs a client of the live tracker for
+the given seconds, once escaping the link for every GNSS and network
+query as the firmware did and once with the queries batched into escape
+windows, and prints the frame rate of both.
+"""
+
+import argparse
+import calendar
+import os
+import pty
+import random
+import select
+import termios
+import threading
+import time
+import tty
+
+CTRL_Z = b"\x1a"
+
+CANNED = {
+    b"AT+CSQ": b"+CSQ: 18,0",
+    b"AT+CREG?": b"+CREG: 2,1,\"0FA1\",\"1B2C\"",
+    b"AT+CGREG?": b"+CGREG: 2,1,\"0FA1\",\"1B2C\"",
+    b"AT+CGATT?": b"+CGATT: 1",
+    b"AT+COPS?": b"+COPS: 0,0,\"Standin\"",
+    b"AT+CBC": b"+CBC: 0,87,4012",
+}
+
+SLOW = (b"AT+CGNSINF", b"AT+CSQ")
+
+# The network monitor refresh, see NetworkMonitorThread.c.
+REFRESH = (b"AT+CREG?", b"AT+CGREG?", b"AT+CSQ", b"AT+COPS?", b"AT+CGATT?",
+           b"AT+CBC")
+
+
+# Time to first fix of the receiver model in seconds by the start it makes.
+TTFF = {"hot": (1.0, 4.0), "warm": (24.0, 34.0), "cold": (30.0, 45.0)}
+EPHEMERIS_VALID = 4 * 3600
+ALMANAC_VALID = 180 * 86400
+
+# Seconds of the virtual clock to open the bearer and to locate the cell.
+BEARER_OPEN = 2.0
+CELL_LOCATION = (3.0, 8.0)
+
+EPOCH = calendar.timegm((2026, 1, 1, 12, 0, 0))
+GPS_EPOCH = calendar.timegm((1980, 1, 6, 0, 0, 0))
+LATITUDE, LONGITUDE = 47.497912, 19.040235
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attr = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud)
+    attr[4] = attr[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attr)
+    return fd
+
+
+class Stats:
+    def __init__(self):
+        self.samples = []
+        self.pending = {}
+
+    def report(self):
+        if not self.samples:
+            print("no replies")
+            return
+        s = sorted(self.samples)
+        print("replies %d, min %.0f ms, median %.0f ms, max %.0f ms"
+              % (len(s), s[0], s[len(s) // 2], s[-1]))
+
+
+class Gnss:
+    """The receiver and the location service of the modem."""
+
+    def __init__(self, args):
+        self.scale = args.scale
+        self.rng = random.Random(args.seed)
+        self.origin = time.monotonic()
+        self.skipped = 0.0
+        self.data_at = None
+        self.on_at = None
+        self.fix_at = None
+        self.bearer = False
+
+    def now(self):
+        return (EPOCH + (time.monotonic() - self.origin) * self.scale
+                + self.skipped)
+
+    def wait(self, seconds):
+        time.sleep(seconds / self.scale)
+
+    def restart(self, mode, clear=True):
+        """A start only uses the data the receiver still has."""
+        age = None if self.data_at is None else self.now() - self.data_at
+        made = "cold"
+        if age is not None and mode != "cold" and age <= ALMANAC_VALID:
+            made = "hot" if mode == "hot" and age <= EPHEMERIS_VALID else "warm"
+        if mode == "cold" and clear:
+            self.data_at = None
+        ttff = self.rng.uniform(*TTFF[made])
+        self.on_at = self.now()
+        self.fix_at = self.on_at + ttff
+        print("gnss: %s start, %s start made, data %s, fix in %.1f s"
+              % (mode, made, "none" if age is None else "%.0f s old" % age,
+                 ttff), flush=True)
+
+    def power(self, on):
+        if on and self.on_at is None:
+            self.restart("cold", clear=False)
+        elif not on:
+            self.on_at = self.fix_at = None
+
+    def skip(self, seconds, loss):
+        self.skipped += seconds
+        if loss:
+            self.data_at = None
+            self.bearer = False
+
+    def info(self):
+        if self.on_at is None:
+            return b"+CGNSINF: 0,,,,,,,,,,,,,,,,,,,,"
+        now = self.now()
+        if now < self.fix_at:
+            # The receiver counts from the GPS epoch until it has the time.
+            since = time.gmtime(GPS_EPOCH + now - self.on_at)
+            return (b"+CGNSINF: 1,0,%s.000,,,,0.00,0.0,0,,,,,,0,0,,,,,"
+                    % time.strftime("%Y%m%d%H%M%S", since).encode())
+        self.data_at = now
+        return (b"+CGNSINF: 1,1,%s.000,%.6f,%.6f,112.4,36.50,180.0,1,,0.9,1.2,"
+                b"0.8,,9,7,,,42,," % (time.strftime(
+                    "%Y%m%d%H%M%S", time.gmtime(now)).encode(), LATITUDE,
+                    LONGITUDE))
+
+    def clbs(self):
+        if not self.bearer:
+            return b"+CLBS: 3"
+        self.wait(self.rng.uniform(*CELL_LOCATION))
+        date = time.strftime("%y/%m/%d,%H:%M:%S", time.gmtime(self.now()))
+        return (b"+CLBS: 0,%.6f,%.6f,550,%s"
+                % (LONGITUDE + 0.004, LATITUDE - 0.003, date.encode()))
+
+
+class Modem:
+    def __init__(self, fd, args):
+        self.fd = fd
+        self.args = args
+        self.messages = {}
+        self.next_index = 1
+        self.buf = b""
+        self.prompt = None
+        self.stats = Stats()
+        self.lock = threading.Lock()
+        self.data = False
+        self.last_rx = 0.0
+        self.escape_at = None
+        self.escapes = 0
+        self.received = 0
+        self.connected = 0.0
+        self.connected_at = None
+        self.gnss = Gnss(args)
+
+    def write(self, data):
+        with self.lock:
+            os.write(self.fd, data)
+
+    def line(self, text):
+        self.write(b"\r\n" + text + b"\r\n")
+
+    def inject(self):
+        if self.args.calls:
+            self.stats.pending[self.args.sender] = time.monotonic()
+            self.line(b"RING")
+            self.line(b"+CLIP: \"%s\",145,\"\",0,\"\",0"
+                      % self.args.sender.encode())
+            return
+        index = self.next_index
+        self.next_index += 1
+        self.messages[index] = (self.args.sender, self.args.text)
+        self.stats.pending[self.args.sender] = time.monotonic()
+        self.line(b"+CMTI: \"SM\",%d" % index)
+
+    def enter_data(self):
+        self.line(b"CONNECT")
+        self.data = True
+        if self.connected_at is None:
+            self.connected_at = time.monotonic()
+
+    def close(self):
+        if self.connected_at is not None:
+            self.connected += time.monotonic() - self.connected_at
+            self.connected_at = None
+        self.data = False
+
+    def answer(self, cmd):
+        if self.args.busy and cmd.startswith(SLOW):
+            time.sleep(self.args.busy / 1000.0)
+        if cmd.startswith(b"AT+CIPSTART="):
+            self.line(b"OK")
+            self.enter_data()
+            return
+        if cmd == b"ATO":
+            self.enter_data()
+            return
+        if cmd == b"AT+CIPCLOSE":
+            self.close()
+            self.line(b"CLOSE OK")
+            return
+        if cmd == b"AT+CIPSHUT":
+            self.close()
+            self.line(b"SHUT OK")
+            return
+        if cmd in CANNED:
+            self.line(CANNED[cmd])
+        elif cmd.startswith(b"AT+CGNS"):
+            self.answer_gnss(cmd)
+            return
+        elif cmd.startswith(b"AT+SAPBR="):
+            if cmd == b"AT+SAPBR=2,1":
+                self.line(b"+SAPBR: 1,%d,\"%s\"" % ((1, b"10.0.0.2")
+                          if self.gnss.bearer else (3, b"0.0.0.0")))
+            elif cmd == b"AT+SAPBR=1,1":
+                self.gnss.wait(BEARER_OPEN)
+                self.gnss.bearer = True
+            elif cmd == b"AT+SAPBR=0,1":
+                self.gnss.bearer = False
+        elif cmd == b"AT+CLBS=4,1":
+            self.line(self.gnss.clbs())
+        elif cmd.startswith(b"AT+XSKIP="):
+            fields = cmd[9:].split(b",")
+            self.gnss.skip(float(fields[0]),
+                           len(fields) > 1 and fields[1] == b"1")
+        elif cmd.startswith(b"AT+CMGR="):
+            entry = self.messages.get(int(cmd[8:]))
+            if entry is None:
+                self.line(b"ERROR")
+                return
+            self.line(b"+CMGR: \"REC UNREAD\",\"%s\",\"\",\"26/01/01,12:00:00+04\""
+                      % entry[0].encode())
+            self.write(entry[1].encode() + b"\r\n")
+        elif cmd.startswith(b"AT+CMGL="):
+            for index, entry in sorted(self.messages.items()):
+                self.line(b"+CMGL: %d,\"REC UNREAD\",\"%s\",\"\",\"\""
+                          % (index, entry[0].encode()))
+                self.write(entry[1].encode() + b"\r\n")
+        elif cmd.startswith(b"AT+CMGD="):
+            self.messages.pop(int(cmd[8:]), None)
+        elif cmd.startswith(b"AT+CMGS="):
+            self.prompt = cmd[9:-1].decode()
+            self.write(b"\r\n> ")
+            return
+        self.line(b"OK")
+
+    def answer_gnss(self, cmd):
+        if cmd == b"AT+CGNSINF":
+            self.line(self.gnss.info())
+        elif cmd.startswith(b"AT+CGNSPWR="):
+            self.gnss.power(cmd.endswith(b"1"))
+        elif cmd in (b"AT+CGNSHOT", b"AT+CGNSWARM", b"AT+CGNSCOLD"):
+            if self.gnss.on_at is None:
+                self.line(b"ERROR")
+                return
+            self.gnss.restart(cmd[7:].decode().lower())
+        self.line(b"OK")
+
+    def sent(self, text):
+        number = self.prompt
+        self.prompt = None
+        start = self.stats.pending.pop(number, None)
+        if start is None:
+            start = self.stats.pending.pop(self.args.sender, None)
+        latency = ""
+        if start is not None:
+            ms = (time.monotonic() - start) * 1000.0
+            self.stats.samples.append(ms)
+            latency = " after %.0f ms" % ms
+        print("reply to %s%s: %r" % (number, latency, text.decode(errors="replace")))
+        self.line(b"+CMGS: %d" % (len(self.stats.samples) % 256))
+        self.line(b"OK")
+
+    def stream(self, data):
+        """Data mode: "+++" after the guard time may be an escape."""
+        now = time.monotonic()
+        if data == b"+++" and now - self.last_rx >= self.args.guard:
+            self.escape_at = now
+        else:
+            self.received += len(data)
+            self.escape_at = None
+        self.last_rx = now
+
+    def escaped(self):
+        """The guard time after "+++" passed without data."""
+        self.escape_at = None
+        self.escapes += 1
+        self.data = False
+        self.line(b"OK")
+
+    def feed(self, data):
+        if self.data:
+            self.stream(data)
+            return
+        self.buf += data
+        while True:
+            if self.prompt is not None:
+                end = self.buf.find(CTRL_Z)
+                if end < 0:
+                    return
+                self.write(self.buf[:end + 1])
+                text, self.buf = self.buf[:end], self.buf[end + 1:]
+                self.sent(text)
+                continue
+            end = self.buf.find(b"\r")
+            if end < 0:
+                return
+            cmd, self.buf = self.buf[:end].strip(), self.buf[end + 1:]
+            if not cmd:
+                continue
+            self.write(cmd + b"\r")
+            if cmd.upper().startswith(b"AT"):
+                self.answer(cmd)
+
+    def run(self, duration):
+        deadline = time.monotonic() + duration if duration else None
+        inject_at = (time.monotonic() + self.args.interval
+                     if self.args.interval else float("inf"))
+        while deadline is None or time.monotonic() < deadline:
+            wake = inject_at
+            if self.escape_at is not None:
+                wake = min(wake, self.escape_at + self.args.guard)
+            if deadline is not None:
+                wake = min(wake, deadline)
+            timeout = (None if wake == float("inf")
+                       else max(0.0, wake - time.monotonic()))
+            ready, _, _ = select.select([self.fd], [], [], timeout)
+            if ready:
+                try:
+                    data = os.read(self.fd, 4096)
+                except OSError:
+                    break
+                if not data:
+                    break
+                self.feed(data)
+            now = time.monotonic()
+            if (self.escape_at is not None
+                    and now - self.escape_at >= self.args.guard):
+                self.escaped()
+            if now >= inject_at:
+                # Announcements wait while the link streams.
+                if not self.data:
+                    self.inject()
+                inject_at = now + self.args.interval
+        self.close()
+        if not self.args.live:
+            self.stats.report()
+        self.report_live()
+
+    def report_live(self):
+        """The rate is given per guard time, frames/s at the real 1 s."""
+        if not self.connected:
+            return
+        frames = self.received // self.args.frame
+        self.rate = frames * self.args.guard / self.connected
+        print("live: %d frames, %d escapes in %.0f guard times connected, "
+              "%.2f frames per guard time"
+              % (frames, self.escapes, self.connected / self.args.guard,
+                 self.rate))
+
+
+def selftest_client(fd, count):
+    """Answers every announcement like the firmware does."""
+    buf = b""
+
+    def command(cmd, until=b"OK\r\n"):
+        nonlocal buf
+        os.write(fd, cmd + b"\r")
+        while until not in buf:
+            buf += os.read(fd, 4096)
+        reply, buf = buf[:buf.index(until) + len(until)], buf[buf.index(until) + len(until):]
+        return reply
+
+    answered = 0
+    while answered < count:
+        while b"+CMTI:" not in buf:
+            buf += os.read(fd, 4096)
+        start = buf.index(b"+CMTI:")
+        end = buf.index(b"\r\n", start)
+        index = int(buf[start:end].split(b",")[1])
+        buf = buf[end:]
+        reply = command(b"AT+CMGR=%d" % index)
+        sender = reply.split(b"\"")[3]
+        command(b"AT+CMGS=\"%s\"" % sender, until=b"> ")
+        os.write(fd, b"g-track: no position yet" + CTRL_Z)
+        while b"OK\r\n" not in buf:
+            buf += os.read(fd, 4096)
+        buf = buf[buf.index(b"OK\r\n") + 4:]
+        command(b"AT+CMGD=%d" % index)
+        answered += 1
+
+
+class FairLock:
+    """Hands the lock over in arrival order, as a ChibiOS mutex does to
+    waiters of equal priority."""
+
+    def __init__(self):
+        self.cond = threading.Condition()
+        self.next = self.serving = 0
+
+    def __enter__(self):
+        with self.cond:
+            ticket = self.next
+            self.next += 1
+            self.cond.wait_for(lambda: self.serving == ticket)
+
+    def __exit__(self, *exc):
+        with self.cond:
+            self.serving += 1
+            self.cond.notify_all()
+
+
+class LiveDriver:
+    """The link handling of the sim8xx driver: a command escapes a data
+    link, the next write resumes it. With windows the queries wait for an
+    escape instead and the link is not resumed until they are done."""
+
+    def __init__(self, fd, guard):
+        self.fd = fd
+        self.guard = guard
+        self.lock = FairLock()
+        self.link = "command"
+        self.last_write = 0.0
+        self.rx = b""
+        self.state = threading.Condition()
+        self.waiters = self.holders = self.windows = 0
+        threading.Thread(target=self.reader, daemon=True).start()
+
+    def reader(self):
+        while True:
+            data = os.read(self.fd, 4096)
+            with self.state:
+                self.rx += data
+                self.state.notify_all()
+
+    def transfer(self, data, until):
+        with self.state:
+            self.rx = b""
+        os.write(self.fd, data)
+        with self.state:
+            self.state.wait_for(lambda: until in self.rx)
+
+    def escape(self):
+        if self.link != "data":
+            return
+        # The margin of the firmware, the modem counts from the last byte.
+        idle = time.monotonic() - self.last_write
+        if idle < self.guard * 1.05:
+            time.sleep(self.guard * 1.05 - idle)
+        self.transfer(b"+++", b"OK\r\n")
+        with self.state:
+            self.link = "online"
+            self.windows += 1
+            self.state.notify_all()
+
+    def execute(self, cmd):
+        with self.lock:
+            self.escape()
+            self.transfer(cmd + b"\r", b"OK\r\n")
+
+    def connect(self):
+        with self.lock:
+            self.transfer(b"AT+CIPSTART=\"TCP\",\"standin\",5051\r",
+                          b"CONNECT\r\n")
+            self.link = "data"
+            self.last_write = time.monotonic()
+
+    def busy(self):
+        return self.link == "online" and self.waiters + self.holders > 0
+
+    def write(self, data):
+        while True:
+            with self.lock:
+                with self.state:
+                    busy = self.busy()
+                if not busy:
+                    if self.link == "online":
+                        self.transfer(b"ATO\r", b"CONNECT\r\n")
+                        self.link = "data"
+                    os.write(self.fd, data)
+                    self.last_write = time.monotonic()
+                    return
+            # The lock is released for the pollers of the window.
+            with self.state:
+                self.state.wait_for(lambda: not self.busy())
+
+    def poll_begin(self, timeout):
+        with self.state:
+            self.waiters += 1
+            admitted = self.state.wait_for(lambda: self.link != "data",
+                                           timeout)
+            self.waiters -= 1
+            self.holders += 1 if admitted else 0
+            self.state.notify_all()
+            return admitted
+
+    def poll_end(self):
+        with self.state:
+            self.holders -= 1
+            self.state.notify_all()
+
+    def open_window(self):
+        with self.lock:
+            with self.state:
+                if self.link != "data" or not self.waiters:
+                    return
+            self.escape()
+
+
+def live_client(fd, args, windows, stop):
+    """The live tracker, the GNSS poll and the network refresh as threads,
+    the periods in guard times as configured in the firmware."""
+    guard = args.guard
+    driver = LiveDriver(fd, guard)
+    driver.connect()
+
+    def every(period, action):
+        next_time = time.monotonic()
+        while not stop.is_set():
+            action()
+            # A late action restarts the schedule, nothing is caught up.
+            next_time = max(next_time + period, time.monotonic())
+            stop.wait(max(0.0, next_time - time.monotonic()))
+
+    def query(commands, period):
+        if windows:
+            if not driver.poll_begin(period):
+                return
+        for cmd in commands:
+            driver.execute(cmd)
+        if windows:
+            driver.poll_end()
+
+    last_window = [time.monotonic()]
+
+    def report():
+        driver.write(b"GL" + bytes(args.frame - 2))
+        if windows and time.monotonic() - last_window[0] >= 10 * guard:
+            driver.open_window()
+            last_window[0] = time.monotonic()
+
+    for period, commands in ((5 * guard, (b"AT+CGNSINF",)),
+                             (30 * guard, REFRESH)):
+        threading.Thread(target=every, daemon=True,
+                         args=(period, lambda c=commands, p=period:
+                               query(c, p))).start()
+    every(guard, report)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    port = parser.add_mutually_exclusive_group(required=True)
+    port.add_argument("--port", help="serial device wired to the board")
+    port.add_argument("--pty", action="store_true",
+                      help="create a pseudo terminal and print its name")
+    port.add_argument("--selftest", type=int, metavar="N",
+                      help="answer N queries with a built-in client")
+    port.add_argument("--live", type=float, metavar="SECONDS",
+                      help="measure the live frame rate of both policies")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--sender", default="+36301234567")
+    parser.add_argument("--text", default="LOC")
+    parser.add_argument("--calls", action="store_true",
+                        help="announce calls instead of messages")
+    parser.add_argument("--interval", type=float, default=10.0,
+                        help="seconds between announcements, 0 for none")
+    parser.add_argument("--busy", type=int, default=0, metavar="MS",
+                        help="delay of the GNSS and signal quality answers")
+    parser.add_argument("--duration", type=float, default=0.0,
+                        help="stop after the given seconds, 0 runs forever")
+    parser.add_argument("--guard", type=float, default=1.0,
+                        help="escape guard time in seconds")
+    parser.add_argument("--frame", type=int, default=26,
+                        help="bytes of a live frame")
+    parser.add_argument("--scale", type=float, default=1.0,
+                        help="speed of the GNSS clock against real time")
+    parser.add_argument("--seed", type=int, help="seed of the GNSS times")
+    args = parser.parse_args()
+
+    if args.live:
+        rates = []
+        for windows in (False, True):
+            fd, peer = pty.openpty()
+            tty.setraw(fd)
+            tty.setraw(peer)
+            args.interval = args.duration = args.live
+            stop = threading.Event()
+            threading.Thread(target=live_client, daemon=True,
+                             args=(peer, args, windows, stop)).start()
+            print("escape per query" if not windows else "escape windows")
+            modem = Modem(fd, args)
+            modem.run(args.live)
+            stop.set()
+            rates.append(modem.rate)
+        if rates[1] <= rates[0]:
+            raise SystemExit("live test failed")
+        return
+
+    if args.port:
+        fd = open_port(args.port, args.baud)
+    else:
+        fd, peer = pty.openpty()
+        tty.setraw(fd)
+        tty.setraw(peer)
+        if args.pty:
+            print("modem on %s" % os.ttyname(peer))
+        else:
+            args.interval = min(args.interval, 0.2)
+            client = threading.Thread(target=selftest_client,
+                                      args=(peer, args.selftest), daemon=True)
+            client.start()
+            args.duration = args.duration or args.selftest * args.interval + 2.0
+
+    modem = Modem(fd, args)
+    try:
+        modem.run(args.duration)
+    except KeyboardInterrupt:
+        modem.stats.report()
+    if args.selftest and len(modem.stats.samples) != args.selftest:
+        raise SystemExit("selftest failed")
+
+
+if __name__ == "__main__":
+    main()
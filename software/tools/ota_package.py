@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Package a firmware image for the "ota get" download and serve it.
+
+The package is a 20 byte header, the CRC-32 of every chunk of the image,
+then the image. All fields are little endian 32 bit words. The header holds
+the magic "GTFW", the version, the image size, the CRC-32 of the image and
+the chunk size. CRCs are computed as by zlib. The device checks every
+chunk before programming it and requests a bad one again.
+
+    ota_package.py build/g-track.bin -v 7 -o g-track.ota
+    ota_package.py --serve g-track.ota --port 8080
+
+The device fetches the package in ranges ("Range: bytes=first-last"), so
+the server answers with 206 Partial Content. Python's http.server ignores
+ranges, hence the small server here. --cut closes the connection after
+the given share of a response to exercise resuming, --flip changes a bit
+in the given share of responses to exercise the chunk CRCs.
+"""
+
+import argparse
+import http.server
+import os
+import random
+import re
+import struct
+import zlib
+
+MAGIC = b"GTFW"
+HEADER = struct.Struct("<4sIIII")
+CHUNK = 2048
+# Must match IW_MAX_CHUNKS in ImageWriter.h.
+MAX_CHUNKS = 128
+
+
+def chunks(image, chunk):
+    return [image[i:i + chunk] for i in range(0, len(image), chunk)]
+
+
+def build(image, version, chunk=CHUNK):
+    crcs = [zlib.crc32(c) for c in chunks(image, chunk)]
+    if chunk % 8 or len(crcs) > MAX_CHUNKS:
+        raise ValueError("chunk size %d does not fit" % chunk)
+    return (HEADER.pack(MAGIC, version, len(image), zlib.crc32(image), chunk)
+            + struct.pack("<%dI" % len(crcs), *crcs) + image)
+
+
+def parse(package):
+    magic, version, size, crc, chunk = HEADER.unpack_from(package)
+    if magic != MAGIC or chunk == 0:
+        raise ValueError("not a package")
+    count = (size + chunk - 1) // chunk
+    start = HEADER.size + 4 * count
+    if len(package) != start + size:
+        raise ValueError("not a package")
+    image = package[start:]
+    crcs = struct.unpack_from("<%dI" % count, package, HEADER.size)
+    if list(crcs) != [zlib.crc32(c) for c in chunks(image, chunk)]:
+        raise ValueError("chunk CRC mismatch")
+    if zlib.crc32(image) != crc:
+        raise ValueError("CRC mismatch")
+    return version, size, crc
+
+
+def make_handler(package, cut, flip):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            first, last = 0, len(package) - 1
+            match = re.match(r"bytes=(\d+)-(\d*)", self.headers.get("Range", ""))
+            if match:
+                first = int(match.group(1))
+                if match.group(2):
+                    last = min(int(match.group(2)), last)
+            if first > last:
+                self.send_response(416)
+                self.end_headers()
+                return
+            body = package[first:last + 1]
+            self.send_response(206 if match else 200)
+            self.send_header("Content-Length", str(len(body)))
+            if match:
+                self.send_header("Content-Range", "bytes %d-%d/%d"
+                                 % (first, last, len(package)))
+            self.end_headers()
+            if flip and body and random.random() < flip:
+                body = bytearray(body)
+                body[random.randrange(len(body))] ^= 1 << random.randrange(8)
+                body = bytes(body)
+            if cut and random.random() < cut:
+                body = body[:len(body) // 2]
+                self.close_connection = True
+            self.wfile.write(body)
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("file", help="image to package, or package to serve")
+    parser.add_argument("-v", "--version", type=int, default=1)
+    parser.add_argument("--chunk", type=int, default=CHUNK,
+                        help="image bytes per chunk CRC")
+    parser.add_argument("-o", "--output", help="package file to write")
+    parser.add_argument("--serve", action="store_true")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--cut", type=float, default=0.0,
+                        help="share of responses cut in half")
+    parser.add_argument("--flip", type=float, default=0.0,
+                        help="share of responses with a bit changed")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+
+    if not args.serve:
+        package = build(data, args.version, args.chunk)
+        output = args.output or os.path.splitext(args.file)[0] + ".ota"
+        with open(output, "wb") as f:
+            f.write(package)
+        version, size, crc = parse(package)
+        print("%s: version %d, %d bytes, crc %08x" % (output, version, size, crc))
+        return
+
+    version, size, crc = parse(data)
+    print("serving version %d, %d bytes, crc %08x on port %d"
+          % (version, size, crc, args.port))
+    server = http.server.ThreadingHTTPServer((args.host, args.port),
+                                             make_handler(data, args.cut,
+                                                          args.flip))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
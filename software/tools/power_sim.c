@@ -0,0 +1,278 @@
+/**
+ * @file power_sim.c
+ * @brief Host simulation of the parking policy and the power budget.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -o power_sim tools/power_sim.c source/PowerPolicy.c
+ *   ./power_sim [seed]
+ *
+ * Scripted weeks of ignition, USB and accelerometer activity are replayed
+ * in 100 ms steps. The decisions come from PowerPolicy.c, the state changes
+ * follow SystemThread.c: ignition on starts riding from any state, ignition
+ * off parks, a parked system enters Stop 2 after PP_PARKING_GRACE_TIME_IN_MS
+ * without events unless USB powers it. Stop 2 ends on an ignition, motion,
+ * VBUS or hourly RTC interrupt. The charge is integrated from the modelled
+ * state currents.
+ *
+ * The policy is checked at every step: riding whenever the ignition or USB
+ * is on, parked otherwise, never in Stop 2 on USB power, and never awake
+ * and parked for longer than the grace time after the last event.
+ */
+
+#include "PowerPolicy.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STEP_IN_MS           100U
+#define DAY_IN_MS            (24UL * 3600UL * 1000UL)
+#define RTC_PERIOD_IN_MS     (3600UL * 1000UL)
+#define MAX_CHANGES          256
+
+#define LINE_IGNITION        (1U << 11)
+#define LINE_VBUS            (1U << 9)
+#define LINE_MOTION          (1U << 0)
+#define LINE_RTC             (1U << 20)
+
+typedef enum {
+  SYSTEM_INIT,
+  SYSTEM_PARKING,
+  SYSTEM_RIDING
+} SystemState_t;
+
+typedef struct {
+  uint32_t time;
+  bool ignition;
+  bool usb;
+} Change_t;
+
+typedef struct {
+  const char *name;
+  uint32_t duration;
+  Change_t changes[MAX_CHANGES];
+  size_t changeNum;
+  uint32_t bumps[MAX_CHANGES];
+  size_t bumpNum;
+} Script_t;
+
+typedef struct {
+  SystemState_t system;
+  PowerState_t power;
+  bool ignition;
+  bool usb;
+  bool powered;
+  uint32_t lastEvent;
+  uint32_t sleepStart;
+  uint64_t timeInState[PM_STATE_NUM];
+  uint64_t charge;
+  uint32_t wakeups[PM_WAKEUP_OTHER + 1];
+  uint32_t violations;
+} Device_t;
+
+static const PpWakeupLines_t wakeupLines = {
+  .ignition = LINE_IGNITION,
+  .motion   = LINE_MOTION,
+  .rtc      = LINE_RTC
+};
+
+static Script_t script;
+
+static void addChange(uint32_t time, bool ignition, bool usb) {
+  if (script.changeNum < MAX_CHANGES) {
+    Change_t *c = &script.changes[script.changeNum++];
+    c->time = time;
+    c->ignition = ignition;
+    c->usb = usb;
+  }
+}
+
+static void addRide(uint32_t start, uint32_t minutes) {
+  addChange(start, true, false);
+  addChange(start + minutes * 60000U, false, false);
+}
+
+static uint32_t at(uint32_t day, uint32_t hour, uint32_t minute) {
+  return day * DAY_IN_MS + (hour * 60U + minute) * 60000U;
+}
+
+static void addBumps(uint32_t perDay) {
+  uint32_t days = script.duration / DAY_IN_MS, d, i;
+  for (d = 0; d < days; ++d)
+    for (i = 0; i < perDay && script.bumpNum < MAX_CHANGES; ++i)
+      script.bumps[script.bumpNum++] = d * DAY_IN_MS +
+          (uint32_t)((double)rand() / RAND_MAX * (DAY_IN_MS - 1));
+}
+
+/*
+ * Commuting on weekdays, a long ride on Saturday, a bike that gets bumped
+ * now and then in the street. On Wednesday evening the charger is plugged in
+ * during the ride and pulled before the ignition is switched off.
+ */
+static void scriptCommute(void) {
+  memset(&script, 0, sizeof(script));
+  script.name = "commute";
+  script.duration = 7 * DAY_IN_MS;
+  uint32_t d;
+  for (d = 0; d < 5; ++d) {
+    addRide(at(d, 7, 45), 40);
+    if (2 == d) {
+      addChange(at(d, 17, 30), true, false);
+      addChange(at(d, 17, 40), true, true);
+      addChange(at(d, 18, 5), true, false);
+      addChange(at(d, 18, 20), false, false);
+    } else {
+      addRide(at(d, 17, 30), 50);
+    }
+  }
+  addRide(at(5, 9, 0), 180);
+  addBumps(3);
+}
+
+/*
+ * Parked for a week, charged over USB on the second evening.
+ */
+static void scriptStorage(void) {
+  memset(&script, 0, sizeof(script));
+  script.name = "storage";
+  script.duration = 7 * DAY_IN_MS;
+  addChange(at(1, 19, 0), false, true);
+  addChange(at(1, 23, 0), false, false);
+  addBumps(1);
+}
+
+static void post(Device_t *dev, uint32_t now, bool on) {
+  dev->lastEvent = now;
+  if (on) {
+    dev->system = SYSTEM_RIDING;
+    dev->power = PM_STATE_RIDING;
+  } else if (SYSTEM_RIDING == dev->system || SYSTEM_INIT == dev->system) {
+    dev->system = SYSTEM_PARKING;
+    dev->power = PM_STATE_PARKED;
+  }
+}
+
+static void wake(Device_t *dev, uint32_t now, uint32_t pending) {
+  dev->wakeups[ppWakeupSource(pending, &wakeupLines)]++;
+  dev->power = PM_STATE_PARKED;
+  dev->lastEvent = now;
+}
+
+static void violation(Device_t *dev, uint32_t now, const char *what) {
+  if (dev->violations++ < 5)
+    printf("  FAIL at day %lu %02lu:%02lu:%02lu: %s\n",
+           (unsigned long)(now / DAY_IN_MS),
+           (unsigned long)(now % DAY_IN_MS / 3600000UL),
+           (unsigned long)(now % 3600000UL / 60000UL),
+           (unsigned long)(now % 60000UL / 1000UL), what);
+}
+
+static bool run(Device_t *dev) {
+  size_t change = 0, bump = 0;
+  uint32_t now;
+
+  memset(dev, 0, sizeof(*dev));
+  dev->system = SYSTEM_INIT;
+  dev->power = PM_STATE_PARKED;
+  /* The system thread parks at startup when the ignition is off. */
+  post(dev, 0, false);
+
+  for (now = 0; now < script.duration; now += STEP_IN_MS) {
+    uint32_t pending = 0;
+
+    while (change < script.changeNum && script.changes[change].time <= now) {
+      const Change_t *c = &script.changes[change++];
+      if (c->ignition != dev->ignition)
+        pending |= LINE_IGNITION;
+      if (c->usb != dev->usb)
+        pending |= LINE_VBUS;
+      dev->ignition = c->ignition;
+      dev->usb = c->usb;
+    }
+    while (bump < script.bumpNum && script.bumps[bump] <= now) {
+      bump++;
+      if (SYSTEM_PARKING == dev->system)
+        pending |= LINE_MOTION;
+    }
+    if ((PM_STATE_STOP2 == dev->power) &&
+        (now - dev->sleepStart >= RTC_PERIOD_IN_MS)) {
+      pending |= LINE_RTC;
+      dev->sleepStart = now;
+    }
+
+    if (pending && (PM_STATE_STOP2 == dev->power))
+      wake(dev, now, pending);
+
+    /* Board monitor: ignition and USB reach the system together. */
+    bool on = ppPowered(dev->ignition, dev->usb);
+    if (on != dev->powered) {
+      dev->powered = on;
+      post(dev, now, on);
+    } else if (pending & (LINE_MOTION | LINE_RTC)) {
+      dev->lastEvent = now;
+    }
+
+    if ((SYSTEM_PARKING == dev->system) && (PM_STATE_PARKED == dev->power) &&
+        (now - dev->lastEvent >= PP_PARKING_GRACE_TIME_IN_MS)) {
+      if (ppCanSleep(dev->usb)) {
+        dev->power = PM_STATE_STOP2;
+        dev->sleepStart = now;
+      } else {
+        dev->lastEvent = now;
+      }
+    }
+
+    if (dev->powered != (SYSTEM_RIDING == dev->system))
+      violation(dev, now, dev->powered ? "powered but parked"
+                                       : "riding without power");
+    if ((PM_STATE_STOP2 == dev->power) && dev->usb)
+      violation(dev, now, "Stop 2 on USB power");
+    if ((PM_STATE_PARKED == dev->power) && !dev->usb &&
+        (now - dev->lastEvent > PP_PARKING_GRACE_TIME_IN_MS))
+      violation(dev, now, "awake past the grace time");
+
+    dev->timeInState[dev->power] += STEP_IN_MS;
+    dev->charge += (uint64_t)ppStateCurrent(dev->power) * STEP_IN_MS;
+  }
+  return 0 == dev->violations;
+}
+
+static void report(const Device_t *dev) {
+  double days = (double)script.duration / DAY_IN_MS;
+  size_t i;
+  printf("%s, %.0f days:\n", script.name, days);
+  for (i = 0; i < PM_STATE_NUM; ++i)
+    printf("  %-8s %8.2f h %6lu uA %9.1f mAh\n", ppStateName(i),
+           dev->timeInState[i] / 3600000.0,
+           (unsigned long)ppStateCurrent(i),
+           (double)ppStateCurrent(i) * dev->timeInState[i] / 3.6e9);
+  printf("  wakeups:");
+  for (i = PM_WAKEUP_IGNITION; i <= PM_WAKEUP_OTHER; ++i)
+    printf(" %s %lu", ppWakeupName(i), (unsigned long)dev->wakeups[i]);
+  uint64_t off = dev->timeInState[PM_STATE_PARKED] +
+                 dev->timeInState[PM_STATE_STOP2];
+  uint64_t offCharge =
+      (uint64_t)ppStateCurrent(PM_STATE_PARKED) *
+          dev->timeInState[PM_STATE_PARKED] +
+      (uint64_t)ppStateCurrent(PM_STATE_STOP2) *
+          dev->timeInState[PM_STATE_STOP2];
+  printf("\n  %.1f mAh per day, %.1f uA average while parked\n",
+         dev->charge / 3.6e9 / days, off ? (double)offCharge / off : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+  static void (*const scripts[])(void) = {scriptCommute, scriptStorage};
+  bool ok = true;
+  size_t i;
+
+  srand(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+  for (i = 0; i < sizeof(scripts) / sizeof(scripts[0]); ++i) {
+    Device_t dev;
+    scripts[i]();
+    ok = run(&dev) && ok;
+    report(&dev);
+  }
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file stack_check.c
+ * @brief Host check of the stack high-water-mark scan and the size advice.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -o stack_check tools/stack_check.c source/StackSizing.c
+ *   ./stack_check
+ *
+ * Stacks of 128 bytes to 4 KiB are filled with the value ChibiOS uses,
+ * then a random depth is written downwards from the top with random
+ * data. The scan has to find that depth, or less when the deepest written
+ * bytes happen to equal the fill value, and never more. The advice has to
+ * cover the peak with 25% and the interrupt reserve to spare, aligned.
+ */
+
+#include "StackSizing.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILL                 0x55
+#define ROUNDS               100000
+
+static const size_t sizes[] = {128, 256, 512, 1024, 2048, 4096};
+
+static uint8_t stack[4096];
+
+static bool checkAdvice(size_t peak) {
+  size_t advice = ssRecommendedSize(peak);
+  if ((advice % SS_ALIGN_IN_BYTES) ||
+      (advice < peak + peak / 4 + SS_RESERVE_IN_BYTES) ||
+      (advice >= peak + peak / 4 + SS_RESERVE_IN_BYTES + SS_ALIGN_IN_BYTES)) {
+    printf("FAIL advice %zu for a peak of %zu\n", advice, peak);
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  bool ok = true;
+  size_t s;
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    size_t size = sizes[s];
+    uint8_t *base = stack;
+    uint8_t *end = stack + size;
+    unsigned exact = 0, under = 0, worst = 0;
+
+    memset(base, FILL, size);
+    if (0 != ssPeakUsage(base, end, FILL)) {
+      printf("FAIL unused %zu byte stack\n", size);
+      ok = false;
+    }
+    memset(base, 0, size);
+    if (size != ssPeakUsage(base, end, FILL)) {
+      printf("FAIL overflowed %zu byte stack\n", size);
+      ok = false;
+    }
+
+    int i;
+    for (i = 0; i < ROUNDS; ++i) {
+      size_t depth = (size_t)rand() % (size + 1);
+      size_t j;
+      memset(base, FILL, size);
+      for (j = size - depth; j < size; ++j)
+        base[j] = (uint8_t)rand();
+
+      size_t peak = ssPeakUsage(base, end, FILL);
+      if (peak > depth) {
+        printf("FAIL %zu byte stack, %zu used, %zu found\n", size, depth,
+               peak);
+        ok = false;
+      } else if (peak == depth) {
+        exact++;
+      } else {
+        under++;
+        if (depth - peak > worst)
+          worst = (unsigned)(depth - peak);
+      }
+      ok = checkAdvice(peak) && ok;
+    }
+    printf("%4zu bytes: %6u exact, %4u under by at most %u bytes, advice for "
+           "a full stack %zu\n", size, exact, under, worst,
+           ssRecommendedSize(size));
+  }
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""Estimate the worst case stack depth of the threads from the call graph.
+
+Build with GCC 10 or later and its call graph output, then run from the
+software directory:
+
+    make USE_OPT="-Os -ggdb -fcallgraph-info=su"
+    python3 tools/stack_estimate.py build/obj
+
+Every function's frame comes from the .ci files GCC writes next to the
+objects. The depth of a thread is the deepest chain of frames from its
+entry function. Calls through function pointers follow the targets listed
+in INDIRECT_TARGETS, other ones and recursion cannot be followed, they are
+printed next to the result. The advice is the one of the 'stacks' command
+(source/StackSizing.c), so it can be compared with the working areas in
+source/main.c and with field data.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+# Keep in sync with source/StackSizing.h.
+SS_RESERVE_IN_BYTES = 128
+SS_ALIGN_IN_BYTES = 8
+
+THREADS = [
+    "SystemThread", "BoardMonitorThread", "PeripheralManagerThread",
+    "GpsReaderThread", "UploaderThread", "LiveTrackerThread",
+    "NetworkMonitorThread", "SmsHandlerThread", "FirmwareUpdateThread",
+    "GeofenceThread", "FusionThread", "source/main.c:HeartBeatThread",
+]
+
+INDIRECT = "__indirect_call"
+
+# Function pointer calls of the firmware, the caller and the pattern of the
+# functions it may call. Callers are matched by name, targets by the end of
+# the name, so static functions of any file match.
+INPUT_CHANGED = r"^(usb|ignition|switch\d|accInterrupt\d)Changed$"
+
+INDIRECT_TARGETS = {
+    "chEvtDispatch": r"(Inserted|Removed|Connected|Disconnected|Terminated|"
+                     r"diagnostics|traceFault)Handler",
+    "BoardMonitorThread": INPUT_CHANGED,
+    "checkInput": INPUT_CHANGED,
+    "pollInput": INPUT_CHANGED,
+    "chvprintf": r"^_(put|write)$",
+    "transfer": r"^_(put|write)$",
+    "sim8xxWrite": r"^_(put|write)$",
+    "execute": r"^at[A-Z]\w*Create",
+    "start": r"^slot(Erase|Program)$",
+    "eraseUpTo": r"^slot(Erase|Program)$",
+    "iwWrite": r"^slot(Erase|Program)$",
+    "iwFinish": r"^slot(Erase|Program)$",
+    "forEachProbe": r"^(saveStats|printBuckets|printStats)$",
+    "forEachStack": r"^(saveUsage|printUsage)$",
+    "oqPutTimeout": r"^notify\d$",
+    "oqWriteTimeout": r"^notify\d$",
+    "obqPostFullBufferS": r"^obnotify$",
+    "chHeapAllocAligned": r"^chCoreAllocAlignedWithOffset$",
+    "chPoolAllocI": r"^chCoreAllocAlignedI$",
+}
+
+NODE = re.compile(r'node: \{ title: "([^"]*)" label: "([^"]*)"')
+EDGE = re.compile(r'edge: \{ sourcename: "([^"]*)" targetname: "([^"]*)"')
+FRAME = re.compile(r'\\n(\d+) bytes \(([a-z,]*)\)$')
+
+
+def recommended_size(peak):
+    size = peak + peak // 4 + SS_RESERVE_IN_BYTES
+    return (size + SS_ALIGN_IN_BYTES - 1) & ~(SS_ALIGN_IN_BYTES - 1)
+
+
+class CallGraph:
+    def __init__(self):
+        self.frames = {}
+        self.dynamic = set()
+        self.calls = {}
+        self.targets = {}
+
+    def load(self, path):
+        with open(path) as f:
+            for line in f:
+                node = NODE.match(line)
+                if node:
+                    frame = FRAME.search(node.group(2))
+                    if frame:
+                        self.frames[node.group(1)] = int(frame.group(1))
+                        if frame.group(2) == "dynamic":
+                            self.dynamic.add(node.group(1))
+                    continue
+                edge = EDGE.match(line)
+                if edge:
+                    self.calls.setdefault(edge.group(1), []).append(
+                        edge.group(2))
+
+    def indirect(self, func):
+        """Known targets of the function pointer calls in func."""
+        name = func.split(":")[-1]
+        if name not in INDIRECT_TARGETS:
+            return None
+        if name not in self.targets:
+            pattern = re.compile(INDIRECT_TARGETS[name])
+            self.targets[name] = [t for t in self.frames
+                                  if pattern.search(t.split(":")[-1])]
+        return self.targets[name]
+
+    def depth(self, entry):
+        """Deepest chain from entry, as (bytes, chain, notes)."""
+        memo = {}
+
+        def walk(func, active):
+            if func in memo:
+                return memo[func]
+            notes = set()
+            if func in self.dynamic:
+                notes.add("dynamic frame in " + func.split(":")[-1])
+            best = (0, [], set())
+            callees = list(self.calls.get(func, []))
+            if INDIRECT in callees:
+                targets = self.indirect(func)
+                if targets:
+                    callees += targets
+                else:
+                    notes.add("indirect call in " + func.split(":")[-1])
+            for callee in callees:
+                if callee == INDIRECT:
+                    continue
+                if callee in active:
+                    notes.add("recursion through " + callee.split(":")[-1])
+                    continue
+                if callee not in self.frames:
+                    continue
+                sub = walk(callee, active | {callee})
+                notes |= sub[2]
+                if sub[0] > best[0]:
+                    best = sub
+            result = (self.frames[func] + best[0], [func] + best[1], notes)
+            memo[func] = result
+            return result
+
+        if entry not in self.frames:
+            return None
+        return walk(entry, {entry})
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dirs", nargs="+",
+                        help="directories searched for .ci files")
+    parser.add_argument("--thread", action="append",
+                        help="entry function, repeatable")
+    parser.add_argument("--chain", action="store_true",
+                        help="print the deepest chain of every thread")
+    args = parser.parse_args()
+
+    graph = CallGraph()
+    files = 0
+    for d in args.dirs:
+        for root, _, names in os.walk(d):
+            for name in names:
+                if name.endswith(".ci"):
+                    graph.load(os.path.join(root, name))
+                    files += 1
+    if 0 == files:
+        sys.exit("no .ci files found, build with -fcallgraph-info=su")
+
+    print("%-26s %7s %7s  %s" % ("thread", "depth", "advice", "notes"))
+    for entry in args.thread or THREADS:
+        result = graph.depth(entry)
+        name = entry.split(":")[-1]
+        if result is None:
+            print("%-26s %7s %7s  not found" % (name, "-", "-"))
+            continue
+        peak, chain, notes = result
+        print("%-26s %7d %7d  %s" % (name, peak, recommended_size(peak),
+                                     ", ".join(sorted(notes))))
+        if args.chain:
+            for func in chain:
+                print("    %5d %s" % (graph.frames[func],
+                                      func.split(":")[-1]))
+
+
+if __name__ == "__main__":
+    main()
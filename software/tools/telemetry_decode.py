@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""Reference codec of the binary telemetry packets (source/TelemetryCodec.c).
+
+decode: print the fixes of a file of concatenated packets.
+ride:   encode a recorded ride, an /outbox.dat copied from the SD card, the
+        way the uploader does and report the size per fix.
+"""
+
+import argparse
+import datetime
+import struct
+import sys
+
+MAGIC = b"GP"
+VERSION = 1
+
+FIELD_ALTITUDE = 1 << 0
+FIELD_SPEED = 1 << 1
+FIELD_SOURCE = 1 << 2
+FIELD_AGE = 1 << 3
+
+MAX_FIXES = 255
+UPLOAD_PAYLOAD_SIZE = 1400
+UPLOAD_FIELDS = FIELD_ALTITUDE | FIELD_SPEED
+
+# Keep in sync with FixRecord_t in source/FixRecord.h.
+FIX_RECORD = struct.Struct("<IiihH")
+SOURCES = {0: "none", 1: "gnss", 2: "cell"}
+
+
+class DecodeError(Exception):
+    pass
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def put_varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def zigzag(value):
+    return ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def wrap32(value):
+    value &= 0xFFFFFFFF
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def encode_fix(fields, fix, last):
+    time, lat, lon, alt, speed = fix
+    if last is None:
+        out = put_varint(time) + put_varint(zigzag(lat)) + \
+            put_varint(zigzag(lon))
+        if fields & FIELD_ALTITUDE:
+            out += put_varint(zigzag(alt))
+        if fields & FIELD_SPEED:
+            out += put_varint(speed)
+        return out
+    out = put_varint(zigzag(wrap32(time - last[0]))) + \
+        put_varint(zigzag(wrap32(lat - last[1]))) + \
+        put_varint(zigzag(wrap32(lon - last[2])))
+    if fields & FIELD_ALTITUDE:
+        out += put_varint(zigzag(alt - last[3]))
+    if fields & FIELD_SPEED:
+        out += put_varint(zigzag(speed - last[4]))
+    return out
+
+
+def encode(fixes, fields=UPLOAD_FIELDS, sequence=0, source=0, age=0,
+           size=UPLOAD_PAYLOAD_SIZE):
+    """Encode as many fixes as fit, returns (packet, number of fixes)."""
+    head = bytearray(MAGIC + bytes([VERSION, fields, 0]))
+    head += put_varint(sequence)
+    if fields & FIELD_SOURCE:
+        head.append(source)
+    if fields & FIELD_AGE:
+        head += put_varint(age)
+    body = bytearray()
+    last = None
+    count = 0
+    for fix in fixes:
+        if count == MAX_FIXES:
+            break
+        data = encode_fix(fields, fix, last)
+        if len(head) + len(body) + len(data) + 2 > size:
+            break
+        body += data
+        last = fix
+        count += 1
+    head[4] = count
+    packet = bytes(head + body)
+    return packet + struct.pack("<H", crc16(packet)), count
+
+
+class Reader:
+    def __init__(self, data, pos=0):
+        self.data = data
+        self.pos = pos
+
+    def byte(self):
+        if self.pos >= len(self.data):
+            raise DecodeError("truncated packet")
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def varint(self):
+        value = 0
+        for shift in range(0, 35, 7):
+            byte = self.byte()
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                return value
+        raise DecodeError("varint too long")
+
+    def zigzag(self):
+        return unzigzag(self.varint())
+
+
+def decode(data, pos=0):
+    """Decode the packet at pos, returns (packet dict, end position)."""
+    if data[pos:pos + 2] != MAGIC:
+        raise DecodeError("bad magic")
+    rd = Reader(data, pos + 2)
+    version = rd.byte()
+    if version != VERSION:
+        raise DecodeError("unknown version %d" % version)
+    fields = rd.byte()
+    count = rd.byte()
+    packet = {"sequence": rd.varint(), "fixes": []}
+    if fields & FIELD_SOURCE:
+        packet["source"] = SOURCES.get(rd.byte(), "?")
+    if fields & FIELD_AGE:
+        packet["age"] = rd.varint() / 10.0
+    last = None
+    for _ in range(count):
+        if last is None:
+            fix = [rd.varint(), rd.zigzag(), rd.zigzag(), 0, 0]
+            if fields & FIELD_ALTITUDE:
+                fix[3] = rd.zigzag()
+            if fields & FIELD_SPEED:
+                fix[4] = rd.varint()
+        else:
+            fix = [(last[0] + rd.zigzag()) & 0xFFFFFFFF,
+                   wrap32(last[1] + rd.zigzag()),
+                   wrap32(last[2] + rd.zigzag()), last[3], last[4]]
+            if fields & FIELD_ALTITUDE:
+                fix[3] = last[3] + rd.zigzag()
+            if fields & FIELD_SPEED:
+                fix[4] = last[4] + rd.zigzag()
+        packet["fixes"].append(tuple(fix))
+        last = fix
+    crc = rd.byte() | (rd.byte() << 8)
+    if crc != crc16(data[pos:rd.pos - 2]):
+        raise DecodeError("CRC mismatch")
+    return packet, rd.pos
+
+
+def decode_stream(data):
+    """Decode concatenated packets, resynchronizing on damaged ones."""
+    pos = 0
+    while True:
+        pos = data.find(MAGIC, pos)
+        if pos < 0:
+            return
+        try:
+            packet, pos = decode(data, pos)
+            yield packet
+        except DecodeError:
+            pos += 1
+
+
+def format_fix(fix):
+    time, lat, lon, alt, speed = fix
+    stamp = datetime.datetime.fromtimestamp(time, datetime.timezone.utc)
+    return "%s %.7f %.7f %d m %.2f km/h" % (
+        stamp.strftime("%Y-%m-%d %H:%M:%S"), lat / 1e7, lon / 1e7, alt,
+        speed / 100.0)
+
+
+def cmd_decode(args):
+    data = open(args.file, "rb").read()
+    for packet in decode_stream(data):
+        extra = ""
+        if "source" in packet:
+            extra += " %s" % packet["source"]
+        if "age" in packet:
+            extra += " age %.1f s" % packet["age"]
+        print("packet #%d, %d fixes%s" % (
+            packet["sequence"], len(packet["fixes"]), extra))
+        for fix in packet["fixes"]:
+            print("  " + format_fix(fix))
+
+
+def cmd_ride(args):
+    data = open(args.file, "rb").read()
+    n = len(data) // FIX_RECORD.size
+    fixes = [FIX_RECORD.unpack_from(data, i * FIX_RECORD.size)
+             for i in range(n)]
+    if not fixes:
+        sys.exit("no fixes in %s" % args.file)
+    packets = 0
+    size = 0
+    i = 0
+    while i < n:
+        packet, count = encode(fixes[i:], sequence=packets)
+        decoded, _ = decode(packet)
+        if decoded["fixes"] != [tuple(f) for f in fixes[i:i + count]]:
+            sys.exit("round trip mismatch in packet %d" % packets)
+        packets += 1
+        size += len(packet)
+        i += count
+    print("%d fixes in %d packets, %d bytes" % (n, packets, size))
+    print("%.2f bytes/fix (raw %d)" % (size / n, FIX_RECORD.size))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("decode", help="print the fixes of packets")
+    p.add_argument("file")
+    p.set_defaults(func=cmd_decode)
+    p = sub.add_parser("ride", help="size per fix of a recorded ride")
+    p.add_argument("file")
+    p.set_defaults(func=cmd_ride)
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
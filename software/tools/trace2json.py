@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Convert the /trace.log written by TraceRecorder into a Chrome trace.
+
+The output can be opened in chrome://tracing or https://ui.perfetto.dev.
+Every dump in the log becomes a separate process named after the reason
+of the dump (periodic, shell, modem, sdcard, mailbox).
+"""
+
+import argparse
+import json
+import sys
+
+STATE_NAMES = [
+    "READY", "CURRENT", "WTSTART", "SUSPENDED", "QUEUED", "WTSEM", "WTMTX",
+    "WTCOND", "SLEEPING", "WTEXIT", "WTOREVT", "WTANDEVT", "SNDMSGQ",
+    "SNDMSG", "WTMSG", "FINAL",
+]
+
+# Keep in sync with TraceEvent_t in source/TraceRecorder.h.
+USER_EVENTS = {
+    1: "system event",
+    2: "modem request",
+    3: "modem response",
+    4: "sd write begin",
+    5: "sd write end",
+    6: "fault",
+    7: "geofence",
+}
+
+RTSTAMP_BITS = 24
+IRQ_TID = 0
+
+
+class Clock:
+    """Rebuild absolute cycle counts from the system tick and the 24 bit
+    truncated realtime counter stored in every record."""
+
+    def __init__(self, freq, hclk):
+        self.cycles_per_tick = hclk / freq
+        self.hclk = hclk
+        self.last = None
+
+    def to_us(self, time, rtstamp):
+        if self.last is None:
+            cycles = time * self.cycles_per_tick
+        else:
+            last_time, last_rtstamp, last_cycles = self.last
+            ticks = (time - last_time) % (1 << 32)
+            delta = (rtstamp - last_rtstamp) % (1 << RTSTAMP_BITS)
+            expected = ticks * self.cycles_per_tick
+            wraps = max(0, round((expected - delta) / (1 << RTSTAMP_BITS)))
+            cycles = last_cycles + delta + wraps * (1 << RTSTAMP_BITS)
+        self.last = (time, rtstamp, cycles)
+        return cycles * 1e6 / self.hclk
+
+
+def parse_dumps(lines):
+    dumps = []
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        if fields[0] == "#":
+            dumps.append({"reason": fields[1], "freq": int(fields[3]),
+                          "hclk": int(fields[4]), "threads": {},
+                          "records": []})
+        elif not dumps:
+            continue
+        elif fields[0] == "T":
+            dumps[-1]["threads"][int(fields[1], 16)] = " ".join(fields[2:])
+        else:
+            dumps[-1]["records"].append(fields)
+    return dumps
+
+
+def convert_dump(pid, dump):
+    events = [{"ph": "M", "pid": pid, "name": "process_name",
+               "args": {"name": dump["reason"]}},
+              {"ph": "M", "pid": pid, "tid": IRQ_TID, "name": "thread_name",
+               "args": {"name": "irq"}}]
+    for addr, name in dump["threads"].items():
+        events.append({"ph": "M", "pid": pid, "tid": addr,
+                       "name": "thread_name", "args": {"name": name}})
+
+    clock = Clock(dump["freq"], dump["hclk"])
+    running = None
+    for fields in dump["records"]:
+        kind = fields[0]
+        ts = clock.to_us(int(fields[1]), int(fields[2]))
+        if kind == "S":
+            ntp = int(fields[3], 16)
+            state = int(fields[5])
+            if running is not None:
+                tid, begin = running
+                events.append({"ph": "X", "pid": pid, "tid": tid,
+                               "name": "running", "ts": begin,
+                               "dur": ts - begin,
+                               "args": {"out": STATE_NAMES[state]
+                                        if state < len(STATE_NAMES)
+                                        else state,
+                                        "wtobj": fields[4]}})
+            running = (ntp, ts)
+        elif kind in ("I", "L"):
+            events.append({"ph": "B" if kind == "I" else "E", "pid": pid,
+                           "tid": IRQ_TID, "name": fields[3], "ts": ts})
+        elif kind == "H":
+            events.append({"ph": "i", "s": "g", "pid": pid, "tid": IRQ_TID,
+                           "name": "halt: " + " ".join(fields[3:]),
+                           "ts": ts})
+        elif kind == "U":
+            event = int(fields[3])
+            events.append({"ph": "i", "s": "t", "pid": pid,
+                           "tid": running[0] if running else IRQ_TID,
+                           "name": USER_EVENTS.get(event, str(event)),
+                           "ts": ts, "args": {"arg": int(fields[4])}})
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("log", help="trace.log copied from the SD card")
+    parser.add_argument("-o", "--output", help="output file, default stdout")
+    parser.add_argument("-d", "--dump", type=int,
+                        help="convert only the given dump, 0 is the first")
+    args = parser.parse_args()
+
+    with open(args.log) as log:
+        dumps = parse_dumps(log)
+
+    if args.dump is not None:
+        dumps = dumps[args.dump:args.dump + 1]
+
+    events = []
+    for pid, dump in enumerate(dumps, 1):
+        events.extend(convert_dump(pid, dump))
+
+    output = open(args.output, "w") if args.output else sys.stdout
+    json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, output)
+    if args.output:
+        output.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,259 @@
+/**
+ * @file tripstats_check.c
+ * @brief Host check of the trip statistics against a recomputation.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -o tripstats_check tools/tripstats_check.c \
+ *      source/TripStats.c source/GeoMath.c -lm
+ *   ./tripstats_check [sim8xx_gnss.log ...]
+ *
+ * Every log is replayed fix by fix through tsUpdate() and recomputed in one
+ * pass in double precision with haversine distances and the same rules.
+ * Without arguments a synthetic ride is written to a temporary log first:
+ * riding with turns and climbs, stops with a wandering receiver, missing
+ * fixes and position spikes. Its true length is known, so the jitter
+ * filter is checked against it and against the plain sum of the steps.
+ */
+
+#include "TripStats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_FIXES           200000
+#define EARTH_RADIUS_IN_M   6371009.0
+#define DEG                 1e7
+
+typedef struct {
+  uint32_t distance;
+  uint32_t movingTime;
+  uint32_t elevationGain;
+  uint32_t stops;
+  uint16_t maxSpeed;
+  uint32_t rejected;
+} Totals_t;
+
+static TsFix_t fixes[MAX_FIXES];
+
+static double rad(int32_t value) {
+  return value / DEG * M_PI / 180.0;
+}
+
+static double haversine(const TsFix_t *a, const TsFix_t *b) {
+  double dlat = rad(b->lat) - rad(a->lat);
+  double dlon = rad(b->lon) - rad(a->lon);
+  double h = sin(dlat / 2) * sin(dlat / 2) +
+             cos(rad(a->lat)) * cos(rad(b->lat)) * sin(dlon / 2) * sin(dlon / 2);
+  return 2 * EARTH_RADIUS_IN_M * asin(sqrt(h)) * 100.0;
+}
+
+/* Days from 1970-01-01 of a proleptic Gregorian date. */
+static long days(int y, int m, int d) {
+  y -= m <= 2;
+  long era = (y >= 0 ? y : y - 399) / 400;
+  long yoe = y - era * 400;
+  long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/*
+ * Lines of GpsReaderThread.c: date lat lon speed altitude fix sats...,
+ * cell positions and fixless lines are skipped like the firmware does.
+ */
+static size_t parse(const char *path) {
+  FILE *f = fopen(path, "r");
+  char line[200];
+  size_t n = 0;
+
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), f) && (n < MAX_FIXES)) {
+    int y, mo, d, h, mi, s, fix;
+    double lat, lon, speed, alt;
+    if ((11 != sscanf(line, "%4d%2d%2d%2d%2d%2d%*s %lf %lf %lf %lf %d", &y,
+                      &mo, &d, &h, &mi, &s, &lat, &lon, &speed, &alt,
+                      &fix)) || (1 != fix))
+      continue;
+    TsFix_t *p = &fixes[n++];
+    p->time = (uint32_t)(days(y, mo, d) * 86400L + h * 3600L + mi * 60L + s);
+    p->lat = (int32_t)lround(lat * DEG);
+    p->lon = (int32_t)lround(lon * DEG);
+    p->altitude = (int16_t)lround(alt);
+    p->speed = (uint16_t)lround(speed * 100.0);
+  }
+  fclose(f);
+  return n;
+}
+
+/*
+ * Same rules as tsUpdate(), written as a batch loop over doubles.
+ */
+static void recompute(const TsFix_t *f, size_t n, Totals_t *t) {
+  size_t anchor = 0, last = 0, i;
+  double distance = 0.0;
+  uint32_t lastMove = f[0].time;
+  int ref = f[0].altitude;
+  int stopped = 0;
+
+  memset(t, 0, sizeof(*t));
+  for (i = 1; i < n; ++i) {
+    if (f[i].time <= f[last].time) {
+      t->rejected++;
+      continue;
+    }
+    double d = haversine(&f[anchor], &f[i]);
+    double kmh = d / 100.0 / (f[i].time - f[last].time) * 3.6;
+    if ((f[i].speed > TS_MAX_SPEED) || (kmh * 100.0 > TS_MAX_SPEED)) {
+      t->rejected++;
+      continue;
+    }
+    uint32_t dt = f[i].time - f[last].time;
+    last = i;
+    if ((d < TS_JITTER_RADIUS_IN_CM) && (f[i].speed < TS_MOVING_SPEED)) {
+      if (!stopped && (f[i].time - lastMove >= TS_STOP_MIN_TIME_IN_S)) {
+        stopped = 1;
+        t->stops++;
+      }
+      continue;
+    }
+    distance += d;
+    t->movingTime += dt;
+    lastMove = f[i].time;
+    stopped = 0;
+    if (f[i].speed > t->maxSpeed)
+      t->maxSpeed = f[i].speed;
+    if (f[i].altitude - ref >= TS_CLIMB_THRESHOLD_IN_M) {
+      t->elevationGain += (uint32_t)(f[i].altitude - ref);
+      ref = f[i].altitude;
+    } else if (f[i].altitude - ref <= -TS_CLIMB_THRESHOLD_IN_M) {
+      ref = f[i].altitude;
+    }
+    anchor = i;
+  }
+  t->distance = (uint32_t)lround(distance);
+}
+
+static double noise(double amplitude) {
+  return amplitude * (2.0 * rand() / RAND_MAX - 1.0);
+}
+
+/*
+ * A 5 s fix period as on the device, positions in meters around Budapest.
+ */
+static double synthesize(const char *path) {
+  FILE *f = fopen(path, "w");
+  const double lat0 = 47.4979, lon0 = 19.0402;
+  const double mPerDegLat = EARTH_RADIUS_IN_M * M_PI / 180.0;
+  const double mPerDegLon = mPerDegLat * cos(lat0 * M_PI / 180.0);
+  double x = 0.0, y = 0.0, heading = 0.3, alt = 110.0, truth = 0.0;
+  time_t t = 1767268800;
+  int i;
+
+  srand(7);
+  for (i = 0; i < 4000; ++i, t += 5) {
+    int phase = (i / 200) % 4;
+    double speed = 0.0;                 /* m/s */
+    if (phase != 3) {
+      speed = 8.0 + 6.0 * sin(i / 40.0);
+      heading += noise(0.15);
+      alt += (phase == 1) ? 0.6 : (phase == 2 ? -0.5 : 0.0);
+    }
+    double step = speed * 5.0;
+    x += step * sin(heading);
+    y += step * cos(heading);
+    truth += step;
+
+    if (0 == rand() % 25)
+      continue;                         /* Missing fix. */
+    double ex = noise(4.0), ey = noise(4.0);
+    if (0 == rand() % 400) {
+      ex += 3000.0;                     /* Spike. */
+    }
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    fprintf(f, "%04d%02d%02d%02d%02d%02d.000 %f %f %f %f 1 12 14 9\n",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+            tm.tm_min, tm.tm_sec, lat0 + (y + ey) / mPerDegLat,
+            lon0 + (x + ex) / mPerDegLon,
+            (speed > 0.0) ? speed * 3.6 + noise(1.0) : fabs(noise(2.5)),
+            alt + noise(2.0));
+  }
+  fclose(f);
+  return truth * 100.0;
+}
+
+static int check(const char *path, double truth) {
+  size_t n = parse(path), i;
+  TripStats_t ts;
+  Totals_t ref;
+  double naive = 0.0;
+
+  if (n < 2) {
+    printf("%s: no fixes\n", path);
+    return 0;
+  }
+
+  tsInit(&ts);
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < n; ++i)
+    tsUpdate(&ts, &fixes[i]);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / n;
+
+  recompute(fixes, n, &ref);
+  for (i = 1; i < n; ++i)
+    naive += haversine(&fixes[i - 1], &fixes[i]);
+
+  double error = 100.0 * ((double)ts.distance - ref.distance) /
+                 (ref.distance ? ref.distance : 1);
+  printf("%s: %zu fixes, %.0f ns/fix\n", path, n, ns);
+  printf("  %-10s %12s %12s\n", "", "tsUpdate", "recomputed");
+  printf("  %-10s %12.3f %12.3f km (%+.3f %%)\n", "distance",
+         ts.distance / 1e5, ref.distance / 1e5, error);
+  printf("  %-10s %12u %12u s\n", "moving", ts.movingTime, ref.movingTime);
+  printf("  %-10s %12.2f %12.2f km/h\n", "average", tsAverageSpeed(&ts) / 100.0,
+         ref.movingTime ? ref.distance * 0.036 / ref.movingTime : 0.0);
+  printf("  %-10s %12.2f %12.2f km/h\n", "max", ts.maxSpeed / 100.0,
+         ref.maxSpeed / 100.0);
+  printf("  %-10s %12u %12u m\n", "gain", ts.elevationGain, ref.elevationGain);
+  printf("  %-10s %12u %12u\n", "stops", ts.stops, ref.stops);
+  printf("  %-10s %12u %12u\n", "rejected", ts.rejected, ref.rejected);
+  if (truth > 0.0)
+    printf("  true length %.3f km, sum of all steps %.3f km\n", truth / 1e5,
+           naive / 1e5);
+
+  int ok = (fabs(error) < 0.5) && (ts.stops == ref.stops) &&
+           (ts.elevationGain == ref.elevationGain) &&
+           (ts.maxSpeed == ref.maxSpeed) &&
+           (abs((int)ts.movingTime - (int)ref.movingTime) <=
+            (int)ref.movingTime / 100);
+  printf("  %s\n", ok ? "OK" : "MISMATCH");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+  int failed = 0, i;
+
+  if (argc < 2) {
+    char path[] = "/tmp/tripstats_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+      perror("mkstemp");
+      return 1;
+    }
+    double truth = synthesize(path);
+    failed = check(path, truth);
+    remove(path);
+  }
+  for (i = 1; i < argc; ++i)
+    failed |= check(argv[i], 0.0);
+
+  return failed;
+}
@@ -0,0 +1,329 @@
+/**
+ * @file upload_sched.c
+ * @brief Host simulation of the upload policy on synthetic coverage traces.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Isource -Iconfig -o upload_sched tools/upload_sched.c \
+ *      source/UploadScheduler.c
+ *   ./upload_sched
+ *
+ * A ride with a fix every 5 s is replayed in 1 s steps against coverage
+ * traces, once with the GTRACK_UPLOAD_* policy and once sending every fix
+ * as soon as it is produced. The costs come from a simple session model and
+ * are reported per delivered fix.
+ *
+ * usDecide() is checked on its own first: nothing is sent without a link,
+ * a full packet and the last flush before parking are always sent, and the
+ * recheck time is exact, the decision changes when the oldest fix has aged
+ * by it and not a millisecond earlier. In the simulation every fix has to be
+ * delivered unless the trace ends without coverage, and the policy must not
+ * open more sessions than the baseline.
+ */
+
+#include "UploadScheduler.h"
+#include "gtrackconf.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Simulated ride, a fix every 5 s for an hour in 1 s steps.
+ */
+#define SIM_DURATION_IN_S           3600
+#define SIM_FIX_PERIOD_IN_S         5
+
+/*
+ * Cost model of a session: PDP activation, TCP handshake and close, the
+ * IP/TCP overhead and the telemetry header of each packet, about 7 bytes
+ * per fix, and the time the radio stays on after the last transfer.
+ */
+#define SIM_SESSION_BYTES           480
+#define SIM_PACKET_BYTES            52
+#define SIM_FIX_BYTES               7
+#define SIM_RADIO_TAIL_IN_MS        5000
+
+typedef struct {
+  bool covered;
+  int rssi;
+  uint32_t supply;
+} SimSample_t;
+
+typedef struct {
+  const char *name;
+  void (*sample)(uint32_t t, SimSample_t *s);
+} SimTrace_t;
+
+typedef struct {
+  uint32_t produced;
+  uint32_t points;
+  uint32_t sessions;
+  uint32_t bytes;
+  uint32_t radioOn;
+  uint32_t maxLatency;
+  bool coveredAtEnd;
+} SimResult_t;
+
+/*
+ * Session setup time in ms and throughput in bytes/s of the link classes.
+ */
+static const uint32_t simSetup[US_LINK_NUM] = {2500, 5000, 10000};
+static const uint32_t simRate[US_LINK_NUM] = {4000, 1500, 400};
+
+/*
+ * Every fix is sent as soon as it is produced.
+ */
+static const UploadPolicy_t eachFixPolicy = {
+  GTRACK_UPLOAD_GOOD_RSSI, GTRACK_UPLOAD_POOR_RSSI, 0, 0, 1, 1, 1
+};
+
+static void traceGood(uint32_t t, SimSample_t *s) {
+  (void)t;
+  s->rssi = -71;
+}
+
+static void traceWeak(uint32_t t, SimSample_t *s) {
+  (void)t;
+  s->rssi = -93;
+}
+
+static void tracePoor(uint32_t t, SimSample_t *s) {
+  (void)t;
+  s->rssi = -105;
+}
+
+/*
+ * Two minutes of good and two minutes of weak signal between buildings.
+ */
+static void traceUrban(uint32_t t, SimSample_t *s) {
+  s->rssi = ((t / 120U) & 1U) ? -95 : -75;
+}
+
+/*
+ * No coverage for 4 minutes every 15 minutes.
+ */
+static void traceTunnel(uint32_t t, SimSample_t *s) {
+  s->covered = (t % 900U) >= 240U;
+  s->rssi = s->covered ? -79 : 0;
+}
+
+/*
+ * The signal swings between -80 and -110 dBm every 10 minutes, with no
+ * coverage at the bottom.
+ */
+static void traceFringe(uint32_t t, SimSample_t *s) {
+  uint32_t phase = t % 600U;
+  uint32_t depth = (phase < 300U) ? phase : 600U - phase;
+  s->rssi = -80 - (int)(depth / 10U);
+  s->covered = s->rssi > -108;
+}
+
+static void traceLowSupply(uint32_t t, SimSample_t *s) {
+  traceUrban(t, s);
+  s->supply = 3450;
+}
+
+static const SimTrace_t traces[] = {
+  {"good", traceGood},
+  {"weak", traceWeak},
+  {"poor", tracePoor},
+  {"urban", traceUrban},
+  {"tunnel", traceTunnel},
+  {"fringe", traceFringe},
+  {"lowbat", traceLowSupply},
+};
+
+/*
+ * Send every pending fix in full packets, the link is the one at the start
+ * of the session. Returns the duration of the session in ms.
+ */
+static uint32_t simSession(const UploadPolicy_t *policy, UploadLink_t link,
+                           uint32_t pending, SimResult_t *res) {
+  uint32_t packets = (pending + policy->fullBatch - 1U) / policy->fullBatch;
+  uint32_t bytes = SIM_SESSION_BYTES + packets * SIM_PACKET_BYTES +
+                   pending * SIM_FIX_BYTES;
+  uint32_t duration = simSetup[link] + (bytes * 1000U) / simRate[link];
+
+  res->sessions++;
+  res->bytes += bytes;
+  res->radioOn += duration + SIM_RADIO_TAIL_IN_MS;
+  res->points += pending;
+  return duration;
+}
+
+static void simRun(const UploadPolicy_t *policy, const SimTrace_t *trace,
+                   SimResult_t *res) {
+  uint32_t pending = 0;
+  uint32_t oldest = 0;
+  uint32_t busyUntil = 0;
+  uint32_t t;
+
+  memset(res, 0, sizeof(*res));
+  for (t = 0; t <= SIM_DURATION_IN_S; ++t) {
+    SimSample_t s = {true, 0, 4000};
+    trace->sample(t, &s);
+    res->coveredAtEnd = s.covered;
+
+    if (0U == (t % SIM_FIX_PERIOD_IN_S)) {
+      if (0U == pending)
+        oldest = t;
+      pending++;
+      res->produced++;
+    }
+
+    if ((t < busyUntil) || (0U == pending))
+      continue;
+
+    const UploadConditions_t cond = {
+      s.covered, t < SIM_DURATION_IN_S, s.rssi, s.supply, pending,
+      (t - oldest) * 1000U
+    };
+    UploadDecision_t decision;
+    usDecide(policy, &cond, &decision);
+    if (!decision.flush)
+      continue;
+
+    UploadLink_t link = usClassifyLink(policy, s.rssi);
+    uint32_t duration = simSession(policy, link, pending, res);
+    uint32_t latency = (t - oldest) * 1000U + duration;
+    if (latency > res->maxLatency)
+      res->maxLatency = latency;
+    busyUntil = t + (duration + 999U) / 1000U;
+    pending = 0;
+  }
+}
+
+static void simPrint(const char *trace, const char *policy,
+                     const SimResult_t *res) {
+  if (0U == res->points) {
+    printf("%-8s%-8snothing delivered\n", trace, policy);
+    return;
+  }
+
+  printf("%-8s%-8s%6u%6u%8.2f%8u%8u\n", trace, policy, res->points,
+         res->sessions, (double)res->bytes / res->points,
+         res->radioOn / res->points, res->maxLatency / 1000U);
+}
+
+static bool simCheck(const char *trace, const SimResult_t *policy,
+                     const SimResult_t *each) {
+  bool ok = true;
+  if (policy->coveredAtEnd && (policy->points != policy->produced)) {
+    printf("FAIL %s: %u of %u fixes delivered\n", trace, policy->points,
+           policy->produced);
+    ok = false;
+  }
+  if (policy->sessions > each->sessions) {
+    printf("FAIL %s: %u sessions, %u sending each fix\n", trace,
+           policy->sessions, each->sessions);
+    ok = false;
+  }
+  return ok;
+}
+
+static bool expect(bool cond, const char *what) {
+  if (!cond)
+    printf("FAIL %s\n", what);
+  return cond;
+}
+
+/*
+ * Aging alone changes the decision exactly after the recheck time, for
+ * every link class, supply and a range of pending volumes.
+ */
+static bool checkRecheck(const UploadPolicy_t *policy) {
+  static const int rssis[] = {-71, -93, -105, 0};
+  static const uint32_t supplies[] = {0, 4000, 3450};
+  bool ok = true;
+  size_t r, s;
+  size_t pending;
+
+  for (r = 0; r < sizeof(rssis) / sizeof(rssis[0]); ++r) {
+    for (s = 0; s < sizeof(supplies) / sizeof(supplies[0]); ++s) {
+      for (pending = 1; pending < policy->fullBatch; ++pending) {
+        UploadConditions_t cond = {true, true, rssis[r], supplies[s],
+                                   pending, 0};
+        UploadDecision_t first, before, after;
+        usDecide(policy, &cond, &first);
+        if (first.flush)
+          continue;
+        cond.age = first.recheck - 1U;
+        usDecide(policy, &cond, &before);
+        cond.age = first.recheck;
+        usDecide(policy, &cond, &after);
+        if (before.flush || !after.flush ||
+            (before.recheck != 1U)) {
+          printf("FAIL recheck %lu ms at %d dBm, %lu mV, %zu pending\n",
+                 (unsigned long)first.recheck, rssis[r],
+                 (unsigned long)supplies[s], pending);
+          ok = false;
+        }
+      }
+    }
+  }
+  return ok;
+}
+
+static bool checkDecide(const UploadPolicy_t *policy) {
+  UploadDecision_t d;
+  bool ok = true;
+
+  UploadConditions_t offline = {false, false, -71, 4000,
+                                policy->fullBatch, 3600000U};
+  usDecide(policy, &offline, &d);
+  ok = expect(!d.flush && (US_RECHECK_NEVER == d.recheck),
+              "sent without a link") && ok;
+
+  UploadConditions_t empty = {true, false, -71, 4000, 0, 0};
+  usDecide(policy, &empty, &d);
+  ok = expect(!d.flush, "sent an empty outbox") && ok;
+
+  UploadConditions_t parking = {true, false, -110, 3450, 1, 0};
+  usDecide(policy, &parking, &d);
+  ok = expect(d.flush, "no last flush before parking") && ok;
+
+  UploadConditions_t full = {true, true, -110, 3450, policy->fullBatch, 0};
+  usDecide(policy, &full, &d);
+  ok = expect(d.flush, "full packet held back") && ok;
+
+  UploadConditions_t good = {true, true, -71, 4000, policy->goodBatch, 0};
+  usDecide(policy, &good, &d);
+  ok = expect(d.flush, "good batch held back") && ok;
+  good.pending--;
+  usDecide(policy, &good, &d);
+  ok = expect(!d.flush && (policy->latency == d.recheck),
+              "good link budget") && ok;
+
+  ok = expect(US_LINK_WEAK == usClassifyLink(policy, 0),
+              "unknown signal is not weak") && ok;
+  ok = expect(US_LINK_GOOD == usClassifyLink(policy, policy->goodRssi),
+              "good threshold") && ok;
+  ok = expect(US_LINK_POOR == usClassifyLink(policy, policy->poorRssi - 1),
+              "poor threshold") && ok;
+
+  return checkRecheck(policy) && ok;
+}
+
+int main(void) {
+  UploadPolicy_t policy;
+  SimResult_t each, res;
+  size_t i;
+
+  usDefaultPolicy(&policy);
+  bool ok = checkDecide(&policy);
+
+  printf("good link >= %d dBm, poor link < %d dBm\n", policy.goodRssi,
+         policy.poorRssi);
+  printf("%-8s%-8s%6s%6s%8s%8s%8s\n", "trace", "policy", "fixes", "sess",
+         "B/fix", "ms/fix", "lat s");
+  for (i = 0; i < sizeof(traces) / sizeof(traces[0]); ++i) {
+    simRun(&eachFixPolicy, &traces[i], &each);
+    simPrint(traces[i].name, "each", &each);
+    simRun(&policy, &traces[i], &res);
+    simPrint(traces[i].name, "policy", &res);
+    ok = simCheck(traces[i].name, &res, &each) && ok;
+  }
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
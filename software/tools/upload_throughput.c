@@ -0,0 +1,300 @@
+/**
+ * @file upload_throughput.c
+ * @brief Host measurement of the outbox drain rate of the TCP uploader.
+ *
+ * Build and run from the software directory:
+ *
+ *   cc -O2 -Itools/host -Isource -Iconfig -o upload_throughput \
+ *      tools/upload_throughput.c source/Outbox.c source/TelemetryCodec.c -lm
+ *   ./upload_throughput [fixes]
+ *
+ * The fixes of a synthetic ride, one every 5 s like the GPS reader writes
+ * them, are queued with obAppend() in a temporary directory. The outbox is
+ * then drained the way uploadBatch() does it: obPeek() of a batch, the
+ * batch packed into one send with the telemetry encoder, obAck() of the
+ * packed fixes. Every fix has to come out once and in order, every packet
+ * has to fit in a single send and the outbox has to be empty at the end.
+ *
+ * The host measures the bytes per fix and the fixes per send, which are
+ * the same on the target, and the time of the path without the modem,
+ * which only shows that it is not the limit. The modem is not measured.
+ * The drain rate is given for a range of uplink rates and round trip
+ * times, with a batch costing its transfer, the wait for the TCP ack in
+ * the poll period of waitAck() and the AT commands. The 'upload' shell
+ * command prints the rate of the last session on the device.
+ */
+
+#include "Outbox.h"
+#include "PositionHistory.h"
+#include "TelemetryCodec.h"
+#include "Sdcard.h"
+#include "gtrackconf.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Keep in sync with source/UploaderThread.c. */
+#define UPLOAD_PAYLOAD_SIZE         1400
+#define UPLOAD_FIELDS               (TC_FIELD_ALTITUDE | TC_FIELD_SPEED)
+#define ACK_POLL_PERIOD_IN_MS       200
+
+#define FIX_PERIOD_IN_S             5
+#define DEFAULT_FIXES               7200
+#define MODEM_BAUD                  115200
+#define AT_COMMAND_IN_MS            20
+
+static char directory[64];
+static FixRecord_t batch[GTRACK_UPLOAD_BATCH_SIZE];
+static uint8_t payload[UPLOAD_PAYLOAD_SIZE];
+
+/*
+ * ChibiOS, FatFs and SD card stand-ins, a single thread and the files in
+ * the temporary directory.
+ */
+void chMtxObjectInit(mutex_t *mp) { mp->owner = 0; }
+void chMtxLock(mutex_t *mp) { mp->owner = 1; }
+void chMtxUnlock(mutex_t *mp) { mp->owner = 0; }
+rtcnt_t chSysGetRealtimeCounterX(void) { return 0; }
+bool sdcardIsMounted(void) { return true; }
+
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
+  (void)chp;
+  (void)fmt;
+  return 0;
+}
+
+size_t phForEach(uint32_t from, uint32_t to, PositionHistoryVisitor_t visitor,
+                 void *arg) {
+  (void)from;
+  (void)to;
+  (void)visitor;
+  (void)arg;
+  return 0;
+}
+
+static void fileName(char *name, size_t size, const char *path) {
+  snprintf(name, size, "%s%s", directory, path);
+}
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode) {
+  char name[96];
+  fileName(name, sizeof(name), path);
+  const char *how = "rb";
+  if (FA_OPEN_APPEND == (mode & FA_OPEN_APPEND))
+    how = "ab";
+  else if (mode & FA_CREATE_ALWAYS)
+    how = "wb";
+  fp->fp = fopen(name, how);
+  return fp->fp ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+  *br = (UINT)fread(buff, 1, btr, fp->fp);
+  return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+  *bw = (UINT)fwrite(buff, 1, btw, fp->fp);
+  return FR_OK;
+}
+
+FRESULT f_close(FIL *fp) {
+  fclose(fp->fp);
+  return FR_OK;
+}
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs) {
+  return fseek(fp->fp, (long)ofs, SEEK_SET) ? FR_DISK_ERR : FR_OK;
+}
+
+FSIZE_t f_size(FIL *fp) {
+  struct stat st;
+  fflush(fp->fp);
+  return fstat(fileno(fp->fp), &st) ? 0U : (FSIZE_t)st.st_size;
+}
+
+FRESULT f_stat(const char *path, FILINFO *fno) {
+  char name[96];
+  struct stat st;
+  fileName(name, sizeof(name), path);
+  if (stat(name, &st))
+    return FR_NO_FILE;
+  fno->fsize = (FSIZE_t)st.st_size;
+  return FR_OK;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * City and country roads, stops included, heading and speed wander like
+ * they do on a bike.
+ */
+static void makeRide(FixRecord_t ride[], uint32_t fixes) {
+  double lat = 47.4979, lon = 19.0402, alt = 120.0, heading = 0.0;
+  double speed = 0.0;
+  uint32_t i;
+
+  for (i = 0; i < fixes; ++i) {
+    heading += ((double)rand() / RAND_MAX - 0.5) * 0.6;
+    speed += ((double)rand() / RAND_MAX - 0.5) * 20.0;
+    if (speed < 0.0)
+      speed = 0.0;
+    if (speed > 110.0)
+      speed = 110.0;
+    alt += ((double)rand() / RAND_MAX - 0.5) * 4.0;
+
+    double meters = speed / 3.6 * FIX_PERIOD_IN_S;
+    lat += meters * cos(heading) / 111320.0;
+    lon += meters * sin(heading) / (111320.0 * cos(lat * M_PI / 180.0));
+
+    ride[i].time = 1700000000U + i * FIX_PERIOD_IN_S;
+    ride[i].latitude = (int32_t)lround(lat * FR_DEGREE_SCALE);
+    ride[i].longitude = (int32_t)lround(lon * FR_DEGREE_SCALE);
+    ride[i].altitude = (int16_t)lround(alt);
+    ride[i].speed = (uint16_t)lround(speed * FR_SPEED_SCALE);
+  }
+}
+
+/*
+ * The encodeBatch() of the uploader.
+ */
+static size_t encodeBatch(size_t num, size_t *encoded, uint32_t sequence) {
+  const TelemetryHeader_t header = {UPLOAD_FIELDS, sequence, 0, 0};
+  TelemetryEncoder_t enc;
+  size_t i;
+
+  tcEncoderInit(&enc, payload, sizeof(payload), &header);
+  for (i = 0; (i < num) && tcEncoderAdd(&enc, &batch[i]); ++i)
+    ;
+  *encoded = i;
+  return tcEncoderFinish(&enc);
+}
+
+/*
+ * Milliseconds a batch of the given size keeps the uploader busy: the
+ * CIPSEND prompt, the payload on the modem UART and on the uplink, then
+ * CIPACK polled until the ack is back after a round trip.
+ */
+static double batchTime(double bytes, double kbps, double rttMs) {
+  double send = 2 * AT_COMMAND_IN_MS + bytes * 10.0 * 1000.0 / MODEM_BAUD +
+                bytes * 8.0 / kbps;
+  double polls = ceil(rttMs / ACK_POLL_PERIOD_IN_MS);
+  return send + polls * ACK_POLL_PERIOD_IN_MS +
+         (polls + 1.0) * AT_COMMAND_IN_MS;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t fixes = (argc > 1) ? (uint32_t)atol(argv[1]) : DEFAULT_FIXES;
+  bool ok = true;
+  uint32_t i;
+
+  snprintf(directory, sizeof(directory), "/tmp/upload_throughputXXXXXX");
+  if (!mkdtemp(directory)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  srand(1);
+
+  FixRecord_t *ride = malloc(fixes * sizeof(FixRecord_t));
+  if (!ride)
+    return 1;
+  makeRide(ride, fixes);
+
+  obInit();
+  double t0 = now();
+  for (i = 0; i < fixes; ++i) {
+    if (!obAppend(&ride[i])) {
+      printf("FAIL append of fix %lu\n", (unsigned long)i);
+      ok = false;
+      break;
+    }
+  }
+  double append = now() - t0;
+
+  uint32_t drained = 0, packets = 0, bytes = 0, bigger = 0;
+  t0 = now();
+  while (ok) {
+    size_t num = obPeek(batch, GTRACK_UPLOAD_BATCH_SIZE);
+    if (0 == num)
+      break;
+    size_t length = encodeBatch(num, &num, packets);
+    if ((0 == num) || (length > UPLOAD_PAYLOAD_SIZE)) {
+      bigger++;
+      break;
+    }
+    for (i = 0; i < num; ++i) {
+      if ((drained + i >= fixes) ||
+          memcmp(&ride[drained + i], &batch[i], sizeof(batch[i]))) {
+        printf("FAIL fix %lu read back changed\n",
+               (unsigned long)(drained + i));
+        ok = false;
+        break;
+      }
+    }
+    if (!obAck(num)) {
+      printf("FAIL ack of %zu fixes\n", num);
+      ok = false;
+    }
+    drained += (uint32_t)num;
+    bytes += (uint32_t)length;
+    packets++;
+  }
+  double drain = now() - t0;
+
+  if (bigger) {
+    printf("FAIL %lu packets do not fit in a send\n", (unsigned long)bigger);
+    ok = false;
+  }
+  if ((drained != fixes) || (0U != obPending())) {
+    printf("FAIL %lu of %lu fixes drained, %zu pending\n",
+           (unsigned long)drained, (unsigned long)fixes, obPending());
+    ok = false;
+  }
+
+  if (drained > 0U) {
+    double perPacket = (double)drained / packets;
+    double packetBytes = (double)bytes / packets;
+    printf("%lu fixes in %lu packets, %.2f bytes/fix (raw %zu), "
+           "%.1f fixes/packet\n", (unsigned long)drained,
+           (unsigned long)packets, (double)bytes / drained,
+           sizeof(FixRecord_t), perPacket);
+    printf("host: append %.0f fixes/s, peek+encode+ack %.0f fixes/s\n",
+           fixes / append, drained / drain);
+    printf("drain rate in fixes/min by uplink and round trip time:\n");
+    printf("%12s", "kbit/s");
+    static const double rtts[] = {300.0, 700.0, 1500.0};
+    static const double rates[] = {8.0, 20.0, 40.0};
+    size_t r, k;
+    for (r = 0; r < sizeof(rtts) / sizeof(rtts[0]); ++r)
+      printf("  rtt %4.0f ms", rtts[r]);
+    printf("\n");
+    for (k = 0; k < sizeof(rates) / sizeof(rates[0]); ++k) {
+      printf("%12.0f", rates[k]);
+      for (r = 0; r < sizeof(rtts) / sizeof(rtts[0]); ++r)
+        printf("  %11.0f",
+               perPacket * 60000.0 / batchTime(packetBytes, rates[k],
+                                               rtts[r]));
+      printf("\n");
+    }
+  }
+
+  char name[96];
+  fileName(name, sizeof(name), "/outbox.dat");
+  remove(name);
+  fileName(name, sizeof(name), "/outbox.cur");
+  remove(name);
+  rmdir(directory);
+  free(ride);
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}